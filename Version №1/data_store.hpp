@@ -32,14 +32,14 @@ public:
             return false;
         }
         
-        std::unique_lock lock(mutex);
-        DeviceData& device = devices[device_id];
-        
-        uint64_t now = utils::current_time_millis();
+        uint64_t now = utils::coarse_time_millis();
         if (timestamp > now + 60000) { 
             return false;
         }
         
+        std::unique_lock lock(mutex);
+        DeviceData& device = devices[device_id];
+        
         int index = device.head;
         device.buffer[index].value = static_cast<double>(value);
         device.buffer[index].timestamp = timestamp;
@@ -172,10 +172,11 @@ public:
     void cleanup_old(uint64_t max_age_seconds) {
         if (max_age_seconds == 0) return;
         
-        std::unique_lock lock(mutex);
         uint64_t now = utils::current_time_millis();
         uint64_t cutoff = now - (max_age_seconds * 1000);
         
+        std::unique_lock lock(mutex);
+        
         for (auto& [id, device] : devices) {
             int valid_count = 0;
             for (int i = 0; i < device.count; ++i) {
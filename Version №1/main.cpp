@@ -61,6 +61,7 @@ int main(int argc, char* argv[]) {
         BinaryServer binary_server(binary_port);
         HttpServer http_server(http_port);
         
+        utils::CoarseClock::instance().start();
         binary_server.start();
         http_server.start();
         
@@ -85,6 +86,7 @@ int main(int argc, char* argv[]) {
         std::cout << "Shutting down servers...\n";
         http_server.stop();
         binary_server.stop();
+        utils::CoarseClock::instance().stop();
         auto final_stats = DataStore::instance().get_global_stats();
         std::cout << "\n=== Final Statistics ===\n";
         std::cout << "Total updates processed: " << final_stats.total_updates << "\n";
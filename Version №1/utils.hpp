@@ -6,6 +6,8 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace utils {
 
@@ -48,6 +50,54 @@ namespace utils {
         auto duration = now.time_since_epoch();
         return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
     }
+
+    // Wall clock refreshed by a background thread once per millisecond, so the
+    // ingest path reads an atomic instead of calling system_clock::now() per
+    // sample. Until start() is called it falls back to the precise clock.
+    class CoarseClock {
+    public:
+        static CoarseClock& instance() {
+            static CoarseClock clock;
+            return clock;
+        }
+
+        void start() {
+            if (running.exchange(true)) return;
+            millis.store(current_time_millis(), std::memory_order_relaxed);
+            ticker = std::thread([this]() {
+                while (running.load(std::memory_order_relaxed)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    millis.store(current_time_millis(), std::memory_order_relaxed);
+                }
+            });
+        }
+
+        void stop() {
+            if (!running.exchange(false)) return;
+            if (ticker.joinable()) {
+                ticker.join();
+            }
+        }
+
+        uint64_t now_millis() const {
+            if (!running.load(std::memory_order_relaxed)) return current_time_millis();
+            return millis.load(std::memory_order_relaxed);
+        }
+
+    private:
+        CoarseClock() = default;
+        ~CoarseClock() { stop(); }
+        CoarseClock(const CoarseClock&) = delete;
+        CoarseClock& operator=(const CoarseClock&) = delete;
+
+        std::atomic<bool> running{false};
+        std::atomic<uint64_t> millis{0};
+        std::thread ticker;
+    };
+
+    inline uint64_t coarse_time_millis() {
+        return CoarseClock::instance().now_millis();
+    }
   
     inline std::string json_escape(const std::string& s) {
         std::ostringstream o;
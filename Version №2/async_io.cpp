@@ -0,0 +1,363 @@
+#include "async_io.hpp"
+#include "latency_histogram.hpp"
+#include "coarse_clock.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <new>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+
+static constexpr size_t FRAME_GRANULE = 64;
+static constexpr size_t FRAME_CLASSES = 128;
+static constexpr int MAX_LOOP_EVENTS = 256;
+
+
+namespace {
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct ThreadFramePool {
+    FreeBlock* free_lists[FRAME_CLASSES] = {};
+    uint64_t live_frames = 0;
+    uint64_t live_bytes = 0;
+    uint64_t pooled_bytes = 0;
+
+    ~ThreadFramePool() {
+        for (FreeBlock*& head : free_lists) {
+            while (head != nullptr) {
+                FreeBlock* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    }
+};
+
+thread_local ThreadFramePool frame_pool;
+
+size_t frame_class(size_t size) {
+    return (size + FRAME_GRANULE - 1) / FRAME_GRANULE - 1;
+}
+
+}
+
+
+void* FramePool::allocate(size_t size) {
+    size_t cls = frame_class(size);
+    frame_pool.live_frames++;
+    if (cls >= FRAME_CLASSES) {
+        frame_pool.live_bytes += size;
+        return ::operator new(size);
+    }
+
+    size_t rounded = (cls + 1) * FRAME_GRANULE;
+    frame_pool.live_bytes += rounded;
+    FreeBlock* block = frame_pool.free_lists[cls];
+    if (block != nullptr) {
+        frame_pool.free_lists[cls] = block->next;
+        frame_pool.pooled_bytes -= rounded;
+        return block;
+    }
+    return ::operator new(rounded);
+}
+
+void FramePool::deallocate(void* ptr, size_t size) {
+    size_t cls = frame_class(size);
+    frame_pool.live_frames--;
+    if (cls >= FRAME_CLASSES) {
+        frame_pool.live_bytes -= size;
+        ::operator delete(ptr);
+        return;
+    }
+
+    size_t rounded = (cls + 1) * FRAME_GRANULE;
+    frame_pool.live_bytes -= rounded;
+    frame_pool.pooled_bytes += rounded;
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = frame_pool.free_lists[cls];
+    frame_pool.free_lists[cls] = block;
+}
+
+FramePool::Stats FramePool::thread_stats() {
+    return Stats{frame_pool.live_frames, frame_pool.live_bytes, frame_pool.pooled_bytes};
+}
+
+
+struct EventLoop::Root {
+    struct promise_type : PooledFrame {
+        EventLoop& loop;
+        RootLink link;
+
+        promise_type(EventLoop& loop, Task<>&) : loop(loop) { loop.link_root(link); }
+        ~promise_type() { loop.unlink_root(link); }
+
+        Root get_return_object() {
+            link.frame = std::coroutine_handle<promise_type>::from_promise(*this);
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+EventLoop::Root EventLoop::detach(EventLoop&, Task<> task) {
+    co_await task;
+}
+
+
+void LoopMailbox::post(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed) return;
+    bool wake = ready.empty();
+    ready.push_back(handle);
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t written = write(event_fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+
+EventLoop::EventLoop() : timers(now_ms()) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        std::cerr << "Ошибка epoll_create1" << std::endl;
+        return;
+    }
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    inbox = std::make_shared<LoopMailbox>(event_fd);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = event_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &ev);
+    deferred.reserve(MAX_LOOP_EVENTS);
+    resuming.reserve(MAX_LOOP_EVENTS);
+}
+
+EventLoop::~EventLoop() {
+    shutdown();
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+}
+
+void EventLoop::spawn(Task<> task) {
+    detach(*this, std::move(task));
+}
+
+void EventLoop::link_root(RootLink& link) {
+    link.prev = &roots;
+    link.next = roots.next;
+    if (roots.next != nullptr) roots.next->prev = &link;
+    roots.next = &link;
+    ++root_count;
+}
+
+void EventLoop::unlink_root(RootLink& link) {
+    link.prev->next = link.next;
+    if (link.next != nullptr) link.next->prev = link.prev;
+    --root_count;
+}
+
+bool EventLoop::watch(int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+void EventLoop::unwatch(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    if (static_cast<size_t>(fd) < waiters.size()) {
+        waiters[fd] = Waiters{};
+    }
+}
+
+uint64_t EventLoop::now_ms() const {
+    return coarse_clock.monotonic_ns() / 1000000;
+}
+
+void EventLoop::arm(Deadline& deadline, uint64_t deadline_ms) {
+    deadline.expired = false;
+    timers.schedule(deadline, deadline_ms);
+}
+
+void EventLoop::expire(Deadline& deadline) {
+    deadline.expired = true;
+    if (deadline.sleeper) {
+        std::exchange(deadline.sleeper, {}).resume();
+        return;
+    }
+    int fd = deadline.fd;
+    if (fd >= 0 && static_cast<size_t>(fd) < waiters.size() && waiters[fd].reader) {
+        std::exchange(waiters[fd].reader, {}).resume();
+    }
+    if (fd >= 0 && static_cast<size_t>(fd) < waiters.size() && waiters[fd].writer) {
+        std::exchange(waiters[fd].writer, {}).resume();
+    }
+}
+
+void EventLoop::park(int fd, bool writable, std::coroutine_handle<> handle) {
+    if (static_cast<size_t>(fd) >= waiters.size()) {
+        waiters.resize(std::max<size_t>(static_cast<size_t>(fd) + 1, waiters.size() * 2));
+    }
+    Waiters& slot = waiters[fd];
+    (writable ? slot.writer : slot.reader) = handle;
+}
+
+void EventLoop::run(const std::function<bool()>& keep_running, const std::function<void()>& after_poll) {
+    epoll_event events[MAX_LOOP_EVENTS];
+
+    while (keep_running()) {
+        int n = epoll_wait(epoll_fd, events, MAX_LOOP_EVENTS, deferred.empty() ? 100 : 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Ошибка epoll_wait" << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t mask = events[i].events;
+            if (fd == inbox->event_fd) {
+                drain_mailbox();
+                continue;
+            }
+            bool failed = (mask & (EPOLLERR | EPOLLHUP)) != 0;
+
+            // Возобновленная корутина может закрыть дескриптор, поэтому ожидающие
+            // ищутся заново перед каждым возобновлением.
+            if ((failed || (mask & (EPOLLIN | EPOLLRDHUP))) && static_cast<size_t>(fd) < waiters.size() &&
+                waiters[fd].reader) {
+                std::exchange(waiters[fd].reader, {}).resume();
+            }
+            if ((failed || (mask & EPOLLOUT)) && static_cast<size_t>(fd) < waiters.size() &&
+                waiters[fd].writer) {
+                std::exchange(waiters[fd].writer, {}).resume();
+            }
+        }
+
+        timers.advance(now_ms(), [this](TimerWheel::Timer& timer) { expire(static_cast<Deadline&>(timer)); });
+
+        if (after_poll) {
+            after_poll();
+        }
+
+        resuming.clear();
+        resuming.swap(deferred);
+        for (std::coroutine_handle<> handle : resuming) {
+            handle.resume();
+        }
+    }
+}
+
+void EventLoop::drain_mailbox() {
+    // Буферы меняются местами и сохраняют емкость между итерациями.
+    drained.clear();
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        uint64_t count = 0;
+        ssize_t bytes = read(inbox->event_fd, &count, sizeof(count));
+        (void)bytes;
+        drained.swap(inbox->ready);
+    }
+    for (std::coroutine_handle<> handle : drained) {
+        handle.resume();
+    }
+}
+
+void EventLoop::shutdown() {
+    // Задачи пула, завершившиеся после остановки, не должны возобновлять
+    // уничтоженные кадры.
+    if (inbox) {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        if (!inbox->closed) {
+            inbox->closed = true;
+            inbox->ready.clear();
+            close(inbox->event_fd);
+        }
+    }
+    waiters.clear();
+    deferred.clear();
+    while (roots.next != nullptr) {
+        roots.next->frame.destroy();
+    }
+}
+
+
+AsyncSocket::AsyncSocket(EventLoop& loop, int fd, uint32_t events) : loop(loop), socket_fd(fd) {
+    deadline.fd = fd;
+    if (!loop.watch(fd, events)) {
+        close(fd);
+        socket_fd = -1;
+    }
+}
+
+AsyncSocket::~AsyncSocket() {
+    loop.disarm(deadline);
+    if (socket_fd >= 0) {
+        loop.unwatch(socket_fd);
+        close(socket_fd);
+    }
+}
+
+ssize_t AsyncSocket::try_read(void* buffer, size_t size) {
+    while (true) {
+        uint64_t read_start = stage_clock_ns();
+        ssize_t bytes_read = ::read(socket_fd, buffer, size);
+        if (bytes_read >= 0) {
+            read_ns = stage_clock_ns() - read_start;
+            return bytes_read;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+bool AsyncSocket::would_block() {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+Task<ssize_t> AsyncSocket::read_some(void* buffer, size_t size) {
+    while (true) {
+        ssize_t bytes_read = try_read(buffer, size);
+        if (bytes_read >= 0 || !would_block()) {
+            co_return bytes_read;
+        }
+        if (timed_out()) {
+            errno = ETIMEDOUT;
+            co_return -1;
+        }
+        co_await readable();
+    }
+}
+
+Task<bool> AsyncSocket::write_all(const void* data, size_t size) {
+    const char* cursor = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::send(socket_fd, cursor, size, MSG_NOSIGNAL);
+        if (written > 0) {
+            cursor += written;
+            size -= static_cast<size_t>(written);
+            continue;
+        }
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (timed_out()) co_return false;
+            co_await loop.writable(socket_fd);
+            continue;
+        }
+        co_return false;
+    }
+    co_return true;
+}
@@ -0,0 +1,306 @@
+#pragma once
+#include "timer_wheel.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+
+// Наборы событий для EventLoop::watch. Ожидание записи регистрируется только
+// там, где сокет пишет: иначе каждый фронт EPOLLOUT будит цикл впустую.
+static constexpr uint32_t WATCH_READ = EPOLLIN | EPOLLRDHUP | EPOLLET;
+static constexpr uint32_t WATCH_READ_WRITE = WATCH_READ | EPOLLOUT;
+
+
+// Кадры корутин выделяются из потоковых списков свободных блоков: цикл событий
+// однопоточный, поэтому кадр освобождается тем же потоком, что его выделил.
+class FramePool {
+public:
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+
+    struct Stats {
+        uint64_t live_frames;
+        uint64_t live_bytes;
+        uint64_t pooled_bytes;
+    };
+
+    static Stats thread_stats();
+};
+
+
+struct PooledFrame {
+    static void* operator new(size_t size) { return FramePool::allocate(size); }
+    static void operator delete(void* ptr, size_t size) { FramePool::deallocate(ptr, size); }
+};
+
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+template <typename Promise>
+struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+struct TaskPromiseBase : PooledFrame {
+    std::coroutine_handle<> continuation;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    void unhandled_exception() { std::terminate(); }
+};
+
+}
+
+
+template <typename T = void>
+class Task {
+public:
+    struct promise_type : detail::TaskPromiseBase {
+        std::optional<T> value;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        detail::FinalAwaiter<promise_type> final_suspend() noexcept { return {}; }
+        void return_value(T result) { value = std::move(result); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if (handle) handle.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    T await_resume() { return std::move(*handle.promise().value); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : detail::TaskPromiseBase {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        detail::FinalAwaiter<promise_type> final_suspend() noexcept { return {}; }
+        void return_void() {}
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if (handle) handle.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    void await_resume() {}
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+
+// Очередь возобновлений из других потоков: задача пула кладет сюда корутину,
+// а цикл событий просыпается по eventfd и возобновляет ее в своем потоке.
+class LoopMailbox {
+public:
+    explicit LoopMailbox(int event_fd) : event_fd(event_fd) {}
+
+    void post(std::coroutine_handle<> handle);
+
+private:
+    friend class EventLoop;
+
+    std::mutex mutex;
+    std::vector<std::coroutine_handle<>> ready;
+    int event_fd;
+    bool closed = false;
+};
+
+
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool valid() const { return epoll_fd >= 0; }
+
+    void spawn(Task<> task);
+
+    const std::shared_ptr<LoopMailbox>& mailbox() const { return inbox; }
+
+    bool watch(int fd, uint32_t events);
+    void unwatch(int fd);
+
+    struct Readiness {
+        EventLoop& loop;
+        int fd;
+        bool writable;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { loop.park(fd, writable, handle); }
+        void await_resume() const noexcept {}
+    };
+
+    Readiness readable(int fd) { return Readiness{*this, fd, false}; }
+    Readiness writable(int fd) { return Readiness{*this, fd, true}; }
+
+    // Уступает ход остальным корутинам: возобновление после следующего опроса.
+    struct Yield {
+        EventLoop& loop;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { loop.deferred.push_back(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    Yield yield() { return Yield{*this}; }
+
+    // Срок ожидания на дескрипторе: по истечении корутины, ждущие чтения и
+    // записи на fd, возобновляются с expired == true. Если задан sleeper,
+    // возобновляется только он.
+    struct Deadline : TimerWheel::Timer {
+        int fd = -1;
+        bool expired = false;
+        std::coroutine_handle<> sleeper;
+    };
+
+    struct Sleep {
+        EventLoop& loop;
+        Deadline& deadline;
+        uint64_t deadline_ms;
+
+        bool await_ready() const { return deadline_ms <= loop.now_ms(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            deadline.sleeper = handle;
+            loop.arm(deadline, deadline_ms);
+        }
+        void await_resume() noexcept { deadline.sleeper = {}; }
+    };
+
+    void arm(Deadline& deadline, uint64_t deadline_ms);
+    void disarm(Deadline& deadline) { timers.cancel(deadline); }
+    uint64_t now_ms() const;
+    size_t armed() const { return timers.size(); }
+
+    void run(const std::function<bool()>& keep_running, const std::function<void()>& after_poll = {});
+    void shutdown();
+
+    size_t spawned() const { return root_count; }
+
+private:
+    struct Root;
+    struct RootLink {
+        RootLink* prev = nullptr;
+        RootLink* next = nullptr;
+        std::coroutine_handle<> frame;
+    };
+    struct Waiters {
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+    };
+
+    static Root detach(EventLoop& loop, Task<> task);
+    void park(int fd, bool writable, std::coroutine_handle<> handle);
+    void drain_mailbox();
+    void expire(Deadline& deadline);
+    void link_root(RootLink& link);
+    void unlink_root(RootLink& link);
+
+    // Ожидающие индексируются номером дескриптора, корневые корутины связаны
+    // интрузивным списком: регистрация соединения не выделяет память в куче.
+    int epoll_fd = -1;
+    std::shared_ptr<LoopMailbox> inbox;
+    std::vector<std::coroutine_handle<>> drained;
+    std::vector<std::coroutine_handle<>> deferred;
+    std::vector<std::coroutine_handle<>> resuming;
+    std::vector<Waiters> waiters;
+    RootLink roots;
+    size_t root_count = 0;
+    TimerWheel timers;
+};
+
+
+// Таймер для co_await внутри корутины; снимается с колеса в деструкторе,
+// поэтому кадр можно уничтожить во время сна.
+class LoopTimer {
+public:
+    explicit LoopTimer(EventLoop& loop) : loop(loop) {}
+    ~LoopTimer() { loop.disarm(deadline); }
+
+    LoopTimer(const LoopTimer&) = delete;
+    LoopTimer& operator=(const LoopTimer&) = delete;
+
+    EventLoop::Sleep sleep_until(uint64_t deadline_ms) { return EventLoop::Sleep{loop, deadline, deadline_ms}; }
+
+private:
+    EventLoop& loop;
+    EventLoop::Deadline deadline;
+};
+
+
+class AsyncSocket {
+public:
+    AsyncSocket(EventLoop& loop, int fd, uint32_t events);
+    ~AsyncSocket();
+
+    AsyncSocket(const AsyncSocket&) = delete;
+    AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+    int fd() const { return socket_fd; }
+    bool valid() const { return socket_fd >= 0; }
+
+    // Возвращает число прочитанных байт, 0 при закрытии соединения или -1 при ошибке.
+    Task<ssize_t> read_some(void* buffer, size_t size);
+    Task<bool> write_all(const void* data, size_t size);
+
+    // Неблокирующее чтение без приостановки: при -1 и would_block() нужно
+    // дождаться co_await readable(). Позволяет читать в общий буфер потока,
+    // не удерживая память в каждом простаивающем соединении.
+    ssize_t try_read(void* buffer, size_t size);
+    static bool would_block();
+    EventLoop::Readiness readable() { return loop.readable(socket_fd); }
+
+    uint64_t last_read_ns() const { return read_ns; }
+
+    // Абсолютный срок в миллисекундах по now_ms() цикла. После истечения
+    // read_some возвращает -1 с errno == ETIMEDOUT, а write_all — false.
+    void expire_at(uint64_t deadline_ms) { loop.arm(deadline, deadline_ms); }
+    void cancel_deadline() { loop.disarm(deadline); }
+    bool timed_out() const { return deadline.expired; }
+
+private:
+    EventLoop& loop;
+    int socket_fd;
+    uint64_t read_ns = 0;
+    EventLoop::Deadline deadline;
+};
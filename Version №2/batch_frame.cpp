@@ -0,0 +1,70 @@
+#include "batch_frame.hpp"
+
+
+static void put_be32(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+
+void encode_batch_frame(uint8_t device_id, const uint64_t* timestamps, const float* values,
+                        size_t count, std::vector<uint8_t>& out, FrameIntegrity integrity) {
+    size_t start = out.size();
+    uint64_t base = count > 0 ? timestamps[0] : 0;
+
+    out.push_back(integrity == FrameIntegrity::Crc32c ? BATCH_FRAME_MAGIC_CRC32C : BATCH_FRAME_MAGIC);
+    out.push_back(device_id);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(base >> shift));
+    }
+    write_varint(out, count);
+
+    uint64_t previous = base;
+    for (size_t i = 0; i < count; ++i) {
+        write_varint(out, timestamps[i] - previous);
+        previous = timestamps[i];
+
+        uint32_t bits;
+        std::memcpy(&bits, &values[i], 4);
+        out.push_back(static_cast<uint8_t>(bits >> 24));
+        out.push_back(static_cast<uint8_t>(bits >> 16));
+        out.push_back(static_cast<uint8_t>(bits >> 8));
+        out.push_back(static_cast<uint8_t>(bits));
+    }
+
+    if (integrity == FrameIntegrity::Crc32c) {
+        uint32_t crc = crc32c(out.data() + start, out.size() - start);
+        out.resize(out.size() + 4);
+        put_be32(out.data() + out.size() - 4, crc);
+    } else {
+        out.push_back(xor_bytes(out.data() + start, out.size() - start));
+    }
+}
+
+void encode_crc32c_frame(uint8_t device_id, float value, uint64_t timestamp, uint8_t* out) {
+    out[0] = device_id;
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    put_be32(out + 1, bits);
+    for (int i = 0; i < 8; ++i) {
+        out[5 + i] = static_cast<uint8_t>(timestamp >> (56 - 8 * i));
+    }
+    put_be32(out + 13, crc32c(out, 13));
+}
+
+bool parse_crc32c_frame(const uint8_t* data, IngestMessage& msg) {
+    if (crc32c(data, 13) != read_be32(data + 13)) {
+        return false;
+    }
+    msg.device_id = data[0];
+    uint32_t bits = read_be32(data + 1);
+    std::memcpy(&msg.value, &bits, 4);
+    uint64_t timestamp = 0;
+    for (int i = 0; i < 8; ++i) {
+        timestamp = (timestamp << 8) | data[5 + i];
+    }
+    msg.timestamp = timestamp;
+    return true;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "crc32c.hpp"
+#include "ingest_pipeline.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+// Приветствие: 'T' 'L' 'M', версия, длина приветствия и XOR первых пяти
+// байт. Старый кадр может начинаться с тех же букв, поэтому приветствие
+// без верной длины и контрольного байта считается обычным кадром.
+static constexpr uint8_t PROTOCOL_HELLO[3] = {'T', 'L', 'M'};
+static constexpr size_t PROTOCOL_HELLO_SIZE = 6;
+static constexpr uint8_t PROTOCOL_BATCH_V1 = 0x01;
+static constexpr uint8_t PROTOCOL_LEGACY_CRC32C = 0x02;
+static constexpr uint8_t PROTOCOL_BATCH_CRC32C = 0x03;
+
+static constexpr uint8_t BATCH_FRAME_MAGIC = 0xB1;
+static constexpr uint8_t BATCH_FRAME_MAGIC_CRC32C = 0xB2;
+static constexpr size_t CRC32C_FRAME_SIZE = 17;
+static constexpr size_t BATCH_FRAME_HEADER = 10;
+static constexpr uint64_t MAX_BATCH_SAMPLES = 4096;
+
+
+enum class FrameStatus {
+    Ok,
+    NeedMore,
+    BadChecksum,
+    Malformed
+};
+
+
+enum class FrameIntegrity {
+    Xor,
+    Crc32c
+};
+
+
+enum class VarintStatus {
+    Ok,
+    NeedMore,
+    Malformed
+};
+
+
+inline VarintStatus read_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return VarintStatus::NeedMore;
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return VarintStatus::Ok;
+    }
+    return VarintStatus::Malformed;
+}
+
+inline void write_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline uint8_t xor_bytes(const uint8_t* data, size_t length) {
+    uint64_t wide = 0;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, data + i, 8);
+        wide ^= chunk;
+    }
+    wide ^= wide >> 32;
+    wide ^= wide >> 16;
+    wide ^= wide >> 8;
+    uint8_t crc = static_cast<uint8_t>(wide);
+    for (; i < length; ++i) {
+        crc ^= data[i];
+    }
+    return crc;
+}
+
+
+inline void write_protocol_hello(std::vector<uint8_t>& out, uint8_t version) {
+    size_t start = out.size();
+    out.insert(out.end(), PROTOCOL_HELLO, PROTOCOL_HELLO + sizeof(PROTOCOL_HELLO));
+    out.push_back(version);
+    out.push_back(static_cast<uint8_t>(PROTOCOL_HELLO_SIZE));
+    out.push_back(xor_bytes(out.data() + start, PROTOCOL_HELLO_SIZE - 1));
+}
+
+// Проверяет PROTOCOL_HELLO_SIZE байт: магию, известную версию, длину и
+// контрольный байт.
+inline bool parse_protocol_hello(const uint8_t* data, uint8_t& version) {
+    if (std::memcmp(data, PROTOCOL_HELLO, sizeof(PROTOCOL_HELLO)) != 0) return false;
+    if (data[3] < PROTOCOL_BATCH_V1 || data[3] > PROTOCOL_BATCH_CRC32C) return false;
+    if (data[4] != PROTOCOL_HELLO_SIZE || data[5] != xor_bytes(data, PROTOCOL_HELLO_SIZE - 1)) return false;
+    version = data[3];
+    return true;
+}
+
+
+inline uint32_t read_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+
+void encode_batch_frame(uint8_t device_id, const uint64_t* timestamps, const float* values,
+                        size_t count, std::vector<uint8_t>& out,
+                        FrameIntegrity integrity = FrameIntegrity::Xor);
+void encode_crc32c_frame(uint8_t device_id, float value, uint64_t timestamp, uint8_t* out);
+bool parse_crc32c_frame(const uint8_t* data, IngestMessage& msg);
+
+
+template <typename Sink>
+FrameStatus decode_batch_frame(const uint8_t* data, size_t length, size_t& consumed, Sink& sink,
+                               FrameIntegrity integrity = FrameIntegrity::Xor) {
+    size_t trailer = integrity == FrameIntegrity::Crc32c ? 4 : 1;
+    uint8_t magic = integrity == FrameIntegrity::Crc32c ? BATCH_FRAME_MAGIC_CRC32C : BATCH_FRAME_MAGIC;
+    if (length < BATCH_FRAME_HEADER + 1) return FrameStatus::NeedMore;
+    if (data[0] != magic) return FrameStatus::Malformed;
+
+    const uint8_t* end = data + length;
+    const uint8_t* p = data + BATCH_FRAME_HEADER;
+    uint64_t count;
+    VarintStatus status = read_varint(p, end, count);
+    if (status != VarintStatus::Ok) {
+        return status == VarintStatus::NeedMore ? FrameStatus::NeedMore : FrameStatus::Malformed;
+    }
+    if (count == 0 || count > MAX_BATCH_SAMPLES) return FrameStatus::Malformed;
+
+    const uint8_t* samples = p;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t delta;
+        status = read_varint(p, end, delta);
+        if (status != VarintStatus::Ok) {
+            return status == VarintStatus::NeedMore ? FrameStatus::NeedMore : FrameStatus::Malformed;
+        }
+        if (static_cast<size_t>(end - p) < 4) return FrameStatus::NeedMore;
+        p += 4;
+    }
+    if (static_cast<size_t>(end - p) < trailer) return FrameStatus::NeedMore;
+
+    size_t body = static_cast<size_t>(p - data);
+    consumed = body + trailer;
+    bool intact = integrity == FrameIntegrity::Crc32c ? crc32c(data, body) == read_be32(p)
+                                                      : xor_bytes(data, body) == *p;
+    if (!intact) {
+        return FrameStatus::BadChecksum;
+    }
+
+    IngestMessage msg;
+    msg.device_id = data[1];
+    uint64_t timestamp = 0;
+    for (int i = 0; i < 8; ++i) {
+        timestamp = (timestamp << 8) | data[2 + i];
+    }
+
+    p = samples;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t delta;
+        read_varint(p, end, delta);
+        timestamp += delta;
+        uint32_t bits = read_be32(p);
+        p += 4;
+        std::memcpy(&msg.value, &bits, 4);
+        msg.timestamp = timestamp;
+        sink.push(msg);
+    }
+    return FrameStatus::Ok;
+}
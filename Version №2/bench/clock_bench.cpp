@@ -0,0 +1,100 @@
+#include "bench_util.hpp"
+#include "coarse_clock.hpp"
+#include "config.hpp"
+#include "structs.hpp"
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+static std::mutex store_mutex;
+static DeviceData store_device;
+
+static bool update_clock_in_lock(float value, uint64_t timestamp) {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    uint64_t now = CoarseClock::precise_wall_ms();
+    if (timestamp > now + 60000) return false;
+    store_device.add_sample(value, timestamp);
+    return true;
+}
+
+static bool update_coarse_outside_lock(float value, uint64_t timestamp) {
+    uint64_t now = coarse_clock.wall_ms();
+    if (timestamp > now + 60000) return false;
+    std::lock_guard<std::mutex> lock(store_mutex);
+    store_device.add_sample(value, timestamp);
+    return true;
+}
+
+template <typename Update>
+static double contended(int threads, uint64_t iterations, Update&& update) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                update(1.0f, 1700000000000ULL + i);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(iterations) * threads);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+    uint64_t iterations = config.get_int("iterations", 5000000);
+    int threads = config.get_int("threads", 4);
+
+    coarse_clock.start();
+
+    std::printf("%-36s %10s\n", "operation", "ns/op");
+    std::printf("%-36s %10.2f\n", "system_clock::now", measure_ns_per_op(iterations, [] {
+        do_not_optimize(CoarseClock::precise_wall_ms());
+    }));
+    std::printf("%-36s %10.2f\n", "steady_clock::now", measure_ns_per_op(iterations, [] {
+        do_not_optimize(CoarseClock::precise_monotonic_ns());
+    }));
+    std::printf("%-36s %10.2f\n", "coarse wall_ms", measure_ns_per_op(iterations, [] {
+        do_not_optimize(coarse_clock.wall_ms());
+    }));
+    std::printf("%-36s %10.2f\n", "coarse monotonic_ns", measure_ns_per_op(iterations, [] {
+        do_not_optimize(coarse_clock.monotonic_ns());
+    }));
+
+    std::ostringstream out;
+    std::printf("%-36s %10.2f\n", "log prefix: localtime + put_time", measure_ns_per_op(iterations / 10, [&] {
+        out.str(std::string());
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        out << std::put_time(std::localtime(&now), "%H:%M:%S");
+        do_not_optimize(out);
+    }));
+    std::printf("%-36s %10.2f\n", "log prefix: coarse wall_hms", measure_ns_per_op(iterations / 10, [&] {
+        out.str(std::string());
+        char now[9];
+        coarse_clock.wall_hms(now);
+        out << now;
+        do_not_optimize(out);
+    }));
+
+    std::printf("%-36s %10.2f\n", "update: clock inside lock", measure_ns_per_op(iterations, [] {
+        do_not_optimize(update_clock_in_lock(1.0f, 1700000000000ULL));
+    }));
+    std::printf("%-36s %10.2f\n", "update: coarse clock outside lock", measure_ns_per_op(iterations, [] {
+        do_not_optimize(update_coarse_outside_lock(1.0f, 1700000000000ULL));
+    }));
+    std::printf("update x%d threads, clock inside lock  %10.2f\n", threads,
+                contended(threads, iterations / threads, update_clock_in_lock));
+    std::printf("update x%d threads, coarse outside lock %10.2f\n", threads,
+                contended(threads, iterations / threads, update_coarse_outside_lock));
+
+    coarse_clock.stop();
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "device_store.hpp"
+#include "ingest_worker.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+static void apply_to_store(const IngestMessage& msg) {
+    device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+}
+
+static int connect_once(int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    while (true) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (sockaddr*)&address, sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static double connect_all(int port, size_t threads, std::vector<std::vector<int>>& fds) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < threads; ++t) {
+        clients.emplace_back([&, t] {
+            for (int& fd : fds[t]) {
+                fd = connect_once(port);
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void close_all(std::vector<std::vector<int>>& fds) {
+    for (auto& group : fds) {
+        for (int& fd : group) {
+            if (fd >= 0) close(fd);
+            fd = -1;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    int port = config.get_int("port", 19001);
+    size_t workers = config.get_int("workers", std::max(1u, std::thread::hardware_concurrency()));
+    size_t connections = config.get_int("connections", 2000);
+    size_t threads = config.get_int("threads", 8);
+
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    options.log_samples = false;
+    ingest_pipeline.start(1, apply_to_store);
+
+    IngestWorkerGroup group;
+    if (!group.start(port, workers, {}, config.get_int("backlog", 4096))) {
+        return 1;
+    }
+
+    std::vector<std::vector<int>> fds(threads);
+    for (size_t i = 0; i < connections; ++i) {
+        fds[i % threads].push_back(-1);
+    }
+
+    double establish = connect_all(port, threads, fds);
+    while (group.accepted() < connections) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::printf("workers=%zu connections=%zu threads=%zu\n", workers, connections, threads);
+    std::printf("establish: %.3f s, %.0f conn/s\n", establish, connections / establish);
+
+    close_all(fds);
+    while (group.active_connections() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto storm_start = std::chrono::steady_clock::now();
+    connect_all(port, threads, fds);
+    while (group.accepted() < 2 * connections) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double recovery = std::chrono::duration<double>(std::chrono::steady_clock::now() - storm_start).count();
+    std::printf("reconnect storm recovery: %.3f s\n", recovery);
+
+    close_all(fds);
+    group.stop();
+    ingest_pipeline.stop();
+    return 0;
+}
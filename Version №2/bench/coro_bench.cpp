@@ -0,0 +1,259 @@
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "device_store.hpp"
+#include "ingest_worker.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+static void apply_to_store(const IngestMessage& msg) {
+    device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+}
+
+static std::vector<uint8_t> make_frames(size_t count) {
+    std::vector<uint8_t> frames(count * 14);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* frame = frames.data() + i * 14;
+        frame[0] = static_cast<uint8_t>(i & 0xff);
+        float value = static_cast<float>(i);
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        for (int b = 0; b < 4; ++b) frame[1 + b] = static_cast<uint8_t>(bits >> (24 - 8 * b));
+        uint64_t ts = 1700000000000ULL + i;
+        for (int b = 0; b < 8; ++b) frame[5 + b] = static_cast<uint8_t>(ts >> (56 - 8 * b));
+        frame[13] = calculate_crc8(frame, 13);
+    }
+    return frames;
+}
+
+struct MemoryUsage {
+    uint64_t virtual_bytes;
+    uint64_t resident_bytes;
+};
+
+static MemoryUsage memory_usage() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return MemoryUsage{size * page, resident * page};
+}
+
+
+// Базовая схема для сравнения: отдельный поток с блокирующим чтением на каждое соединение.
+class ThreadPerConnectionServer {
+public:
+    bool start(int port) {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int opt = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(port);
+        if (bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 4096) < 0) {
+            close(listen_fd);
+            return false;
+        }
+        acceptor = std::thread([this] { accept_loop(); });
+        return true;
+    }
+
+    void stop() {
+        shutdown(listen_fd, SHUT_RDWR);
+        close(listen_fd);
+        acceptor.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int fd : client_fds) shutdown(fd, SHUT_RDWR);
+        }
+        for (auto& thread : threads) thread.join();
+        for (int fd : client_fds) close(fd);
+        threads.clear();
+        client_fds.clear();
+    }
+
+    uint64_t accepted() const { return accepted_total.load(std::memory_order_relaxed); }
+
+private:
+    void accept_loop() {
+        while (true) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                client_fds.push_back(fd);
+            }
+            threads.emplace_back([fd] { serve(fd); });
+            accepted_total.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void serve(int fd) {
+        IngestProducer* producer = nullptr;
+        std::vector<uint8_t> buffer(16384 + 14);
+        size_t pending = 0;
+        while (true) {
+            ssize_t n = read(fd, buffer.data() + pending, 16384);
+            if (n <= 0) break;
+            if (producer == nullptr) producer = ingest_pipeline.register_producer();
+            size_t available = pending + static_cast<size_t>(n);
+            size_t frames = available / 14;
+            process_frames(buffer.data(), frames, *producer);
+            producer->flush();
+            pending = available - frames * 14;
+            std::memmove(buffer.data(), buffer.data() + frames * 14, pending);
+        }
+        if (producer != nullptr) producer->close();
+    }
+
+    int listen_fd = -1;
+    std::thread acceptor;
+    std::mutex mutex;
+    std::vector<int> client_fds;
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> accepted_total{0};
+};
+
+
+static std::vector<int> open_connections(int port, size_t count) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    std::vector<int> fds;
+    for (size_t i = 0; i < count; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+            if (fd >= 0) close(fd);
+            break;
+        }
+        fds.push_back(fd);
+    }
+    return fds;
+}
+
+static void close_connections(std::vector<int>& fds) {
+    for (int fd : fds) close(fd);
+    fds.clear();
+}
+
+template <typename Accepted>
+static void wait_accepted(Accepted&& accepted, uint64_t expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (accepted() < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static double blast(int port, size_t connections, size_t frames_per_connection, size_t threads) {
+    std::vector<uint8_t> chunk = make_frames(512);
+    std::vector<int> fds = open_connections(port, connections);
+    uint64_t base = ingest_pipeline.applied_total();
+    uint64_t expected = fds.size() * frames_per_connection;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> senders;
+    for (size_t t = 0; t < threads; ++t) {
+        senders.emplace_back([&, t] {
+            for (size_t sent = 0; sent < frames_per_connection; sent += 512) {
+                for (size_t i = t; i < fds.size(); i += threads) {
+                    const uint8_t* data = chunk.data();
+                    size_t left = chunk.size();
+                    while (left > 0) {
+                        ssize_t n = write(fds[i], data, left);
+                        if (n <= 0) return;
+                        data += n;
+                        left -= static_cast<size_t>(n);
+                    }
+                }
+            }
+        });
+    }
+    for (auto& sender : senders) sender.join();
+
+    auto last_change = std::chrono::steady_clock::now();
+    uint64_t last = ingest_pipeline.applied_total();
+    while (last - base < expected) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        uint64_t now = ingest_pipeline.applied_total();
+        if (now != last) {
+            last = now;
+            last_change = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - last_change > std::chrono::milliseconds(500)) {
+            break;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    close_connections(fds);
+    return (last - base) / elapsed;
+}
+
+static void report_idle(const char* name, const MemoryUsage& before, const MemoryUsage& after, size_t connections) {
+    double rss = static_cast<double>(after.resident_bytes - before.resident_bytes) / connections;
+    double vsz = static_cast<double>(after.virtual_bytes - before.virtual_bytes) / connections;
+    std::printf("%-22s idle=%zu  rss/conn=%.1f KB  virt/conn=%.1f KB\n", name, connections, rss / 1024, vsz / 1024);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    int port = config.get_int("port", 19101);
+    size_t idle = config.get_int("idle", 2000);
+    size_t connections = config.get_int("connections", 64);
+    size_t frames = config.get_int("frames", 51200);
+    size_t threads = config.get_int("threads", 4);
+
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    options.log_samples = false;
+    ingest_pipeline.start(1, apply_to_store);
+
+    {
+        IngestWorkerGroup group;
+        if (!group.start(port, 1, {}, 4096)) return 1;
+        MemoryUsage before = memory_usage();
+        std::vector<int> fds = open_connections(port, idle);
+        wait_accepted([&] { return group.accepted(); }, fds.size());
+        report_idle("coroutine epoll", before, memory_usage(), fds.size());
+        close_connections(fds);
+
+        double rate = blast(port, connections, frames, threads);
+        std::printf("%-22s connections=%zu  %.2f M samples/s\n", "coroutine epoll", connections, rate / 1e6);
+        group.stop();
+    }
+
+    {
+        ThreadPerConnectionServer server;
+        if (!server.start(port + 1)) return 1;
+        MemoryUsage before = memory_usage();
+        std::vector<int> fds = open_connections(port + 1, idle);
+        wait_accepted([&] { return server.accepted(); }, fds.size());
+        report_idle("thread per connection", before, memory_usage(), fds.size());
+        close_connections(fds);
+
+        double rate = blast(port + 1, connections, frames, threads);
+        std::printf("%-22s connections=%zu  %.2f M samples/s\n", "thread per connection", connections, rate / 1e6);
+        server.stop();
+    }
+
+    ingest_pipeline.stop();
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "bench_util.hpp"
+#include "config.hpp"
+#include "counters.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+template <typename Increment>
+static double run_threads(int threads, uint64_t iterations, Increment&& increment) {
+    std::vector<std::thread> workers;
+    std::atomic<int> ready{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            ready.fetch_add(1);
+            while (ready.load() < threads) {
+                std::this_thread::yield();
+            }
+            for (uint64_t i = 0; i < iterations; ++i) {
+                increment();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(iterations) * threads);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+    int threads = config.get_int("threads", 16);
+    uint64_t iterations = config.get_int("iterations", 5000000);
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> shared{0};
+    ShardedCounter sharded;
+
+    double single_ns = measure_ns_per_op(iterations, [&] { sharded.add(); });
+    double shared_ns = run_threads(threads, iterations, [&] { shared.fetch_add(1, std::memory_order_relaxed); });
+    double sharded_ns = run_threads(threads, iterations, [&] { sharded.add(); });
+
+    uint64_t expected = iterations * threads + iterations + iterations / 10 + 1;
+    std::printf("threads=%d iterations/thread=%llu\n", threads, static_cast<unsigned long long>(iterations));
+    std::printf("sharded, 1 thread:      %6.2f ns/op\n", single_ns);
+    std::printf("shared atomic, %2d thr:  %6.2f ns/op (aggregate)\n", threads, shared_ns);
+    std::printf("sharded, %2d thr:        %6.2f ns/op (aggregate)\n", threads, sharded_ns);
+    std::printf("sharded total: %llu (expected %llu)\n",
+                static_cast<unsigned long long>(sharded.load()), static_cast<unsigned long long>(expected));
+    return sharded.load() == expected ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "batch_frame.hpp"
+#include "binary_message.hpp"
+#include "crc32c.hpp"
+#include "bench_util.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+int main(int argc, char* argv[]) {
+    uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    if (crc32c_sw(check, sizeof(check)) != 0xE3069283u || crc32c_hw(check, sizeof(check)) != 0xE3069283u) {
+        std::printf("crc32c check value mismatch\n");
+        return 1;
+    }
+    for (size_t len = 0; len < 64; ++len) {
+        std::vector<uint8_t> data(len);
+        for (size_t i = 0; i < len; ++i) data[i] = static_cast<uint8_t>(i * 31 + len);
+        if (crc32c_sw(data.data(), len) != crc32c_hw(data.data(), len)) {
+            std::printf("crc32c hw/sw mismatch at length %zu\n", len);
+            return 1;
+        }
+    }
+
+    uint8_t frame[CRC32C_FRAME_SIZE];
+    encode_crc32c_frame(42, 21.5f, 1700000000000ULL, frame);
+
+    std::printf("crc32c hardware: %s\n", crc32c_hw_supported() ? "yes" : "no");
+    std::printf("%-24s %10s\n", "per-frame integrity", "ns/frame");
+
+    volatile uint8_t sink8 = 0;
+    volatile uint32_t sink32 = 0;
+    double ns = measure_ns_per_op(iterations, [&] {
+        do_not_optimize(frame);
+        sink8 = calculate_crc8(frame, 13);
+    });
+    std::printf("%-24s %10.2f\n", "xor crc8 (13 bytes)", ns);
+
+    ns = measure_ns_per_op(iterations, [&] {
+        do_not_optimize(frame);
+        sink32 = crc32c_hw(frame, 13);
+    });
+    std::printf("%-24s %10.2f\n", "crc32c sse4.2", ns);
+
+    ns = measure_ns_per_op(iterations, [&] {
+        do_not_optimize(frame);
+        sink32 = crc32c_sw(frame, 13);
+    });
+    std::printf("%-24s %10.2f\n", "crc32c slicing-by-8", ns);
+
+    std::vector<uint8_t> batch;
+    std::vector<uint64_t> timestamps(64);
+    std::vector<float> values(64);
+    for (size_t i = 0; i < 64; ++i) {
+        timestamps[i] = 1700000000000ULL + i * 10;
+        values[i] = static_cast<float>(i);
+    }
+    encode_batch_frame(1, timestamps.data(), values.data(), 64, batch, FrameIntegrity::Crc32c);
+
+    ns = measure_ns_per_op(iterations / 10, [&] {
+        do_not_optimize(batch.data());
+        sink8 = xor_bytes(batch.data(), batch.size() - 4);
+    });
+    std::printf("%-24s %10.2f (%.3f per sample)\n", "xor batch of 64", ns, ns / 64);
+
+    ns = measure_ns_per_op(iterations / 10, [&] {
+        do_not_optimize(batch.data());
+        sink32 = crc32c(batch.data(), batch.size() - 4);
+    });
+    std::printf("%-24s %10.2f (%.3f per sample)\n", "crc32c batch of 64", ns, ns / 64);
+
+    (void)sink8;
+    (void)sink32;
+    return 0;
+}
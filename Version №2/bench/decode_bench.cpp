@@ -0,0 +1,62 @@
+#include "binary_message.hpp"
+#include "frame_decoder.hpp"
+#include "bench_util.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+struct DecodeBuffers {
+    std::vector<uint8_t> device_id;
+    std::vector<float> value;
+    std::vector<uint64_t> timestamp;
+    std::vector<uint8_t> valid;
+
+    explicit DecodeBuffers(size_t frames)
+        : device_id(frames), value(frames), timestamp(frames), valid(frames) {}
+
+    DecodedFrames view() {
+        return DecodedFrames{device_id.data(), value.data(), timestamp.data(), valid.data()};
+    }
+};
+
+static std::vector<uint8_t> make_frames(size_t frames, std::mt19937_64& rng) {
+    std::vector<uint8_t> data(frames * LEGACY_FRAME_SIZE);
+    for (size_t i = 0; i < frames; ++i) {
+        uint8_t* frame = data.data() + i * LEGACY_FRAME_SIZE;
+        uint64_t a = rng();
+        uint64_t b = rng();
+        std::memcpy(frame, &a, 8);
+        std::memcpy(frame + 8, &b, 5);
+        frame[13] = calculate_crc8(frame, 13);
+        if (rng() % 10 == 0) {
+            frame[rng() % LEGACY_FRAME_SIZE] ^= static_cast<uint8_t>(1u << (rng() % 8));
+        }
+    }
+    return data;
+}
+
+int main(int argc, char* argv[]) {
+    size_t frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1 << 20;
+    std::mt19937_64 rng(12345);
+
+    std::vector<uint8_t> data = make_frames(frames, rng);
+    std::printf("active decoder: %s (differential check: tests/decode_test)\n", decoder_name(active_decoder()));
+
+    DecodeBuffers buffers(frames);
+    DecodedFrames out = buffers.view();
+    std::printf("%-8s %12s %12s\n", "decoder", "ns/frame", "GB/s");
+    for (DecoderKind kind : {DecoderKind::Scalar, DecoderKind::Ssse3, DecoderKind::Avx2}) {
+        if (!decoder_supported(kind)) continue;
+        double ns = measure_ns_per_op(10, [&] {
+            size_t valid = kind == DecoderKind::Avx2 ? decode_frames_avx2(data.data(), frames, out)
+                         : kind == DecoderKind::Ssse3 ? decode_frames_ssse3(data.data(), frames, out)
+                         : decode_frames_scalar(data.data(), frames, out);
+            do_not_optimize(valid);
+        });
+        std::printf("%-8s %12.2f %12.2f\n", decoder_name(kind), ns / frames, data.size() / ns);
+    }
+    return 0;
+}
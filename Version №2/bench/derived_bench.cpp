@@ -0,0 +1,138 @@
+#include "config.hpp"
+#include "derived_metrics.hpp"
+#include "device_store.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<double> make_values(size_t count) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 5.0);
+    std::vector<double> values(count);
+    for (size_t i = 0; i < count; ++i) values[i] = 50.0 + noise(rng);
+    return values;
+}
+
+static std::vector<AlertRule> rules_from(const std::string& spec, size_t alphas) {
+    std::vector<AlertRule> rules;
+    std::string error;
+    if (!parse_alert_rules(spec, alphas, rules, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+    }
+    return rules;
+}
+
+// Цена на сэмпл: запись в хранилище с производными значениями и без них.
+// Пороги лежат вне диапазона значений, тревоги не срабатывают, поэтому
+// измеряется обновление и проверка правил, а не очередь.
+static void bench_overhead(size_t samples) {
+    std::vector<double> values = make_values(65536);
+    const std::vector<double> one = {0.1};
+    const std::vector<double> four = {0.5, 0.1, 0.01, 0.001};
+    std::string sixteen;
+    for (int i = 0; i < 16; ++i) {
+        sixteen += (i > 0 ? "," : "") + std::string(i % 2 ? "z>50/40" : "value>1000/900");
+    }
+
+    struct Case {
+        const char* name;
+        bool derived;
+        std::vector<double> alphas;
+        std::string rules;
+    };
+    const Case cases[] = {
+        {"store only", false, {}, ""},
+        {"1 alpha", true, one, ""},
+        {"4 alphas", true, four, ""},
+        {"4 alphas, 4 rules", true, four, "value>1000/900,ewma1>1000,rate>1e9/1e8,z>50/40"},
+        {"4 alphas, 16 rules", true, four, sixteen},
+    };
+
+    double baseline = 0;
+    for (const Case& c : cases) {
+        auto tracker = std::make_unique<DerivedTracker>();
+        tracker->configure(c.alphas, rules_from(c.rules, c.alphas.size()));
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < samples; ++i) {
+            uint8_t device = static_cast<uint8_t>(i & 255);
+            double value = values[i & 65535];
+            device_store.apply(device, value, i);
+            if (c.derived) tracker->update(device, value, i);
+        }
+        double ns = static_cast<double>(now_ns() - start) / samples;
+        if (!c.derived) baseline = ns;
+        std::printf("%-20s %6.1f ns/sample (+%5.1f ns over store)\n", c.name, ns, ns - baseline);
+    }
+}
+
+static std::atomic<uint64_t> sink_events{0};
+
+static void count_alert(const AlertEvent&) {
+    sink_events.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Шумная синусоида около порога: без гистерезиса тревога дребезжит, с ним
+// срабатывает один раз на подъем. Редкие выбросы ловит правило по z.
+static bool bench_alerts(size_t samples) {
+    std::mt19937 rng(11);
+    std::normal_distribution<double> noise(0.0, 2.0);
+
+    auto run = [&](const char* spec, bool spikes) {
+        auto tracker = std::make_unique<DerivedTracker>();
+        tracker->configure({0.1}, rules_from(spec, 1));
+        sink_events.store(0);
+        tracker->start_notifier(count_alert);
+        size_t injected = 0;
+        for (size_t i = 0; i < samples; ++i) {
+            double value = 50.0 + 30.0 * std::sin(static_cast<double>(i) / 2000.0) + noise(rng);
+            if (spikes && i > 1000 && i % 5000 == 0) {
+                value += 200.0;
+                ++injected;
+            }
+            tracker->update(1, value, i);
+            // Тревоги тоже исходят от ограниченной очереди: дадим уведомителю
+            // разобрать ее, как в живом потоке между пачками.
+            if ((i & 4095) == 0) std::this_thread::yield();
+        }
+        tracker->stop_notifier();
+        std::printf("%-16s raised %5lu, cleared %5lu, delivered %5lu, dropped %lu",
+                    spec, (unsigned long)tracker->raised(), (unsigned long)tracker->cleared(),
+                    (unsigned long)sink_events.load(), (unsigned long)tracker->dropped());
+        if (spikes) std::printf(", spikes %zu", injected);
+        std::printf("\n");
+        bool delivered = sink_events.load() + tracker->dropped() == tracker->raised() + tracker->cleared();
+        return std::make_pair(tracker->raised(), delivered);
+    };
+
+    auto plain = run("value>80", false);
+    auto hysteresis = run("value>80/70", false);
+    auto spikes = run("z>6/2", true);
+    size_t expected_spikes = (samples - 1) / 5000;
+    return plain.second && hysteresis.second && spikes.second && hysteresis.first < plain.first &&
+           spikes.first >= expected_spikes * 9 / 10 && spikes.first <= expected_spikes;
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    size_t samples = static_cast<size_t>(config.get_int("samples", 20000000));
+    size_t alert_samples = static_cast<size_t>(config.get_int("alert-samples", 1000000));
+
+    bench_overhead(samples);
+    bool ok = bench_alerts(alert_samples);
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+#include "binary_message.hpp"
+#include "coarse_clock.hpp"
+#include "config.hpp"
+#include "ingest_worker.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+static constexpr size_t DEVICES = 256;
+
+static std::atomic<uint64_t> applied[DEVICES];
+static std::atomic<uint64_t> latest_ts[DEVICES];
+static uint64_t apply_spin = 0;
+
+static uint64_t now_ns() {
+    return CoarseClock::precise_monotonic_ns();
+}
+
+static void spin(uint64_t iterations) {
+    volatile double sink = 1.0;
+    for (uint64_t i = 0; i < iterations; ++i) sink = std::sqrt(sink + static_cast<double>(i));
+}
+
+static void apply_counted(const IngestMessage& msg) {
+    applied[msg.device_id].fetch_add(1, std::memory_order_relaxed);
+    latest_ts[msg.device_id].store(msg.timestamp, std::memory_order_relaxed);
+    if (apply_spin > 0) spin(apply_spin);
+}
+
+static void reset_counts() {
+    for (size_t i = 0; i < DEVICES; ++i) {
+        applied[i].store(0);
+        latest_ts[i].store(0);
+    }
+}
+
+static uint64_t applied_sum() {
+    uint64_t total = 0;
+    for (auto& count : applied) total += count.load();
+    return total;
+}
+
+static void wait_applied(uint64_t target) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (applied_sum() < target && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Стоимость проверок на сэмпл: производитель без лимитов, с лимитом устройств,
+// который не срабатывает, и с корзиной соединения перед каждым кадром.
+static void bench_push_cost(uint64_t samples) {
+    const char* names[] = {"no limits", "device limit", "device + connection"};
+    for (int mode = 0; mode < 3; ++mode) {
+        reset_counts();
+        ingest_pipeline.device_limits().configure(mode >= 1 ? 1e12 : 0, 0);
+        ingest_pipeline.start(1, apply_counted);
+        IngestProducer* producer = ingest_pipeline.register_producer();
+        TokenBucket bucket;
+        bucket.configure(mode == 2 ? 1e12 : 0, 0, now_ns());
+
+        IngestMessage msg{};
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < samples; ++i) {
+            if (mode == 2 && (i & 255) == 0) bucket.refill(now_ns());
+            if (bucket.admit(1) == 0) continue;
+            msg.device_id = static_cast<uint8_t>(i & 31);
+            msg.timestamp = i;
+            producer->push(msg);
+        }
+        producer->flush();
+        wait_applied(samples);
+        double elapsed = static_cast<double>(now_ns() - start) / 1e9;
+        producer->close();
+        ingest_pipeline.stop();
+        std::printf("push %-20s %6.1f M samples/s (%5.1f ns/sample)\n", names[mode],
+                    samples / elapsed / 1e6, elapsed * 1e9 / samples);
+    }
+    ingest_pipeline.device_limits().configure(0, 0);
+}
+
+static int connect_to(int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static std::vector<uint8_t> make_frames(uint8_t device, size_t count) {
+    std::vector<uint8_t> frames(count * 14, 0);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* frame = frames.data() + i * 14;
+        frame[0] = device;
+        frame[12] = static_cast<uint8_t>(i);
+        frame[13] = calculate_crc8(frame, 13);
+    }
+    return frames;
+}
+
+// Одно соединение шлет кадры без ограничения, несколько обычных — по
+// normal_rate сэмплов в секунду. Считается, сколько сэмплов каждого дошло.
+static void bench_flooder(int port, FlowPolicy policy, double connection_rate, size_t normal,
+                          double normal_rate, double seconds) {
+    reset_counts();
+    options.log_samples = false;
+    options.flow_policy = policy;
+    options.connection_rate = connection_rate;
+    options.connection_burst = connection_rate / 10;
+    uint64_t dropped_before = ingest_counters.flow_dropped.load();
+    uint64_t pauses_before = ingest_counters.flow_pauses.load();
+
+    ingest_pipeline.start(1, apply_counted);
+    IngestWorkerGroup group;
+    if (!group.start(port, 1, {}, 4096)) return;
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> flood_sent{0};
+    std::thread flooder([&] {
+        int fd = connect_to(port);
+        std::vector<uint8_t> chunk = make_frames(0, 4096);
+        timeval timeout{0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        while (!stop.load()) {
+            ssize_t n = send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL);
+            if (n > 0) flood_sent.fetch_add(static_cast<uint64_t>(n) / 14);
+        }
+        close(fd);
+    });
+
+    std::vector<int> fds;
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t i = 0; i < normal; ++i) {
+        fds.push_back(connect_to(port));
+        frames.push_back(make_frames(static_cast<uint8_t>(1 + i), 1));
+    }
+    uint64_t normal_sent = 0;
+    uint64_t period_ns = static_cast<uint64_t>(1e9 / normal_rate);
+    uint64_t start = now_ns();
+    uint64_t next = start;
+    while (now_ns() - start < static_cast<uint64_t>(seconds * 1e9)) {
+        for (size_t i = 0; i < normal; ++i) {
+            send(fds[i], frames[i].data(), 14, MSG_NOSIGNAL);
+        }
+        ++normal_sent;
+        next += period_ns;
+        uint64_t now = now_ns();
+        if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+    }
+    stop.store(true);
+    flooder.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    uint64_t normal_applied = 0;
+    for (size_t i = 0; i < normal; ++i) normal_applied += applied[1 + i].load();
+    std::printf("%-24s flooder: sent %8lu applied %8lu (%7.0f/s) | normal: %5.1f%% delivered | "
+                "dropped %lu, pauses %lu\n",
+                connection_rate > 0 ? (policy == FlowPolicy::Pause ? "limit, pause" : "limit, drop") : "no limit",
+                (unsigned long)flood_sent.load(), (unsigned long)applied[0].load(), applied[0].load() / seconds,
+                100.0 * normal_applied / std::max<uint64_t>(1, normal_sent * normal),
+                (unsigned long)(ingest_counters.flow_dropped.load() - dropped_before),
+                (unsigned long)(ingest_counters.flow_pauses.load() - pauses_before));
+
+    for (int fd : fds) close(fd);
+    group.stop();
+    ingest_pipeline.stop();
+    options.connection_rate = 0;
+}
+
+// Сэмплы приходят с фиксированной скоростью выше пропускной способности
+// писателя. Задержка /latest — разница между текущим временем и меткой
+// последнего видимого сэмпла устройства.
+static void bench_overload(OverloadPolicy policy, double offered_rate, uint64_t spin_per_apply, double seconds) {
+    reset_counts();
+    apply_spin = spin_per_apply;
+    ingest_pipeline.set_overload_policy(policy);
+    uint64_t coalesced_before = ingest_pipeline.coalesced_total();
+    ingest_pipeline.start(1, apply_counted);
+    IngestProducer* producer = ingest_pipeline.register_producer();
+
+    std::atomic<bool> done{false};
+    std::vector<uint64_t> lags;
+    std::thread sampler([&] {
+        while (!done.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            uint64_t latest = latest_ts[0].load();
+            if (latest > 0) lags.push_back(now_ns() - latest);
+        }
+    });
+
+    uint64_t period_ns = static_cast<uint64_t>(1e9 / offered_rate);
+    uint64_t start = now_ns();
+    uint64_t end = start + static_cast<uint64_t>(seconds * 1e9);
+    uint64_t generated = 0;
+    IngestMessage msg{};
+    for (uint64_t scheduled = start; scheduled < end; scheduled += period_ns) {
+        uint64_t now = now_ns();
+        if (now >= end) break;
+        while (now < scheduled) now = now_ns();
+        msg.device_id = static_cast<uint8_t>(generated & 15);
+        msg.timestamp = scheduled;
+        producer->push(msg);
+        if ((++generated & 63) == 0) producer->flush();
+    }
+    producer->flush();
+    done.store(true);
+    sampler.join();
+
+    uint64_t lag_max = 0, lag_sum = 0;
+    for (uint64_t lag : lags) {
+        lag_max = std::max(lag_max, lag);
+        lag_sum += lag;
+    }
+    std::printf("overload %-9s offered %lu in %.1f s, applied %lu, coalesced %lu, "
+                "/latest lag avg %.1f ms max %.1f ms\n",
+                overload_policy_name(policy), (unsigned long)generated, seconds, (unsigned long)applied_sum(),
+                (unsigned long)(ingest_pipeline.coalesced_total() - coalesced_before),
+                lags.empty() ? 0.0 : lag_sum / 1e6 / lags.size(), lag_max / 1e6);
+
+    producer->close();
+    ingest_pipeline.stop();
+    apply_spin = 0;
+    ingest_pipeline.set_overload_policy(OverloadPolicy::Block);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    uint64_t samples = config.get_int("samples", 20000000);
+    int port = config.get_int("port", 19203);
+    double seconds = config.get_double("seconds", 2.0);
+    double connection_rate = config.get_double("connection-rate", 50000);
+    size_t normal = config.get_int("normal", 8);
+    double normal_rate = config.get_double("normal-rate", 500);
+    double offered = config.get_double("offered-rate", 400000);
+    uint64_t apply_spin_iterations = config.get_int("apply-spin", 2000);
+
+    bench_push_cost(samples);
+
+    bench_flooder(port, FlowPolicy::Pause, 0, normal, normal_rate, seconds);
+    bench_flooder(port, FlowPolicy::Pause, connection_rate, normal, normal_rate, seconds);
+    bench_flooder(port, FlowPolicy::Drop, connection_rate, normal, normal_rate, seconds);
+
+    bench_overload(OverloadPolicy::Block, offered, apply_spin_iterations, seconds);
+    bench_overload(OverloadPolicy::Coalesce, offered, apply_spin_iterations, seconds);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "batch_frame.hpp"
+#include "binary_message.hpp"
+#include "bench_util.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+struct CountingSink {
+    uint64_t count = 0;
+    double sum = 0;
+
+    void push(const IngestMessage& msg) {
+        ++count;
+        sum += msg.value;
+    }
+};
+
+static void put_legacy_frame(std::vector<uint8_t>& out, uint8_t device_id, float value, uint64_t ts) {
+    size_t start = out.size();
+    out.push_back(device_id);
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(bits >> shift));
+    for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(ts >> shift));
+    out.push_back(calculate_crc8(out.data() + start, 13));
+}
+
+int main(int argc, char* argv[]) {
+    size_t devices = 64;
+    size_t per_batch = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    size_t batches_per_device = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+    size_t total = devices * per_batch * batches_per_device;
+
+    std::vector<uint8_t> legacy;
+    std::vector<uint8_t> batch;
+    legacy.reserve(total * 14);
+
+    std::vector<uint64_t> timestamps(per_batch);
+    std::vector<float> values(per_batch);
+    uint64_t base = 1700000000000ULL;
+
+    for (size_t b = 0; b < batches_per_device; ++b) {
+        for (size_t d = 0; d < devices; ++d) {
+            for (size_t i = 0; i < per_batch; ++i) {
+                timestamps[i] = base + (b * per_batch + i) * 10;
+                values[i] = static_cast<float>(d) + static_cast<float>(i) * 0.25f;
+                put_legacy_frame(legacy, static_cast<uint8_t>(d), values[i], timestamps[i]);
+            }
+            encode_batch_frame(static_cast<uint8_t>(d), timestamps.data(), values.data(), per_batch, batch);
+        }
+    }
+
+    std::printf("samples: %zu, samples per batch frame: %zu\n", total, per_batch);
+    std::printf("%-8s %14s %14s %12s\n", "format", "bytes/sample", "Msamples/s", "MB/s");
+
+    double legacy_ns = measure_ns_per_op(5, [&] {
+        CountingSink sink;
+        for (size_t offset = 0; offset + 14 <= legacy.size(); offset += 14) {
+            IngestMessage msg;
+            if (parse_binary_message(legacy.data() + offset, msg.device_id, msg.value, msg.timestamp)) {
+                sink.push(msg);
+            }
+        }
+        do_not_optimize(sink.sum);
+    });
+    std::printf("%-8s %14.2f %14.1f %12.1f\n", "legacy",
+                static_cast<double>(legacy.size()) / total,
+                total / legacy_ns * 1e3, legacy.size() / legacy_ns * 1e3);
+
+    double batch_ns = measure_ns_per_op(5, [&] {
+        CountingSink sink;
+        size_t offset = 0;
+        while (offset < batch.size()) {
+            size_t consumed = 0;
+            if (decode_batch_frame(batch.data() + offset, batch.size() - offset, consumed, sink) != FrameStatus::Ok) {
+                std::abort();
+            }
+            offset += consumed;
+        }
+        if (sink.count != total) std::abort();
+        do_not_optimize(sink.sum);
+    });
+    std::printf("%-8s %14.2f %14.1f %12.1f\n", "batch",
+                static_cast<double>(batch.size()) / total,
+                total / batch_ns * 1e3, batch.size() / batch_ns * 1e3);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "bench_util.hpp"
+#include "config.hpp"
+#include "latency_histogram.hpp"
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+    uint64_t iterations = config.get_int("iterations", 20000000);
+    int threads = config.get_int("threads", 4);
+
+    uint64_t value = 1;
+    double record_ns = measure_ns_per_op(iterations, [&] {
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+        record_stage(Stage::Framing, value >> 44);
+    });
+    double timer_ns = measure_ns_per_op(iterations, [] {
+        StageTimer timer(Stage::Handler);
+    });
+    double clock_ns = measure_ns_per_op(iterations, [] {
+        do_not_optimize(stage_clock_ns());
+    });
+
+    std::atomic<uint64_t> total_ns_x1000{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            uint64_t x = t + 1;
+            double ns = measure_ns_per_op(iterations / threads, [&] {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+                record_stage(Stage::Serialize, x >> 44);
+            });
+            total_ns_x1000.fetch_add(static_cast<uint64_t>(ns * 1000));
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    double worst_error = 0;
+    for (uint64_t v = 1; v < (uint64_t{1} << 36); v = v * 3 / 2 + 1) {
+        uint64_t upper = LatencyHistogram::bucket_upper(LatencyHistogram::bucket_of(v));
+        worst_error = std::max(worst_error, static_cast<double>(upper - v) / static_cast<double>(v));
+    }
+
+    LatencySummary summary = latency_summary(Stage::Serialize);
+    std::printf("record_stage:          %6.2f ns/op\n", record_ns);
+    std::printf("StageTimer (2 clocks): %6.2f ns/op\n", timer_ns);
+    std::printf("steady_clock::now:     %6.2f ns/op\n", clock_ns);
+    std::printf("record_stage x%d thr:   %6.2f ns/op\n", threads,
+                static_cast<double>(total_ns_x1000.load()) / 1000.0 / threads);
+    std::printf("max bucket error:      %6.2f %%\n", worst_error * 100);
+    std::printf("merged count=%llu p50=%llu p99=%llu p999=%llu ns\n",
+                static_cast<unsigned long long>(summary.count), static_cast<unsigned long long>(summary.p50),
+                static_cast<unsigned long long>(summary.p99), static_cast<unsigned long long>(summary.p999));
+    return record_ns <= 20.0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include "device_store.hpp"
+#include "ingest_pipeline.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+static void apply_to_store(const IngestMessage& msg) {
+    device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+}
+
+static double run_pipeline(size_t threads, uint64_t per_thread) {
+    IngestPipeline pipeline;
+    pipeline.start(threads, apply_to_store);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < threads; ++t) {
+        producers.emplace_back([&pipeline, t, per_thread] {
+            IngestProducer* producer = pipeline.register_producer();
+            for (uint64_t i = 0; i < per_thread; ++i) {
+                IngestMessage msg;
+                msg.device_id = static_cast<uint8_t>((i * 7 + t) & 0xff);
+                msg.value = static_cast<float>(i);
+                msg.timestamp = i;
+                producer->push(msg);
+            }
+            producer->close();
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    while (pipeline.applied_total() < threads * per_thread) {
+        std::this_thread::yield();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    pipeline.stop();
+
+    return threads * per_thread / std::chrono::duration<double>(elapsed).count();
+}
+
+static double run_mutex_baseline(size_t threads, uint64_t per_thread) {
+    std::unordered_map<uint8_t, DeviceData> devices;
+    std::mutex devices_mutex;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t] {
+            for (uint64_t i = 0; i < per_thread; ++i) {
+                std::lock_guard<std::mutex> lock(devices_mutex);
+                devices[static_cast<uint8_t>((i * 7 + t) & 0xff)].add_sample(static_cast<double>(i), i);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return threads * per_thread / std::chrono::duration<double>(elapsed).count();
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t per_thread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t max_threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 32;
+
+    std::printf("cores available: %u\n", std::thread::hardware_concurrency());
+    std::printf("%8s %18s %18s\n", "threads", "pipeline msg/s", "mutex msg/s");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double pipeline = run_pipeline(threads, per_thread);
+        double baseline = run_mutex_baseline(threads, per_thread);
+        std::printf("%8zu %18.0f %18.0f\n", threads, pipeline, baseline);
+    }
+    return 0;
+}
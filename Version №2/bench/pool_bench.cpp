@@ -0,0 +1,139 @@
+#include "config.hpp"
+#include "task_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Работа задается числом итераций, а не временем: при вытеснении потока
+// задача по-прежнему требует того же процессорного времени.
+static void spin(uint64_t iterations) {
+    volatile double sink = 1.0;
+    for (uint64_t i = 0; i < iterations; ++i) sink = std::sqrt(sink + static_cast<double>(i));
+}
+
+static uint64_t iterations_per_us() {
+    const uint64_t probe = 4000000;
+    uint64_t start = now_ns();
+    spin(probe);
+    return std::max<uint64_t>(1, probe * 1000 / std::max<uint64_t>(1, now_ns() - start));
+}
+
+static uint64_t work_per_us = 1;
+
+static uint64_t percentile(std::vector<uint64_t>& values, double q) {
+    if (values.empty()) return 0;
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(q * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+struct MixedResult {
+    uint64_t high_p50;
+    uint64_t high_p99;
+    uint64_t high_max;
+    uint64_t analytics_done;
+    uint64_t steals;
+};
+
+// Поток приема отправляет короткие задачи раз в period_us, пока пул занят
+// длинными задачами аналитики. С приоритетами ожидание ограничено длиной
+// одной задачи аналитики; без них задача приема стоит в общей очереди.
+static MixedResult run_mixed(size_t threads, bool prioritized, size_t analytics, uint64_t analytics_us,
+                             size_t batches, uint64_t period_us) {
+    TaskPool pool;
+    pool.start(threads);
+    std::atomic<uint64_t> analytics_done{0};
+    TaskPriority analytics_priority = prioritized ? TaskPriority::Low : TaskPriority::Normal;
+    TaskPriority ingest_priority = prioritized ? TaskPriority::High : TaskPriority::Normal;
+
+    for (size_t i = 0; i < analytics; ++i) {
+        pool.submit(analytics_priority, [&, analytics_us] {
+            spin(analytics_us * work_per_us);
+            analytics_done.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+
+    std::vector<uint64_t> waits(batches, 0);
+    std::atomic<size_t> finished{0};
+    for (size_t i = 0; i < batches; ++i) {
+        uint64_t submitted = now_ns();
+        pool.submit(ingest_priority, [&, i, submitted] {
+            waits[i] = now_ns() - submitted;
+            spin(2 * work_per_us);
+            finished.fetch_add(1, std::memory_order_release);
+        });
+        std::this_thread::sleep_for(std::chrono::microseconds(period_us));
+    }
+    while (finished.load(std::memory_order_acquire) < batches) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    MixedResult result{};
+    result.analytics_done = analytics_done.load();
+    result.steals = pool.stats().steals;
+    result.high_p50 = percentile(waits, 0.5);
+    result.high_p99 = percentile(waits, 0.99);
+    result.high_max = *std::max_element(waits.begin(), waits.end());
+    pool.stop();
+    return result;
+}
+
+static void fork(TaskPool& pool, std::atomic<uint64_t>& leaves, int depth) {
+    if (depth == 0) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    pool.submit(TaskPriority::Normal, [&pool, &leaves, depth] { fork(pool, leaves, depth - 1); });
+    pool.submit(TaskPriority::Normal, [&pool, &leaves, depth] { fork(pool, leaves, depth - 1); });
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    size_t threads = config.get_int("threads", 4);
+    size_t analytics = config.get_int("analytics", 400);
+    uint64_t analytics_us = config.get_int("analytics-us", 500);
+    size_t batches = config.get_int("batches", 400);
+    uint64_t period_us = config.get_int("period-us", 200);
+    int depth = config.get_int("depth", 16);
+
+    work_per_us = iterations_per_us();
+    std::printf("threads=%zu analytics=%zu x %lu us, ingest batches=%zu every %lu us\n",
+                threads, analytics, (unsigned long)analytics_us, batches, (unsigned long)period_us);
+    for (bool prioritized : {false, true}) {
+        MixedResult r = run_mixed(threads, prioritized, analytics, analytics_us, batches, period_us);
+        std::printf("%-12s ingest wait p50=%8.1f us  p99=%8.1f us  max=%8.1f us  analytics done=%lu  steals=%lu\n",
+                    prioritized ? "priorities" : "single fifo", r.high_p50 / 1e3, r.high_p99 / 1e3,
+                    r.high_max / 1e3, (unsigned long)r.analytics_done, (unsigned long)r.steals);
+    }
+
+    {
+        TaskPool pool;
+        pool.start(threads);
+        std::atomic<uint64_t> leaves{0};
+        uint64_t expected = 1ULL << depth;
+        auto start = std::chrono::steady_clock::now();
+        pool.submit(TaskPriority::Normal, [&] { fork(pool, leaves, depth); });
+        while (leaves.load(std::memory_order_relaxed) < expected) {
+            std::this_thread::yield();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        TaskPool::Stats stats = pool.stats();
+        uint64_t tasks = stats.executed[static_cast<size_t>(TaskPriority::Normal)];
+        std::printf("fork-join depth=%d: %lu tasks in %.3f s (%.2f M tasks/s), steals=%lu\n", depth,
+                    (unsigned long)tasks, elapsed, tasks / elapsed / 1e6, (unsigned long)stats.steals);
+        pool.stop();
+    }
+    return 0;
+}
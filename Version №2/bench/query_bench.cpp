@@ -0,0 +1,165 @@
+#include "config.hpp"
+#include "history_store.hpp"
+#include "query_engine.hpp"
+#include "task_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct DeviceSeries {
+    std::vector<uint64_t> timestamps;
+    std::vector<float> values;
+};
+
+// Сэмплы раз в 10 мс, значения около 50 со своим сдвигом у каждого устройства.
+static std::vector<DeviceSeries> make_series(size_t devices, size_t samples) {
+    std::mt19937 rng(5);
+    std::normal_distribution<float> noise(0.0f, 20.0f);
+    std::vector<DeviceSeries> series(devices);
+    for (size_t id = 0; id < devices; ++id) {
+        series[id].timestamps.resize(samples);
+        series[id].values.resize(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            series[id].timestamps[i] = 1000000 + i * 10;
+            series[id].values[i] = 50.0f + static_cast<float>(id % 16) + noise(rng);
+        }
+    }
+    return series;
+}
+
+// Эталон: построчный обход исходных массивов с ветвлениями.
+static QueryPartial reference(const DeviceSeries& series, size_t retained, const QueryBounds& bounds) {
+    QueryPartial partial;
+    for (size_t i = series.values.size() - retained; i < series.values.size(); ++i) {
+        float value = series.values[i];
+        if (series.timestamps[i] < bounds.from || series.timestamps[i] > bounds.to) continue;
+        if (value < bounds.min_value || value > bounds.max_value) continue;
+        ++partial.count;
+        partial.sum += value;
+        partial.min = std::min(partial.min, value);
+        partial.max = std::max(partial.max, value);
+    }
+    return partial;
+}
+
+static bool same(const QueryPartial& a, const QueryPartial& b) {
+    if (a.count != b.count) return false;
+    if (a.count == 0) return true;
+    return a.min == b.min && a.max == b.max && std::fabs(a.sum - b.sum) <= 1e-9 * std::max(1.0, std::fabs(b.sum));
+}
+
+static bool check(const std::vector<DeviceSeries>& series, size_t retained, const QueryRequest& request,
+                  const QueryResult& result) {
+    size_t group = 0;
+    QueryPartial total;
+    for (uint32_t id : request.devices) {
+        QueryPartial expected = reference(series[id], retained, result.bounds);
+        if (request.by_device) {
+            if (expected.count == 0) continue;
+            if (group >= result.groups.size() || result.groups[group].device_id != id ||
+                !same(result.groups[group].partial, expected)) {
+                return false;
+            }
+            ++group;
+        }
+        total.merge(expected);
+    }
+    return request.by_device ? group == result.groups.size() : same(result.groups[0].partial, total);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    size_t devices = static_cast<size_t>(std::max(1, config.get_int("devices", 256)));
+    size_t samples = static_cast<size_t>(std::max(1, config.get_int("samples", 10000)));
+    size_t iterations = static_cast<size_t>(std::max(1, config.get_int("iterations", 20)));
+    size_t threads = static_cast<size_t>(std::max(1, config.get_int("threads", 4)));
+
+    std::vector<DeviceSeries> series = make_series(devices, samples);
+    auto store = std::make_unique<HistoryStore>();
+    store->configure(static_cast<uint32_t>(devices), samples);
+    uint64_t fill_start = now_ns();
+    for (size_t i = 0; i < samples; ++i) {
+        for (size_t id = 0; id < devices; ++id) {
+            store->append(static_cast<uint32_t>(id), series[id].values[i], series[id].timestamps[i]);
+        }
+    }
+    double fill_ns = static_cast<double>(now_ns() - fill_start) / static_cast<double>(devices * samples);
+    size_t retained = std::min(samples, store->capacity());
+    std::printf("history: %zu devices x %zu samples, %.1f ns/append, %.1f MiB, kernel %s\n", devices, retained,
+                fill_ns, store->memory_bytes() / 1048576.0, query_kernel_name(active_query_kernel()));
+
+    task_pool.start(threads);
+
+    struct Case {
+        const char* name;
+        std::string query;
+    };
+    const Case cases[] = {
+        {"all, value>60", "where=value>60&agg=count,sum,avg,min,max&group=device"},
+        {"all, no filter", "agg=count,avg,min,max"},
+        {"last 10%", "from=-" + std::to_string(samples) + "&agg=count,avg,max&group=device"},
+        {"10-40, last 30s", "devices=10-40&from=-30000&where=value>55&agg=avg,max&group=device"},
+        {"old 5%, 40<v<=60", "to=" + std::to_string(1000000 + samples / 2) + "&where=value>40,value<=60&agg=count,avg"},
+    };
+
+    struct Variant {
+        const char* name;
+        QueryKernel kernel;
+        bool pushdown;
+        size_t parallelism;
+    };
+    const Variant variants[] = {
+        {"scalar", QueryKernel::Scalar, false, 1},
+        {"avx2", QueryKernel::Avx2, false, 1},
+        {"avx2+pushdown", QueryKernel::Avx2, true, 1},
+        {"avx2+pushdown xN", QueryKernel::Avx2, true, threads},
+    };
+
+    bool ok = true;
+    for (const Case& c : cases) {
+        QueryRequest request;
+        std::string error;
+        if (!parse_query(c.query, static_cast<uint32_t>(devices), request, error)) {
+            std::fprintf(stderr, "%s: %s\n", c.query.c_str(), error.c_str());
+            return 1;
+        }
+        std::printf("%s (%s)\n", c.name, c.query.c_str());
+        for (const Variant& variant : variants) {
+            if (!query_kernel_supported(variant.kernel)) continue;
+            QueryExecution execution{variant.kernel, variant.pushdown, variant.parallelism};
+            QueryResult result;
+            run_query(*store, request, result, execution);
+            bool correct = check(series, retained, request, result);
+            ok = ok && correct;
+
+            uint64_t start = now_ns();
+            for (size_t i = 0; i < iterations; ++i) {
+                run_query(*store, request, result, execution);
+            }
+            double query_ns = static_cast<double>(now_ns() - start) / static_cast<double>(iterations);
+            double selected = static_cast<double>(request.devices.size() * retained);
+            std::printf("  %-18s %9.1f us/query %8.0f M samples/s | chunks scanned %5lu, skipped %5lu, "
+                        "summarized %5lu | %s\n",
+                        variant.name, query_ns / 1e3, selected / query_ns * 1e3,
+                        (unsigned long)result.chunks_scanned, (unsigned long)result.chunks_skipped,
+                        (unsigned long)result.chunks_summarized, correct ? "ok" : "MISMATCH");
+        }
+    }
+
+    task_pool.stop();
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
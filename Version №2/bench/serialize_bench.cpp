@@ -0,0 +1,63 @@
+#include "encoding.hpp"
+#include "bench_util.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+int main(int argc, char* argv[]) {
+    uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    Sample sample{};
+    sample.value = 23.456789012345;
+    sample.timestamp = 1700000000123ULL;
+
+    DeviceStats stats{};
+    stats.device_id = 42;
+    stats.min = -12.5;
+    stats.max = 98.0625;
+    stats.average = 41.123456789;
+    stats.count = RING_SIZE;
+
+    std::vector<uint8_t> ids;
+    for (int i = 0; i < 256; ++i) {
+        ids.push_back(static_cast<uint8_t>(i));
+    }
+
+    const ResponseFormat formats[] = {ResponseFormat::Json, ResponseFormat::MsgPack, ResponseFormat::Cbor};
+    const char* names[] = {"json", "msgpack", "cbor"};
+
+    std::printf("%-10s %-8s %12s %8s\n", "endpoint", "format", "ns/op", "bytes");
+    std::string out;
+    out.reserve(4096);
+
+    for (int f = 0; f < 3; ++f) {
+        double ns = measure_ns_per_op(iterations, [&] {
+            out.clear();
+            encode_latest(formats[f], 42, sample, out);
+            do_not_optimize(out.data());
+        });
+        std::printf("%-10s %-8s %12.1f %8zu\n", "latest", names[f], ns, out.size());
+    }
+
+    for (int f = 0; f < 3; ++f) {
+        double ns = measure_ns_per_op(iterations, [&] {
+            out.clear();
+            encode_stats(formats[f], stats, out);
+            do_not_optimize(out.data());
+        });
+        std::printf("%-10s %-8s %12.1f %8zu\n", "stats", names[f], ns, out.size());
+    }
+
+    for (int f = 0; f < 3; ++f) {
+        double ns = measure_ns_per_op(iterations / 10, [&] {
+            out.clear();
+            encode_devices(formats[f], ids, out);
+            do_not_optimize(out.data());
+        });
+        std::printf("%-10s %-8s %12.1f %8zu\n", "devices", names[f], ns, out.size());
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "ingest_worker.hpp"
+#include "shm_ingest_server.hpp"
+#include "shm_ring.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+static std::atomic<uint64_t> applied{0};
+static std::vector<uint64_t> latencies;
+static std::atomic<bool> record_latency{false};
+
+static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void apply_and_measure(const IngestMessage& msg) {
+    if (record_latency.load(std::memory_order_relaxed)) {
+        latencies.push_back(steady_ns() - msg.timestamp);
+    }
+    applied.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void wait_applied(uint64_t target) {
+    while (applied.load(std::memory_order_relaxed) < target) {
+        std::this_thread::yield();
+    }
+}
+
+static void report(const char* name, uint64_t count, double seconds) {
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [](double p) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1000.0;
+    };
+    std::printf("%-10s %14.0f %10.1f %10.1f %10.1f\n", name, count / seconds, pct(0.5), pct(0.99), pct(0.999));
+    latencies.clear();
+}
+
+template <typename Send, typename Flush>
+static void run(const char* name, uint64_t count, uint64_t probes, Send&& send, Flush&& flush) {
+    uint64_t base = applied.load();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        send(static_cast<uint8_t>(i & 0xff), static_cast<float>(i), i);
+    }
+    flush();
+    wait_applied(base + count);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    latencies.reserve(probes);
+    record_latency = true;
+    for (uint64_t i = 0; i < probes; ++i) {
+        uint64_t target = applied.load() + 1;
+        send(1, 1.0f, steady_ns());
+        flush();
+        wait_applied(target);
+    }
+    record_latency = false;
+    report(name, count, seconds);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+    uint64_t count = config.get_int("messages", 2000000);
+    uint64_t probes = config.get_int("probes", 10000);
+    int port = config.get_int("port", 19001);
+    std::string name = config.get_string("shm", "/telemetry_bench_ingest");
+
+    options.log_samples = false;
+    ingest_pipeline.start(1, apply_and_measure);
+
+    ShmIngestServer shm(name, 4, 65536);
+    IngestWorkerGroup tcp;
+    if (!shm.start() || !tcp.start(port, 1, {}, 128)) {
+        return 1;
+    }
+
+    std::printf("%-10s %14s %10s %10s %10s\n", "transport", "msg/s", "p50 us", "p99 us", "p99.9 us");
+
+    ShmIngestClient client;
+    if (!client.attach(name)) {
+        std::printf("failed to attach %s\n", name.c_str());
+        return 1;
+    }
+    run("shm", count, probes,
+        [&](uint8_t id, float value, uint64_t ts) { client.push_wait(id, value, ts); },
+        [&] { client.flush(); });
+    client.detach();
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        return 1;
+    }
+
+    std::vector<uint8_t> pending;
+    pending.reserve(64 * 1024);
+    auto flush_tcp = [&] {
+        size_t offset = 0;
+        while (offset < pending.size()) {
+            ssize_t n = write(fd, pending.data() + offset, pending.size() - offset);
+            if (n <= 0) break;
+            offset += n;
+        }
+        pending.clear();
+    };
+    run("tcp", count, probes,
+        [&](uint8_t id, float value, uint64_t ts) {
+            uint8_t frame[14];
+            frame[0] = id;
+            uint32_t bits;
+            std::memcpy(&bits, &value, 4);
+            for (int b = 0; b < 4; ++b) frame[1 + b] = static_cast<uint8_t>(bits >> (24 - 8 * b));
+            for (int b = 0; b < 8; ++b) frame[5 + b] = static_cast<uint8_t>(ts >> (56 - 8 * b));
+            frame[13] = calculate_crc8(frame, 13);
+            pending.insert(pending.end(), frame, frame + 14);
+            if (pending.size() >= 64 * 1024 - 14) flush_tcp();
+        },
+        flush_tcp);
+    close(fd);
+
+    tcp.stop();
+    shm.stop();
+    ingest_pipeline.stop();
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "config.hpp"
+#include "device_store.hpp"
+#include "device_view.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+
+static std::atomic<bool> stop{false};
+
+static uint64_t encode_timestamp(uint64_t step, int device_id) {
+    return step * MAX_DEVICES + device_id;
+}
+
+static bool consistent(const DeviceData& data, int device_id) {
+    if (data.count <= 0 || data.count > RING_SIZE || data.head < 0 || data.head >= RING_SIZE) {
+        return false;
+    }
+    int last = (data.head + RING_SIZE - 1) % RING_SIZE;
+    if (data.latest.timestamp != data.buffer[last].timestamp || data.latest.value != data.buffer[last].value) {
+        return false;
+    }
+    uint64_t newest = static_cast<uint64_t>(data.latest.value);
+    for (int i = 0; i < data.count; ++i) {
+        const Sample& sample = data.buffer[(last + RING_SIZE - i) % RING_SIZE];
+        if (static_cast<uint64_t>(sample.value) != newest - i ||
+            sample.timestamp != encode_timestamp(newest - i, device_id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+    int writers = config.get_int("writers", 4);
+    int readers = config.get_int("readers", 2);
+    int seconds = config.get_int("seconds", 2);
+    std::string name = config.get_string("shm", "/telemetry_bench_devices");
+
+    if (!device_store.publish(name)) {
+        return 1;
+    }
+
+    std::atomic<uint64_t> writes{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            uint64_t step = 1;
+            uint64_t local = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int id = w; id < MAX_DEVICES; id += writers) {
+                    device_store.apply(static_cast<uint8_t>(id), static_cast<double>(step), encode_timestamp(step, id));
+                    ++local;
+                }
+                ++step;
+            }
+            writes.fetch_add(local);
+        });
+    }
+
+    std::atomic<uint64_t> snapshots{0};
+    std::atomic<uint64_t> torn{0};
+    std::atomic<bool> attach_failed{false};
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&] {
+            DeviceTableView view;
+            if (!view.open(name)) {
+                attach_failed = true;
+                return;
+            }
+            DeviceData data;
+            uint64_t local = 0;
+            uint64_t bad = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (uint32_t id = 0; id < view.device_count(); ++id) {
+                    if (view.read(static_cast<uint8_t>(id), data) == SlotRead::Ok) {
+                        if (!consistent(data, static_cast<int>(id))) ++bad;
+                        ++local;
+                    }
+                }
+            }
+            snapshots.fetch_add(local);
+            torn.fetch_add(bad);
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    device_store.unpublish();
+
+    if (attach_failed) {
+        std::printf("failed to open %s\n", name.c_str());
+        return 1;
+    }
+    std::printf("writers=%d readers=%d seconds=%d\n", writers, readers, seconds);
+    std::printf("writes/s:          %.0f\n", static_cast<double>(writes.load()) / seconds);
+    std::printf("device reads/s:    %.0f\n", static_cast<double>(snapshots.load()) / seconds);
+    std::printf("torn snapshots:    %llu\n", static_cast<unsigned long long>(torn.load()));
+    return torn.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+#include "config.hpp"
+#include "device_store.hpp"
+#include "fleet_snapshot.hpp"
+#include "ingest_pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+
+static void apply_to_store(const IngestMessage& msg) {
+    device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+}
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Производитель пишет раунды: в раунде r каждое устройство по порядку получает
+// метку r. Писатель шарда применяет сэмплы в порядке записи, поэтому в
+// согласованном срезе метки по устройствам шарда не растут и отличаются не
+// больше чем на единицу.
+static bool consistent(const uint64_t* rounds, size_t devices, size_t shards) {
+    for (size_t shard = 0; shard < shards; ++shard) {
+        uint64_t first = rounds[shard];
+        uint64_t previous = first;
+        for (size_t id = shard + shards; id < devices; id += shards) {
+            if (rounds[id] > previous || first - rounds[id] > 1) return false;
+            previous = rounds[id];
+        }
+    }
+    return true;
+}
+
+// Темп читателя: 0 — без пауз, иначе чтений в секунду на поток.
+static double read_rate = 0;
+
+static void pace(uint64_t& next) {
+    if (read_rate <= 0) return;
+    next += static_cast<uint64_t>(1e9 / read_rate);
+    uint64_t now = now_ns();
+    if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+}
+
+struct ReaderResult {
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t reused = 0;
+};
+
+// Снимок парка читается из опубликованного среза.
+static void read_snapshots(std::atomic<bool>& stop, size_t devices, size_t shards, ReaderResult& result) {
+    uint64_t rounds[MAX_DEVICES];
+    uint64_t next = now_ns();
+    while (!stop.load(std::memory_order_relaxed)) {
+        pace(next);
+        auto snapshot = fleet_snapshots.read();
+        if (!snapshot) continue;
+        uint64_t version = snapshot->version;
+        if (snapshot->device_count < devices) continue;
+        for (size_t id = 0; id < devices; ++id) {
+            rounds[id] = snapshot->devices[id].latest.timestamp;
+        }
+        result.torn += consistent(rounds, devices, shards) ? 0 : 1;
+        // Срез не должен переиспользоваться, пока читатель держит эпоху.
+        result.reused += snapshot->version != version ? 1 : 0;
+        ++result.reads;
+    }
+}
+
+// Тот же снимок, собранный обходом seqlock каждого устройства.
+static void read_scan(std::atomic<bool>& stop, size_t devices, size_t shards, ReaderResult& result) {
+    uint64_t rounds[MAX_DEVICES];
+    uint64_t next = now_ns();
+    while (!stop.load(std::memory_order_relaxed)) {
+        pace(next);
+        Sample latest{};
+        for (size_t id = 0; id < devices; ++id) {
+            rounds[id] = device_store.latest(static_cast<uint8_t>(id), latest) ? latest.timestamp : 0;
+        }
+        result.torn += consistent(rounds, devices, shards) ? 0 : 1;
+        ++result.reads;
+    }
+}
+
+static void run_phase(const char* mode, bool snapshots, size_t readers, size_t devices, size_t shards, double seconds) {
+    std::atomic<bool> stop{false};
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    uint64_t applied_before = ingest_pipeline.applied_total();
+    uint64_t published_before = fleet_snapshots.published();
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < readers; ++i) {
+        threads.emplace_back([&, i] {
+            if (snapshots) {
+                read_snapshots(stop, devices, shards, results[i]);
+            } else {
+                read_scan(stop, devices, shards, results[i]);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<uint64_t>(seconds * 1e9)));
+    stop.store(true);
+    for (auto& thread : threads) thread.join();
+    double elapsed = static_cast<double>(now_ns() - start) / 1e9;
+
+    ReaderResult total;
+    for (const ReaderResult& result : results) {
+        total.reads += result.reads;
+        total.torn += result.torn;
+        total.reused += result.reused;
+    }
+    std::printf("%-9s readers=%zu: %10.0f fleet reads/s, inconsistent %6.2f%%, reused %lu | "
+                "ingest %6.2f M samples/s, snapshots %lu\n",
+                mode, readers, total.reads / elapsed,
+                100.0 * total.torn / std::max<uint64_t>(1, total.reads), (unsigned long)total.reused,
+                (ingest_pipeline.applied_total() - applied_before) / elapsed / 1e6,
+                (unsigned long)(fleet_snapshots.published() - published_before));
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    size_t devices = std::clamp(config.get_int("devices", 256), 1, MAX_DEVICES);
+    size_t shards = static_cast<size_t>(std::max(1, config.get_int("shards", 1)));
+    double seconds = config.get_double("seconds", 1.0);
+    uint64_t interval_ms = static_cast<uint64_t>(std::max(1, config.get_int("interval-ms", 10)));
+    size_t max_readers = static_cast<size_t>(std::max(1, config.get_int("readers", 4)));
+    read_rate = config.get_double("read-rate", 0);
+
+    fleet_snapshots.configure(interval_ms);
+    ingest_pipeline.set_batch_hook(fleet_snapshot_hook);
+    ingest_pipeline.start(shards, apply_to_store);
+
+    std::atomic<bool> stop{false};
+    std::thread producer_thread([&] {
+        IngestProducer* producer = ingest_pipeline.register_producer();
+        IngestMessage msg{};
+        for (uint64_t round = 1; !stop.load(std::memory_order_relaxed); ++round) {
+            for (size_t id = 0; id < devices; ++id) {
+                msg.device_id = static_cast<uint8_t>(id);
+                msg.timestamp = round;
+                msg.value = static_cast<float>(id);
+                producer->push(msg);
+            }
+            producer->flush();
+        }
+        producer->close();
+    });
+
+    while (fleet_snapshots.published() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    run_phase("idle", false, 0, devices, shards, seconds);
+    for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+        run_phase("scan", false, readers, devices, shards, seconds);
+    }
+    for (size_t readers = 1; readers <= max_readers; readers *= 2) {
+        run_phase("snapshot", true, readers, devices, shards, seconds);
+    }
+
+    stop.store(true);
+    producer_thread.join();
+    ingest_pipeline.stop();
+    std::printf("snapshots: published %lu, allocated %zu, awaiting reclamation %zu, last build %.1f us\n",
+                (unsigned long)fleet_snapshots.published(), fleet_snapshots.allocated(), fleet_snapshots.retired(),
+                fleet_snapshots.build_ns() / 1e3);
+    return 0;
+}
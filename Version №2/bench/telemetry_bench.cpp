@@ -0,0 +1,311 @@
+#include "bench_util.hpp"
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "crc32c.hpp"
+#include "device_store.hpp"
+#include "encoding.hpp"
+#include "frame_decoder.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct Benchmark {
+    std::string name;
+    uint64_t bytes_per_op;
+    std::function<void(uint64_t)> run;
+};
+
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double min_ns_per_op;
+    uint64_t bytes_per_op;
+};
+
+
+static std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+static void add_benchmark(const std::string& name, uint64_t bytes_per_op, std::function<void(uint64_t)> run) {
+    registry().push_back({name, bytes_per_op, std::move(run)});
+}
+
+static double run_for(const Benchmark& bench, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    bench.run(iterations);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result measure(const Benchmark& bench, double min_time_ns, int repetitions) {
+    uint64_t iterations = 1;
+    double elapsed = run_for(bench, iterations);
+    while (elapsed < min_time_ns && iterations < (uint64_t{1} << 40)) {
+        double scale = elapsed > 0 ? min_time_ns / elapsed * 1.2 : 10.0;
+        iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * std::min(scale, 10.0)));
+        elapsed = run_for(bench, iterations);
+    }
+
+    std::vector<double> samples;
+    samples.push_back(elapsed / iterations);
+    for (int r = 1; r < repetitions; ++r) {
+        samples.push_back(run_for(bench, iterations) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    return {bench.name, iterations, samples[samples.size() / 2], samples.front(), bench.bytes_per_op};
+}
+
+
+static std::vector<uint8_t> make_frames(size_t count) {
+    std::vector<uint8_t> data(count * LEGACY_FRAME_SIZE);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* frame = data.data() + i * LEGACY_FRAME_SIZE;
+        float value = 20.0f + static_cast<float>(i % 100) / 10.0f;
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint64_t timestamp = 1700000000000ULL + i;
+        frame[0] = static_cast<uint8_t>(i);
+        for (int b = 0; b < 4; ++b) frame[1 + b] = static_cast<uint8_t>(bits >> (24 - 8 * b));
+        for (int b = 0; b < 8; ++b) frame[5 + b] = static_cast<uint8_t>(timestamp >> (56 - 8 * b));
+        frame[13] = calculate_crc8(frame, 13);
+    }
+    return data;
+}
+
+static DeviceData make_full_device() {
+    DeviceData device;
+    for (int i = 0; i < RING_SIZE; ++i) {
+        device.add_sample(20.0 + i * 0.1, 1700000000000ULL + i);
+    }
+    return device;
+}
+
+template <typename Fn>
+static void with_background_thread(Fn&& background, uint64_t iterations, const std::function<void()>& op) {
+    std::atomic<bool> stop{false};
+    std::thread thread([&] { background(stop); });
+    for (uint64_t i = 0; i < iterations; ++i) {
+        op();
+    }
+    stop = true;
+    thread.join();
+}
+
+static void noop_apply(const IngestMessage& msg) {
+    do_not_optimize(msg);
+}
+
+static void register_benchmarks() {
+    static const std::vector<uint8_t> frames = make_frames(256);
+
+    add_benchmark("crc/crc8_13B", 13, [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            do_not_optimize(calculate_crc8(frames.data() + (i & 255) * LEGACY_FRAME_SIZE, 13));
+        }
+    });
+    add_benchmark("crc/crc32c_13B", 13, [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            do_not_optimize(crc32c(frames.data() + (i & 255) * LEGACY_FRAME_SIZE, 13));
+        }
+    });
+    add_benchmark("parse/parse_binary_message", LEGACY_FRAME_SIZE, [](uint64_t n) {
+        uint8_t id;
+        float value;
+        uint64_t timestamp;
+        for (uint64_t i = 0; i < n; ++i) {
+            parse_binary_message(frames.data() + (i & 255) * LEGACY_FRAME_SIZE, id, value, timestamp);
+            do_not_optimize(timestamp);
+        }
+    });
+    add_benchmark("parse/decode_frames_256", 256 * LEGACY_FRAME_SIZE, [](uint64_t n) {
+        uint8_t ids[256];
+        float values[256];
+        uint64_t timestamps[256];
+        uint8_t valid[256];
+        DecodedFrames out{ids, values, timestamps, valid};
+        for (uint64_t i = 0; i < n; ++i) {
+            do_not_optimize(decode_frames(frames.data(), 256, out));
+        }
+    });
+    add_benchmark("parse/process_frames_256", 256 * LEGACY_FRAME_SIZE, [](uint64_t n) {
+        IngestProducer* producer = ingest_pipeline.register_producer();
+        for (uint64_t i = 0; i < n; ++i) {
+            do_not_optimize(process_frames(frames.data(), 256, *producer));
+        }
+        producer->close();
+    });
+
+    add_benchmark("store/DeviceData::add_sample", 0, [](uint64_t n) {
+        DeviceData device;
+        for (uint64_t i = 0; i < n; ++i) {
+            device.add_sample(static_cast<double>(i), i);
+        }
+        do_not_optimize(device);
+    });
+    add_benchmark("store/DeviceData::get_stats", 0, [](uint64_t n) {
+        DeviceData device = make_full_device();
+        double min_val = 0, max_val = 0, average = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            device.get_stats(min_val, max_val, average);
+            do_not_optimize(average);
+        }
+    });
+    add_benchmark("store/DeviceStore::apply", 0, [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            do_not_optimize(device_store.apply(static_cast<uint8_t>(i), static_cast<double>(i), i));
+        }
+    });
+    add_benchmark("store/DeviceStore::read", 0, [](uint64_t n) {
+        DeviceData device;
+        for (uint64_t i = 0; i < n; ++i) {
+            do_not_optimize(device_store.read(static_cast<uint8_t>(i), device));
+        }
+    });
+    add_benchmark("store/DeviceStore::apply_contended_reader", 0, [](uint64_t n) {
+        uint64_t i = 0;
+        with_background_thread([](std::atomic<bool>& stop) {
+            DeviceData device;
+            for (uint8_t id = 0; !stop.load(std::memory_order_relaxed); ++id) {
+                do_not_optimize(device_store.read(id & 7, device));
+            }
+        }, n, [&] {
+            do_not_optimize(device_store.apply(static_cast<uint8_t>(i & 7), static_cast<double>(i), i));
+            ++i;
+        });
+    });
+    add_benchmark("store/DeviceStore::stats_contended_writer", 0, [](uint64_t n) {
+        uint64_t i = 0;
+        with_background_thread([](std::atomic<bool>& stop) {
+            for (uint64_t k = 0; !stop.load(std::memory_order_relaxed); ++k) {
+                device_store.apply(static_cast<uint8_t>(k & 7), static_cast<double>(k), k);
+            }
+        }, n, [&] {
+            DeviceData device;
+            double min_val = 0, max_val = 0, average = 0;
+            if (device_store.read(static_cast<uint8_t>(i & 7), device)) {
+                device.get_stats(min_val, max_val, average);
+            }
+            do_not_optimize(average);
+            ++i;
+        });
+    });
+
+    add_benchmark("serialize/latest_json", 0, [](uint64_t n) {
+        Sample sample{23.456789, 1700000000123ULL};
+        std::string out;
+        for (uint64_t i = 0; i < n; ++i) {
+            out.clear();
+            encode_latest(ResponseFormat::Json, 42, sample, out);
+            do_not_optimize(out.data());
+        }
+    });
+    add_benchmark("serialize/stats_json", 0, [](uint64_t n) {
+        DeviceStats stats{42, -12.5, 98.0625, 41.123456789, RING_SIZE};
+        std::string out;
+        for (uint64_t i = 0; i < n; ++i) {
+            out.clear();
+            encode_stats(ResponseFormat::Json, stats, out);
+            do_not_optimize(out.data());
+        }
+    });
+    add_benchmark("serialize/devices_json_256", 0, [](uint64_t n) {
+        std::vector<uint8_t> ids(256);
+        for (int i = 0; i < 256; ++i) ids[i] = static_cast<uint8_t>(i);
+        std::string out;
+        for (uint64_t i = 0; i < n; ++i) {
+            out.clear();
+            encode_devices(ResponseFormat::Json, ids, out);
+            do_not_optimize(out.data());
+        }
+    });
+    add_benchmark("serialize/stats_msgpack", 0, [](uint64_t n) {
+        DeviceStats stats{42, -12.5, 98.0625, 41.123456789, RING_SIZE};
+        std::string out;
+        for (uint64_t i = 0; i < n; ++i) {
+            out.clear();
+            encode_stats(ResponseFormat::MsgPack, stats, out);
+            do_not_optimize(out.data());
+        }
+    });
+}
+
+
+static void print_console(const Result& r) {
+    double mbps = r.bytes_per_op > 0 ? r.bytes_per_op / r.ns_per_op * 1e3 : 0;
+    std::printf("%-45s %14llu %12.2f %12.2f %10.1f\n", r.name.c_str(),
+                static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.min_ns_per_op, mbps);
+    std::fflush(stdout);
+}
+
+static void print_json(const std::vector<Result>& results, int repetitions) {
+    std::printf("{\"context\": {\"decoder\": \"%s\", \"crc32c_hw\": %s, \"threads\": %u, \"repetitions\": %d},\n",
+                decoder_name(active_decoder()), crc32c_hw_supported() ? "true" : "false",
+                std::thread::hardware_concurrency(), repetitions);
+    std::printf(" \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("  {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, "
+                    "\"bytes_per_op\": %llu}%s\n",
+                    r.name.c_str(), static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.min_ns_per_op,
+                    static_cast<unsigned long long>(r.bytes_per_op), i + 1 < results.size() ? "," : "");
+    }
+    std::printf(" ]}\n");
+}
+
+static void print_csv(const std::vector<Result>& results) {
+    std::printf("name,iterations,ns_per_op,min_ns_per_op,bytes_per_op\n");
+    for (const Result& r : results) {
+        std::printf("%s,%llu,%.3f,%.3f,%llu\n", r.name.c_str(), static_cast<unsigned long long>(r.iterations),
+                    r.ns_per_op, r.min_ns_per_op, static_cast<unsigned long long>(r.bytes_per_op));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+    std::string filter = config.get_string("filter");
+    std::string format = config.get_string("format", "console");
+    double min_time_ms = config.get_double("min-time-ms", 200.0);
+    int repetitions = std::max(1, config.get_int("repetitions", 3));
+
+    register_benchmarks();
+    if (config.has("list")) {
+        for (const Benchmark& bench : registry()) {
+            std::printf("%s\n", bench.name.c_str());
+        }
+        return 0;
+    }
+
+    options.log_samples = false;
+    ingest_pipeline.start(1, noop_apply);
+
+    if (format == "console") {
+        std::printf("%-45s %14s %12s %12s %10s\n", "benchmark", "iterations", "ns/op", "min ns/op", "MB/s");
+    }
+    std::vector<Result> results;
+    for (const Benchmark& bench : registry()) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+        results.push_back(measure(bench, min_time_ms * 1e6, repetitions));
+        if (format == "console") {
+            print_console(results.back());
+        }
+    }
+
+    ingest_pipeline.stop();
+
+    if (format == "json") {
+        print_json(results, repetitions);
+    } else if (format == "csv") {
+        print_csv(results);
+    }
+    return 0;
+}
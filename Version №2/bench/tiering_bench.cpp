@@ -0,0 +1,192 @@
+#include "config.hpp"
+#include "history_store.hpp"
+#include "query_engine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Текущий и пиковый RSS процесса в МиБ.
+static double rss_mb(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind(field, 0) == 0) return std::stod(line.substr(std::string(field).size())) / 1024.0;
+    }
+    return 0;
+}
+
+static const uint64_t BASE_TS = 1700000000000ULL;
+
+// Датчик с шагом 0.1: значение зависит от устройства и номера сэмпла,
+// поэтому итог любого запроса можно пересчитать.
+static float sample_value(uint32_t device, uint64_t index) {
+    return static_cast<float>((device * 7 + index * 13) % 1000) / 10.0f;
+}
+
+static void report(const char* phase, const HistoryStore& store, double baseline) {
+    std::printf("%-14s rss %7.1f MiB (+%7.1f), history %7.1f MiB, resident %7zu, compressed %7zu, spilled %7zu | "
+                "evicted %lu/%lu/%lu, page-ins %lu/%lu, streamed %lu/%lu, spill file %.1f MiB\n",
+                phase, rss_mb("VmRSS:"), rss_mb("VmRSS:") - baseline, store.memory_bytes() / 1048576.0,
+                store.devices_in(HistoryTier::Resident), store.devices_in(HistoryTier::Compressed),
+                store.devices_in(HistoryTier::Spilled),
+                (unsigned long)store.evictions(HistoryTier::Compressed),
+                (unsigned long)store.evictions(HistoryTier::Spilled),
+                (unsigned long)store.evictions(HistoryTier::Empty),
+                (unsigned long)store.page_ins(HistoryTier::Compressed),
+                (unsigned long)store.page_ins(HistoryTier::Spilled),
+                (unsigned long)store.streamed_reads(HistoryTier::Compressed),
+                (unsigned long)store.streamed_reads(HistoryTier::Spilled), store.spill_file_bytes() / 1048576.0);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    uint32_t devices = static_cast<uint32_t>(std::max(1, config.get_int("devices", 1000000)));
+    uint64_t samples = static_cast<uint64_t>(std::max(1, config.get_int("samples", 64)));
+    size_t history = static_cast<size_t>(std::max(1, config.get_int("history", 512)));
+    size_t budget_mb = static_cast<size_t>(std::max(0, config.get_int("budget-mb", 256)));
+    std::string spill = config.get_string("spill", "/tmp/telemetry_history.spill");
+    uint32_t hot = static_cast<uint32_t>(std::clamp(config.get_int("hot", 2000), 1, static_cast<int>(devices)));
+    uint64_t hot_rounds = static_cast<uint64_t>(std::max(0, config.get_int("hot-rounds", 200)));
+    size_t queries = static_cast<size_t>(std::max(1, config.get_int("queries", 2000)));
+
+    auto store = std::make_unique<HistoryStore>();
+    store->configure(devices, history);
+    if (!store->set_budget(budget_mb << 20, spill)) {
+        std::fprintf(stderr, "cannot open spill file %s\n", spill.c_str());
+        return 1;
+    }
+    double baseline = rss_mb("VmRSS:");
+    size_t ring_bytes = HistoryRing::footprint(store->chunk_count());
+    std::printf("%u devices x %lu samples, ring %zu KiB, budget %zu MiB, without budget %.0f MiB, "
+                "metadata rss %.1f MiB\n",
+                devices, (unsigned long)samples, ring_bytes / 1024, budget_mb,
+                static_cast<double>(ring_bytes) * devices / 1048576.0, baseline);
+
+    // Заполнение: устройства присылают историю пачками по очереди, как после
+    // переподключения парка. Писатель обслуживает бюджет каждые 1024 сэмпла.
+    uint64_t appended = 0;
+    uint64_t fill_start = now_ns();
+    for (uint32_t device = 0; device < devices; ++device) {
+        for (uint64_t i = 0; i < samples; ++i) {
+            store->append(device, sample_value(device, i), BASE_TS + i * 1000);
+            if ((++appended & 1023) == 0) store->maintain(0, 1);
+        }
+        if ((device + 1) % std::max<uint32_t>(1, devices / 5) == 0) {
+            char phase[32];
+            std::snprintf(phase, sizeof(phase), "fill %u", device + 1);
+            report(phase, *store, baseline);
+        }
+    }
+    store->maintain(0, 1);
+    double fill_s = static_cast<double>(now_ns() - fill_start) / 1e9;
+    std::printf("fill: %.1f M samples/s\n", appended / fill_s / 1e6);
+
+    // Горячий набор: часть устройств пишет дальше и держится в памяти.
+    uint64_t page_ins_before = store->page_ins(HistoryTier::Compressed) + store->page_ins(HistoryTier::Spilled);
+    for (uint64_t round = 0; round < hot_rounds; ++round) {
+        for (uint32_t device = 0; device < hot; ++device) {
+            store->append(device, sample_value(device, samples + round), BASE_TS + (samples + round) * 1000);
+            if ((++appended & 1023) == 0) store->maintain(0, 1);
+        }
+    }
+    uint64_t hot_page_ins = store->page_ins(HistoryTier::Compressed) + store->page_ins(HistoryTier::Spilled) -
+                            page_ins_before;
+    report("hot set", *store, baseline);
+    std::printf("hot set: %u devices x %lu rounds, page-ins %lu\n", hot, (unsigned long)hot_rounds,
+                (unsigned long)hot_page_ins);
+
+    // Запросы к случайным холодным устройствам читают историю из сжатого
+    // вида или файла, не возвращая ее в память; итог сверяется с пересчетом.
+    // Без файла сброса часть истории отброшена, такие устройства только
+    // считаются.
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<uint32_t> pick(hot < devices ? hot : 0, devices - 1);
+    std::vector<uint64_t> latencies;
+    latencies.reserve(queries);
+    bool ok = true;
+    size_t discarded = 0;
+    for (size_t q = 0; q < queries; ++q) {
+        uint32_t device = pick(rng);
+        bool lost = store->tier(device) == HistoryTier::Empty;
+        QueryRequest request;
+        std::string error;
+        parse_query("devices=" + std::to_string(device) + "&agg=count,sum", devices, request, error);
+        QueryResult result;
+        uint64_t start = now_ns();
+        run_query(*store, request, result);
+        latencies.push_back(now_ns() - start);
+        store->maintain(0, 1);
+
+        if (lost) {
+            ++discarded;
+            continue;
+        }
+        uint64_t expected_count = std::min<uint64_t>(samples, store->capacity());
+        double expected_sum = 0;
+        for (uint64_t i = samples - expected_count; i < samples; ++i) expected_sum += sample_value(device, i);
+        const QueryPartial& partial = result.groups[0].partial;
+        ok = ok && partial.count == expected_count && partial.sum == expected_sum;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    report("cold queries", *store, baseline);
+    std::printf("cold queries: %zu (%zu discarded), p50 %.1f us, p99 %.1f us, results %s\n", queries, discarded,
+                latencies[latencies.size() / 2] / 1e3, latencies[latencies.size() * 99 / 100] / 1e3,
+                ok ? "match" : "MISMATCH");
+
+    // Один запрос по всем устройствам: холодные читаются по очереди через
+    // временное кольцо, и память истории не растет.
+    QueryRequest all;
+    std::string all_error;
+    parse_query("agg=count", devices, all, all_error);
+    QueryResult all_result;
+    size_t memory_before = store->memory_bytes();
+    uint64_t all_start = now_ns();
+    run_query(*store, all, all_result);
+    double all_ms = static_cast<double>(now_ns() - all_start) / 1e6;
+    bool streamed = store->memory_bytes() <= memory_before;
+    report("full scan", *store, baseline);
+    std::printf("full scan: %u devices in %.0f ms, %lu samples, history memory unchanged: %s\n", devices, all_ms,
+                (unsigned long)all_result.groups[0].partial.count, streamed ? "yes" : "no");
+
+    // Окно новее всей истории холодного устройства отсекается по последней
+    // метке и не возвращает его в память.
+    auto cold_reads = [&] {
+        return store->page_ins(HistoryTier::Compressed) + store->page_ins(HistoryTier::Spilled) +
+               store->streamed_reads(HistoryTier::Compressed) + store->streamed_reads(HistoryTier::Spilled);
+    };
+    uint64_t before = cold_reads();
+    QueryRequest recent;
+    std::string error;
+    parse_query("devices=" + std::to_string(devices - 1) + "&from=" + std::to_string(BASE_TS + samples * 1000),
+                devices, recent, error);
+    QueryResult recent_result;
+    run_query(*store, recent, recent_result);
+    bool pruned = cold_reads() == before && recent_result.groups[0].partial.count == 0;
+
+    // Бюджет ограничивает и RSS: пик сверх метаданных не выше бюджета.
+    double peak = rss_mb("VmHWM:") - baseline;
+    bool bounded = budget_mb == 0 || (store->memory_bytes() <= (budget_mb << 20) && peak <= budget_mb);
+    std::printf("peak rss above metadata %.1f MiB for budget %zu MiB, within budget: %s, "
+                "window pruned without reading history: %s\n",
+                peak, budget_mb, bounded ? "yes" : "no", pruned ? "yes" : "no");
+
+    store.reset();
+    if (!spill.empty()) unlink(spill.c_str());
+    ok = ok && streamed && bounded && pruned;
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
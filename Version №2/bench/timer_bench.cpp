@@ -0,0 +1,195 @@
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "connection_limiter.hpp"
+#include "device_store.hpp"
+#include "ingest_worker.hpp"
+#include "timer_wheel.hpp"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <random>
+#include <set>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Каждое "чтение" продлевает срок случайного соединения на idle_ms, время
+// идет тиками по 1 мс. Колесо сравнивается с упорядоченным множеством сроков,
+// где продление — это удаление и вставка.
+static void bench_wheel(size_t timers, size_t touches, uint64_t idle_ms) {
+    std::mt19937 rng(42);
+    std::vector<uint32_t> order(touches);
+    for (auto& index : order) index = rng() % timers;
+
+    uint64_t fired = 0;
+    double wheel_ns = 0;
+    {
+        uint64_t clock_ms = 1000;
+        TimerWheel wheel(clock_ms);
+        std::vector<TimerWheel::Timer> nodes(timers);
+        for (auto& node : nodes) wheel.schedule(node, clock_ms + idle_ms);
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < touches; ++i) {
+            if (i % 1000 == 0) {
+                wheel.advance(++clock_ms, [&](TimerWheel::Timer&) { ++fired; });
+            }
+            wheel.schedule(nodes[order[i]], clock_ms + idle_ms);
+        }
+        wheel_ns = static_cast<double>(now_ns() - start) / touches;
+    }
+
+    double set_ns = 0;
+    {
+        uint64_t clock_ms = 1000;
+        std::set<std::pair<uint64_t, uint32_t>> deadlines;
+        std::vector<uint64_t> current(timers, clock_ms + idle_ms);
+        for (uint32_t i = 0; i < timers; ++i) deadlines.emplace(current[i], i);
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < touches; ++i) {
+            if (i % 1000 == 0) {
+                ++clock_ms;
+                while (!deadlines.empty() && deadlines.begin()->first <= clock_ms) {
+                    deadlines.erase(deadlines.begin());
+                }
+            }
+            uint32_t index = order[i];
+            deadlines.erase({current[index], index});
+            current[index] = clock_ms + idle_ms;
+            deadlines.emplace(current[index], index);
+        }
+        set_ns = static_cast<double>(now_ns() - start) / touches;
+    }
+
+    std::printf("timers=%zu touches=%zu: wheel %.1f ns/touch, std::set %.1f ns/touch, fired=%lu\n",
+                timers, touches, wheel_ns, set_ns, (unsigned long)fired);
+}
+
+static int connect_to(int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void make_frame(uint8_t* frame, uint8_t device) {
+    std::memset(frame, 0, 14);
+    frame[0] = device;
+    frame[12] = 1;
+    frame[13] = calculate_crc8(frame, 13);
+}
+
+// Сервер закрыл соединение, если чтение вернуло 0 или ошибку без EAGAIN.
+static bool closed_by_server(int fd) {
+    char byte;
+    ssize_t n = recv(fd, &byte, 1, MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+static void apply_to_store(const IngestMessage& msg) {
+    device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+}
+
+// Сценарий на живом потоке приема: часть соединений простаивает, часть
+// держит неполный кадр и досылает по байту, часть работает нормально, а лишние
+// соединения с одного адреса отклоняются лимитом.
+static bool run_eviction(int port, size_t per_group, uint64_t idle_ms, uint64_t frame_ms) {
+    options.log_samples = false;
+    options.idle_timeout_ms = idle_ms;
+    options.frame_timeout_ms = frame_ms;
+    connection_limiter.configure(0, static_cast<uint32_t>(per_group * 3));
+
+    ingest_pipeline.start(1, apply_to_store);
+    IngestWorkerGroup group;
+    if (!group.start(port, 1, {}, 4096)) return false;
+
+    std::vector<int> idle, slow, healthy, extra;
+    for (size_t i = 0; i < per_group; ++i) idle.push_back(connect_to(port));
+    for (size_t i = 0; i < per_group; ++i) slow.push_back(connect_to(port));
+    for (size_t i = 0; i < per_group; ++i) healthy.push_back(connect_to(port));
+    for (size_t i = 0; i < per_group; ++i) extra.push_back(connect_to(port));
+
+    uint8_t frame[14];
+    make_frame(frame, 1);
+    for (int fd : slow) send(fd, frame, 5, MSG_NOSIGNAL);
+
+    // Медленные досылают по байту чаще idle, но кадр не завершают за frame_ms.
+    uint64_t start = now_ns();
+    uint64_t duration_ns = (std::max(idle_ms, frame_ms) * 2 + 300) * 1000000;
+    size_t step = 0;
+    while (now_ns() - start < duration_ns) {
+        for (int fd : healthy) send(fd, frame, sizeof(frame), MSG_NOSIGNAL);
+        if (step % 4 == 0 && step / 4 < 8) {
+            for (int fd : slow) send(fd, frame + 5 + step / 4, 1, MSG_NOSIGNAL);
+        }
+        ++step;
+        std::this_thread::sleep_for(std::chrono::milliseconds(idle_ms / 8 + 1));
+    }
+
+    auto closed = [](const std::vector<int>& fds) {
+        size_t count = 0;
+        for (int fd : fds) count += closed_by_server(fd) ? 1 : 0;
+        return count;
+    };
+    size_t idle_closed = closed(idle), slow_closed = closed(slow);
+    size_t healthy_closed = closed(healthy), extra_closed = closed(extra);
+
+    std::printf("eviction: idle %zu/%zu closed, slow %zu/%zu closed, healthy %zu/%zu closed, "
+                "over cap %zu/%zu refused\n",
+                idle_closed, per_group, slow_closed, per_group, healthy_closed, per_group, extra_closed, per_group);
+    std::printf("counters: evicted idle=%lu slow=%lu, rejected per_ip=%lu, open=%lu\n",
+                (unsigned long)ingest_counters.evicted_idle.load(), (unsigned long)ingest_counters.evicted_slow.load(),
+                (unsigned long)ingest_counters.rejected_per_ip.load(), (unsigned long)connection_limiter.open());
+
+    for (auto* fds : {&idle, &slow, &healthy, &extra}) {
+        for (int fd : *fds) close(fd);
+    }
+    group.stop();
+    ingest_pipeline.stop();
+
+    return idle_closed == per_group && slow_closed == per_group && healthy_closed == 0 &&
+           extra_closed == per_group && ingest_counters.evicted_idle.load() == per_group &&
+           ingest_counters.evicted_slow.load() == per_group && ingest_counters.rejected_per_ip.load() == per_group;
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    size_t timers = config.get_int("timers", 100000);
+    size_t touches = config.get_int("touches", 5000000);
+    int port = config.get_int("port", 19202);
+    size_t per_group = config.get_int("connections", 50);
+    uint64_t idle_ms = config.get_int("idle-ms", 400);
+    uint64_t frame_ms = config.get_int("frame-ms", 250);
+
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    bench_wheel(timers / 10, touches, 60000);
+    bench_wheel(timers, touches, 60000);
+    bench_wheel(timers * 10, touches, 60000);
+
+    bool ok = run_eviction(port, per_group, idle_ms, frame_ms);
+    std::printf("%s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "device_store.hpp"
+#include "ingest_worker.hpp"
+#include "udp_listener.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+static void apply_to_store(const IngestMessage& msg) {
+    device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+}
+
+static std::vector<uint8_t> make_frames(size_t count) {
+    std::vector<uint8_t> frames(count * 14);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* frame = frames.data() + i * 14;
+        frame[0] = static_cast<uint8_t>(i & 0xff);
+        float value = static_cast<float>(i);
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        for (int b = 0; b < 4; ++b) frame[1 + b] = static_cast<uint8_t>(bits >> (24 - 8 * b));
+        uint64_t ts = 1700000000000ULL + i;
+        for (int b = 0; b < 8; ++b) frame[5 + b] = static_cast<uint8_t>(ts >> (56 - 8 * b));
+        frame[13] = calculate_crc8(frame, 13);
+    }
+    return frames;
+}
+
+static double wait_applied(uint64_t base, uint64_t expected, std::chrono::steady_clock::time_point start) {
+    auto last_change = std::chrono::steady_clock::now();
+    uint64_t last = ingest_pipeline.applied_total();
+    while (last - base < expected) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        uint64_t now = ingest_pipeline.applied_total();
+        if (now != last) {
+            last = now;
+            last_change = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - last_change > std::chrono::milliseconds(300)) {
+            break;
+        }
+    }
+    return std::chrono::duration<double>(last_change - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    size_t total = config.get_int("frames", 2000000);
+    size_t per_datagram = config.get_int("per-datagram", 100);
+    size_t batch = config.get_int("batch", 64);
+    int udp_port = config.get_int("udp-port", 19002);
+    int tcp_port = config.get_int("tcp-port", 19001);
+
+    options.log_samples = false;
+    ingest_pipeline.start(1, apply_to_store);
+
+    UdpListener listener(udp_port, batch, 16 * 1024 * 1024);
+    IngestWorkerGroup tcp;
+    if (!listener.start() || !tcp.start(tcp_port, 1, {}, 128)) {
+        return 1;
+    }
+
+    std::vector<uint8_t> frames = make_frames(total);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        address.sin_port = htons(udp_port);
+        connect(fd, (sockaddr*)&address, sizeof(address));
+
+        size_t datagrams = total / per_datagram;
+        std::vector<iovec> iovecs(datagrams);
+        std::vector<mmsghdr> messages(datagrams);
+        for (size_t i = 0; i < datagrams; ++i) {
+            iovecs[i].iov_base = frames.data() + i * per_datagram * 14;
+            iovecs[i].iov_len = per_datagram * 14;
+            messages[i] = mmsghdr{};
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        uint64_t base = ingest_pipeline.applied_total();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t sent = 0; sent < datagrams;) {
+            int n = sendmmsg(fd, messages.data() + sent,
+                             static_cast<unsigned>(std::min<size_t>(64, datagrams - sent)), 0);
+            if (n < 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            sent += n;
+        }
+        double seconds = wait_applied(base, datagrams * per_datagram, start);
+        uint64_t applied = ingest_pipeline.applied_total() - base;
+
+        send(fd, frames.data(), 14, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::printf("udp: %zu frames/datagram, %lu of %zu frames applied, %.0f frames/s, kernel drops %lu\n",
+                    per_datagram, static_cast<unsigned long>(applied), datagrams * per_datagram,
+                    applied / seconds,
+                    static_cast<unsigned long>(ingest_counters.udp_kernel_drops.load()));
+        close(fd);
+    }
+
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        address.sin_port = htons(tcp_port);
+        if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+            return 1;
+        }
+
+        uint64_t base = ingest_pipeline.applied_total();
+        auto start = std::chrono::steady_clock::now();
+        size_t offset = 0;
+        while (offset < frames.size()) {
+            ssize_t n = write(fd, frames.data() + offset, std::min<size_t>(65536, frames.size() - offset));
+            if (n <= 0) break;
+            offset += n;
+        }
+        double seconds = wait_applied(base, total, start);
+        uint64_t applied = ingest_pipeline.applied_total() - base;
+        std::printf("tcp: %lu of %zu frames applied, %.0f frames/s\n",
+                    static_cast<unsigned long>(applied), total, applied / seconds);
+        close(fd);
+    }
+
+    listener.stop();
+    tcp.stop();
+    ingest_pipeline.stop();
+    return 0;
+}
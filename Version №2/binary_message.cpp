@@ -1,4 +1,11 @@
 #include "binary_message.hpp"
+#include "device_store.hpp"
+#include "freshness.hpp"
+#include "derived_metrics.hpp"
+#include "history_store.hpp"
+#include "coarse_clock.hpp"
+#include "frame_decoder.hpp"
+#include <algorithm>
 #include <iostream>
 #include <cstring>
 #include <arpa/inet.h>
@@ -12,9 +19,8 @@
 
 
 std::atomic<bool> running{true};
-std::unordered_map<uint8_t, DeviceData> devices;
-std::mutex devices_mutex;
-int binary_listen_socket = -1;
+ServerOptions options;
+IngestCounters ingest_counters;
 int http_listen_socket = -1;
 
 
@@ -49,27 +55,80 @@ bool parse_binary_message(const uint8_t* data, uint8_t& device_id,
 }
 
 
-void process_message(const uint8_t* msg) {
-    uint8_t device_id;
-    float value;
-    uint64_t timestamp;
+bool process_message(const uint8_t* msg, IngestProducer& producer) {
+    IngestMessage parsed;
     
-    if (!parse_binary_message(msg, device_id, value, timestamp)) {
-        return;  
+    if (!parse_binary_message(msg, parsed.device_id, parsed.value, parsed.timestamp)) {
+        ingest_counters.crc_failures.add(1);
+        return false;  
     }
     
-    std::lock_guard<std::mutex> lock(devices_mutex);
+    producer.push(parsed);
+    return true;
+}
+
+
+size_t process_frames(const uint8_t* data, size_t frames, IngestProducer& producer) {
+    static constexpr size_t CHUNK = 256;
+    uint8_t device_ids[CHUNK];
+    float values[CHUNK];
+    uint64_t timestamps[CHUNK];
+    uint8_t valid[CHUNK];
+    DecodedFrames out{device_ids, values, timestamps, valid};
     
-    devices[device_id].add_sample(static_cast<double>(value), timestamp);
+    size_t accepted = 0;
+    for (size_t start = 0; start < frames; start += CHUNK) {
+        size_t n = std::min(CHUNK, frames - start);
+        const uint8_t* chunk = data + start * LEGACY_FRAME_SIZE;
+        size_t ok = decode_frames(chunk, n, out);
+        
+        for (size_t i = 0; i < n; ++i) {
+            if (!valid[i]) {
+                uint8_t device_id;
+                float value;
+                uint64_t timestamp;
+                parse_binary_message(chunk + i * LEGACY_FRAME_SIZE, device_id, value, timestamp);
+                continue;
+            }
+            IngestMessage msg;
+            msg.device_id = device_ids[i];
+            msg.value = values[i];
+            msg.timestamp = timestamps[i];
+            producer.push(msg);
+        }
+        
+        if (ok != n) {
+            ingest_counters.crc_failures.add(n - ok);
+        }
+        accepted += ok;
+    }
+    return accepted;
+}
+
+
+void apply_message(const IngestMessage& msg) {
+    int count = device_store.apply(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+    if (derived_metrics.enabled()) {
+        derived_metrics.update(msg.device_id, static_cast<double>(msg.value), msg.timestamp);
+    }
+    if (history_store.enabled()) {
+        history_store.append(msg.device_id, msg.value, msg.timestamp);
+    }
+    if (freshness.should_sample()) {
+        freshness.record(msg.device_id, msg.received_ns, msg.timestamp);
+    }
     
+    if (!options.log_samples) {
+        return;
+    }
    
-    auto now = std::chrono::system_clock::now();
-    auto now_time_t = std::chrono::system_clock::to_time_t(now);
+    char now[9];
+    coarse_clock.wall_hms(now);
     
-    std::cout << std::put_time(std::localtime(&now_time_t), "%H:%M:%S")
-              << " Обработано: device=" << (int)device_id
-              << ", value=" << std::fixed << std::setprecision(6) << value
-              << ", timestamp=" << timestamp
-              << ", буфер: " << devices[device_id].count << "/" << RING_SIZE 
+    std::cout << now
+              << " Обработано: device=" << (int)msg.device_id
+              << ", value=" << std::fixed << std::setprecision(6) << msg.value
+              << ", timestamp=" << msg.timestamp
+              << ", буфер: " << count << "/" << RING_SIZE 
               << std::endl;
 }
\ No newline at end of file
@@ -1,17 +1,38 @@
 #pragma once
 #include "structs.hpp"
+#include "ingest_pipeline.hpp"
+#include "counters.hpp"
 #include <atomic>
 #include <memory>
 
+struct IngestCounters {
+    ShardedCounter crc_failures;
+    ShardedCounter protocol_errors;
+    ShardedCounter udp_datagrams;
+    ShardedCounter udp_frames;
+    ShardedCounter udp_malformed;
+    ShardedCounter udp_kernel_drops;
+    ShardedCounter connections_accepted;
+    ShardedCounter rejected_global;
+    ShardedCounter rejected_per_ip;
+    ShardedCounter evicted_idle;
+    ShardedCounter evicted_slow;
+    ShardedCounter flow_dropped;
+    ShardedCounter flow_pauses;
+};
+
 extern std::atomic<bool> running;
-extern std::unordered_map<uint8_t, DeviceData> devices;
-extern std::mutex devices_mutex;
-extern int binary_listen_socket;
+extern ServerOptions options;
+extern IngestCounters ingest_counters;
 extern int http_listen_socket;
 
 uint8_t calculate_crc8(const uint8_t* data, size_t length);
 bool parse_binary_message(const uint8_t* data, uint8_t& device_id, 
                          float& value, uint64_t& timestamp);
-void process_message(const uint8_t* msg);
+bool process_message(const uint8_t* msg, IngestProducer& producer);
+size_t process_frames(const uint8_t* data, size_t frames, IngestProducer& producer);
+void UdpServer();
+void ShmServer();
+void apply_message(const IngestMessage& msg);
 void BynaryServer();
 void HTTP_server();
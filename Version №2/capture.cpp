@@ -0,0 +1,125 @@
+#include "capture.hpp"
+#include "coarse_clock.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+
+CaptureWriter capture_writer;
+
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+uint64_t CaptureWriter::now_ns() const {
+    return coarse_clock.monotonic_ns() - start_ns;
+}
+
+bool CaptureWriter::open(const std::string& path) {
+    if (running.load()) return false;
+
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Ошибка открытия файла захвата " << path << std::endl;
+        return false;
+    }
+
+    CaptureFileHeader header{};
+    std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    start_ns = coarse_clock.monotonic_ns();
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&CaptureWriter::run, this);
+    return true;
+}
+
+void CaptureWriter::close() {
+    if (!running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeup.notify_one();
+    }
+    thread.join();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void CaptureWriter::submit(std::vector<uint8_t>& chunk) {
+    if (chunk.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queued_bytes + chunk.size() > CAPTURE_MAX_QUEUED_BYTES) {
+            dropped.fetch_add(chunk.size(), std::memory_order_relaxed);
+            chunk.clear();
+            return;
+        }
+        queued_bytes += chunk.size();
+        queue.emplace_back();
+        queue.back().swap(chunk);
+        wakeup.notify_one();
+    }
+    chunk.clear();
+}
+
+void CaptureWriter::run() {
+    std::deque<std::vector<uint8_t>> pending;
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [&] { return !queue.empty() || !running.load(std::memory_order_acquire); });
+            pending.swap(queue);
+            queued_bytes = 0;
+            stopping = !running.load(std::memory_order_acquire);
+        }
+
+        for (const auto& chunk : pending) {
+            std::fwrite(chunk.data(), 1, chunk.size(), file);
+            written.fetch_add(chunk.size(), std::memory_order_relaxed);
+        }
+        pending.clear();
+        std::fflush(file);
+
+        if (stopping) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.empty()) break;
+        }
+    }
+}
+
+
+void CaptureBuffer::record(uint32_t connection, CaptureKind kind, const uint8_t* data, size_t length) {
+    CaptureRecord record;
+    record.timestamp_ns = capture_writer.now_ns();
+    record.connection = connection;
+    record.kind = static_cast<uint8_t>(kind);
+    record.length = static_cast<uint32_t>(length);
+
+    if (buffer.empty()) {
+        buffer.reserve(CAPTURE_FLUSH_BYTES + sizeof(record) + length);
+        first_ns = record.timestamp_ns;
+    }
+    const uint8_t* header = reinterpret_cast<const uint8_t*>(&record);
+    buffer.insert(buffer.end(), header, header + sizeof(record));
+    if (length > 0) {
+        buffer.insert(buffer.end(), data, data + length);
+    }
+    if (buffer.size() >= CAPTURE_FLUSH_BYTES) {
+        flush();
+    }
+}
+
+void CaptureBuffer::flush_if_due() {
+    if (!buffer.empty() && capture_writer.now_ns() - first_ns >= CAPTURE_FLUSH_NS) {
+        flush();
+    }
+}
+
+void CaptureBuffer::flush() {
+    capture_writer.submit(buffer);
+}
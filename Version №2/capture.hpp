@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static constexpr char CAPTURE_MAGIC[8] = {'T', 'L', 'M', 'C', 'A', 'P', '0', '1'};
+static constexpr uint32_t CAPTURE_VERSION = 1;
+static constexpr size_t CAPTURE_FLUSH_BYTES = 64 * 1024;
+static constexpr uint64_t CAPTURE_FLUSH_NS = 50000000;
+static constexpr size_t CAPTURE_MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+
+enum class CaptureKind : uint8_t {
+    Data = 0,
+    Open = 1,
+    Close = 2
+};
+
+
+#pragma pack(push, 1)
+struct CaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t start_unix_ns;
+};
+
+struct CaptureRecord {
+    uint64_t timestamp_ns;
+    uint32_t connection;
+    uint8_t kind;
+    uint32_t length;
+};
+#pragma pack(pop)
+
+
+class CaptureWriter {
+public:
+    ~CaptureWriter();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool active() const { return running.load(std::memory_order_acquire); }
+    uint32_t next_connection_id() { return connection_ids.fetch_add(1, std::memory_order_relaxed) + 1; }
+    uint64_t now_ns() const;
+
+    void submit(std::vector<uint8_t>& chunk);
+
+    uint64_t written_bytes() const { return written.load(std::memory_order_relaxed); }
+    uint64_t dropped_bytes() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    FILE* file = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<std::vector<uint8_t>> queue;
+    size_t queued_bytes = 0;
+    uint64_t start_ns = 0;
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> connection_ids{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+extern CaptureWriter capture_writer;
+
+
+class CaptureBuffer {
+public:
+    void record(uint32_t connection, CaptureKind kind, const uint8_t* data, size_t length);
+    void flush_if_due();
+    void flush();
+
+private:
+    std::vector<uint8_t> buffer;
+    uint64_t first_ns = 0;
+};
@@ -0,0 +1,65 @@
+#include "coarse_clock.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+
+CoarseClock coarse_clock;
+
+
+static uint64_t format_hms(time_t seconds) {
+    std::tm local{};
+    localtime_r(&seconds, &local);
+    char text[9];
+    std::snprintf(text, sizeof(text), "%02d:%02d:%02d", local.tm_hour, local.tm_min, local.tm_sec);
+    uint64_t packed = 0;
+    std::memcpy(&packed, text, 8);
+    return packed;
+}
+
+
+CoarseClock::~CoarseClock() {
+    stop();
+}
+
+void CoarseClock::start(std::chrono::microseconds interval) {
+    if (running.load()) return;
+    tick = interval.count() > 0 ? interval : std::chrono::microseconds(1000);
+    update();
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&CoarseClock::run, this);
+}
+
+void CoarseClock::stop() {
+    if (!running.exchange(false)) return;
+    thread.join();
+}
+
+void CoarseClock::wall_hms(char* out) const {
+    uint64_t packed;
+    if (running.load(std::memory_order_relaxed)) {
+        packed = hms.load(std::memory_order_relaxed);
+    } else {
+        packed = format_hms(static_cast<time_t>(precise_wall_ms() / 1000));
+    }
+    std::memcpy(out, &packed, 8);
+    out[8] = '\0';
+}
+
+void CoarseClock::update() {
+    monotonic.store(precise_monotonic_ns(), std::memory_order_relaxed);
+    uint64_t now_ms = precise_wall_ms();
+    wall.store(now_ms, std::memory_order_relaxed);
+    int64_t second = static_cast<int64_t>(now_ms / 1000);
+    if (second != hms_second) {
+        hms_second = second;
+        hms.store(format_hms(static_cast<time_t>(second)), std::memory_order_relaxed);
+    }
+}
+
+void CoarseClock::run() {
+    while (running.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(tick);
+        update();
+    }
+}
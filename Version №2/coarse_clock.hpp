@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+
+class CoarseClock {
+public:
+    ~CoarseClock();
+
+    void start(std::chrono::microseconds tick = std::chrono::milliseconds(1));
+    void stop();
+
+    uint64_t monotonic_ns() const {
+        if (!running.load(std::memory_order_relaxed)) return precise_monotonic_ns();
+        return monotonic.load(std::memory_order_relaxed);
+    }
+
+    uint64_t wall_ms() const {
+        if (!running.load(std::memory_order_relaxed)) return precise_wall_ms();
+        return wall.load(std::memory_order_relaxed);
+    }
+
+    void wall_hms(char* out) const;
+
+    static uint64_t precise_monotonic_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint64_t precise_wall_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    void run();
+    void update();
+
+    std::chrono::microseconds tick{1000};
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> monotonic{0};
+    std::atomic<uint64_t> wall{0};
+    std::atomic<uint64_t> hms{0};
+    int64_t hms_second = -1;
+};
+
+extern CoarseClock coarse_clock;
@@ -0,0 +1,54 @@
+#include "connection_limiter.hpp"
+
+
+ConnectionLimiter connection_limiter;
+
+
+void ConnectionLimiter::configure(uint64_t max_total, uint32_t max_per_source) {
+    limit_total = max_total;
+    limit_source = max_per_source;
+}
+
+Admission ConnectionLimiter::admit(uint32_t source) {
+    uint64_t opened = total.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (limit_total > 0 && opened > limit_total) {
+        total.fetch_sub(1, std::memory_order_relaxed);
+        return Admission::GlobalLimit;
+    }
+    if (limit_source == 0) {
+        return Admission::Accepted;
+    }
+
+    Stripe& bucket = stripe(source);
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    uint32_t& count = bucket.counts[source];
+    if (count >= limit_source) {
+        total.fetch_sub(1, std::memory_order_relaxed);
+        return Admission::SourceLimit;
+    }
+    ++count;
+    return Admission::Accepted;
+}
+
+void ConnectionLimiter::release(uint32_t source) {
+    total.fetch_sub(1, std::memory_order_relaxed);
+    if (limit_source == 0) {
+        return;
+    }
+
+    Stripe& bucket = stripe(source);
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    auto it = bucket.counts.find(source);
+    if (it != bucket.counts.end() && --it->second == 0) {
+        bucket.counts.erase(it);
+    }
+}
+
+size_t ConnectionLimiter::sources() const {
+    size_t count = 0;
+    for (const Stripe& bucket : stripes) {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        count += bucket.counts.size();
+    }
+    return count;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+
+enum class Admission {
+    Accepted,
+    GlobalLimit,
+    SourceLimit
+};
+
+
+// Общие для всех потоков приема ограничения числа соединений: всего и с
+// одного IPv4-адреса. Нулевой лимит отключает проверку; без лимита на адрес
+// таблица адресов не ведется и прием стоит одну атомарную операцию.
+class ConnectionLimiter {
+public:
+    void configure(uint64_t max_total, uint32_t max_per_source);
+
+    Admission admit(uint32_t source);
+    void release(uint32_t source);
+
+    uint64_t open() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max_total() const { return limit_total; }
+    uint32_t max_per_source() const { return limit_source; }
+    size_t sources() const;
+
+private:
+    static constexpr size_t STRIPES = 16;
+
+    struct alignas(CACHE_LINE_SIZE) Stripe {
+        mutable std::mutex mutex;
+        std::unordered_map<uint32_t, uint32_t> counts;
+    };
+
+    Stripe& stripe(uint32_t source) { return stripes[(source * 2654435761u) >> 28]; }
+
+    std::atomic<uint64_t> total{0};
+    uint64_t limit_total = 0;
+    uint32_t limit_source = 0;
+    Stripe stripes[STRIPES];
+};
+
+extern ConnectionLimiter connection_limiter;
@@ -0,0 +1,57 @@
+#include "counters.hpp"
+#include <cstdio>
+
+
+ConnectionRegistry connection_registry;
+
+
+size_t next_counter_shard() {
+    static std::atomic<size_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed) % COUNTER_SHARDS;
+}
+
+
+ConnectionStats* ConnectionRegistry::open(const char* peer, size_t worker) {
+    ConnectionStats* stats = pool.acquire();
+    std::snprintf(stats->peer, sizeof(stats->peer), "%s", peer);
+    stats->worker = worker;
+    stats->bytes.store(0, std::memory_order_relaxed);
+    stats->frames.store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed.size() <= worker) closed.resize(worker + 1);
+    stats->prev = nullptr;
+    stats->next = head;
+    if (head != nullptr) head->prev = stats;
+    head = stats;
+    ++open_connections;
+    return stats;
+}
+
+void ConnectionRegistry::close(ConnectionStats* stats) {
+    if (stats == nullptr) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stats->prev != nullptr) stats->prev->next = stats->next;
+        else head = stats->next;
+        if (stats->next != nullptr) stats->next->prev = stats->prev;
+        closed[stats->worker].bytes += stats->bytes.load(std::memory_order_relaxed);
+        closed[stats->worker].frames += stats->frames.load(std::memory_order_relaxed);
+        --open_connections;
+    }
+    pool.release(stats);
+}
+
+size_t ConnectionRegistry::open_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return open_connections;
+}
+
+void ConnectionRegistry::worker_traffic(std::vector<WorkerTraffic>& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.assign(closed.begin(), closed.end());
+    for (const ConnectionStats* stats = head; stats != nullptr; stats = stats->next) {
+        out[stats->worker].bytes += stats->bytes.load(std::memory_order_relaxed);
+        out[stats->worker].frames += stats->frames.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "slab_pool.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+static constexpr size_t COUNTER_SHARDS = 32;
+
+
+size_t next_counter_shard();
+
+inline size_t counter_shard() {
+    static thread_local size_t shard = next_counter_shard();
+    return shard;
+}
+
+
+class ShardedCounter {
+public:
+    void add(uint64_t n = 1) {
+        shards[counter_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t load() const {
+        uint64_t total = 0;
+        for (const Shard& shard : shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    Shard shards[COUNTER_SHARDS];
+};
+
+
+struct ConnectionStats {
+    char peer[32] = {};
+    size_t worker = 0;
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frames{0};
+
+    void add_bytes(uint64_t n) { bytes.store(bytes.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void add_frames(uint64_t n) { frames.store(frames.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+private:
+    friend class ConnectionRegistry;
+    ConnectionStats* prev = nullptr;
+    ConnectionStats* next = nullptr;
+};
+
+
+struct WorkerTraffic {
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+};
+
+
+// Записи соединений берутся из пула и связаны в интрузивный список, поэтому
+// открытие и закрытие соединения не обращается к куче (кроме первого
+// соединения воркера, для которого заводится строка итогов).
+class ConnectionRegistry {
+public:
+    ConnectionStats* open(const char* peer, size_t worker);
+    void close(ConnectionStats* stats);
+    size_t open_count() const;
+    // Трафик по воркерам с начала работы: закрытые соединения плюс открытые.
+    // Вектор вызывающего переиспользуется, чтобы /metrics не выделял память.
+    void worker_traffic(std::vector<WorkerTraffic>& out) const;
+
+private:
+    mutable std::mutex mutex;
+    ConnectionStats* head = nullptr;
+    size_t open_connections = 0;
+    std::vector<WorkerTraffic> closed;
+    SlabPool<ConnectionStats> pool;
+};
+
+extern ConnectionRegistry connection_registry;
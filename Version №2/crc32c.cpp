@@ -0,0 +1,115 @@
+#include "crc32c.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TELEMETRY_X86_64 1
+#endif
+
+
+namespace {
+
+constexpr uint32_t CRC32C_POLY = 0x82F63B78u;
+
+using SliceTable = std::array<std::array<uint32_t, 256>, 8>;
+
+SliceTable make_table() {
+    SliceTable table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (size_t slice = 1; slice < 8; ++slice) {
+            uint32_t prev = table[slice - 1][i];
+            table[slice][i] = (prev >> 8) ^ table[0][prev & 0xff];
+        }
+    }
+    return table;
+}
+
+const SliceTable& table() {
+    static const SliceTable instance = make_table();
+    return instance;
+}
+
+}
+
+
+uint32_t crc32c_sw(const uint8_t* data, size_t length) {
+    const SliceTable& t = table();
+    uint32_t crc = 0xFFFFFFFFu;
+
+    while (length >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, data, 4);
+        std::memcpy(&hi, data + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+    }
+    return ~crc;
+}
+
+
+#ifdef TELEMETRY_X86_64
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(const uint8_t* data, size_t length) {
+    uint64_t crc = 0xFFFFFFFFu;
+    while (length >= 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, data, 8);
+        crc = _mm_crc32_u64(crc, chunk);
+        data += 8;
+        length -= 8;
+    }
+    uint32_t crc32 = static_cast<uint32_t>(crc);
+    if (length >= 4) {
+        uint32_t chunk;
+        std::memcpy(&chunk, data, 4);
+        crc32 = _mm_crc32_u32(crc32, chunk);
+        data += 4;
+        length -= 4;
+    }
+    while (length-- > 0) {
+        crc32 = _mm_crc32_u8(crc32, *data++);
+    }
+    return ~crc32;
+}
+
+bool crc32c_hw_supported() {
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#else
+
+uint32_t crc32c_hw(const uint8_t* data, size_t length) {
+    return crc32c_sw(data, length);
+}
+
+bool crc32c_hw_supported() {
+    return false;
+}
+
+#endif
+
+
+uint32_t crc32c(const uint8_t* data, size_t length) {
+    static const bool hw = crc32c_hw_supported();
+    return hw ? crc32c_hw(data, length) : crc32c_sw(data, length);
+}
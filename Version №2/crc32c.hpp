@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+uint32_t crc32c_sw(const uint8_t* data, size_t length);
+uint32_t crc32c_hw(const uint8_t* data, size_t length);
+bool crc32c_hw_supported();
+
+uint32_t crc32c(const uint8_t* data, size_t length);
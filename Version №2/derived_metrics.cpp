@@ -0,0 +1,323 @@
+#include "derived_metrics.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+
+DerivedTracker derived_metrics;
+
+
+static std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::string> split_list(const std::string& spec) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t comma = spec.find(',', start);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string item = trim(spec.substr(start, comma - start));
+        if (!item.empty()) items.push_back(item);
+        start = comma + 1;
+    }
+    return items;
+}
+
+static bool parse_number(const std::string& text, double& value) {
+    try {
+        size_t used = 0;
+        value = std::stod(text, &used);
+        return used == text.size() && std::isfinite(value);
+    } catch (...) {
+        return false;
+    }
+}
+
+bool parse_alphas(const std::string& spec, std::vector<double>& alphas, std::string& error) {
+    alphas.clear();
+    for (const std::string& item : split_list(spec)) {
+        double alpha = 0;
+        if (!parse_number(item, alpha) || alpha <= 0 || alpha > 1) {
+            error = "коэффициент EWMA должен быть в (0, 1]: " + item;
+            return false;
+        }
+        if (alphas.size() == MAX_EWMA_ALPHAS) {
+            error = "не больше " + std::to_string(MAX_EWMA_ALPHAS) + " коэффициентов EWMA";
+            return false;
+        }
+        alphas.push_back(alpha);
+    }
+    return true;
+}
+
+bool parse_alert_rules(const std::string& spec, size_t alpha_count, std::vector<AlertRule>& rules,
+                       std::string& error) {
+    rules.clear();
+    for (const std::string& item : split_list(spec)) {
+        if (rules.size() == MAX_ALERT_RULES) {
+            error = "не больше " + std::to_string(MAX_ALERT_RULES) + " правил";
+            return false;
+        }
+        if (item.size() >= ALERT_TEXT_SIZE) {
+            error = "слишком длинное правило: " + item;
+            return false;
+        }
+
+        AlertRule rule;
+        std::memcpy(rule.text, item.c_str(), item.size() + 1);
+        size_t op = item.find_first_of("<>");
+        if (op == std::string::npos) {
+            error = "в правиле нет сравнения: " + item;
+            return false;
+        }
+        rule.above = item[op] == '>';
+
+        std::string name = item.substr(0, op);
+        if (name == "value") {
+            rule.metric = DerivedMetric::Value;
+        } else if (name == "rate") {
+            rule.metric = DerivedMetric::Rate;
+        } else if (name == "z") {
+            rule.metric = DerivedMetric::ZScore;
+        } else if (name.size() == 5 && name.starts_with("ewma") && name[4] >= '0' &&
+                   static_cast<size_t>(name[4] - '0') < alpha_count) {
+            rule.metric = DerivedMetric::Ewma;
+            rule.ewma_index = static_cast<size_t>(name[4] - '0');
+        } else {
+            error = "неизвестная метрика в правиле: " + item;
+            return false;
+        }
+
+        std::string rest = item.substr(op + 1);
+        size_t at = rest.find('@');
+        if (at != std::string::npos) {
+            double device = -1;
+            if (!parse_number(rest.substr(at + 1), device) || device < 0 || device >= MAX_DEVICES ||
+                device != std::floor(device)) {
+                error = "некорректное устройство в правиле: " + item;
+                return false;
+            }
+            rule.device = static_cast<int>(device);
+            rest = rest.substr(0, at);
+        }
+        size_t slash = rest.find('/');
+        if (!parse_number(rest.substr(0, slash), rule.threshold)) {
+            error = "некорректный порог в правиле: " + item;
+            return false;
+        }
+        rule.clear = rule.threshold;
+        if (slash != std::string::npos && !parse_number(rest.substr(slash + 1), rule.clear)) {
+            error = "некорректный уровень сброса в правиле: " + item;
+            return false;
+        }
+        if (rule.above ? rule.clear > rule.threshold : rule.clear < rule.threshold) {
+            error = "уровень сброса должен лежать по другую сторону порога: " + item;
+            return false;
+        }
+        rules.push_back(rule);
+    }
+    return true;
+}
+
+
+AlertQueue::AlertQueue(size_t capacity) {
+    size_t size = std::bit_ceil(std::max<size_t>(capacity, 2));
+    cells = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask = size - 1;
+}
+
+bool AlertQueue::push(const AlertEvent& event) {
+    uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->event = event;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AlertQueue::pop(AlertEvent& event) {
+    uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    event = cell->event;
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+
+void DerivedTracker::configure(const std::vector<double>& alphas, const std::vector<AlertRule>& rules) {
+    alphas_count = std::min(alphas.size(), MAX_EWMA_ALPHAS);
+    for (size_t i = 0; i < alphas_count; ++i) {
+        alpha_values[i] = alphas[i];
+        auto result = std::to_chars(alpha_names[i], alpha_names[i] + sizeof(alpha_names[i]) - 1, alphas[i]);
+        *result.ptr = '\0';
+    }
+    rules_count = std::min(rules.size(), MAX_ALERT_RULES);
+    for (size_t i = 0; i < rules_count; ++i) {
+        rule_list[i] = rules[i];
+    }
+}
+
+void DerivedTracker::update(uint8_t device_id, double value, uint64_t timestamp) {
+    Slot& slot = slots[device_id];
+    uint32_t seq = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    DerivedValues& values = slot.values;
+    if (values.samples == 0) {
+        for (size_t i = 0; i < alphas_count; ++i) values.ewma[i] = value;
+        values.mean = value;
+    } else {
+        for (size_t i = 0; i < alphas_count; ++i) {
+            values.ewma[i] += alpha_values[i] * (value - values.ewma[i]);
+        }
+        if (timestamp > values.timestamp) {
+            values.rate = (value - values.value) * 1000.0 / static_cast<double>(timestamp - values.timestamp);
+        }
+        double variance = values.variance();
+        values.z = variance > 0 ? (value - values.mean) / std::sqrt(variance) : 0;
+        double delta = value - values.mean;
+        values.mean += delta / static_cast<double>(values.samples + 1);
+        values.m2 += delta * (value - values.mean);
+    }
+    ++values.samples;
+    values.value = value;
+    values.timestamp = timestamp;
+
+    if (rules_count > 0) {
+        evaluate(device_id, values);
+    }
+
+    slot.sequence.store(seq + 2, std::memory_order_release);
+}
+
+void DerivedTracker::evaluate(uint8_t device_id, DerivedValues& values) {
+    for (size_t i = 0; i < rules_count; ++i) {
+        const AlertRule& rule = rule_list[i];
+        if (rule.device >= 0 && rule.device != device_id) continue;
+
+        double metric = values.value;
+        switch (rule.metric) {
+            case DerivedMetric::Ewma: metric = values.ewma[rule.ewma_index]; break;
+            case DerivedMetric::Rate: metric = values.rate; break;
+            case DerivedMetric::ZScore: metric = values.z; break;
+            default: break;
+        }
+
+        uint32_t bit = 1u << i;
+        if ((values.active_alerts & bit) == 0) {
+            if (rule.above ? metric > rule.threshold : metric < rule.threshold) {
+                values.active_alerts |= bit;
+                emit(device_id, i, metric, values.timestamp, true);
+            }
+        } else if (rule.above ? metric <= rule.clear : metric >= rule.clear) {
+            values.active_alerts &= ~bit;
+            emit(device_id, i, metric, values.timestamp, false);
+        }
+    }
+}
+
+void DerivedTracker::emit(uint8_t device_id, size_t rule, double metric, uint64_t timestamp, bool raised) {
+    (raised ? raised_count : cleared_count).add();
+    AlertEvent event{timestamp, metric, device_id, static_cast<uint8_t>(rule), raised};
+    if (!queue.push(event)) {
+        dropped_count.add();
+        return;
+    }
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+}
+
+bool DerivedTracker::read(uint8_t device_id, DerivedValues& out) const {
+    const Slot& slot = slots[device_id];
+    while (true) {
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            cpu_relax();
+            continue;
+        }
+        std::memcpy(static_cast<void*>(&out), &slot.values, sizeof(DerivedValues));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            return out.samples > 0;
+        }
+    }
+}
+
+size_t DerivedTracker::active() const {
+    size_t count = 0;
+    DerivedValues values;
+    for (int id = 0; id < MAX_DEVICES; ++id) {
+        if (read(static_cast<uint8_t>(id), values)) {
+            count += static_cast<size_t>(std::popcount(values.active_alerts));
+        }
+    }
+    return count;
+}
+
+void DerivedTracker::start_notifier(AlertSink alert_sink) {
+    if (notifying.exchange(true)) return;
+    sink = alert_sink;
+    notifier = std::thread(&DerivedTracker::run_notifier, this);
+}
+
+void DerivedTracker::stop_notifier() {
+    if (!notifying.exchange(false)) return;
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+    if (notifier.joinable()) {
+        notifier.join();
+    }
+}
+
+void DerivedTracker::run_notifier() {
+    AlertEvent event;
+    while (true) {
+        uint32_t seen = signal.load(std::memory_order_acquire);
+        while (queue.pop(event)) {
+            if (sink != nullptr) {
+                sink(event);
+            } else {
+                std::cerr << (event.raised ? "Тревога" : "Тревога снята") << ": устройство "
+                          << static_cast<int>(event.device_id) << ", правило " << rule_list[event.rule].text
+                          << ", значение " << event.value << ", метка " << event.timestamp << std::endl;
+            }
+            delivered_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!notifying.load(std::memory_order_acquire)) break;
+        signal.wait(seen, std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "counters.hpp"
+#include "device_store.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static constexpr size_t MAX_EWMA_ALPHAS = 4;
+static constexpr size_t MAX_ALERT_RULES = 16;
+static constexpr size_t ALERT_TEXT_SIZE = 32;
+
+
+enum class DerivedMetric {
+    Value,
+    Ewma,
+    Rate,
+    ZScore
+};
+
+// Правило срабатывает, когда метрика переходит порог, и снимается, когда
+// возвращается за уровень сброса. Разрыв между ними — гистерезис, он не дает
+// тревоге дребезжать на шумном сигнале около порога.
+struct AlertRule {
+    DerivedMetric metric = DerivedMetric::Value;
+    size_t ewma_index = 0;
+    bool above = true;
+    double threshold = 0;
+    double clear = 0;
+    int device = -1;
+    char text[ALERT_TEXT_SIZE] = {};
+};
+
+// Правила через запятую: <метрика><op><порог>[/<сброс>][@<устройство>],
+// метрика — value, ewma<i>, rate или z, op — > или <. Например
+// "value>80/75,z>3/2,rate<-5@7". Номер ewma — индекс в списке коэффициентов.
+bool parse_alert_rules(const std::string& spec, size_t alpha_count, std::vector<AlertRule>& rules,
+                       std::string& error);
+bool parse_alphas(const std::string& spec, std::vector<double>& alphas, std::string& error);
+
+
+// Производные значения устройства. Скорость изменения — в единицах значения
+// в секунду при метках в миллисекундах. Среднее и дисперсия считаются по
+// Уэлфорду за всю историю, z — отклонение нового сэмпла от статистики до него.
+struct DerivedValues {
+    uint64_t samples = 0;
+    uint64_t timestamp = 0;
+    double value = 0;
+    double ewma[MAX_EWMA_ALPHAS] = {};
+    double rate = 0;
+    double mean = 0;
+    double m2 = 0;
+    double z = 0;
+    uint32_t active_alerts = 0;
+
+    double variance() const { return samples > 1 ? m2 / static_cast<double>(samples - 1) : 0; }
+};
+
+
+struct AlertEvent {
+    uint64_t timestamp;
+    double value;
+    uint8_t device_id;
+    uint8_t rule;
+    bool raised;
+};
+
+// Ограниченная очередь для многих производителей без блокировок: у каждой
+// ячейки свой номер, по которому производитель и потребитель узнают, что
+// ячейка свободна или заполнена.
+class AlertQueue {
+public:
+    explicit AlertQueue(size_t capacity);
+
+    bool push(const AlertEvent& event);
+    bool pop(AlertEvent& event);
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        AlertEvent event;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> enqueue_pos{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> dequeue_pos{0};
+};
+
+
+// Обновляется писателем шарда на том же проходе, что и хранилище, поэтому у
+// каждого устройства один писатель. Читатели копируют значения через seqlock.
+class DerivedTracker {
+public:
+    using AlertSink = void (*)(const AlertEvent&);
+
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+
+    DerivedTracker() : queue(QUEUE_CAPACITY) {}
+    ~DerivedTracker() { stop_notifier(); }
+
+    void configure(const std::vector<double>& alphas, const std::vector<AlertRule>& rules);
+    void set_enabled(bool value) { enabled_flag = value; }
+    bool enabled() const { return enabled_flag; }
+
+    void update(uint8_t device_id, double value, uint64_t timestamp);
+    bool read(uint8_t device_id, DerivedValues& out) const;
+
+    size_t alpha_count() const { return alphas_count; }
+    double alpha(size_t index) const { return alpha_values[index]; }
+    const char* alpha_name(size_t index) const { return alpha_names[index]; }
+    size_t rule_count() const { return rules_count; }
+    const AlertRule& rule(size_t index) const { return rule_list[index]; }
+
+    // Поток уведомлений разбирает очередь тревог. Без приемника тревоги
+    // пишутся в stderr.
+    void start_notifier(AlertSink sink = nullptr);
+    void stop_notifier();
+
+    uint64_t raised() const { return raised_count.load(); }
+    uint64_t cleared() const { return cleared_count.load(); }
+    uint64_t dropped() const { return dropped_count.load(); }
+    uint64_t delivered() const { return delivered_count.load(std::memory_order_relaxed); }
+    size_t active() const;
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<uint32_t> sequence{0};
+        DerivedValues values;
+    };
+
+    void evaluate(uint8_t device_id, DerivedValues& values);
+    void emit(uint8_t device_id, size_t rule, double metric, uint64_t timestamp, bool raised);
+    void run_notifier();
+
+    bool enabled_flag = true;
+    size_t alphas_count = 0;
+    double alpha_values[MAX_EWMA_ALPHAS] = {};
+    char alpha_names[MAX_EWMA_ALPHAS][16] = {};
+    size_t rules_count = 0;
+    AlertRule rule_list[MAX_ALERT_RULES];
+
+    Slot slots[MAX_DEVICES];
+
+    AlertQueue queue;
+    ShardedCounter raised_count;
+    ShardedCounter cleared_count;
+    ShardedCounter dropped_count;
+    std::atomic<uint64_t> delivered_count{0};
+
+    std::thread notifier;
+    AlertSink sink = nullptr;
+    std::atomic<bool> notifying{false};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> signal{0};
+};
+
+extern DerivedTracker derived_metrics;
@@ -0,0 +1,123 @@
+#include "device_store.hpp"
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+DeviceStore device_store;
+
+
+int DeviceStore::apply(uint8_t device_id, double value, uint64_t timestamp) {
+    DeviceSlot& slot = slots[device_id];
+    uint32_t seq = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.data.add_sample(value, timestamp);
+
+    slot.sequence.store(seq + 2, std::memory_order_release);
+    slot.applied.store(slot.applied.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return slot.data.count;
+}
+
+bool DeviceStore::read(uint8_t device_id, DeviceData& out) const {
+    return seqlock_read(slots[device_id], out, copy_device_data);
+}
+
+bool DeviceStore::latest(uint8_t device_id, Sample& out) const {
+    return seqlock_read(slots[device_id], out, copy_latest);
+}
+
+bool DeviceStore::summarize(uint8_t device_id, DeviceSummary& out) const {
+    const DeviceSlot& slot = slots[device_id];
+    out.applied = slot.applied.load(std::memory_order_relaxed);
+    if (!seqlock_read(slot, out, copy_summary)) {
+        out = DeviceSummary{};
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint8_t> DeviceStore::active_devices() const {
+    std::vector<uint8_t> ids;
+    active_devices(ids);
+    return ids;
+}
+
+void DeviceStore::active_devices(std::vector<uint8_t>& ids) const {
+    ids.clear();
+    for (int id = 0; id < MAX_DEVICES; ++id) {
+        if (slots[id].sequence.load(std::memory_order_acquire) != 0) {
+            ids.push_back(static_cast<uint8_t>(id));
+        }
+    }
+}
+
+uint64_t DeviceStore::applied(uint8_t device_id) const {
+    return slots[device_id].applied.load(std::memory_order_relaxed);
+}
+
+bool DeviceStore::publish(const std::string& name) {
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Ошибка shm_open " << name << std::endl;
+        return false;
+    }
+
+    size_t size = sizeof(DeviceTableHeader) + sizeof(DeviceSlot) * MAX_DEVICES;
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        std::cerr << "Ошибка ftruncate " << name << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "Ошибка mmap " << name << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    DeviceTableHeader* header = new (base) DeviceTableHeader{};
+    header->version = DEVICE_TABLE_VERSION;
+    header->device_count = MAX_DEVICES;
+    header->slot_size = sizeof(DeviceSlot);
+    header->ring_size = RING_SIZE;
+
+    DeviceSlot* shared = reinterpret_cast<DeviceSlot*>(header + 1);
+    for (int id = 0; id < MAX_DEVICES; ++id) {
+        DeviceSlot* slot = new (&shared[id]) DeviceSlot{};
+        slot->data = slots[id].data;
+        slot->sequence.store(slots[id].sequence.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slot->applied.store(slots[id].applied.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = DEVICE_TABLE_MAGIC;
+
+    slots = shared;
+    shared_name = name;
+    shared_size = size;
+    return true;
+}
+
+void DeviceStore::unpublish() {
+    if (shared_name.empty()) {
+        return;
+    }
+    for (int id = 0; id < MAX_DEVICES; ++id) {
+        local_slots[id].data = slots[id].data;
+        local_slots[id].sequence.store(slots[id].sequence.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        local_slots[id].applied.store(slots[id].applied.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    void* base = reinterpret_cast<DeviceTableHeader*>(slots) - 1;
+    slots = local_slots;
+    munmap(base, shared_size);
+    shm_unlink(shared_name.c_str());
+    shared_name.clear();
+    shared_size = 0;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include "structs.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static constexpr int MAX_DEVICES = 256;
+static constexpr uint32_t DEVICE_TABLE_MAGIC = 0x544C4D44;
+static constexpr uint32_t DEVICE_TABLE_VERSION = 2;
+
+
+struct alignas(CACHE_LINE_SIZE) DeviceSlot {
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint64_t> applied{0};
+    DeviceData data;
+};
+
+
+struct alignas(CACHE_LINE_SIZE) DeviceTableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t device_count;
+    uint32_t slot_size;
+    uint32_t ring_size;
+};
+
+
+// Сводка устройства для среза парка: последний сэмпл и статистика кольца.
+struct DeviceSummary {
+    Sample latest{};
+    uint64_t applied = 0;
+    double min = 0;
+    double max = 0;
+    double average = 0;
+    int count = 0;
+};
+
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+template <typename T, typename Copy>
+bool seqlock_read(const DeviceSlot& slot, T& out, Copy&& copy) {
+    while (true) {
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            cpu_relax();
+            continue;
+        }
+        if (!copy(slot.data, out)) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                return false;
+            }
+            continue;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+}
+
+enum class SlotRead {
+    Ok,
+    Empty,
+    Unavailable
+};
+
+// Чтение слота, который пишет другой процесс. Писатель может умереть
+// посреди записи, и тогда номер останется нечетным навсегда, поэтому
+// ожидание ограничено timeout_ns: после него возвращается Unavailable.
+template <typename T, typename Copy>
+SlotRead seqlock_try_read(const DeviceSlot& slot, T& out, Copy&& copy, uint64_t timeout_ns) {
+    static constexpr uint32_t SPINS = 64;
+    std::chrono::steady_clock::time_point deadline{};
+    for (uint32_t attempt = 0;; ++attempt) {
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            bool copied = copy(slot.data, out);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                return copied ? SlotRead::Ok : SlotRead::Empty;
+            }
+        }
+        if (attempt < SPINS) {
+            cpu_relax();
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (attempt == SPINS) {
+            deadline = now + std::chrono::nanoseconds(timeout_ns);
+        } else if (now >= deadline) {
+            return SlotRead::Unavailable;
+        }
+        std::this_thread::yield();
+    }
+}
+
+inline bool copy_device_data(const DeviceData& data, DeviceData& dst) {
+    if (data.count == 0) return false;
+    std::memcpy(static_cast<void*>(&dst), &data, sizeof(DeviceData));
+    return true;
+}
+
+inline bool copy_latest(const DeviceData& data, Sample& dst) {
+    if (data.count == 0) return false;
+    dst = data.latest;
+    return true;
+}
+
+inline bool copy_summary(const DeviceData& data, DeviceSummary& dst) {
+    if (!data.get_stats(dst.min, dst.max, dst.average)) return false;
+    dst.latest = data.latest;
+    dst.count = data.count;
+    return true;
+}
+
+
+class DeviceStore {
+public:
+    int apply(uint8_t device_id, double value, uint64_t timestamp);
+
+    bool read(uint8_t device_id, DeviceData& out) const;
+    bool latest(uint8_t device_id, Sample& out) const;
+    bool summarize(uint8_t device_id, DeviceSummary& out) const;
+    std::vector<uint8_t> active_devices() const;
+    void active_devices(std::vector<uint8_t>& ids) const;
+    uint64_t applied(uint8_t device_id) const;
+    size_t memory_bytes() const { return sizeof(DeviceSlot) * MAX_DEVICES; }
+
+    bool publish(const std::string& name);
+    // Только после остановки писателей: данные возвращаются в память
+    // процесса, отображение снимается, имя удаляется.
+    void unpublish();
+
+private:
+    DeviceSlot local_slots[MAX_DEVICES];
+    DeviceSlot* slots = local_slots;
+    std::string shared_name;
+    size_t shared_size = 0;
+};
+
+extern DeviceStore device_store;
@@ -0,0 +1,100 @@
+#pragma once
+#include "device_store.hpp"
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+
+class DeviceTableView {
+public:
+    DeviceTableView() = default;
+    ~DeviceTableView() { close(); }
+
+    DeviceTableView(const DeviceTableView&) = delete;
+    DeviceTableView& operator=(const DeviceTableView&) = delete;
+
+    bool open(const std::string& name) {
+        close();
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(DeviceTableHeader)) {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            return false;
+        }
+
+        header = static_cast<const DeviceTableHeader*>(base);
+        if (header->magic != DEVICE_TABLE_MAGIC || header->version != DEVICE_TABLE_VERSION ||
+            header->slot_size != sizeof(DeviceSlot) || header->ring_size != RING_SIZE ||
+            sizeof(DeviceTableHeader) + header->device_count * sizeof(DeviceSlot) > size) {
+            close();
+            return false;
+        }
+        slots = reinterpret_cast<const DeviceSlot*>(header + 1);
+        return true;
+    }
+
+    void close() {
+        if (base != nullptr) {
+            munmap(base, size);
+            base = nullptr;
+            header = nullptr;
+            slots = nullptr;
+        }
+    }
+
+    bool is_open() const { return slots != nullptr; }
+    uint32_t device_count() const { return header->device_count; }
+
+    // Сколько ждать писателя, застрявшего посреди записи слота.
+    static constexpr uint64_t READ_TIMEOUT_NS = 10'000'000;
+
+    SlotRead read(uint8_t device_id, DeviceData& out, uint64_t timeout_ns = READ_TIMEOUT_NS) const {
+        if (device_id >= header->device_count) return SlotRead::Empty;
+        return seqlock_try_read(slots[device_id], out, copy_device_data, timeout_ns);
+    }
+
+    SlotRead latest(uint8_t device_id, Sample& out, uint64_t timeout_ns = READ_TIMEOUT_NS) const {
+        if (device_id >= header->device_count) return SlotRead::Empty;
+        return seqlock_try_read(slots[device_id], out, copy_latest, timeout_ns);
+    }
+
+    // Агрегаты кольца, как у /device/{id}/stats, считаются по согласованной
+    // копии слота на стороне читателя: писатель не тратит на них время.
+    SlotRead stats(uint8_t device_id, DeviceSummary& out, uint64_t timeout_ns = READ_TIMEOUT_NS) const {
+        if (device_id >= header->device_count) return SlotRead::Empty;
+        out.applied = slots[device_id].applied.load(std::memory_order_relaxed);
+        return seqlock_try_read(slots[device_id], out, copy_summary, timeout_ns);
+    }
+
+    uint32_t sequence(uint8_t device_id) const {
+        return slots[device_id].sequence.load(std::memory_order_acquire);
+    }
+
+    std::vector<uint8_t> active_devices() const {
+        std::vector<uint8_t> ids;
+        for (uint32_t id = 0; id < header->device_count; ++id) {
+            if (slots[id].sequence.load(std::memory_order_acquire) != 0) {
+                ids.push_back(static_cast<uint8_t>(id));
+            }
+        }
+        return ids;
+    }
+
+private:
+    void* base = nullptr;
+    size_t size = 0;
+    const DeviceTableHeader* header = nullptr;
+    const DeviceSlot* slots = nullptr;
+};
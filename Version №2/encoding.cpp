@@ -0,0 +1,469 @@
+#include "encoding.hpp"
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <strings.h>
+
+
+namespace {
+
+const char* find_header(const char* request, const char* name) {
+    size_t name_len = std::strlen(name);
+    const char* line = std::strstr(request, "\r\n");
+    while (line != nullptr) {
+        line += 2;
+        if (line[0] == '\r' || line[0] == '\0') {
+            return nullptr;
+        }
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char* value = line + name_len + 1;
+            while (*value == ' ' || *value == '\t') ++value;
+            return value;
+        }
+        line = std::strstr(line, "\r\n");
+    }
+    return nullptr;
+}
+
+bool has_prefix(const char* str, size_t len, const char* prefix) {
+    size_t prefix_len = std::strlen(prefix);
+    return len >= prefix_len && strncasecmp(str, prefix, prefix_len) == 0;
+}
+
+template <typename Fn>
+void for_each_accept_item(const char* request, Fn&& fn) {
+    const char* accept = find_header(request, "Accept");
+    if (accept == nullptr) {
+        return;
+    }
+    const char* end = std::strstr(accept, "\r\n");
+    if (end == nullptr) {
+        end = accept + std::strlen(accept);
+    }
+
+    const char* item = accept;
+    while (item < end) {
+        while (item < end && (*item == ' ' || *item == ',')) ++item;
+        const char* item_end = item;
+        while (item_end < end && *item_end != ',') ++item_end;
+        if (fn(item, static_cast<size_t>(item_end - item))) {
+            return;
+        }
+        item = item_end;
+    }
+}
+
+template <typename Writer>
+void write_latest(Writer& w, int device_id, const Sample& sample) {
+    w.map(3);
+    w.key("device_id");
+    w.uint(static_cast<uint64_t>(device_id));
+    w.key("value");
+    w.f64(sample.value);
+    w.key("timestamp");
+    w.uint(sample.timestamp);
+}
+
+template <typename Writer>
+void write_stats(Writer& w, const DeviceStats& stats) {
+    w.map(5);
+    w.key("device_id");
+    w.uint(static_cast<uint64_t>(stats.device_id));
+    w.key("min");
+    w.f64(stats.min);
+    w.key("max");
+    w.f64(stats.max);
+    w.key("average");
+    w.f64(stats.average);
+    w.key("count");
+    w.uint(static_cast<uint64_t>(stats.count));
+}
+
+template <typename Writer>
+void write_derived(Writer& w, int device_id, const DerivedValues& values, const DerivedTracker& tracker) {
+    w.map(10);
+    w.key("device_id");
+    w.uint(static_cast<uint64_t>(device_id));
+    w.key("samples");
+    w.uint(values.samples);
+    w.key("value");
+    w.f64(values.value);
+    w.key("timestamp");
+    w.uint(values.timestamp);
+    w.key("ewma");
+    w.map(static_cast<uint32_t>(tracker.alpha_count()));
+    for (size_t i = 0; i < tracker.alpha_count(); ++i) {
+        w.key(tracker.alpha_name(i));
+        w.f64(values.ewma[i]);
+    }
+    w.key("rate");
+    w.f64(values.rate);
+    w.key("mean");
+    w.f64(values.mean);
+    w.key("stddev");
+    w.f64(std::sqrt(values.variance()));
+    w.key("z");
+    w.f64(values.z);
+    w.key("alerts");
+    w.array(static_cast<uint32_t>(std::popcount(values.active_alerts)));
+    for (size_t i = 0; i < tracker.rule_count(); ++i) {
+        if (values.active_alerts & (1u << i)) w.key(tracker.rule(i).text);
+    }
+}
+
+// Агрегаты без сэмплов не определены, кроме count и sum: группа их опускает.
+uint32_t query_group_aggregates(uint32_t aggregates, const QueryPartial& partial) {
+    return partial.count > 0 ? aggregates : aggregates & (QUERY_COUNT | QUERY_SUM);
+}
+
+template <typename Writer>
+void write_query_group(Writer& w, const QueryRequest& request, const QueryGroup& group) {
+    uint32_t aggregates = query_group_aggregates(request.aggregates, group.partial);
+    w.map(static_cast<uint32_t>(std::popcount(aggregates)) + (request.by_device ? 1 : 0));
+    if (request.by_device) {
+        w.key("device_id");
+        w.uint(group.device_id);
+    }
+    const QueryPartial& partial = group.partial;
+    if (aggregates & QUERY_COUNT) {
+        w.key("count");
+        w.uint(partial.count);
+    }
+    if (aggregates & QUERY_SUM) {
+        w.key("sum");
+        w.f64(partial.sum);
+    }
+    if (aggregates & QUERY_AVG) {
+        w.key("avg");
+        w.f64(partial.sum / static_cast<double>(partial.count));
+    }
+    if (aggregates & QUERY_MIN) {
+        w.key("min");
+        w.f64(partial.min);
+    }
+    if (aggregates & QUERY_MAX) {
+        w.key("max");
+        w.f64(partial.max);
+    }
+}
+
+template <typename Writer>
+void write_query(Writer& w, const QueryRequest& request, const QueryResult& result) {
+    w.map(6);
+    w.key("from");
+    w.uint(result.bounds.from);
+    w.key("to");
+    w.uint(result.bounds.to);
+    w.key("devices");
+    w.uint(result.devices);
+    w.key("groups");
+    w.array(static_cast<uint32_t>(result.groups.size()));
+    for (const QueryGroup& group : result.groups) {
+        write_query_group(w, request, group);
+    }
+    w.key("chunks");
+    w.map(3);
+    w.key("scanned");
+    w.uint(result.chunks_scanned);
+    w.key("skipped");
+    w.uint(result.chunks_skipped);
+    w.key("summarized");
+    w.uint(result.chunks_summarized);
+    w.key("samples_scanned");
+    w.uint(result.samples_scanned);
+}
+
+template <typename Writer>
+void write_devices(Writer& w, const std::vector<uint8_t>& ids) {
+    w.array(static_cast<uint32_t>(ids.size()));
+    for (uint8_t id : ids) {
+        w.uint(id);
+    }
+}
+
+}
+
+
+// Числа дописываются через to_chars прямо в выходную строку: ответ собирается
+// без временных потоков и строк, а емкость буфера запроса переиспользуется.
+void append_uint(std::string& out, uint64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void append_fixed(std::string& out, double value) {
+    // Худший случай -DBL_MAX: знак, 309 цифр целой части, точка и 6 знаков.
+    char digits[DBL_MAX_10_EXP + 16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, 6);
+    out.append(digits, result.ptr);
+}
+
+namespace {
+
+// Вес q элемента Accept в тысячных: без параметра 1000, некорректный — 0.
+int accept_quality(const char* item, size_t len) {
+    const char* end = item + len;
+    for (const char* p = item; p < end; ++p) {
+        if (*p != ';') continue;
+        const char* param = p + 1;
+        while (param < end && *param == ' ') ++param;
+        if (end - param < 2 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=') continue;
+        param += 2;
+        if (param == end || (*param != '0' && *param != '1')) return 0;
+        int quality = (*param++ - '0') * 1000;
+        if (param < end && *param == '.') {
+            ++param;
+            for (int scale = 100; scale > 0 && param < end && *param >= '0' && *param <= '9'; scale /= 10) {
+                quality += (*param++ - '0') * scale;
+            }
+        }
+        return std::min(quality, 1000);
+    }
+    return 1000;
+}
+
+// Выбирает тип с наибольшим весом, при равенстве — первый в заголовке.
+// classify возвращает индекс варианта или -1; вариант 0 — по умолчанию.
+template <typename Classify>
+int best_accept(const char* request, Classify&& classify) {
+    int best = 0;
+    int best_quality = 0;
+    for_each_accept_item(request, [&](const char* item, size_t len) {
+        int candidate = classify(item, len);
+        if (candidate < 0) return false;
+        int quality = accept_quality(item, len);
+        if (quality > best_quality) {
+            best = candidate;
+            best_quality = quality;
+        }
+        return false;
+    });
+    return best;
+}
+
+}
+
+
+ResponseFormat negotiate_format(const char* request) {
+    static const ResponseFormat formats[] = {ResponseFormat::Json, ResponseFormat::MsgPack, ResponseFormat::Cbor};
+    return formats[best_accept(request, [](const char* item, size_t len) {
+        if (has_prefix(item, len, "application/msgpack") ||
+            has_prefix(item, len, "application/x-msgpack")) {
+            return 1;
+        }
+        if (has_prefix(item, len, "application/cbor")) return 2;
+        if (has_prefix(item, len, "application/json") || has_prefix(item, len, "*/*") ||
+            has_prefix(item, len, "application/*")) {
+            return 0;
+        }
+        return -1;
+    })];
+}
+
+bool accepts_prometheus(const char* request) {
+    return best_accept(request, [](const char* item, size_t len) {
+        if (has_prefix(item, len, "text/plain") ||
+            has_prefix(item, len, "application/openmetrics-text")) {
+            return 1;
+        }
+        if (has_prefix(item, len, "application/json") || has_prefix(item, len, "*/*")) return 0;
+        return -1;
+    }) == 1;
+}
+
+const char* content_type(ResponseFormat format) {
+    switch (format) {
+        case ResponseFormat::MsgPack: return "application/msgpack";
+        case ResponseFormat::Cbor: return "application/cbor";
+        default: return "application/json";
+    }
+}
+
+void encode_latest(ResponseFormat format, int device_id, const Sample& sample, std::string& out) {
+    if (format == ResponseFormat::MsgPack) {
+        MsgPackWriter w(out);
+        write_latest(w, device_id, sample);
+        return;
+    }
+    if (format == ResponseFormat::Cbor) {
+        CborWriter w(out);
+        write_latest(w, device_id, sample);
+        return;
+    }
+
+    out += "{\"device_id\": ";
+    append_uint(out, static_cast<uint64_t>(device_id));
+    out += ", \"value\": ";
+    append_fixed(out, sample.value);
+    out += ", \"timestamp\": ";
+    append_uint(out, sample.timestamp);
+    out += '}';
+}
+
+void encode_stats(ResponseFormat format, const DeviceStats& stats, std::string& out) {
+    if (format == ResponseFormat::MsgPack) {
+        MsgPackWriter w(out);
+        write_stats(w, stats);
+        return;
+    }
+    if (format == ResponseFormat::Cbor) {
+        CborWriter w(out);
+        write_stats(w, stats);
+        return;
+    }
+
+    out += "{\"device_id\": ";
+    append_uint(out, static_cast<uint64_t>(stats.device_id));
+    out += ", \"min\": ";
+    append_fixed(out, stats.min);
+    out += ", \"max\": ";
+    append_fixed(out, stats.max);
+    out += ", \"average\": ";
+    append_fixed(out, stats.average);
+    out += ", \"count\": ";
+    append_uint(out, static_cast<uint64_t>(stats.count));
+    out += '}';
+}
+
+void encode_devices(ResponseFormat format, const std::vector<uint8_t>& ids, std::string& out) {
+    if (format == ResponseFormat::MsgPack) {
+        MsgPackWriter w(out);
+        write_devices(w, ids);
+        return;
+    }
+    if (format == ResponseFormat::Cbor) {
+        CborWriter w(out);
+        write_devices(w, ids);
+        return;
+    }
+
+    out += '[';
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i > 0) out += ", ";
+        append_uint(out, ids[i]);
+    }
+    out += ']';
+}
+
+void encode_derived(ResponseFormat format, int device_id, const DerivedValues& values,
+                    const DerivedTracker& tracker, std::string& out) {
+    if (format == ResponseFormat::MsgPack) {
+        MsgPackWriter w(out);
+        write_derived(w, device_id, values, tracker);
+        return;
+    }
+    if (format == ResponseFormat::Cbor) {
+        CborWriter w(out);
+        write_derived(w, device_id, values, tracker);
+        return;
+    }
+
+    out += "{\"device_id\": ";
+    append_uint(out, static_cast<uint64_t>(device_id));
+    out += ", \"samples\": ";
+    append_uint(out, values.samples);
+    out += ", \"value\": ";
+    append_fixed(out, values.value);
+    out += ", \"timestamp\": ";
+    append_uint(out, values.timestamp);
+    out += ", \"ewma\": {";
+    for (size_t i = 0; i < tracker.alpha_count(); ++i) {
+        if (i > 0) out += ", ";
+        out += '"';
+        out += tracker.alpha_name(i);
+        out += "\": ";
+        append_fixed(out, values.ewma[i]);
+    }
+    out += "}, \"rate\": ";
+    append_fixed(out, values.rate);
+    out += ", \"mean\": ";
+    append_fixed(out, values.mean);
+    out += ", \"stddev\": ";
+    append_fixed(out, std::sqrt(values.variance()));
+    out += ", \"z\": ";
+    append_fixed(out, values.z);
+    out += ", \"alerts\": [";
+    bool first = true;
+    for (size_t i = 0; i < tracker.rule_count(); ++i) {
+        if ((values.active_alerts & (1u << i)) == 0) continue;
+        if (!first) out += ", ";
+        first = false;
+        out += '"';
+        out += tracker.rule(i).text;
+        out += '"';
+    }
+    out += "]}";
+}
+
+void encode_query(ResponseFormat format, const QueryRequest& request, const QueryResult& result, std::string& out) {
+    if (format == ResponseFormat::MsgPack) {
+        MsgPackWriter w(out);
+        write_query(w, request, result);
+        return;
+    }
+    if (format == ResponseFormat::Cbor) {
+        CborWriter w(out);
+        write_query(w, request, result);
+        return;
+    }
+
+    out += "{\"from\": ";
+    append_uint(out, result.bounds.from);
+    out += ", \"to\": ";
+    append_uint(out, result.bounds.to);
+    out += ", \"devices\": ";
+    append_uint(out, result.devices);
+    out += ", \"groups\": [";
+    for (size_t i = 0; i < result.groups.size(); ++i) {
+        const QueryGroup& group = result.groups[i];
+        const QueryPartial& partial = group.partial;
+        uint32_t aggregates = query_group_aggregates(request.aggregates, partial);
+        if (i > 0) out += ", ";
+        out += '{';
+        const char* separator = "";
+        auto field = [&](const char* name) {
+            out += separator;
+            out += '"';
+            out += name;
+            out += "\": ";
+            separator = ", ";
+        };
+        if (request.by_device) {
+            field("device_id");
+            append_uint(out, group.device_id);
+        }
+        if (aggregates & QUERY_COUNT) {
+            field("count");
+            append_uint(out, partial.count);
+        }
+        if (aggregates & QUERY_SUM) {
+            field("sum");
+            append_fixed(out, partial.sum);
+        }
+        if (aggregates & QUERY_AVG) {
+            field("avg");
+            append_fixed(out, partial.sum / static_cast<double>(partial.count));
+        }
+        if (aggregates & QUERY_MIN) {
+            field("min");
+            append_fixed(out, partial.min);
+        }
+        if (aggregates & QUERY_MAX) {
+            field("max");
+            append_fixed(out, partial.max);
+        }
+        out += '}';
+    }
+    out += "], \"chunks\": {\"scanned\": ";
+    append_uint(out, result.chunks_scanned);
+    out += ", \"skipped\": ";
+    append_uint(out, result.chunks_skipped);
+    out += ", \"summarized\": ";
+    append_uint(out, result.chunks_summarized);
+    out += "}, \"samples_scanned\": ";
+    append_uint(out, result.samples_scanned);
+    out += '}';
+}
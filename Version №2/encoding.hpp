@@ -0,0 +1,175 @@
+#pragma once
+#include "structs.hpp"
+#include "derived_metrics.hpp"
+#include "query_engine.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+enum class ResponseFormat {
+    Json,
+    MsgPack,
+    Cbor
+};
+
+
+struct DeviceStats {
+    int device_id;
+    double min;
+    double max;
+    double average;
+    int count;
+};
+
+
+class MsgPackWriter {
+public:
+    explicit MsgPackWriter(std::string& out) : out(out) {}
+
+    void map(uint32_t size) {
+        if (size < 16) {
+            put(static_cast<uint8_t>(0x80 | size));
+        } else {
+            put(0xde);
+            put_be(static_cast<uint16_t>(size));
+        }
+    }
+
+    void array(uint32_t size) {
+        if (size < 16) {
+            put(static_cast<uint8_t>(0x90 | size));
+        } else if (size <= 0xffff) {
+            put(0xdc);
+            put_be(static_cast<uint16_t>(size));
+        } else {
+            put(0xdd);
+            put_be(size);
+        }
+    }
+
+    void key(const char* str) {
+        size_t len = std::strlen(str);
+        if (len < 32) {
+            put(static_cast<uint8_t>(0xa0 | len));
+        } else if (len <= 0xff) {
+            put(0xd9);
+            put(static_cast<uint8_t>(len));
+        } else if (len <= 0xffff) {
+            put(0xda);
+            put_be(static_cast<uint16_t>(len));
+        } else {
+            put(0xdb);
+            put_be(static_cast<uint32_t>(len));
+        }
+        out.append(str, len);
+    }
+
+    void uint(uint64_t value) {
+        if (value < 128) {
+            put(static_cast<uint8_t>(value));
+        } else if (value <= 0xff) {
+            put(0xcc);
+            put(static_cast<uint8_t>(value));
+        } else if (value <= 0xffff) {
+            put(0xcd);
+            put_be(static_cast<uint16_t>(value));
+        } else if (value <= 0xffffffffULL) {
+            put(0xce);
+            put_be(static_cast<uint32_t>(value));
+        } else {
+            put(0xcf);
+            put_be(value);
+        }
+    }
+
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put(0xcb);
+        put_be(bits);
+    }
+
+private:
+    std::string& out;
+
+    void put(uint8_t byte) { out.push_back(static_cast<char>(byte)); }
+
+    template <typename T>
+    void put_be(T value) {
+        for (int shift = (sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+            put(static_cast<uint8_t>(value >> shift));
+        }
+    }
+};
+
+
+class CborWriter {
+public:
+    explicit CborWriter(std::string& out) : out(out) {}
+
+    void map(uint32_t size) { head(5, size); }
+    void array(uint32_t size) { head(4, size); }
+
+    void key(const char* str) {
+        size_t len = std::strlen(str);
+        head(3, len);
+        out.append(str, len);
+    }
+
+    void uint(uint64_t value) { head(0, value); }
+
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put(0xfb);
+        put_be(bits);
+    }
+
+private:
+    std::string& out;
+
+    void put(uint8_t byte) { out.push_back(static_cast<char>(byte)); }
+
+    template <typename T>
+    void put_be(T value) {
+        for (int shift = (sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+            put(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    void head(uint8_t major, uint64_t value) {
+        uint8_t type = static_cast<uint8_t>(major << 5);
+        if (value < 24) {
+            put(static_cast<uint8_t>(type | value));
+        } else if (value <= 0xff) {
+            put(type | 24);
+            put(static_cast<uint8_t>(value));
+        } else if (value <= 0xffff) {
+            put(type | 25);
+            put_be(static_cast<uint16_t>(value));
+        } else if (value <= 0xffffffffULL) {
+            put(type | 26);
+            put_be(static_cast<uint32_t>(value));
+        } else {
+            put(type | 27);
+            put_be(value);
+        }
+    }
+};
+
+
+void append_uint(std::string& out, uint64_t value);
+void append_fixed(std::string& out, double value);
+
+ResponseFormat negotiate_format(const char* request);
+bool accepts_prometheus(const char* request);
+const char* content_type(ResponseFormat format);
+
+void encode_latest(ResponseFormat format, int device_id, const Sample& sample, std::string& out);
+void encode_stats(ResponseFormat format, const DeviceStats& stats, std::string& out);
+void encode_devices(ResponseFormat format, const std::vector<uint8_t>& ids, std::string& out);
+void encode_derived(ResponseFormat format, int device_id, const DerivedValues& values,
+                    const DerivedTracker& tracker, std::string& out);
+void encode_query(ResponseFormat format, const QueryRequest& request, const QueryResult& result, std::string& out);
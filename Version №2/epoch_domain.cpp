@@ -0,0 +1,94 @@
+#include "epoch_domain.hpp"
+
+
+// Слот закрепляется за потоком при первом чтении и возвращается при его
+// завершении. Поток может читать из нескольких доменов, например срезы
+// парка и историю; домены сверх MAX_DOMAINS читают через счетчик
+// переполнения. Вложенные чтения в одном потоке держат эпоху внешнего.
+struct EpochReaderState {
+    static constexpr size_t MAX_DOMAINS = 4;
+
+    struct Binding {
+        EpochDomain* domain = nullptr;
+        size_t slot = 0;
+        unsigned depth = 0;
+    };
+
+    Binding bindings[MAX_DOMAINS];
+
+    Binding* find(const EpochDomain* domain) {
+        for (Binding& binding : bindings) {
+            if (binding.domain == domain) return &binding;
+        }
+        return nullptr;
+    }
+
+    ~EpochReaderState() {
+        for (Binding& binding : bindings) {
+            if (binding.domain != nullptr) {
+                binding.domain->slots[binding.slot].owned.store(false, std::memory_order_release);
+            }
+        }
+    }
+};
+
+static thread_local EpochReaderState reader_state;
+
+
+EpochDomain::Guard::Guard(EpochDomain& domain) : domain(domain), slot(domain.claim_slot()) {
+    if (slot == OVERFLOW_SLOT) {
+        domain.overflow.fetch_add(1, std::memory_order_seq_cst);
+        return;
+    }
+    if (reader_state.find(&domain)->depth++ == 0) {
+        // Эпоха объявляется до чтения указателя: seq_cst упорядочивает эту
+        // запись с последующей загрузкой опубликованного объекта.
+        domain.slots[slot].epoch.store(domain.global.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+}
+
+EpochDomain::Guard::~Guard() {
+    if (slot == OVERFLOW_SLOT) {
+        domain.overflow.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    if (--reader_state.find(&domain)->depth == 0) {
+        domain.slots[slot].epoch.store(0, std::memory_order_release);
+    }
+}
+
+size_t EpochDomain::claim_slot() {
+    if (EpochReaderState::Binding* binding = reader_state.find(this)) return binding->slot;
+    EpochReaderState::Binding* binding = reader_state.find(nullptr);
+    if (binding == nullptr) return OVERFLOW_SLOT;
+
+    for (size_t i = 0; i < MAX_READERS; ++i) {
+        bool expected = false;
+        if (!slots[i].owned.load(std::memory_order_relaxed) &&
+            slots[i].owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            binding->domain = this;
+            binding->slot = i;
+            return i;
+        }
+    }
+    return OVERFLOW_SLOT;
+}
+
+uint64_t EpochDomain::oldest() const {
+    if (overflow.load(std::memory_order_seq_cst) > 0) return 0;
+
+    uint64_t result = NONE;
+    for (const Slot& slot : slots) {
+        uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0 && epoch < result) result = epoch;
+    }
+    return result;
+}
+
+size_t EpochDomain::readers() const {
+    size_t count = 0;
+    for (const Slot& slot : slots) {
+        count += slot.owned.load(std::memory_order_relaxed) ? 1 : 0;
+    }
+    return count;
+}
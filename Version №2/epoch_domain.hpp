@@ -0,0 +1,56 @@
+#pragma once
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+
+// Эпохи для отложенного освобождения объектов, которые читатели берут без
+// блокировок. Читатель объявляет текущую эпоху в своем слоте до чтения
+// указателя и снимает ее после. Объект, снятый с публикации в эпоху E,
+// можно освободить, когда ни один слот не держит эпоху E или более раннюю.
+class EpochDomain {
+public:
+    static constexpr size_t MAX_READERS = 128;
+    static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        EpochDomain& domain;
+        size_t slot;
+    };
+
+    // Сдвигает эпоху и возвращает прежнюю: ею помечается снятый объект.
+    uint64_t advance() { return global.fetch_add(1, std::memory_order_seq_cst); }
+
+    // Самая ранняя эпоха, которую держат читатели, или NONE.
+    uint64_t oldest() const;
+
+    size_t readers() const;
+
+private:
+    friend struct EpochReaderState;
+
+    static constexpr size_t OVERFLOW_SLOT = MAX_READERS;
+
+    size_t claim_slot();
+
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> owned{false};
+    };
+
+    Slot slots[MAX_READERS];
+    // Потоки сверх MAX_READERS читают через общий счетчик: пока он не ноль,
+    // освобождение откладывается целиком.
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> overflow{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> global{1};
+};
@@ -0,0 +1,145 @@
+#include "fleet_snapshot.hpp"
+#include "coarse_clock.hpp"
+#include <algorithm>
+
+
+FleetSnapshots fleet_snapshots;
+
+
+void fleet_snapshot_hook(size_t shard, size_t shard_count) {
+    fleet_snapshots.on_batch(shard, shard_count);
+}
+
+
+void FleetSnapshots::configure(uint64_t interval_ms) {
+    interval_ns = interval_ms * 1000000;
+    std::lock_guard<std::mutex> lock(mutex);
+    spare.reserve(16);
+    retired_list.reserve(16);
+}
+
+void FleetSnapshots::on_batch(size_t shard, size_t shard_count) {
+    if (interval_ns == 0 || shard_count > MAX_SHARDS) return;
+
+    uint64_t version = cut_version.load(std::memory_order_acquire);
+    if (version == 0) {
+        if (shard != 0) return;
+        uint64_t now = coarse_clock.monotonic_ns();
+        if (now < next_cut_ns) return;
+        next_cut_ns = now + interval_ns;
+
+        // Срез собирается лениво: без новых сэмплов прежний остается верным.
+        uint64_t applied = 0;
+        for (int id = 0; id < MAX_DEVICES; ++id) {
+            applied += device_store.applied(static_cast<uint8_t>(id));
+        }
+        if (applied == last_applied && current.load(std::memory_order_relaxed) != nullptr) return;
+        last_applied = applied;
+
+        open_cut(shard_count);
+        version = cut_version.load(std::memory_order_relaxed);
+    }
+
+    if (cut_shards != shard_count || contributed[shard] == version) return;
+    contributed[shard] = version;
+    contribute(shard, shard_count);
+    if (cut_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        finish();
+    }
+}
+
+void FleetSnapshots::open_cut(size_t shard_count) {
+    FleetSnapshot* snapshot = take_spare();
+    snapshot->version = ++next_version;
+    snapshot->wall_ms = coarse_clock.wall_ms();
+    building = snapshot;
+    cut_shards = shard_count;
+    cut_start_ns = CoarseClock::precise_monotonic_ns();
+    cut_remaining.store(shard_count, std::memory_order_relaxed);
+    cut_version.store(snapshot->version, std::memory_order_release);
+}
+
+void FleetSnapshots::contribute(size_t shard, size_t shard_count) {
+    // Устройства шарда меняет только этот поток, поэтому seqlock читается
+    // без повторов.
+    for (size_t id = shard; id < MAX_DEVICES; id += shard_count) {
+        device_store.summarize(static_cast<uint8_t>(id), building->devices[id]);
+    }
+}
+
+void FleetSnapshots::finish() {
+    FleetSnapshot& snapshot = *building;
+    snapshot.device_count = 0;
+    snapshot.samples_total = 0;
+    double latest_sum = 0;
+    for (int id = 0; id < MAX_DEVICES; ++id) {
+        const DeviceSummary& device = snapshot.devices[id];
+        snapshot.samples_total += device.applied;
+        if (device.count == 0) continue;
+
+        double value = device.latest.value;
+        if (snapshot.device_count == 0) {
+            snapshot.latest_min = snapshot.latest_max = value;
+        } else {
+            snapshot.latest_min = std::min(snapshot.latest_min, value);
+            snapshot.latest_max = std::max(snapshot.latest_max, value);
+        }
+        latest_sum += value;
+        snapshot.ids[snapshot.device_count++] = static_cast<uint8_t>(id);
+    }
+    snapshot.latest_average = snapshot.device_count > 0 ? latest_sum / snapshot.device_count : 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const FleetSnapshot* previous = current.exchange(&snapshot, std::memory_order_seq_cst);
+        if (previous != nullptr) {
+            retired_list.push_back({const_cast<FleetSnapshot*>(previous), epochs.advance()});
+        }
+        reclaim();
+        building = nullptr;
+    }
+
+    published_count.fetch_add(1, std::memory_order_relaxed);
+    last_build_ns.store(CoarseClock::precise_monotonic_ns() - cut_start_ns, std::memory_order_relaxed);
+    cut_version.store(0, std::memory_order_release);
+}
+
+FleetSnapshot* FleetSnapshots::take_spare() {
+    std::lock_guard<std::mutex> lock(mutex);
+    reclaim();
+    if (spare.empty()) {
+        storage.push_back(std::make_unique<FleetSnapshot>());
+        allocated_count.store(storage.size(), std::memory_order_relaxed);
+        return storage.back().get();
+    }
+    FleetSnapshot* snapshot = spare.back();
+    spare.pop_back();
+    return snapshot;
+}
+
+void FleetSnapshots::reclaim() {
+    if (retired_list.empty()) return;
+    uint64_t oldest = epochs.oldest();
+    size_t kept = 0;
+    for (const Retired& entry : retired_list) {
+        if (entry.epoch < oldest) {
+            spare.push_back(entry.snapshot);
+        } else {
+            retired_list[kept++] = entry;
+        }
+    }
+    retired_list.resize(kept);
+    retired_count.store(kept, std::memory_order_relaxed);
+}
+
+void FleetSnapshots::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (building != nullptr) {
+        spare.push_back(building);
+        building = nullptr;
+    }
+    cut_remaining.store(0, std::memory_order_relaxed);
+    cut_version.store(0, std::memory_order_release);
+    next_cut_ns = 0;
+    last_applied = 0;
+}
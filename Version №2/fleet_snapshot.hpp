@@ -0,0 +1,117 @@
+#pragma once
+#include "device_store.hpp"
+#include "epoch_domain.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// Неизменяемый срез всего парка. Каждый шард хранилища заполняет свои
+// устройства сам, на границе пачки, поэтому устройство не попадает в срез
+// посреди обновления, а итоги посчитаны по тем же копиям, что и значения.
+// При одном шарде срез точный; при нескольких части шардов разнесены не
+// больше чем на одну пачку каждого писателя.
+struct FleetSnapshot {
+    uint64_t version = 0;
+    uint64_t wall_ms = 0;
+    uint64_t samples_total = 0;
+    size_t device_count = 0;
+    double latest_min = 0;
+    double latest_max = 0;
+    double latest_average = 0;
+    uint8_t ids[MAX_DEVICES] = {};
+    DeviceSummary devices[MAX_DEVICES];
+
+    bool active(uint8_t device_id) const { return devices[device_id].count > 0; }
+};
+
+
+// Публикация срезов в духе RCU. Читатель берет указатель на текущий срез без
+// ожидания и держит его, пока жив объект Reader. Писатели хранилища собирают
+// новый срез раз в интервал, если с прошлого что-то применено. Старые срезы
+// освобождаются по эпохам и переиспользуются, новых выделений в
+// установившемся режиме нет.
+class FleetSnapshots {
+public:
+    static constexpr size_t MAX_SHARDS = 64;
+
+    class Reader {
+    public:
+        explicit Reader(FleetSnapshots& owner)
+            : guard(owner.epochs), snapshot(owner.current.load(std::memory_order_seq_cst)) {}
+
+        explicit operator bool() const { return snapshot != nullptr; }
+        const FleetSnapshot& operator*() const { return *snapshot; }
+        const FleetSnapshot* operator->() const { return snapshot; }
+        const FleetSnapshot* get() const { return snapshot; }
+
+    private:
+        EpochDomain::Guard guard;
+        const FleetSnapshot* snapshot;
+    };
+
+    // Интервал 0 выключает срезы, читатели получают пустой Reader.
+    void configure(uint64_t interval_ms);
+    bool enabled() const { return interval_ns > 0; }
+
+    Reader read() { return Reader(*this); }
+
+    // Вызывается писателем шарда после каждой пачки и в простое.
+    void on_batch(size_t shard, size_t shard_count);
+
+    // Сбрасывает незавершенный срез. Только при остановленных писателях.
+    void reset();
+
+    uint64_t published() const { return published_count.load(std::memory_order_relaxed); }
+    uint64_t build_ns() const { return last_build_ns.load(std::memory_order_relaxed); }
+    size_t retired() const { return retired_count.load(std::memory_order_relaxed); }
+    size_t allocated() const { return allocated_count.load(std::memory_order_relaxed); }
+    size_t readers() const { return epochs.readers(); }
+
+private:
+    struct Retired {
+        FleetSnapshot* snapshot;
+        uint64_t epoch;
+    };
+
+    void open_cut(size_t shard_count);
+    void contribute(size_t shard, size_t shard_count);
+    void finish();
+    FleetSnapshot* take_spare();
+    void reclaim();
+
+    EpochDomain epochs;
+    alignas(CACHE_LINE_SIZE) std::atomic<const FleetSnapshot*> current{nullptr};
+
+    // Открытый срез: номер версии или 0. Открывает его писатель шарда 0,
+    // публикует тот, кто внес последнюю часть.
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> cut_version{0};
+    std::atomic<size_t> cut_remaining{0};
+    FleetSnapshot* building = nullptr;
+    size_t cut_shards = 0;
+    uint64_t cut_start_ns = 0;
+    uint64_t contributed[MAX_SHARDS] = {};
+
+    // Состояние писателя шарда 0.
+    uint64_t interval_ns = 0;
+    uint64_t next_cut_ns = 0;
+    uint64_t last_applied = 0;
+    uint64_t next_version = 0;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<FleetSnapshot>> storage;
+    std::vector<FleetSnapshot*> spare;
+    std::vector<Retired> retired_list;
+
+    std::atomic<uint64_t> published_count{0};
+    std::atomic<uint64_t> last_build_ns{0};
+    std::atomic<size_t> retired_count{0};
+    std::atomic<size_t> allocated_count{0};
+};
+
+extern FleetSnapshots fleet_snapshots;
+
+void fleet_snapshot_hook(size_t shard, size_t shard_count);
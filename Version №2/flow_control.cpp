@@ -0,0 +1,79 @@
+#include "flow_control.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+const char* flow_policy_name(FlowPolicy policy) {
+    return policy == FlowPolicy::Pause ? "pause" : "drop";
+}
+
+const char* overload_policy_name(OverloadPolicy policy) {
+    return policy == OverloadPolicy::Block ? "block" : "coalesce";
+}
+
+
+void TokenBucket::configure(double rate, double burst, uint64_t now_ns) {
+    this->rate = std::max(0.0, rate);
+    this->burst = std::max(1.0, burst > 0 ? burst : rate);
+    tokens = this->burst;
+    refill_ns = now_ns;
+}
+
+void TokenBucket::refill(uint64_t now_ns) {
+    if (rate <= 0 || now_ns <= refill_ns) return;
+    tokens = std::min(burst, tokens + static_cast<double>(now_ns - refill_ns) * rate / 1e9);
+    refill_ns = now_ns;
+}
+
+uint64_t TokenBucket::wait_ns() const {
+    if (rate <= 0 || tokens >= 1.0) return 0;
+    return static_cast<uint64_t>(std::ceil((1.0 - tokens) * 1e9 / rate));
+}
+
+
+void DeviceRateLimiter::configure(double rate, double burst) {
+    this->rate = std::max(0.0, rate);
+    this->burst = std::max(1.0, burst > 0 ? burst : rate);
+    // Порция не больше сотой доли секундного лимита: иначе один производитель
+    // забирал бы заметную часть лимита медленного устройства.
+    credit_portion = static_cast<uint32_t>(std::clamp(this->rate / 100.0, 1.0, 64.0));
+    for (Bucket& bucket : buckets) {
+        bucket.tokens.store(static_cast<int64_t>(this->burst), std::memory_order_relaxed);
+        bucket.refill_ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint32_t DeviceRateLimiter::take(uint8_t device, uint32_t wanted, uint64_t now_ns) {
+    Bucket& bucket = buckets[device];
+
+    // Пополнение выполняет поток, выигравший обмен метки времени; остальные
+    // сразу списывают из текущего баланса.
+    uint64_t last = bucket.refill_ns.load(std::memory_order_relaxed);
+    if (last == 0) {
+        bucket.refill_ns.compare_exchange_strong(last, now_ns, std::memory_order_relaxed);
+    } else if (now_ns > last) {
+        // Метка сдвигается ровно на время целых начисленных токенов: дробный
+        // остаток переходит в следующее пополнение. Иначе при частых вызовах
+        // остаток терялся бы каждый раз, и 1500/с превращались бы в 1000/с.
+        uint64_t elapsed = now_ns - last;
+        int64_t added = static_cast<int64_t>(static_cast<double>(elapsed) * rate / 1e9);
+        uint64_t spent = std::min<uint64_t>(
+            elapsed, static_cast<uint64_t>(std::ceil(static_cast<double>(added) * 1e9 / rate)));
+        if (added > 0 &&
+            bucket.refill_ns.compare_exchange_strong(last, last + spent, std::memory_order_relaxed)) {
+            int64_t limit = static_cast<int64_t>(burst);
+            int64_t current = bucket.tokens.load(std::memory_order_relaxed);
+            int64_t target;
+            do {
+                target = std::min(limit, current + added);
+            } while (!bucket.tokens.compare_exchange_weak(current, target, std::memory_order_relaxed));
+        }
+    }
+
+    int64_t before = bucket.tokens.fetch_sub(wanted, std::memory_order_relaxed);
+    int64_t granted = std::clamp<int64_t>(before, 0, wanted);
+    if (granted < static_cast<int64_t>(wanted)) {
+        bucket.tokens.fetch_add(static_cast<int64_t>(wanted) - granted, std::memory_order_relaxed);
+    }
+    return static_cast<uint32_t>(granted);
+}
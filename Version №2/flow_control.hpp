@@ -0,0 +1,84 @@
+#pragma once
+#include "spsc_ring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Что делать с соединением, превысившим свой лимит: перестать читать сокет,
+// чтобы отправителя остановило окно TCP, или читать дальше и отбрасывать кадры.
+enum class FlowPolicy {
+    Pause,
+    Drop
+};
+
+// Поведение производителя, когда кольцо шарда заполнено: ждать писателя
+// (без потерь) или хранить только последний сэмпл каждого устройства, чтобы
+// /latest оставался свежим, а история пропускала промежуточные значения.
+enum class OverloadPolicy {
+    Block,
+    Coalesce
+};
+
+const char* flow_policy_name(FlowPolicy policy);
+const char* overload_policy_name(OverloadPolicy policy);
+
+
+// Корзина токенов одного владельца, без синхронизации. Токен — один сэмпл.
+// Баланс может уйти в минус, когда кадр пачки списывается целиком.
+class TokenBucket {
+public:
+    void configure(double rate, double burst, uint64_t now_ns);
+
+    bool limited() const { return rate > 0; }
+    void refill(uint64_t now_ns);
+
+    // Выдает не больше wanted целых токенов из доступных.
+    uint64_t admit(uint64_t wanted) {
+        if (rate <= 0) return wanted;
+        if (tokens < 1.0) return 0;
+        uint64_t granted = std::min<uint64_t>(wanted, static_cast<uint64_t>(tokens));
+        tokens -= static_cast<double>(granted);
+        return granted;
+    }
+    void charge(uint64_t samples) { tokens -= static_cast<double>(samples); }
+    bool exhausted() const { return limited() && tokens < 1.0; }
+
+    // Через сколько наберется хотя бы один токен.
+    uint64_t wait_ns() const;
+
+private:
+    double rate = 0;
+    double burst = 0;
+    double tokens = 0;
+    uint64_t refill_ns = 0;
+};
+
+
+// Лимиты устройств общие для всех производителей. Производитель берет токены
+// порциями и расходует их локально, поэтому атомарные операции приходятся на
+// порцию, а не на каждый сэмпл.
+class DeviceRateLimiter {
+public:
+    static constexpr size_t DEVICES = 256;
+
+    void configure(double rate, double burst);
+
+    bool enabled() const { return rate > 0; }
+    double limit() const { return rate; }
+    uint32_t portion() const { return credit_portion; }
+
+    uint32_t take(uint8_t device, uint32_t wanted, uint64_t now_ns);
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        std::atomic<int64_t> tokens{0};
+        std::atomic<uint64_t> refill_ns{0};
+    };
+
+    double rate = 0;
+    double burst = 0;
+    uint32_t credit_portion = 1;
+    Bucket buckets[DEVICES];
+};
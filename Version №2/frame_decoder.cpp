@@ -0,0 +1,186 @@
+#include "frame_decoder.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TELEMETRY_X86 1
+#endif
+
+
+static inline void decode_one(const uint8_t* frame, size_t i, const DecodedFrames& out, size_t& valid) {
+    uint8_t crc = 0;
+    for (size_t b = 0; b < LEGACY_FRAME_SIZE - 1; ++b) {
+        crc ^= frame[b];
+    }
+
+    uint32_t bits = (static_cast<uint32_t>(frame[1]) << 24) | (static_cast<uint32_t>(frame[2]) << 16) |
+                    (static_cast<uint32_t>(frame[3]) << 8) | static_cast<uint32_t>(frame[4]);
+    uint64_t timestamp = 0;
+    for (int b = 0; b < 8; ++b) {
+        timestamp = (timestamp << 8) | frame[5 + b];
+    }
+
+    out.device_id[i] = frame[0];
+    std::memcpy(&out.value[i], &bits, 4);
+    out.timestamp[i] = timestamp;
+    out.valid[i] = crc == frame[13];
+    valid += out.valid[i];
+}
+
+size_t decode_frames_scalar(const uint8_t* data, size_t frames, const DecodedFrames& out) {
+    size_t valid = 0;
+    for (size_t i = 0; i < frames; ++i) {
+        decode_one(data + i * LEGACY_FRAME_SIZE, i, out, valid);
+    }
+    return valid;
+}
+
+
+#ifdef TELEMETRY_X86
+
+// Байты 0..13 кадра: XOR всех 14 байт равен нулю, если CRC верен.
+// Перестановка кладет float (байты 1..4) в lane 0..3 и timestamp (байты 5..12) в lane 8..15
+// сразу в порядке хоста.
+
+__attribute__((target("ssse3")))
+size_t decode_frames_ssse3(const uint8_t* data, size_t frames, const DecodedFrames& out) {
+    const __m128i frame_mask = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0);
+    const __m128i swap = _mm_setr_epi8(4, 3, 2, 1, -1, -1, -1, -1, 12, 11, 10, 9, 8, 7, 6, 5);
+
+    size_t valid = 0;
+    size_t i = 0;
+    for (; i + 2 <= frames; ++i) {
+        const uint8_t* frame = data + i * LEGACY_FRAME_SIZE;
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame));
+
+        __m128i x = _mm_and_si128(v, frame_mask);
+        x = _mm_xor_si128(x, _mm_srli_si128(x, 8));
+        x = _mm_xor_si128(x, _mm_srli_si128(x, 4));
+        x = _mm_xor_si128(x, _mm_srli_si128(x, 2));
+        x = _mm_xor_si128(x, _mm_srli_si128(x, 1));
+
+        __m128i swapped = _mm_shuffle_epi8(v, swap);
+        uint32_t bits = static_cast<uint32_t>(_mm_cvtsi128_si32(swapped));
+
+        out.device_id[i] = frame[0];
+        std::memcpy(&out.value[i], &bits, 4);
+        out.timestamp[i] = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_srli_si128(swapped, 8)));
+        out.valid[i] = (_mm_cvtsi128_si32(x) & 0xff) == 0;
+        valid += out.valid[i];
+    }
+    for (; i < frames; ++i) {
+        decode_one(data + i * LEGACY_FRAME_SIZE, i, out, valid);
+    }
+    return valid;
+}
+
+__attribute__((target("avx2")))
+size_t decode_frames_avx2(const uint8_t* data, size_t frames, const DecodedFrames& out) {
+    const __m256i frame_mask = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0);
+    const __m256i swap = _mm256_setr_epi8(
+        4, 3, 2, 1, -1, -1, -1, -1, 12, 11, 10, 9, 8, 7, 6, 5,
+        4, 3, 2, 1, -1, -1, -1, -1, 12, 11, 10, 9, 8, 7, 6, 5);
+
+    size_t valid = 0;
+    size_t i = 0;
+    for (; i + 5 <= frames; i += 4) {
+        const uint8_t* frame = data + i * LEGACY_FRAME_SIZE;
+        __m256i a = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(frame))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + LEGACY_FRAME_SIZE)), 1);
+        __m256i b = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + 2 * LEGACY_FRAME_SIZE))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + 3 * LEGACY_FRAME_SIZE)), 1);
+
+        __m256i xa = _mm256_and_si256(a, frame_mask);
+        __m256i xb = _mm256_and_si256(b, frame_mask);
+        xa = _mm256_xor_si256(xa, _mm256_srli_si256(xa, 8));
+        xb = _mm256_xor_si256(xb, _mm256_srli_si256(xb, 8));
+        xa = _mm256_xor_si256(xa, _mm256_srli_si256(xa, 4));
+        xb = _mm256_xor_si256(xb, _mm256_srli_si256(xb, 4));
+        xa = _mm256_xor_si256(xa, _mm256_srli_si256(xa, 2));
+        xb = _mm256_xor_si256(xb, _mm256_srli_si256(xb, 2));
+        xa = _mm256_xor_si256(xa, _mm256_srli_si256(xa, 1));
+        xb = _mm256_xor_si256(xb, _mm256_srli_si256(xb, 1));
+
+        __m256i sa = _mm256_shuffle_epi8(a, swap);
+        __m256i sb = _mm256_shuffle_epi8(b, swap);
+
+        uint32_t bits[4] = {
+            static_cast<uint32_t>(_mm256_extract_epi32(sa, 0)),
+            static_cast<uint32_t>(_mm256_extract_epi32(sa, 4)),
+            static_cast<uint32_t>(_mm256_extract_epi32(sb, 0)),
+            static_cast<uint32_t>(_mm256_extract_epi32(sb, 4)),
+        };
+        std::memcpy(&out.value[i], bits, sizeof(bits));
+
+        out.timestamp[i] = static_cast<uint64_t>(_mm256_extract_epi64(sa, 1));
+        out.timestamp[i + 1] = static_cast<uint64_t>(_mm256_extract_epi64(sa, 3));
+        out.timestamp[i + 2] = static_cast<uint64_t>(_mm256_extract_epi64(sb, 1));
+        out.timestamp[i + 3] = static_cast<uint64_t>(_mm256_extract_epi64(sb, 3));
+
+        out.valid[i] = (_mm256_extract_epi8(xa, 0) & 0xff) == 0;
+        out.valid[i + 1] = (_mm256_extract_epi8(xa, 16) & 0xff) == 0;
+        out.valid[i + 2] = (_mm256_extract_epi8(xb, 0) & 0xff) == 0;
+        out.valid[i + 3] = (_mm256_extract_epi8(xb, 16) & 0xff) == 0;
+        valid += out.valid[i] + out.valid[i + 1] + out.valid[i + 2] + out.valid[i + 3];
+
+        for (size_t k = 0; k < 4; ++k) {
+            out.device_id[i + k] = frame[k * LEGACY_FRAME_SIZE];
+        }
+    }
+    for (; i < frames; ++i) {
+        decode_one(data + i * LEGACY_FRAME_SIZE, i, out, valid);
+    }
+    return valid;
+}
+
+bool decoder_supported(DecoderKind kind) {
+    switch (kind) {
+        case DecoderKind::Avx2: return __builtin_cpu_supports("avx2");
+        case DecoderKind::Ssse3: return __builtin_cpu_supports("ssse3");
+        default: return true;
+    }
+}
+
+#else
+
+size_t decode_frames_ssse3(const uint8_t* data, size_t frames, const DecodedFrames& out) {
+    return decode_frames_scalar(data, frames, out);
+}
+
+size_t decode_frames_avx2(const uint8_t* data, size_t frames, const DecodedFrames& out) {
+    return decode_frames_scalar(data, frames, out);
+}
+
+bool decoder_supported(DecoderKind kind) {
+    return kind == DecoderKind::Scalar;
+}
+
+#endif
+
+
+DecoderKind active_decoder() {
+    static const DecoderKind kind = decoder_supported(DecoderKind::Avx2) ? DecoderKind::Avx2
+                                  : decoder_supported(DecoderKind::Ssse3) ? DecoderKind::Ssse3
+                                  : DecoderKind::Scalar;
+    return kind;
+}
+
+const char* decoder_name(DecoderKind kind) {
+    switch (kind) {
+        case DecoderKind::Avx2: return "avx2";
+        case DecoderKind::Ssse3: return "ssse3";
+        default: return "scalar";
+    }
+}
+
+size_t decode_frames(const uint8_t* data, size_t frames, const DecodedFrames& out) {
+    switch (active_decoder()) {
+        case DecoderKind::Avx2: return decode_frames_avx2(data, frames, out);
+        case DecoderKind::Ssse3: return decode_frames_ssse3(data, frames, out);
+        default: return decode_frames_scalar(data, frames, out);
+    }
+}
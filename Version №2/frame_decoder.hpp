@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+static constexpr size_t LEGACY_FRAME_SIZE = 14;
+
+
+struct DecodedFrames {
+    uint8_t* device_id;
+    float* value;
+    uint64_t* timestamp;
+    uint8_t* valid;
+};
+
+
+enum class DecoderKind {
+    Scalar,
+    Ssse3,
+    Avx2
+};
+
+
+size_t decode_frames_scalar(const uint8_t* data, size_t frames, const DecodedFrames& out);
+size_t decode_frames_ssse3(const uint8_t* data, size_t frames, const DecodedFrames& out);
+size_t decode_frames_avx2(const uint8_t* data, size_t frames, const DecodedFrames& out);
+
+bool decoder_supported(DecoderKind kind);
+DecoderKind active_decoder();
+const char* decoder_name(DecoderKind kind);
+
+size_t decode_frames(const uint8_t* data, size_t frames, const DecodedFrames& out);
@@ -0,0 +1,84 @@
+#include "freshness.hpp"
+#include "coarse_clock.hpp"
+#include <iostream>
+
+
+FreshnessTracker freshness;
+
+
+static constexpr uint64_t ALERT_INTERVAL_NS = 1000000000;
+
+
+void FreshnessTracker::configure(uint32_t every, uint64_t visible_alert_ms, uint64_t device_alert_ms) {
+    sample_every = every < 1 ? 1 : every;
+    visible_alert_ns = visible_alert_ms * 1000000;
+    device_alert_ns = device_alert_ms * 1000000;
+}
+
+void FreshnessTracker::record(uint8_t device_id, uint64_t received_ns, uint64_t device_timestamp_ms) {
+    if (received_ns != 0) {
+        uint64_t now = stage_clock_ns();
+        uint64_t lag = now > received_ns ? now - received_ns : 0;
+        visible_lag[device_id].record(lag);
+        if (visible_alert_ns > 0 && lag > visible_alert_ns) {
+            alert("видимости", device_id, lag, visible_alert_ns);
+        }
+    }
+
+    uint64_t now_ms = coarse_clock.wall_ms();
+    if (device_timestamp_ms > now_ms) {
+        ahead.add();
+        return;
+    }
+    uint64_t lag = (now_ms - device_timestamp_ms) * 1000000;
+    device_lag[device_id].record(lag);
+    if (device_alert_ns > 0 && lag > device_alert_ns) {
+        alert("относительно времени устройства", device_id, lag, device_alert_ns);
+    }
+}
+
+void FreshnessTracker::alert(const char* kind, uint8_t device_id, uint64_t lag_ns, uint64_t threshold_ns) {
+    alert_count.add();
+    uint64_t now = stage_clock_ns();
+    uint64_t last = last_alert_ns.load(std::memory_order_relaxed);
+    if (now - last < ALERT_INTERVAL_NS || !last_alert_ns.compare_exchange_strong(last, now)) {
+        return;
+    }
+    std::cerr << "Предупреждение: задержка " << kind << " для устройства " << static_cast<int>(device_id)
+              << " составила " << lag_ns / 1000000.0 << " мс (порог " << threshold_ns / 1000000 << " мс)"
+              << std::endl;
+}
+
+LatencySummary FreshnessTracker::visible(int device_id) const {
+    LatencyTotals totals{};
+    uint64_t sum = 0;
+    if (device_id < 0) {
+        for (const LatencyHistogram& histogram : visible_lag) {
+            histogram.merge_into(totals);
+            sum += histogram.sum();
+        }
+    } else {
+        visible_lag[device_id].merge_into(totals);
+        sum = visible_lag[device_id].sum();
+    }
+    LatencySummary summary = summarize_latency(totals);
+    summary.sum = sum;
+    return summary;
+}
+
+LatencySummary FreshnessTracker::device(int device_id) const {
+    LatencyTotals totals{};
+    uint64_t sum = 0;
+    if (device_id < 0) {
+        for (const LatencyHistogram& histogram : device_lag) {
+            histogram.merge_into(totals);
+            sum += histogram.sum();
+        }
+    } else {
+        device_lag[device_id].merge_into(totals);
+        sum = device_lag[device_id].sum();
+    }
+    LatencySummary summary = summarize_latency(totals);
+    summary.sum = sum;
+    return summary;
+}
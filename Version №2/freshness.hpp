@@ -0,0 +1,40 @@
+#pragma once
+#include "counters.hpp"
+#include "device_store.hpp"
+#include "latency_histogram.hpp"
+#include <atomic>
+#include <cstdint>
+
+
+class FreshnessTracker {
+public:
+    void configure(uint32_t sample_every, uint64_t visible_alert_ms, uint64_t device_alert_ms);
+
+    bool should_sample() {
+        static thread_local uint32_t counter = 0;
+        if (++counter < sample_every) return false;
+        counter = 0;
+        return true;
+    }
+
+    void record(uint8_t device_id, uint64_t received_ns, uint64_t device_timestamp_ms);
+
+    LatencySummary visible(int device_id) const;
+    LatencySummary device(int device_id) const;
+    uint64_t clock_ahead() const { return ahead.load(); }
+    uint64_t alerts() const { return alert_count.load(); }
+
+private:
+    void alert(const char* kind, uint8_t device_id, uint64_t lag_ns, uint64_t threshold_ns);
+
+    uint32_t sample_every = 16;
+    uint64_t visible_alert_ns = 0;
+    uint64_t device_alert_ns = 0;
+    LatencyHistogram visible_lag[MAX_DEVICES];
+    LatencyHistogram device_lag[MAX_DEVICES];
+    ShardedCounter ahead;
+    ShardedCounter alert_count;
+    std::atomic<uint64_t> last_alert_ns{0};
+};
+
+extern FreshnessTracker freshness;
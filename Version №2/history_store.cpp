@@ -0,0 +1,537 @@
+#include "history_store.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+
+HistoryStore history_store;
+
+
+const char* history_tier_name(HistoryTier tier) {
+    switch (tier) {
+        case HistoryTier::Resident: return "resident";
+        case HistoryTier::Compressed: return "compressed";
+        case HistoryTier::Spilled: return "spilled";
+        default: return "empty";
+    }
+}
+
+
+namespace {
+
+void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool get_varint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Сжатое кольцо: число блоков, затем для каждого число сэмплов и сэмплы.
+// Метка — дельта дельты со знаком в zigzag: при ровном периоде это один
+// байт. Значение — XOR битов с предыдущим: у медленного сигнала старшие
+// биты совпадают, и varint короче четырех байт.
+void encode_ring(const HistoryRing& ring, size_t chunk_count, std::vector<uint8_t>& out) {
+    out.clear();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    uint64_t oldest = head > chunk_count ? head - chunk_count : 0;
+    uint64_t filled = 0;
+    for (uint64_t index = oldest; index < head; ++index) {
+        filled += ring.chunks[index % chunk_count].count.load(std::memory_order_relaxed) > 0 ? 1 : 0;
+    }
+    put_varint(out, filled);
+
+    uint64_t previous_ts = 0;
+    int64_t previous_delta = 0;
+    uint32_t previous_bits = 0;
+    for (uint64_t index = oldest; index < head; ++index) {
+        const HistoryChunk& chunk = ring.chunks[index % chunk_count];
+        uint32_t count = chunk.count.load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        put_varint(out, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            int64_t delta = static_cast<int64_t>(chunk.timestamps[i] - previous_ts);
+            put_varint(out, zigzag(delta - previous_delta));
+            previous_ts = chunk.timestamps[i];
+            previous_delta = delta;
+
+            uint32_t bits;
+            std::memcpy(&bits, &chunk.values[i], sizeof(bits));
+            put_varint(out, bits ^ previous_bits);
+            previous_bits = bits;
+        }
+    }
+}
+
+bool decode_ring(const uint8_t* data, size_t size, HistoryRing& ring, size_t chunk_count) {
+    const uint8_t* cursor = data;
+    const uint8_t* end = data + size;
+    uint64_t filled = 0;
+    if (!get_varint(cursor, end, filled) || filled > chunk_count) return false;
+
+    uint64_t previous_ts = 0;
+    int64_t previous_delta = 0;
+    uint32_t previous_bits = 0;
+    for (uint64_t index = 0; index < filled; ++index) {
+        HistoryChunk& chunk = ring.chunks[index];
+        uint64_t count = 0;
+        if (!get_varint(cursor, end, count) || count == 0 || count > HistoryChunk::SAMPLES) return false;
+        uint64_t min_ts = std::numeric_limits<uint64_t>::max();
+        uint64_t max_ts = 0;
+        float min_value = std::numeric_limits<float>::infinity();
+        float max_value = -std::numeric_limits<float>::infinity();
+        double sum = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t dod = 0;
+            uint64_t xored = 0;
+            if (!get_varint(cursor, end, dod) || !get_varint(cursor, end, xored)) return false;
+            previous_delta += unzigzag(dod);
+            previous_ts += static_cast<uint64_t>(previous_delta);
+            previous_bits ^= static_cast<uint32_t>(xored);
+            float value;
+            std::memcpy(&value, &previous_bits, sizeof(value));
+
+            chunk.timestamps[i] = previous_ts;
+            chunk.values[i] = value;
+            min_ts = std::min(min_ts, previous_ts);
+            max_ts = std::max(max_ts, previous_ts);
+            if (value < min_value) min_value = value;
+            if (value > max_value) max_value = value;
+            sum += value;
+        }
+        chunk.min_timestamp.store(min_ts, std::memory_order_relaxed);
+        chunk.max_timestamp.store(max_ts, std::memory_order_relaxed);
+        chunk.min_value.store(min_value, std::memory_order_relaxed);
+        chunk.max_value.store(max_value, std::memory_order_relaxed);
+        chunk.sum.store(sum, std::memory_order_relaxed);
+        chunk.count.store(static_cast<uint32_t>(count), std::memory_order_relaxed);
+    }
+    ring.head.store(filled, std::memory_order_relaxed);
+    return cursor == end;
+}
+
+bool read_fully(int fd, uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pread(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool write_fully(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+size_t mapped_size(size_t chunk_count) {
+    size_t bytes = sizeof(HistoryChunk) * chunk_count;
+    if (bytes < HistoryRing::MAPPED_BYTES) return 0;
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (bytes + page - 1) / page * page;
+}
+
+}
+
+
+HistoryRing::HistoryRing(size_t chunk_count) : chunk_count(chunk_count), mapped_bytes(mapped_size(chunk_count)) {
+    if (mapped_bytes > 0) {
+        void* base = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != MAP_FAILED) {
+            chunks = static_cast<HistoryChunk*>(base);
+            for (size_t i = 0; i < chunk_count; ++i) new (&chunks[i]) HistoryChunk;
+            return;
+        }
+        mapped_bytes = 0;
+    }
+    chunks = new HistoryChunk[chunk_count];
+}
+
+HistoryRing::~HistoryRing() {
+    if (mapped_bytes > 0) {
+        std::destroy_n(chunks, chunk_count);
+        munmap(chunks, mapped_bytes);
+    } else {
+        delete[] chunks;
+    }
+}
+
+size_t HistoryRing::footprint(size_t chunk_count) {
+    size_t mapped = mapped_size(chunk_count);
+    return sizeof(HistoryRing) + (mapped > 0 ? mapped : sizeof(HistoryChunk) * chunk_count);
+}
+
+
+void HistoryStore::configure(uint32_t devices_total, size_t samples_per_device) {
+    release();
+    devices_count = devices_total;
+    chunks_per_device = (samples_per_device + HistoryChunk::SAMPLES - 1) / HistoryChunk::SAMPLES;
+    if (chunks_per_device > 0) {
+        devices = std::make_unique<DeviceHistory[]>(devices_count);
+        shards = std::make_unique<ShardState[]>(MAX_SHARDS);
+        tier_devices[static_cast<size_t>(HistoryTier::Empty)].store(devices_count, std::memory_order_relaxed);
+    }
+}
+
+bool HistoryStore::set_budget(size_t bytes, const std::string& spill_path) {
+    budget_bytes = bytes;
+    if (spill_fd >= 0) {
+        close(spill_fd);
+        spill_fd = -1;
+    }
+    spill_end.store(0, std::memory_order_relaxed);
+    if (spill_path.empty()) return true;
+    spill_fd = open(spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    return spill_fd >= 0;
+}
+
+void HistoryStore::release() {
+    if (devices) {
+        for (uint32_t i = 0; i < devices_count; ++i) {
+            delete devices[i].ring.load(std::memory_order_relaxed);
+            delete[] devices[i].blob;
+        }
+    }
+    if (shards) {
+        for (size_t i = 0; i < MAX_SHARDS; ++i) {
+            for (const Retired& entry : shards[i].retired) delete entry.ring;
+        }
+    }
+    devices.reset();
+    shards.reset();
+    if (spill_fd >= 0) {
+        close(spill_fd);
+        spill_fd = -1;
+    }
+    resident_bytes.store(0, std::memory_order_relaxed);
+    compressed_bytes.store(0, std::memory_order_relaxed);
+    for (auto& count : tier_devices) count.store(0, std::memory_order_relaxed);
+}
+
+void HistoryStore::lock(DeviceHistory& history) {
+    while (history.locked.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+HistoryRing* HistoryStore::allocate_ring() const {
+    resident_bytes.fetch_add(HistoryRing::footprint(chunks_per_device), std::memory_order_relaxed);
+    return new HistoryRing(chunks_per_device);
+}
+
+void HistoryStore::free_ring(HistoryRing* ring) const {
+    delete ring;
+    resident_bytes.fetch_sub(HistoryRing::footprint(chunks_per_device), std::memory_order_relaxed);
+}
+
+void HistoryStore::set_tier(DeviceHistory& history, HistoryTier tier) const {
+    HistoryTier previous = history.tier.load(std::memory_order_relaxed);
+    tier_devices[static_cast<size_t>(previous)].fetch_sub(1, std::memory_order_relaxed);
+    tier_devices[static_cast<size_t>(tier)].fetch_add(1, std::memory_order_relaxed);
+    history.tier.store(tier, std::memory_order_release);
+}
+
+// Переиспользование блока обернуто в нечетное поколение: читатель, попавший
+// на него, отбросит прочитанное вместо смеси старых и новых сэмплов.
+HistoryChunk* HistoryStore::start_chunk(HistoryRing& ring) {
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    HistoryChunk& chunk = ring.chunks[head % chunks_per_device];
+    uint32_t generation = chunk.generation.load(std::memory_order_relaxed);
+    chunk.generation.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    chunk.count.store(0, std::memory_order_relaxed);
+    chunk.min_timestamp.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    chunk.max_timestamp.store(0, std::memory_order_relaxed);
+    chunk.min_value.store(std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+    chunk.max_value.store(-std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+    chunk.sum.store(0, std::memory_order_relaxed);
+    chunk.generation.store(generation + 2, std::memory_order_release);
+    ring.head.store(head + 1, std::memory_order_release);
+    return &chunk;
+}
+
+void HistoryStore::append(uint32_t device, float value, uint64_t timestamp) {
+    if (device >= devices_count || !enabled()) return;
+    DeviceHistory& history = devices[device];
+    touch(history);
+
+    // Запрос может вернуть историю в память между чтением кольца и уровня,
+    // поэтому кольцо и уровень перечитываются под флагом: новое кольцо
+    // заводится только у устройства без истории, иначе берется уже
+    // опубликованное.
+    HistoryRing* ring = history.ring.load(std::memory_order_acquire);
+    while (ring == nullptr) {
+        HistoryTier current = history.tier.load(std::memory_order_acquire);
+        make_room(device);
+        if (current == HistoryTier::Compressed || current == HistoryTier::Spilled) {
+            page_in(device);
+            ring = history.ring.load(std::memory_order_acquire);
+            continue;
+        }
+        lock(history);
+        ring = history.ring.load(std::memory_order_relaxed);
+        if (ring == nullptr && history.tier.load(std::memory_order_relaxed) == HistoryTier::Empty) {
+            ring = allocate_ring();
+            history.ring.store(ring, std::memory_order_release);
+            set_tier(history, HistoryTier::Resident);
+        }
+        unlock(history);
+    }
+
+    HistoryChunk* chunk = nullptr;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head > 0) {
+        chunk = &ring->chunks[(head - 1) % chunks_per_device];
+    }
+    uint32_t count = chunk != nullptr ? chunk->count.load(std::memory_order_relaxed) : 0;
+    if (chunk == nullptr || chunk->full(count)) {
+        chunk = start_chunk(*ring);
+        count = 0;
+    }
+
+    chunk->timestamps[count] = timestamp;
+    chunk->values[count] = value;
+    if (timestamp < chunk->min_timestamp.load(std::memory_order_relaxed)) {
+        chunk->min_timestamp.store(timestamp, std::memory_order_relaxed);
+    }
+    if (timestamp > chunk->max_timestamp.load(std::memory_order_relaxed)) {
+        chunk->max_timestamp.store(timestamp, std::memory_order_relaxed);
+    }
+    if (value < chunk->min_value.load(std::memory_order_relaxed)) {
+        chunk->min_value.store(value, std::memory_order_relaxed);
+    }
+    if (value > chunk->max_value.load(std::memory_order_relaxed)) {
+        chunk->max_value.store(value, std::memory_order_relaxed);
+    }
+    chunk->sum.store(chunk->sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    chunk->count.store(count + 1, std::memory_order_release);
+
+    uint64_t newest = history.newest.load(std::memory_order_relaxed);
+    if (timestamp >= newest) {
+        history.newest.store(timestamp, std::memory_order_relaxed);
+    } else if (history.samples.load(std::memory_order_relaxed) > 0) {
+        history.ordered.store(false, std::memory_order_relaxed);
+    }
+    history.samples.store(history.samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Возвращает в память писатель устройства; запрос в это время может читать
+// сжатые данные, поэтому смена уровня идет под флагом. Место в файле сброса
+// остается за устройством и переиспользуется при следующем сбросе.
+void HistoryStore::page_in(uint32_t device) {
+    DeviceHistory& history = devices[device];
+    lock(history);
+    HistoryTier current = history.tier.load(std::memory_order_relaxed);
+    if (current != HistoryTier::Compressed && current != HistoryTier::Spilled) {
+        unlock(history);
+        return;
+    }
+
+    std::unique_ptr<uint8_t[]> spilled;
+    const uint8_t* data = history.blob;
+    if (current == HistoryTier::Spilled) {
+        spilled.reset(new uint8_t[history.blob_size]);
+        if (!read_fully(spill_fd, spilled.get(), history.blob_size, history.spill_offset)) {
+            spilled.reset();
+        }
+        data = spilled.get();
+    }
+
+    HistoryRing* ring = allocate_ring();
+    if (data == nullptr || !decode_ring(data, history.blob_size, *ring, chunks_per_device)) {
+        std::cerr << "Ошибка возврата истории устройства " << device << ", история отброшена" << std::endl;
+        free_ring(ring);
+        ring = nullptr;
+    }
+    if (current == HistoryTier::Compressed) {
+        delete[] history.blob;
+        history.blob = nullptr;
+        compressed_bytes.fetch_sub(history.blob_size, std::memory_order_relaxed);
+    }
+    history.ring.store(ring, std::memory_order_release);
+    set_tier(history, ring != nullptr ? HistoryTier::Resident : HistoryTier::Empty);
+    paged_in[static_cast<size_t>(current)].fetch_add(1, std::memory_order_relaxed);
+    unlock(history);
+}
+
+// Временное кольцо потока для чтения вытесненной истории. Живет до
+// следующего обхода этим потоком, поэтому в бюджет не входит.
+struct StreamScratch {
+    size_t chunks = 0;
+    std::unique_ptr<HistoryRing> ring;
+    std::vector<uint8_t> spilled;
+};
+
+// Кольцо могли опубликовать после проверки вызывающего, поэтому кольцо и
+// уровень перечитываются под флагом. Опубликованное кольцо защищено эпохой
+// вызывающего, вытесненное распаковывается во временное.
+const HistoryRing* HistoryStore::stream_in(uint32_t device) const {
+    DeviceHistory& history = devices[device];
+    lock(history);
+    const HistoryRing* ring = history.ring.load(std::memory_order_relaxed);
+    HistoryTier current = history.tier.load(std::memory_order_relaxed);
+    if (ring != nullptr || (current != HistoryTier::Compressed && current != HistoryTier::Spilled)) {
+        unlock(history);
+        return ring;
+    }
+
+    static thread_local StreamScratch scratch;
+    if (scratch.chunks != chunks_per_device) {
+        scratch.ring = std::make_unique<HistoryRing>(chunks_per_device);
+        scratch.chunks = chunks_per_device;
+    }
+    const uint8_t* data = history.blob;
+    if (current == HistoryTier::Spilled) {
+        scratch.spilled.resize(history.blob_size);
+        data = read_fully(spill_fd, scratch.spilled.data(), history.blob_size, history.spill_offset)
+                   ? scratch.spilled.data()
+                   : nullptr;
+    }
+    bool decoded = data != nullptr && decode_ring(data, history.blob_size, *scratch.ring, chunks_per_device);
+    streamed[static_cast<size_t>(current)].fetch_add(1, std::memory_order_relaxed);
+    unlock(history);
+    if (!decoded) {
+        std::cerr << "Ошибка чтения истории устройства " << device << std::endl;
+        return nullptr;
+    }
+    return scratch.ring.get();
+}
+
+// Сдвигает устройство на уровень холоднее. Кольцо снимается с публикации
+// и освобождается по эпохам: запрос мог взять его до вытеснения.
+bool HistoryStore::evict(uint32_t device, ShardState& shard) {
+    DeviceHistory& history = devices[device];
+    // Кольцо мог вернуть в память запрос: acquire видит его содержимое.
+    HistoryTier current = history.tier.load(std::memory_order_acquire);
+
+    if (current == HistoryTier::Resident) {
+        HistoryRing* ring = history.ring.load(std::memory_order_acquire);
+        encode_ring(*ring, chunks_per_device, shard.scratch);
+        uint8_t* blob = new uint8_t[shard.scratch.size()];
+        std::memcpy(blob, shard.scratch.data(), shard.scratch.size());
+        compressed_bytes.fetch_add(shard.scratch.size(), std::memory_order_relaxed);
+
+        lock(history);
+        history.blob = blob;
+        history.blob_size = static_cast<uint32_t>(shard.scratch.size());
+        history.ring.store(nullptr, std::memory_order_release);
+        set_tier(history, HistoryTier::Compressed);
+        unlock(history);
+        shard.retired.push_back({ring, epochs.advance()});
+        evicted[static_cast<size_t>(HistoryTier::Compressed)].fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    if (current != HistoryTier::Compressed) return false;
+
+    lock(history);
+    if (history.tier.load(std::memory_order_relaxed) != HistoryTier::Compressed) {
+        unlock(history);
+        return false;
+    }
+    HistoryTier next = HistoryTier::Empty;
+    if (spill_fd >= 0) {
+        // Место устройства в файле растет степенями двойки: история растет до
+        // заполнения кольца, и брошенные участки в сумме не больше нового.
+        if (history.blob_size > history.spill_capacity) {
+            history.spill_capacity = std::bit_ceil(std::max<uint32_t>(history.blob_size, 256));
+            history.spill_offset = spill_end.fetch_add(history.spill_capacity, std::memory_order_relaxed);
+        }
+        if (write_fully(spill_fd, history.blob, history.blob_size, history.spill_offset)) {
+            next = HistoryTier::Spilled;
+        }
+    }
+    delete[] history.blob;
+    history.blob = nullptr;
+    compressed_bytes.fetch_sub(history.blob_size, std::memory_order_relaxed);
+    set_tier(history, next);
+    unlock(history);
+    evicted[static_cast<size_t>(next)].fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void HistoryStore::reclaim(ShardState& shard) {
+    if (shard.retired.empty()) return;
+    uint64_t oldest = epochs.oldest();
+    size_t kept = 0;
+    for (const Retired& entry : shard.retired) {
+        if (entry.epoch < oldest) {
+            free_ring(entry.ring);
+        } else {
+            shard.retired[kept++] = entry;
+        }
+    }
+    shard.retired.resize(kept);
+}
+
+// Часы по устройствам шарда: устройство с битом обращения получает второй
+// шанс, без него — уходит на уровень холоднее. Вытеснение начинается выше
+// 7/8 бюджета (остальное — запас на кучу) и идет до 13/16, чтобы не
+// возвращаться к нему на каждой пачке.
+void HistoryStore::maintain(size_t shard, size_t shard_count) {
+    if (!enabled() || shard >= MAX_SHARDS || shard >= devices_count) return;
+    if (writer_shards.load(std::memory_order_relaxed) != shard_count) {
+        writer_shards.store(shard_count, std::memory_order_relaxed);
+    }
+    ShardState& state = shards[shard];
+    reclaim(state);
+    size_t limit = budget_bytes - budget_bytes / 8;
+    if (budget_bytes == 0 || memory_bytes() <= limit) return;
+
+    size_t target = limit - budget_bytes / 16;
+    uint64_t owned = (devices_count - shard + shard_count - 1) / shard_count;
+    for (size_t visits = 0; visits < MAINTAIN_VISITS && memory_bytes() > target; ++visits) {
+        uint32_t device = static_cast<uint32_t>(shard + (state.cursor++ % owned) * shard_count);
+        DeviceHistory& history = devices[device];
+        HistoryTier current = history.tier.load(std::memory_order_relaxed);
+        if (current != HistoryTier::Resident && current != HistoryTier::Compressed) continue;
+        if (history.referenced.exchange(false, std::memory_order_relaxed)) continue;
+        evict(device, state);
+        reclaim(state);
+    }
+}
+
+// Между границами пачек писатель может завести много колец: пачка новых
+// или вернувшихся устройств. Поэтому перед выделением кольца сверх предела
+// писатель сам запускает обход часов своего шарда.
+void HistoryStore::make_room(uint32_t device) {
+    size_t shard_count = writer_shards.load(std::memory_order_relaxed);
+    if (budget_bytes == 0 || shard_count == 0 || memory_bytes() <= budget_bytes - budget_bytes / 8) return;
+    maintain(device % shard_count, shard_count);
+}
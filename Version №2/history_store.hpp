@@ -0,0 +1,231 @@
+#pragma once
+#include "epoch_domain.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Блок истории: метки и значения лежат отдельными колонками, чтобы запрос
+// сканировал их векторами. Зона блока — границы меток и значений и сумма —
+// позволяет запросу пропустить блок целиком или взять итог без сканирования.
+// Зона может опережать счетчик на сэмпл, поэтому границы только шире
+// видимых данных; сумма согласована со счетчиком лишь у заполненного блока.
+struct HistoryChunk {
+    static constexpr uint32_t SAMPLES = 512;
+
+    // Нечетное поколение — писатель переиспользует блок под новые сэмплы.
+    std::atomic<uint32_t> generation{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint64_t> min_timestamp{0};
+    std::atomic<uint64_t> max_timestamp{0};
+    std::atomic<float> min_value{0};
+    std::atomic<float> max_value{0};
+    std::atomic<double> sum{0};
+    alignas(32) uint64_t timestamps[SAMPLES];
+    alignas(32) float values[SAMPLES];
+
+    bool full(uint32_t samples) const { return samples == SAMPLES; }
+
+    // Читает блок как seqlock: fn(samples) видит первые samples сэмплов.
+    // Возвращает false, если блок переиспользовали во время чтения, и тогда
+    // результат fn нужно отбросить.
+    template <typename Fn>
+    bool read(Fn&& fn) const {
+        uint32_t before = generation.load(std::memory_order_acquire);
+        if (before & 1) return false;
+        fn(count.load(std::memory_order_acquire));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return generation.load(std::memory_order_relaxed) == before;
+    }
+};
+
+// Кольцо блоков устройства. Счетчик начатых блоков лежит рядом с ними:
+// читатель, взявший кольцо до вытеснения, видит его целиком прежним.
+// Массив блоков от MAPPED_BYTES занимает отдельное отображение: вытесненное
+// кольцо сразу возвращается системе, а его место в куче не дробят сжатые
+// данные, так что RSS следует учтенной памяти.
+struct HistoryRing {
+    static constexpr size_t MAPPED_BYTES = 32 * 1024;
+
+    explicit HistoryRing(size_t chunk_count);
+    ~HistoryRing();
+    HistoryRing(const HistoryRing&) = delete;
+    HistoryRing& operator=(const HistoryRing&) = delete;
+
+    // Память кольца с округлением отображения до страниц.
+    static size_t footprint(size_t chunk_count);
+
+    // Текущий блок — head - 1 по модулю кольца.
+    std::atomic<uint64_t> head{0};
+    HistoryChunk* chunks = nullptr;
+    size_t chunk_count = 0;
+    size_t mapped_bytes = 0;
+};
+
+
+// Где лежит история устройства.
+enum class HistoryTier : uint8_t {
+    Empty,
+    Resident,
+    Compressed,
+    Spilled,
+    Count
+};
+
+static constexpr size_t HISTORY_TIER_COUNT = static_cast<size_t>(HistoryTier::Count);
+
+const char* history_tier_name(HistoryTier tier);
+
+
+// История сэмплов для запросов /query. У каждого устройства кольцо блоков,
+// которое выделяется при первом сэмпле; когда кольцо заполнено, самый
+// старый блок переиспользуется. Пишет один писатель шарда на устройство,
+// читатели не блокируют его.
+//
+// При заданном бюджете памяти писатель шарда на границе пачки вытесняет
+// холодные устройства своего шарда по алгоритму часов: кольцо сжимается
+// (дельты дельт меток и XOR значений), сжатое уходит в файл сброса, а без
+// файла отбрасывается. Новый сэмпл возвращает историю в память, а запрос
+// читает ее, не возвращая. Учтенная память держится на 7/8 бюджета:
+// остаток уходит на заголовки выделений и фрагментацию кучи, так что
+// бюджет ограничивает и RSS истории.
+class HistoryStore {
+public:
+    static constexpr size_t MAX_SHARDS = 64;
+    // Сколько устройств писатель осматривает за один вызов maintain.
+    static constexpr size_t MAINTAIN_VISITS = 4096;
+
+    ~HistoryStore() { release(); }
+
+    // Только до запуска писателей. samples_per_device округляется вверх до
+    // целых блоков; 0 выключает историю.
+    void configure(uint32_t devices, size_t samples_per_device);
+    bool enabled() const { return chunks_per_device > 0; }
+
+    // Бюджет в байтах на кольца и сжатые данные, 0 — без ограничения.
+    // Пустой путь — без файла сброса. Только до запуска писателей.
+    bool set_budget(size_t bytes, const std::string& spill_path = {});
+    size_t budget() const { return budget_bytes; }
+    bool budgeted() const { return budget_bytes > 0; }
+
+    void append(uint32_t device, float value, uint64_t timestamp);
+
+    // Вызывается писателем шарда: вытесняет устройства шарда, пока память
+    // выше бюджета, и освобождает кольца, которые больше не читают.
+    void maintain(size_t shard, size_t shard_count);
+
+    uint32_t device_count() const { return devices_count; }
+    size_t chunk_count() const { return chunks_per_device; }
+    size_t capacity() const { return chunks_per_device * HistoryChunk::SAMPLES; }
+    uint64_t samples(uint32_t device) const { return devices[device].samples.load(std::memory_order_relaxed); }
+    uint64_t newest(uint32_t device) const { return devices[device].newest.load(std::memory_order_relaxed); }
+    // Метки устройства до сих пор не убывали: блоки упорядочены по времени.
+    bool ordered(uint32_t device) const { return devices[device].ordered.load(std::memory_order_relaxed); }
+    HistoryTier tier(uint32_t device) const { return devices[device].tier.load(std::memory_order_relaxed); }
+
+    // Кольца, включая ждущие освобождения, и сжатые данные в памяти.
+    size_t memory_bytes() const {
+        return resident_bytes.load(std::memory_order_relaxed) + compressed_bytes.load(std::memory_order_relaxed);
+    }
+    size_t compressed_memory_bytes() const { return compressed_bytes.load(std::memory_order_relaxed); }
+    uint64_t spill_file_bytes() const { return spill_end.load(std::memory_order_relaxed); }
+    size_t devices_in(HistoryTier tier) const { return tier_devices[static_cast<size_t>(tier)].load(std::memory_order_relaxed); }
+    uint64_t evictions(HistoryTier to) const { return evicted[static_cast<size_t>(to)].load(std::memory_order_relaxed); }
+    uint64_t page_ins(HistoryTier from) const { return paged_in[static_cast<size_t>(from)].load(std::memory_order_relaxed); }
+
+    uint64_t streamed_reads(HistoryTier from) const { return streamed[static_cast<size_t>(from)].load(std::memory_order_relaxed); }
+
+    // Обходит блоки устройства от нового к старому, пока fn возвращает true.
+    // Вытесненная история не возвращается в память, а распаковывается во
+    // временное кольцо потока: запрос по холодным устройствам не растит
+    // память сверх бюджета.
+    template <typename Fn>
+    void for_each_chunk(uint32_t device, Fn&& fn) const {
+        DeviceHistory& history = devices[device];
+        touch(history);
+        EpochDomain::Guard guard(epochs);
+        const HistoryRing* ring = history.ring.load(std::memory_order_seq_cst);
+        if (ring == nullptr) ring = stream_in(device);
+        if (ring == nullptr) return;
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > chunks_per_device ? head - chunks_per_device : 0;
+        for (uint64_t index = head; index > oldest; --index) {
+            if (!fn(ring->chunks[(index - 1) % chunks_per_device], static_cast<size_t>(index - 1 - oldest))) return;
+        }
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) DeviceHistory {
+        std::atomic<HistoryRing*> ring{nullptr};
+        std::atomic<uint64_t> newest{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<bool> ordered{true};
+        // Бит часов: устройство писали или читали с прошлого обхода.
+        std::atomic<bool> referenced{false};
+        std::atomic<HistoryTier> tier{HistoryTier::Empty};
+        // Смену уровня выполняют под этим флагом: вытесняет только писатель
+        // шарда, а вернуть в память может и запрос.
+        std::atomic<bool> locked{false};
+        uint32_t blob_size = 0;
+        uint32_t spill_capacity = 0;
+        uint8_t* blob = nullptr;
+        uint64_t spill_offset = 0;
+    };
+
+    struct Retired {
+        HistoryRing* ring;
+        uint64_t epoch;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) ShardState {
+        uint64_t cursor = 0;
+        std::vector<Retired> retired;
+        std::vector<uint8_t> scratch;
+    };
+
+    static void touch(DeviceHistory& history) {
+        if (!history.referenced.load(std::memory_order_relaxed)) {
+            history.referenced.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    static void lock(DeviceHistory& history);
+    static void unlock(DeviceHistory& history) { history.locked.store(false, std::memory_order_release); }
+
+    HistoryRing* allocate_ring() const;
+    void free_ring(HistoryRing* ring) const;
+    HistoryChunk* start_chunk(HistoryRing& ring);
+    void set_tier(DeviceHistory& history, HistoryTier tier) const;
+
+    void make_room(uint32_t device);
+    void page_in(uint32_t device);
+    const HistoryRing* stream_in(uint32_t device) const;
+    bool evict(uint32_t device, ShardState& shard);
+    void reclaim(ShardState& shard);
+    void release();
+
+    std::unique_ptr<DeviceHistory[]> devices;
+    uint32_t devices_count = 0;
+    size_t chunks_per_device = 0;
+    size_t budget_bytes = 0;
+    int spill_fd = -1;
+    std::unique_ptr<ShardState[]> shards;
+    // Число шардов писателей из последнего maintain: устройство
+    // принадлежит шарду device % writer_shards.
+    std::atomic<size_t> writer_shards{0};
+
+    mutable EpochDomain epochs;
+    mutable std::atomic<size_t> resident_bytes{0};
+    mutable std::atomic<size_t> compressed_bytes{0};
+    mutable std::atomic<uint64_t> spill_end{0};
+    mutable std::atomic<size_t> tier_devices[HISTORY_TIER_COUNT] = {};
+    std::atomic<uint64_t> evicted[HISTORY_TIER_COUNT] = {};
+    std::atomic<uint64_t> paged_in[HISTORY_TIER_COUNT] = {};
+    mutable std::atomic<uint64_t> streamed[HISTORY_TIER_COUNT] = {};
+};
+
+extern HistoryStore history_store;
@@ -0,0 +1,312 @@
+#include "ingest_pipeline.hpp"
+#include "latency_histogram.hpp"
+#include "coarse_clock.hpp"
+#include <algorithm>
+#include <chrono>
+
+
+IngestPipeline ingest_pipeline;
+
+
+namespace {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+}
+
+
+IngestProducer::IngestProducer(IngestPipeline& pipeline, size_t shards, size_t ring_capacity)
+    : pipeline(pipeline), shards_attached(shards) {
+    rings.reserve(shards);
+    for (size_t i = 0; i < shards; ++i) {
+        rings.push_back(std::make_unique<SpscRing<IngestMessage>>(ring_capacity));
+    }
+}
+
+void IngestProducer::push(const IngestMessage& message) {
+    if (pipeline.device_limiter.enabled() && !admit_device(message.device_id)) {
+        return;
+    }
+    IngestMessage msg = message;
+    if (msg.received_ns == 0) {
+        msg.received_ns = arrival_ns;
+    }
+    // Пока устройство ждет места в кольце, более новый сэмпл заменяет
+    // ожидающий: так сохраняется порядок и /latest не откатывается назад.
+    if (held_count > 0 && is_held(msg.device_id)) {
+        held[msg.device_id] = msg;
+        pipeline.coalesced.add(1);
+        // Цикл событий сбрасывает производителя редко, поэтому ожидающие
+        // сэмплы периодически пробуют занять освободившееся место в кольцах.
+        if ((++held_pushes & 63) == 0) {
+            flush();
+        }
+        return;
+    }
+    size_t shard = pipeline.shard_of(msg.device_id);
+    SpscRing<IngestMessage>& ring = *rings[shard];
+
+    if (!ring.stage(msg)) {
+        if (pipeline.overload == OverloadPolicy::Coalesce) {
+            ring.publish();
+            pipeline.wake(shard);
+            hold(msg);
+            return;
+        }
+        uint64_t wait_start = stage_clock_ns();
+        do {
+            ring.publish();
+            pipeline.wake(shard);
+            std::this_thread::yield();
+        } while (!ring.stage(msg));
+        record_stage(Stage::QueueWait, stage_clock_ns() - wait_start);
+    }
+
+    if (ring.staged() >= IngestPipeline::PUBLISH_BATCH) {
+        ring.publish();
+        pipeline.wake(shard);
+    }
+}
+
+bool IngestProducer::admit_device(uint8_t device_id) {
+    uint32_t& credit = device_credit[device_id];
+    if (credit == 0) {
+        DeviceRateLimiter& limiter = pipeline.device_limiter;
+        credit = limiter.take(device_id, limiter.portion(), coarse_clock.monotonic_ns());
+        if (credit == 0) {
+            pipeline.throttled.add(1);
+            return false;
+        }
+    }
+    --credit;
+    return true;
+}
+
+void IngestProducer::hold(const IngestMessage& msg) {
+    if (!held) {
+        held = std::make_unique<IngestMessage[]>(DeviceRateLimiter::DEVICES);
+    }
+    held[msg.device_id] = msg;
+    held_mask[msg.device_id >> 6] |= 1ULL << (msg.device_id & 63);
+    if (held_count++ == 0) {
+        pipeline.overloaded.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void IngestProducer::drain_held() {
+    for (size_t word = 0; word < DeviceRateLimiter::DEVICES / 64; ++word) {
+        uint64_t bits = held_mask[word];
+        while (bits != 0) {
+            size_t device = word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+            bits &= bits - 1;
+            if (rings[pipeline.shard_of(static_cast<uint8_t>(device))]->stage(held[device])) {
+                held_mask[word] &= ~(1ULL << (device & 63));
+                --held_count;
+            }
+        }
+    }
+    if (held_count == 0) {
+        pipeline.overloaded.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void IngestProducer::flush() {
+    if (held_count > 0) {
+        drain_held();
+    }
+    for (size_t shard = 0; shard < rings.size(); ++shard) {
+        if (rings[shard]->staged() > 0) {
+            rings[shard]->publish();
+            pipeline.wake(shard);
+        }
+    }
+}
+
+void IngestProducer::close() {
+    flush();
+    // Не дождавшиеся места сэмплы считаются замещенными: писатели могут
+    // быть уже остановлены, ждать их нельзя.
+    if (held_count > 0) {
+        pipeline.coalesced.add(held_count);
+        held_count = 0;
+        std::fill(std::begin(held_mask), std::end(held_mask), 0);
+        pipeline.overloaded.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // После установки closed писатели могут удалить продюсер, поэтому число
+    // шардов и ссылка на конвейер запоминаются до нее.
+    size_t shard_count = rings.size();
+    IngestPipeline& owner = pipeline;
+    closed.store(true, std::memory_order_release);
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        owner.wake(shard);
+    }
+}
+
+
+IngestPipeline::~IngestPipeline() {
+    stop();
+}
+
+void IngestPipeline::start(size_t shard_count, ApplyFn apply) {
+    if (active.exchange(true)) return;
+
+    apply_fn = apply;
+    shard_count = std::max<size_t>(1, shard_count);
+    shards.clear();
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+        shards.back()->index = i;
+    }
+    for (auto& shard : shards) {
+        shard->writer = std::thread(&IngestPipeline::run_shard, this, std::ref(*shard));
+    }
+}
+
+void IngestPipeline::stop() {
+    if (!active.exchange(false)) return;
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        shards[i]->wakeup.notify_one();
+    }
+    for (auto& shard : shards) {
+        if (shard->writer.joinable()) {
+            shard->writer.join();
+        }
+    }
+}
+
+IngestProducer* IngestPipeline::register_producer() {
+    IngestProducer* producer = new IngestProducer(*this, shards.size(), RING_CAPACITY);
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->pending.push_back(producer);
+        shard->pending_version.fetch_add(1, std::memory_order_release);
+        shard->wakeup.notify_one();
+    }
+    return producer;
+}
+
+uint64_t IngestPipeline::applied_total() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard->applied.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void IngestPipeline::wake(size_t shard_index) {
+    Shard& shard = *shards[shard_index];
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.wakeup.notify_one();
+    }
+}
+
+void IngestPipeline::run_shard(Shard& shard) {
+    std::vector<IngestProducer*> producers;
+    uint64_t seen_version = 0;
+    size_t batch = MIN_DRAIN_BATCH;
+    unsigned idle_rounds = 0;
+    ApplyFn apply = apply_fn;
+    BatchHook hook = batch_hook;
+
+    auto detach = [](IngestProducer* producer) {
+        if (producer->shards_attached.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete producer;
+        }
+    };
+
+    auto has_work = [&]() {
+        for (IngestProducer* producer : producers) {
+            if (!producer->rings[shard.index]->empty() ||
+                producer->closed.load(std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return shard.pending_version.load(std::memory_order_acquire) != seen_version;
+    };
+
+    while (true) {
+        if (shard.pending_version.load(std::memory_order_acquire) != seen_version) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            seen_version = shard.pending_version.load(std::memory_order_relaxed);
+            producers.insert(producers.end(), shard.pending.begin(), shard.pending.end());
+            shard.pending.clear();
+        }
+
+        uint64_t drain_start = stage_clock_ns();
+        size_t applied = 0;
+        bool saturated = false;
+        for (size_t i = 0; i < producers.size();) {
+            IngestProducer* producer = producers[i];
+            bool closed = producer->closed.load(std::memory_order_acquire);
+            SpscRing<IngestMessage>& ring = *producer->rings[shard.index];
+
+            size_t n = ring.drain(batch, apply);
+            applied += n;
+            if (n == batch) {
+                saturated = true;
+            }
+
+            if (closed && ring.empty()) {
+                producers[i] = producers.back();
+                producers.pop_back();
+                detach(producer);
+                continue;
+            }
+            ++i;
+        }
+
+        if (applied > 0) {
+            record_stage(Stage::StoreUpdate, stage_clock_ns() - drain_start);
+            shard.applied.fetch_add(applied, std::memory_order_relaxed);
+        }
+        if (hook != nullptr) {
+            hook(shard.index, shards.size());
+        }
+
+        if (applied > 0) {
+            batch = saturated ? std::min(batch * 2, MAX_DRAIN_BATCH)
+                              : std::max(batch / 2, MIN_DRAIN_BATCH);
+            idle_rounds = 0;
+            continue;
+        }
+
+        if (!active.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        ++idle_rounds;
+        if (idle_rounds < 64) {
+            cpu_relax();
+            continue;
+        }
+        if (idle_rounds < 128) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_work() && active.load(std::memory_order_acquire)) {
+            shard.wakeup.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        shard.sleeping.store(false, std::memory_order_relaxed);
+        idle_rounds = 0;
+    }
+
+    for (IngestProducer* producer : producers) {
+        if (producer->closed.load(std::memory_order_acquire)) {
+            detach(producer);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "counters.hpp"
+#include "flow_control.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct IngestMessage {
+    uint64_t timestamp;
+    uint64_t received_ns = 0;
+    float value;
+    uint8_t device_id;
+};
+
+
+class IngestPipeline;
+
+
+class IngestProducer {
+public:
+    IngestProducer(const IngestProducer&) = delete;
+    IngestProducer& operator=(const IngestProducer&) = delete;
+
+    void push(const IngestMessage& msg);
+    void flush();
+    void set_arrival(uint64_t ns) { arrival_ns = ns; }
+    void close();
+
+private:
+    friend class IngestPipeline;
+
+    IngestProducer(IngestPipeline& pipeline, size_t shards, size_t ring_capacity);
+
+    bool admit_device(uint8_t device_id);
+    void hold(const IngestMessage& msg);
+    void drain_held();
+    bool is_held(uint8_t device_id) const { return (held_mask[device_id >> 6] >> (device_id & 63)) & 1; }
+
+    IngestPipeline& pipeline;
+    std::vector<std::unique_ptr<SpscRing<IngestMessage>>> rings;
+    std::atomic<bool> closed{false};
+    std::atomic<size_t> shards_attached;
+    uint64_t arrival_ns = 0;
+
+    // Остаток порции токенов каждого устройства.
+    uint32_t device_credit[DeviceRateLimiter::DEVICES] = {};
+    // При перегрузке здесь ждет последний сэмпл устройства, не поместившийся в кольцо.
+    std::unique_ptr<IngestMessage[]> held;
+    uint64_t held_mask[DeviceRateLimiter::DEVICES / 64] = {};
+    size_t held_count = 0;
+    uint64_t held_pushes = 0;
+};
+
+
+class IngestPipeline {
+public:
+    using ApplyFn = void (*)(const IngestMessage&);
+    // Вызывается писателем шарда между пачками, когда в шарде нет наполовину
+    // примененных сэмплов.
+    using BatchHook = void (*)(size_t shard, size_t shard_count);
+
+    static constexpr size_t RING_CAPACITY = 1024;
+    static constexpr size_t PUBLISH_BATCH = 64;
+    static constexpr size_t MIN_DRAIN_BATCH = 16;
+    static constexpr size_t MAX_DRAIN_BATCH = 1024;
+
+    IngestPipeline() = default;
+    ~IngestPipeline();
+
+    void start(size_t shard_count, ApplyFn apply);
+    void stop();
+
+    IngestProducer* register_producer();
+
+    size_t shard_count() const { return shards.size(); }
+    size_t shard_of(uint8_t device_id) const { return device_id % shards.size(); }
+    uint64_t applied_total() const;
+
+    // Настраиваются до запуска источников данных.
+    void set_batch_hook(BatchHook hook) { batch_hook = hook; }
+    void set_overload_policy(OverloadPolicy policy) { overload = policy; }
+    OverloadPolicy overload_policy() const { return overload; }
+    DeviceRateLimiter& device_limits() { return device_limiter; }
+
+    uint64_t throttled_total() const { return throttled.load(); }
+    uint64_t coalesced_total() const { return coalesced.load(); }
+    size_t overloaded_producers() const { return overloaded.load(std::memory_order_relaxed); }
+
+private:
+    friend class IngestProducer;
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        size_t index = 0;
+        std::thread writer;
+
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::vector<IngestProducer*> pending;
+        std::atomic<uint64_t> pending_version{0};
+
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> sleeping{false};
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> applied{0};
+    };
+
+    void run_shard(Shard& shard);
+    void wake(size_t shard_index);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    ApplyFn apply_fn = nullptr;
+    BatchHook batch_hook = nullptr;
+    std::atomic<bool> active{false};
+
+    OverloadPolicy overload = OverloadPolicy::Block;
+    DeviceRateLimiter device_limiter;
+    ShardedCounter throttled;
+    ShardedCounter coalesced;
+    std::atomic<size_t> overloaded{0};
+};
+
+extern IngestPipeline ingest_pipeline;
@@ -0,0 +1,450 @@
+#include "ingest_worker.hpp"
+#include "latency_histogram.hpp"
+#include "binary_message.hpp"
+#include "connection_limiter.hpp"
+#include "coarse_clock.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+static constexpr size_t READ_CHUNK = 16384;
+static constexpr size_t FRAME_SIZE = 14;
+// Полных чтений подряд, после которых соединение уступает ход остальным.
+static constexpr size_t READS_PER_TURN = 16;
+// Пауза перед повтором accept после ошибки вроде EMFILE: слушающий сокет
+// зарегистрирован по фронту, и соединения из очереди нового фронта не дадут.
+static constexpr uint64_t ACCEPT_RETRY_MS = 20;
+
+
+// Отказ без корутины и регистрации соединения: SO_LINGER с нулевым временем
+// закрывает сокет сбросом, не оставляя его в TIME_WAIT.
+static void reject_connection(int fd) {
+    linger reset{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    close(fd);
+}
+
+// Считает сэмплы кадра пачки для списания с корзины соединения; без
+// производителя сэмплы отбрасываются.
+struct CountingSink {
+    IngestProducer* producer;
+    uint64_t samples = 0;
+
+    void push(const IngestMessage& msg) {
+        ++samples;
+        if (producer != nullptr) producer->push(msg);
+    }
+};
+
+
+IngestWorker::IngestWorker(size_t index, int port, int backlog, int cpu, FrameIntegrity integrity)
+    : index(index), port(port), backlog(backlog), cpu(cpu), integrity(integrity) {}
+
+IngestWorker::~IngestWorker() {
+    stop();
+}
+
+bool IngestWorker::start() {
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Ошибка создания сокета" << std::endl;
+        return false;
+    }
+    
+    int opt = 1;
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        std::cerr << "Ошибка setsockopt" << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    
+    if (bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Ошибка привязки сокета" << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    
+    if (listen(listen_fd, backlog) < 0) {
+        std::cerr << "Ошибка listen" << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    
+    producer = ingest_pipeline.register_producer();
+    thread = std::thread(&IngestWorker::run, this);
+    return true;
+}
+
+void IngestWorker::stop() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void IngestWorker::run() {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            std::cerr << "Не удалось закрепить поток приема " << index
+                      << " за ядром " << cpu << std::endl;
+        }
+    }
+    
+    {
+        EventLoop loop;
+        if (loop.valid() && loop.watch(listen_fd, WATCH_READ)) {
+            loop.spawn(accept_loop(loop));
+            loop.run([this] { return !stopping.load(std::memory_order_relaxed); },
+                     [this] {
+                         producer->flush();
+                         capture.flush_if_due();
+                     });
+        }
+    }
+    capture.flush();
+    active.store(0, std::memory_order_relaxed);
+    
+    producer->close();
+    close(listen_fd);
+    listen_fd = -1;
+}
+
+Task<> IngestWorker::accept_loop(EventLoop& loop) {
+    LoopTimer backoff(loop);
+    while (true) {
+        sockaddr_in peer{};
+        socklen_t peer_len = sizeof(peer);
+        int client_socket = accept4(listen_fd, (sockaddr*)&peer, &peer_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                co_await loop.readable(listen_fd);
+                continue;
+            }
+            std::cerr << "Ошибка accept: " << std::strerror(errno) << std::endl;
+            co_await backoff.sleep_until(loop.now_ms() + ACCEPT_RETRY_MS);
+            continue;
+        }
+        Admission admission = connection_limiter.admit(ntohl(peer.sin_addr.s_addr));
+        if (admission != Admission::Accepted) {
+            (admission == Admission::GlobalLimit ? ingest_counters.rejected_global
+                                                 : ingest_counters.rejected_per_ip).add(1);
+            reject_connection(client_socket);
+            continue;
+        }
+        ingest_counters.connections_accepted.add(1);
+        loop.spawn(serve_connection(loop, client_socket, peer));
+    }
+}
+
+Task<> IngestWorker::serve_connection(EventLoop& loop, int fd, sockaddr_in peer) {
+    struct AdmissionGuard {
+        uint32_t source;
+        ~AdmissionGuard() { connection_limiter.release(source); }
+    } admission{ntohl(peer.sin_addr.s_addr)};
+    
+    // Бинарный протокол односторонний: сокет приема ждет только чтения.
+    AsyncSocket socket(loop, fd, WATCH_READ);
+    if (!socket.valid()) {
+        co_return;
+    }
+    
+    Connection conn;
+    char peer_ip[INET_ADDRSTRLEN] = "?";
+    inet_ntop(AF_INET, &peer.sin_addr, peer_ip, sizeof(peer_ip));
+    if (capture_writer.active()) {
+        conn.capture_id = capture_writer.next_connection_id();
+        capture.record(conn.capture_id, CaptureKind::Open, nullptr, 0);
+    }
+    char peer_name[sizeof(ConnectionStats::peer)];
+    std::snprintf(peer_name, sizeof(peer_name), "%s:%u", peer_ip, static_cast<unsigned>(ntohs(peer.sin_port)));
+    conn.stats = connection_registry.open(peer_name, index);
+    conn.flow.configure(options.connection_rate, options.connection_burst, coarse_clock.monotonic_ns());
+    accepted_total.fetch_add(1, std::memory_order_relaxed);
+    active.fetch_add(1, std::memory_order_relaxed);
+    
+    // Кадр корутины может быть уничтожен при остановке цикла, не дойдя до конца
+    // функции, поэтому закрытие соединения выполняется в деструкторе.
+    struct CloseGuard {
+        IngestWorker& worker;
+        Connection& conn;
+        ~CloseGuard() {
+            if (conn.capture_id != 0) {
+                worker.capture.record(conn.capture_id, CaptureKind::Close, nullptr, 0);
+            }
+            connection_registry.close(conn.stats);
+            worker.active.fetch_sub(1, std::memory_order_relaxed);
+        }
+    } guard{*this, conn};
+    
+    // Срок соединения продлевается на каждом чтении одной записью в таймер.
+    // Неполный кадр, который не сдвигается дольше frame_timeout_ms, считается
+    // медленной атакой (slow loris), даже если байты продолжают приходить.
+    uint64_t partial_since = 0;
+    bool slow_deadline = false;
+    auto rearm = [&](uint64_t now) {
+        uint64_t deadline = options.idle_timeout_ms > 0 ? now + options.idle_timeout_ms : UINT64_MAX;
+        slow_deadline = partial_since != 0 && options.frame_timeout_ms > 0 &&
+                        partial_since + options.frame_timeout_ms < deadline;
+        if (slow_deadline) {
+            deadline = partial_since + options.frame_timeout_ms;
+        }
+        if (deadline == UINT64_MAX) {
+            socket.cancel_deadline();
+        } else {
+            socket.expire_at(deadline);
+        }
+    };
+    rearm(loop.now_ms());
+    
+    // Чтение идет в общий буфер потока; в соединении остается только хвост
+    // неполного кадра, поэтому простаивающее соединение почти не занимает памяти.
+    LoopTimer pause(loop);
+    bool drained = false;
+    bool backlog = false;
+    size_t reads_in_turn = 0;
+    while (true) {
+        if (drained && !backlog) {
+            // Короткое чтение опустошило сокет: новое поступление данных даст
+            // свежий фронт epoll, лишний read() до EAGAIN не нужен.
+            co_await socket.readable();
+            drained = false;
+            reads_in_turn = 0;
+        } else if (++reads_in_turn > READS_PER_TURN) {
+            // Сокет, который не успевает опустеть, не должен занимать цикл:
+            // иначе остальные соединения и сброс производителя ждут.
+            co_await loop.yield();
+            reads_in_turn = 0;
+        }
+        if (socket.timed_out()) {
+            (slow_deadline ? ingest_counters.evicted_slow : ingest_counters.evicted_idle).add(1);
+            co_return;
+        }
+        size_t pending = conn.buffer.size();
+        if (scratch.size() < pending + READ_CHUNK) {
+            scratch.resize(pending + READ_CHUNK);
+        }
+        // После паузы сначала разбираются кадры, уже лежащие в буфере.
+        ssize_t bytes_read = 0;
+        uint64_t framing_start = stage_clock_ns();
+        if (!backlog) {
+            bytes_read = socket.try_read(scratch.data() + pending, READ_CHUNK);
+            if (bytes_read < 0 && AsyncSocket::would_block()) {
+                co_await socket.readable();
+                continue;
+            }
+            if (bytes_read <= 0) {
+                co_return;
+            }
+            drained = static_cast<size_t>(bytes_read) < READ_CHUNK;
+            
+            framing_start = stage_clock_ns();
+            record_stage(Stage::SocketRead, socket.last_read_ns());
+            producer->set_arrival(framing_start);
+            conn.stats->add_bytes(static_cast<uint64_t>(bytes_read));
+            if (conn.capture_id != 0) {
+                capture.record(conn.capture_id, CaptureKind::Data, scratch.data() + pending,
+                               static_cast<size_t>(bytes_read));
+            }
+        }
+        backlog = false;
+        if (pending > 0) {
+            std::memcpy(scratch.data(), conn.buffer.data(), pending);
+        }
+        size_t available = pending + static_cast<size_t>(bytes_read);
+        size_t offset = 0;
+        bool consumed = consume_frames(conn, scratch.data(), available, offset);
+        record_stage(Stage::Framing, stage_clock_ns() - framing_start);
+        if (!consumed) {
+            co_return;
+        }
+        
+        conn.buffer.assign(scratch.data() + offset, scratch.data() + available);
+        if (conn.buffer.empty() && conn.buffer.capacity() > READ_CHUNK) {
+            conn.buffer.shrink_to_fit();
+        }
+        
+        uint64_t now = loop.now_ms();
+        if (conn.buffer.empty()) {
+            partial_since = 0;
+        } else if (offset > 0 || partial_since == 0) {
+            partial_since = now;
+        }
+        
+        if (conn.paused) {
+            // Пока корзина пуста, сокет не читается: ядро перестает принимать
+            // данные, и окно TCP останавливает отправителя. Сроки простоя на
+            // время паузы снимаются, чтобы не закрыть ограниченное соединение.
+            conn.paused = false;
+            ingest_counters.flow_pauses.add(1);
+            socket.cancel_deadline();
+            uint64_t wait_ms = std::max<uint64_t>(1, (conn.flow.wait_ns() + 999999) / 1000000);
+            co_await pause.sleep_until(now + wait_ms);
+            now = loop.now_ms();
+            if (partial_since != 0) {
+                partial_since = now;
+            }
+            // Фронт готовности, пришедший во время паузы, потерян, поэтому
+            // следующий шаг читает сокет без ожидания.
+            backlog = !conn.buffer.empty();
+            drained = false;
+        }
+        rearm(now);
+    }
+}
+
+bool IngestWorker::consume_frames(Connection& conn, const uint8_t* data, size_t available, size_t& offset) {    
+    if (conn.flow.limited()) {
+        conn.flow.refill(coarse_clock.monotonic_ns());
+    }
+    bool drop = options.flow_policy == FlowPolicy::Drop;
+    
+    if (conn.protocol == Protocol::Unknown) {
+        Protocol fallback = integrity == FrameIntegrity::Crc32c ? Protocol::LegacyCrc32c : Protocol::Legacy;
+        size_t prefix = std::min(available, sizeof(PROTOCOL_HELLO));
+        uint8_t version = 0;
+        if (std::memcmp(data, PROTOCOL_HELLO, prefix) != 0) {
+            conn.protocol = fallback;
+        } else if (available < PROTOCOL_HELLO_SIZE) {
+            return true;
+        } else if (!parse_protocol_hello(data, version)) {
+            conn.protocol = fallback;
+        } else {
+            switch (version) {
+                case PROTOCOL_BATCH_V1: conn.protocol = Protocol::Batch; break;
+                case PROTOCOL_LEGACY_CRC32C: conn.protocol = Protocol::LegacyCrc32c; break;
+                default: conn.protocol = Protocol::BatchCrc32c; break;
+            }
+            offset = PROTOCOL_HELLO_SIZE;
+        }
+    }
+    
+    if (conn.protocol == Protocol::Legacy) {
+        size_t frames = (available - offset) / FRAME_SIZE;
+        size_t admitted = conn.flow.admit(frames);
+        process_frames(data + offset, admitted, *producer);
+        if (admitted < frames && drop) {
+            ingest_counters.flow_dropped.add(frames - admitted);
+            admitted = frames;
+        }
+        conn.paused = admitted < frames;
+        conn.stats->add_frames(admitted);
+        offset += admitted * FRAME_SIZE;
+        return true;
+    }
+    
+    if (conn.protocol == Protocol::LegacyCrc32c) {
+        while (available - offset >= CRC32C_FRAME_SIZE) {
+            if (conn.flow.admit(1) == 0) {
+                if (!drop) {
+                    conn.paused = true;
+                    return true;
+                }
+                ingest_counters.flow_dropped.add(1);
+                offset += CRC32C_FRAME_SIZE;
+                conn.stats->add_frames(1);
+                continue;
+            }
+            IngestMessage msg;
+            if (parse_crc32c_frame(data + offset, msg)) {
+                producer->push(msg);
+            } else {
+                ingest_counters.crc_failures.add(1);
+            }
+            offset += CRC32C_FRAME_SIZE;
+            conn.stats->add_frames(1);
+        }
+        return true;
+    }
+    
+    FrameIntegrity frame_integrity = conn.protocol == Protocol::BatchCrc32c ? FrameIntegrity::Crc32c
+                                                                            : FrameIntegrity::Xor;
+    while (offset < available) {
+        // Кадр пачки списывается целиком после разбора, баланс может уйти в минус.
+        bool throttled = conn.flow.exhausted();
+        if (throttled && !drop) {
+            conn.paused = true;
+            return true;
+        }
+        size_t consumed = 0;
+        CountingSink sink{throttled ? nullptr : producer};
+        FrameStatus status = decode_batch_frame(data + offset, available - offset, consumed,
+                                                sink, frame_integrity);
+        if (throttled) {
+            ingest_counters.flow_dropped.add(sink.samples);
+        } else if (conn.flow.limited()) {
+            conn.flow.charge(sink.samples);
+        }
+        if (status == FrameStatus::NeedMore) {
+            return true;
+        }
+        if (status == FrameStatus::Malformed) {
+            ingest_counters.protocol_errors.add(1);
+            return false;
+        }
+        if (status == FrameStatus::BadChecksum) {
+            ingest_counters.crc_failures.add(1);
+        }
+        conn.stats->add_frames(1);
+        offset += consumed;
+    }
+    return true;
+}
+
+bool IngestWorkerGroup::start(int port, size_t count, const std::vector<int>& cpus, int backlog,
+                              FrameIntegrity integrity) {
+    for (size_t i = 0; i < count; ++i) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        auto worker = std::make_unique<IngestWorker>(i, port, backlog, cpu, integrity);
+        if (!worker->start()) {
+            stop();
+            return false;
+        }
+        workers.push_back(std::move(worker));
+    }
+    return true;
+}
+
+void IngestWorkerGroup::stop() {
+    for (auto& worker : workers) {
+        worker->stop();
+    }
+    workers.clear();
+}
+
+uint64_t IngestWorkerGroup::accepted() const {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->accepted();
+    }
+    return total;
+}
+
+uint64_t IngestWorkerGroup::active_connections() const {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->active_connections();
+    }
+    return total;
+}
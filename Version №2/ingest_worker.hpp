@@ -0,0 +1,81 @@
+#pragma once
+#include "async_io.hpp"
+#include "batch_frame.hpp"
+#include "capture.hpp"
+#include "counters.hpp"
+#include "ingest_pipeline.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <netinet/in.h>
+#include <thread>
+#include <vector>
+
+
+class IngestWorker {
+public:
+    IngestWorker(size_t index, int port, int backlog, int cpu, FrameIntegrity integrity);
+    ~IngestWorker();
+
+    IngestWorker(const IngestWorker&) = delete;
+    IngestWorker& operator=(const IngestWorker&) = delete;
+
+    bool start();
+    void stop();
+
+    uint64_t accepted() const { return accepted_total.load(std::memory_order_relaxed); }
+    uint64_t active_connections() const { return active.load(std::memory_order_relaxed); }
+
+private:
+    enum class Protocol {
+        Unknown,
+        Legacy,
+        LegacyCrc32c,
+        Batch,
+        BatchCrc32c
+    };
+
+    struct Connection {
+        Protocol protocol = Protocol::Unknown;
+        std::vector<uint8_t> buffer;
+        ConnectionStats* stats = nullptr;
+        uint32_t capture_id = 0;
+        TokenBucket flow;
+        bool paused = false;
+    };
+
+    void run();
+    Task<> accept_loop(EventLoop& loop);
+    Task<> serve_connection(EventLoop& loop, int fd, sockaddr_in peer);
+    bool consume_frames(Connection& conn, const uint8_t* data, size_t available, size_t& consumed);
+
+    size_t index;
+    int port;
+    int backlog;
+    int cpu;
+    FrameIntegrity integrity;
+
+    int listen_fd = -1;
+    IngestProducer* producer = nullptr;
+    std::vector<uint8_t> scratch;
+    CaptureBuffer capture;
+
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> accepted_total{0};
+    std::atomic<uint64_t> active{0};
+};
+
+
+class IngestWorkerGroup {
+public:
+    bool start(int port, size_t workers, const std::vector<int>& cpus, int backlog,
+               FrameIntegrity integrity = FrameIntegrity::Xor);
+    void stop();
+
+    uint64_t accepted() const;
+    uint64_t active_connections() const;
+
+private:
+    std::vector<std::unique_ptr<IngestWorker>> workers;
+};
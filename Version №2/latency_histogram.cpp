@@ -0,0 +1,101 @@
+#include "latency_histogram.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+thread_local ThreadHistograms* thread_histograms = nullptr;
+
+
+namespace {
+
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadHistograms>> registry;
+std::vector<ThreadHistograms*> released;
+
+struct ThreadRelease {
+    ~ThreadRelease() {
+        if (thread_histograms != nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            released.push_back(thread_histograms);
+            thread_histograms = nullptr;
+        }
+    }
+};
+
+thread_local ThreadRelease thread_release;
+
+}
+
+
+uint64_t latency_percentile(const LatencyTotals& totals, uint64_t count, double p) {
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < totals.size(); ++i) {
+        seen += totals[i];
+        if (seen >= rank) {
+            return LatencyHistogram::bucket_upper(i);
+        }
+    }
+    return LatencyHistogram::bucket_upper(totals.size() - 1);
+}
+
+const char* stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::SocketRead: return "socket_read";
+        case Stage::Framing: return "framing";
+        case Stage::QueueWait: return "queue_wait";
+        case Stage::StoreUpdate: return "store_update";
+        case Stage::HttpParse: return "http_parse";
+        case Stage::Handler: return "handler";
+        case Stage::Serialize: return "serialize";
+        default: return "unknown";
+    }
+}
+
+ThreadHistograms* acquire_thread_histograms() {
+    (void)thread_release;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (!released.empty()) {
+        thread_histograms = released.back();
+        released.pop_back();
+    } else {
+        registry.push_back(std::make_unique<ThreadHistograms>());
+        thread_histograms = registry.back().get();
+    }
+    return thread_histograms;
+}
+
+LatencySummary latency_summary(Stage stage) {
+    LatencyTotals totals{};
+    uint64_t sum = 0;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& histograms : registry) {
+            const LatencyHistogram& histogram = histograms->stages[static_cast<size_t>(stage)];
+            histogram.merge_into(totals);
+            sum += histogram.sum();
+        }
+    }
+    LatencySummary summary = summarize_latency(totals);
+    summary.sum = sum;
+    return summary;
+}
+
+LatencySummary summarize_latency(const LatencyTotals& totals) {
+    LatencySummary summary;
+    for (size_t i = 0; i < totals.size(); ++i) {
+        if (totals[i] > 0) {
+            summary.count += totals[i];
+            summary.max = LatencyHistogram::bucket_upper(i);
+        }
+    }
+    if (summary.count == 0) {
+        return summary;
+    }
+    summary.p50 = latency_percentile(totals, summary.count, 0.50);
+    summary.p90 = latency_percentile(totals, summary.count, 0.90);
+    summary.p99 = latency_percentile(totals, summary.count, 0.99);
+    summary.p999 = latency_percentile(totals, summary.count, 0.999);
+    return summary;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+
+enum class Stage : uint8_t {
+    SocketRead,
+    Framing,
+    QueueWait,
+    StoreUpdate,
+    HttpParse,
+    Handler,
+    Serialize,
+    Count
+};
+
+static constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::Count);
+
+const char* stage_name(Stage stage);
+
+
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t OCTAVES = 40;
+    static constexpr size_t BUCKETS = (OCTAVES + 1) * SUB_BUCKETS;
+
+    static size_t bucket_of(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return static_cast<size_t>(ns);
+        int shift = 63 - __builtin_clzll(ns) - SUB_BUCKET_BITS;
+        size_t index = static_cast<size_t>(shift + 1) * SUB_BUCKETS + ((ns >> shift) & (SUB_BUCKETS - 1));
+        return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    static uint64_t bucket_upper(size_t index) {
+        if (index < SUB_BUCKETS) return index;
+        size_t shift = index / SUB_BUCKETS - 1;
+        uint64_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+        return lower + (uint64_t{1} << shift) - 1;
+    }
+
+    void record(uint64_t ns) {
+        std::atomic<uint64_t>& count = counts[bucket_of(ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_ns.store(sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    }
+
+    void merge_into(std::array<uint64_t, BUCKETS>& totals) const {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            totals[i] += counts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Точная сумма записанных значений: границы корзин для нее слишком грубы.
+    uint64_t sum() const { return sum_ns.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> sum_ns{0};
+};
+
+
+struct ThreadHistograms {
+    LatencyHistogram stages[STAGE_COUNT];
+};
+
+
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+
+using LatencyTotals = std::array<uint64_t, LatencyHistogram::BUCKETS>;
+
+
+extern thread_local ThreadHistograms* thread_histograms;
+
+ThreadHistograms* acquire_thread_histograms();
+LatencySummary latency_summary(Stage stage);
+LatencySummary summarize_latency(const LatencyTotals& totals);
+uint64_t latency_percentile(const LatencyTotals& totals, uint64_t count, double p);
+
+
+inline uint64_t stage_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void record_stage(Stage stage, uint64_t ns) {
+    ThreadHistograms* histograms = thread_histograms;
+    if (histograms == nullptr) {
+        histograms = acquire_thread_histograms();
+    }
+    histograms->stages[static_cast<size_t>(stage)].record(ns);
+}
+
+
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage) : stage(stage), start(stage_clock_ns()) {}
+    ~StageTimer() { record_stage(stage, stage_clock_ns() - start); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stage stage;
+    uint64_t start;
+};
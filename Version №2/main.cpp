@@ -1,8 +1,23 @@
 #include "binary_message.hpp"
+#include "config.hpp"
+#include "device_store.hpp"
+#include "capture.hpp"
+#include "freshness.hpp"
+#include "coarse_clock.hpp"
+#include "task_pool.hpp"
+#include "connection_limiter.hpp"
+#include "fleet_snapshot.hpp"
+#include "derived_metrics.hpp"
+#include "history_store.hpp"
 #include <iostream>
 #include <thread>
 #include <csignal>
 #include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <sys/socket.h>  
 #include <unistd.h>      
 
@@ -11,12 +26,6 @@ void signal_handler(int signal) {
     running = false;
     
     
-    if (binary_listen_socket >= 0) {
-        shutdown(binary_listen_socket, SHUT_RDWR);
-        close(binary_listen_socket);
-        binary_listen_socket = -1;
-    }
-    
     if (http_listen_socket >= 0) {
         shutdown(http_listen_socket, SHUT_RDWR);
         close(http_listen_socket);
@@ -24,30 +33,231 @@ void signal_handler(int signal) {
     }
 }
 
-int main() {
+// Писатель шарда на границе пачки собирает свою часть среза парка и
+// вытесняет холодную историю своих устройств.
+void batch_hook(size_t shard, size_t shard_count) {
+    fleet_snapshot_hook(shard, shard_count);
+    history_store.maintain(shard, shard_count);
+}
+
+// Пустое значение или false — без закрепления. Номера ядер вне
+// [0, cores) и за пределами cpu_set_t отвергаются.
+bool parse_cpu_list(const std::string& value, size_t workers, unsigned cores, std::vector<int>& cpus,
+                    std::string& error) {
+    cpus.clear();
+    if (value.empty() || value == "false") {
+        return true;
+    }
+    if (value == "true" || value == "auto") {
+        for (size_t i = 0; i < workers; ++i) {
+            cpus.push_back(static_cast<int>(i % cores));
+        }
+        return true;
+    }
+    unsigned limit = std::min<unsigned>(cores, CPU_SETSIZE);
+    std::istringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int cpu = -1;
+        auto result = std::from_chars(item.data(), item.data() + item.size(), cpu);
+        if (item.empty() || result.ec != std::errc() || result.ptr != item.data() + item.size()) {
+            error = "некорректный номер ядра в --cpu-affinity: " + item;
+            return false;
+        }
+        if (cpu < 0 || static_cast<unsigned>(cpu) >= limit) {
+            error = "ядро " + item + " в --cpu-affinity вне диапазона 0-" + std::to_string(limit - 1);
+            return false;
+        }
+        cpus.push_back(cpu);
+    }
+    return true;
+}
+
+void print_usage(const char* program_name) {
+    std::cout << "Использование: " << program_name << " [опции]\n";
+    std::cout << "Опции:\n";
+    std::cout << "  --ingest-shards=<n>      Число потоков-писателей хранилища (по умолчанию: число ядер)\n";
+    std::cout << "  --ingest-workers=<n>     Число потоков приема с SO_REUSEPORT (по умолчанию: число ядер)\n";
+    std::cout << "  --cpu-affinity=<list>    Закрепить потоки приема за ядрами: true или список 0,2,4\n";
+    std::cout << "  --listen-backlog=<n>     Очередь listen для бинарного порта (по умолчанию: 4096)\n";
+    std::cout << "  --crc32c-port=<port>     Порт для кадров с CRC-32C по умолчанию (по умолчанию: выключен)\n";
+    std::cout << "  --udp-port=<port>        Включить прием UDP датаграмм на порту (по умолчанию: выключен)\n";
+    std::cout << "  --udp-batch=<n>          Датаграмм за один вызов recvmmsg (по умолчанию: 64)\n";
+    std::cout << "  --shm-ingest=<name>      Принимать данные через разделяемую память, например /telemetry_ingest\n";
+    std::cout << "  --shm-rings=<n>          Число колец производителей в разделяемой памяти (по умолчанию: 16)\n";
+    std::cout << "  --shm-devices=<name>     Публиковать таблицу устройств в разделяемой памяти только для чтения\n";
+    std::cout << "  --capture=<file>         Записывать входящие бинарные потоки в файл для telemetry_replay\n";
+    std::cout << "  --freshness-sample=<n>   Измерять свежесть для каждого n-го сэмпла (по умолчанию: 16)\n";
+    std::cout << "  --freshness-alert-ms=<n> Порог предупреждения о задержке видимости, 0 - выключено\n";
+    std::cout << "  --device-lag-alert-ms=<n> Порог предупреждения об отставании от времени устройства, 0 - выключено\n";
+    std::cout << "  --clock-tick-us=<n>      Период обновления грубых часов в мкс (по умолчанию: 1000)\n";
+    std::cout << "  --pool-threads=<n>       Потоков общего пула задач (по умолчанию: число ядер)\n";
+    std::cout << "  --max-connections=<n>    Лимит бинарных соединений на все порты, 0 - без лимита\n";
+    std::cout << "  --max-connections-per-ip=<n> Лимит бинарных соединений с одного адреса, 0 - без лимита\n";
+    std::cout << "  --idle-timeout-ms=<n>    Закрывать соединение без данных дольше n мс (по умолчанию: 120000, 0 - выключено)\n";
+    std::cout << "  --frame-timeout-ms=<n>   Закрывать соединение, не дописавшее кадр за n мс (по умолчанию: 10000, 0 - выключено)\n";
+    std::cout << "  --connection-rate=<n>    Лимит сэмплов в секунду на бинарное соединение, 0 - без лимита\n";
+    std::cout << "  --connection-burst=<n>   Запас токенов соединения (по умолчанию: секундный лимит)\n";
+    std::cout << "  --device-rate=<n>        Лимит сэмплов в секунду на устройство, 0 - без лимита\n";
+    std::cout << "  --device-burst=<n>       Запас токенов устройства (по умолчанию: секундный лимит)\n";
+    std::cout << "  --flow-policy=<mode>     Превышение лимита соединения: pause (окно TCP) или drop\n";
+    std::cout << "  --overload=<mode>        Переполнение очереди хранилища: block (без потерь) или coalesce\n";
+    std::cout << "                           (хранить только последний сэмпл устройства, /latest остается свежим)\n";
+    std::cout << "  --snapshot-interval-ms=<n> Период среза парка для /devices и /metrics (по умолчанию: 10, 0 - выключено)\n";
+    std::cout << "  --derived=<bool>         Считать EWMA, скорость изменения и z-оценку для /device/{id}/derived (по умолчанию: true)\n";
+    std::cout << "  --ewma-alphas=<list>     Коэффициенты EWMA через запятую, до 4 (по умолчанию: 0.1,0.01)\n";
+    std::cout << "  --alerts=<rules>         Правила тревог через запятую: <метрика><op><порог>[/<сброс>][@<устройство>],\n";
+    std::cout << "                           метрика value, ewma<i>, rate или z, например value>80/75,z>3/2\n";
+    std::cout << "  --history=<n>            Хранить до n последних сэмплов устройства для /query (по умолчанию: 4096, 0 - выключено)\n";
+    std::cout << "  --history-budget-mb=<n>  Бюджет памяти истории, холодные устройства сжимаются и вытесняются (по умолчанию: 0 - без лимита)\n";
+    std::cout << "  --history-spill=<file>   Файл сброса вытесненной истории; без него история сверх бюджета отбрасывается\n";
+    std::cout << "  --query-threads=<n>      Потоков на один запрос /query (по умолчанию: потоков пула)\n";
+    std::cout << "  --log-samples=<bool>     Логировать каждое принятое сообщение (по умолчанию: true)\n";
+    std::cout << "  --help                   Показать эту справку\n";
+}
+
+int main(int argc, char* argv[]) {
     std::signal(SIGINT, signal_handler);
     std::signal(SIGTERM, signal_handler);
     
+    Config config;
+    if (!config.parse_args(argc, argv)) {
+        return 1;
+    }
+    
+    if (config.has("help") || config.has("h")) {
+        print_usage(argv[0]);
+        return 0;
+    }
+    
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    int shards = config.get_int("ingest-shards", 0);
+    options.ingest_shards = shards > 0 ? static_cast<size_t>(shards) : cores;
+    int workers = config.get_int("ingest-workers", 0);
+    options.ingest_workers = workers > 0 ? static_cast<size_t>(workers) : cores;
+    std::string affinity_error;
+    if (!parse_cpu_list(config.get_string("cpu-affinity"), options.ingest_workers, cores, options.cpu_affinity,
+                        affinity_error)) {
+        std::cerr << "Ошибка: " << affinity_error << std::endl;
+        return 1;
+    }
+    options.listen_backlog = config.get_int("listen-backlog", options.listen_backlog);
+    options.crc32c_port = config.get_int("crc32c-port", 0);
+    options.udp_port = config.get_int("udp-port", 0);
+    options.udp_batch = static_cast<size_t>(std::max(1, config.get_int("udp-batch", 64)));
+    options.shm_ingest = config.get_string("shm-ingest");
+    options.shm_rings = static_cast<uint32_t>(std::max(1, config.get_int("shm-rings", 16)));
+    options.shm_ring_capacity = static_cast<uint32_t>(
+        std::max(64, config.get_int("shm-ring-capacity", 65536)));
+    options.shm_devices = config.get_string("shm-devices");
+    options.capture_path = config.get_string("capture");
+    options.freshness_sample = static_cast<uint32_t>(std::max(1, config.get_int("freshness-sample", 16)));
+    options.freshness_alert_ms = static_cast<uint64_t>(std::max(0, config.get_int("freshness-alert-ms", 0)));
+    options.device_lag_alert_ms = static_cast<uint64_t>(std::max(0, config.get_int("device-lag-alert-ms", 0)));
+    freshness.configure(options.freshness_sample, options.freshness_alert_ms, options.device_lag_alert_ms);
+    options.clock_tick_us = std::max(10, config.get_int("clock-tick-us", 1000));
+    int pool_threads = config.get_int("pool-threads", 0);
+    options.pool_threads = pool_threads > 0 ? static_cast<size_t>(pool_threads) : cores;
+    options.max_connections = static_cast<uint64_t>(std::max(0, config.get_int("max-connections", 0)));
+    options.max_connections_per_ip = static_cast<uint32_t>(std::max(0, config.get_int("max-connections-per-ip", 0)));
+    options.idle_timeout_ms = static_cast<uint64_t>(std::max(0, config.get_int("idle-timeout-ms", 120000)));
+    options.frame_timeout_ms = static_cast<uint64_t>(std::max(0, config.get_int("frame-timeout-ms", 10000)));
+    connection_limiter.configure(options.max_connections, options.max_connections_per_ip);
+    options.connection_rate = std::max(0.0, config.get_double("connection-rate", 0));
+    options.connection_burst = std::max(0.0, config.get_double("connection-burst", 0));
+    options.device_rate = std::max(0.0, config.get_double("device-rate", 0));
+    options.device_burst = std::max(0.0, config.get_double("device-burst", 0));
+    options.flow_policy = config.get_string("flow-policy", "pause") == "drop" ? FlowPolicy::Drop : FlowPolicy::Pause;
+    options.overload_policy = config.get_string("overload", "block") == "coalesce" ? OverloadPolicy::Coalesce
+                                                                                   : OverloadPolicy::Block;
+    ingest_pipeline.set_overload_policy(options.overload_policy);
+    ingest_pipeline.device_limits().configure(options.device_rate, options.device_burst);
+    options.snapshot_interval_ms = static_cast<uint64_t>(std::max(0, config.get_int("snapshot-interval-ms", 10)));
+    fleet_snapshots.configure(options.snapshot_interval_ms);
+    std::vector<double> alphas;
+    std::vector<AlertRule> rules;
+    std::string derived_error;
+    if (!parse_alphas(config.get_string("ewma-alphas", "0.1,0.01"), alphas, derived_error) ||
+        !parse_alert_rules(config.get_string("alerts"), alphas.size(), rules, derived_error)) {
+        std::cerr << "Ошибка: " << derived_error << std::endl;
+        return 1;
+    }
+    derived_metrics.configure(alphas, rules);
+    derived_metrics.set_enabled(config.get_bool("derived", true));
+    options.history_samples = static_cast<size_t>(std::max(0, config.get_int("history", 4096)));
+    history_store.configure(MAX_DEVICES, options.history_samples);
+    options.history_budget_mb = static_cast<size_t>(std::max(0, config.get_int("history-budget-mb", 0)));
+    options.history_spill = config.get_string("history-spill");
+    if (!history_store.set_budget(options.history_budget_mb << 20, options.history_spill)) {
+        std::cerr << "Ошибка: не удалось открыть файл сброса истории " << options.history_spill << std::endl;
+        return 1;
+    }
+    if (fleet_snapshots.enabled() || history_store.budgeted()) {
+        ingest_pipeline.set_batch_hook(batch_hook);
+    }
+    int query_threads = config.get_int("query-threads", 0);
+    options.query_parallelism = query_threads > 0 ? static_cast<size_t>(query_threads) : options.pool_threads;
+    options.log_samples = config.get_bool("log-samples", true);
+    
     try {
         std::cout << "==========================================" << std::endl;
         std::cout << "Сервис телеметрии запускается" << std::endl;
         std::cout << "Бинарный порт: " << BINARY_PORT << std::endl;
         std::cout << "HTTP порт: " << HTTP_PORT << std::endl;
+        std::cout << "Шардов хранилища: " << options.ingest_shards << std::endl;
         std::cout << "==========================================" << std::endl;
         std::cout << std::endl;
         
+        if (!options.shm_devices.empty()) {
+            if (device_store.publish(options.shm_devices)) {
+                std::cout << "Таблица устройств опубликована: " << options.shm_devices << std::endl;
+            }
+        }
+        coarse_clock.start(std::chrono::microseconds(options.clock_tick_us));
+        if (!options.capture_path.empty() && capture_writer.open(options.capture_path)) {
+            std::cout << "Захват входящих потоков: " << options.capture_path << std::endl;
+        }
+        derived_metrics.start_notifier();
+        ingest_pipeline.start(options.ingest_shards, apply_message);
+        task_pool.start(options.pool_threads);
+        
         std::thread binary_thread(BynaryServer);
         std::thread http_thread(HTTP_server);
+        std::thread udp_thread;
+        if (options.udp_port > 0) {
+            udp_thread = std::thread(UdpServer);
+        }
+        std::thread shm_thread;
+        if (!options.shm_ingest.empty()) {
+            shm_thread = std::thread(ShmServer);
+        }
         
         std::cout << "Серверы запущены. Используйте Ctrl+C для остановки." << std::endl;
         std::cout << std::endl;
         std::cout << "Доступные HTTP эндпоинты:" << std::endl;
         std::cout << "  GET /device/{id}/latest  - последнее значение устройства" << std::endl;
         std::cout << "  GET /device/{id}/stats   - статистика по устройству" << std::endl;
+        std::cout << "  GET /device/{id}/derived - EWMA, скорость изменения, z-оценка и тревоги" << std::endl;
+        std::cout << "  GET /devices             - список активных устройств" << std::endl;
+        std::cout << "  GET /query?devices=10-40&from=-30000&where=value>5&agg=avg,max&group=device" << std::endl;
+        std::cout << "                           - выборка по истории нескольких устройств" << std::endl;
+        std::cout << "  GET /metrics             - счетчики сервиса" << std::endl;
         std::cout << std::endl;
 
         binary_thread.join();
         http_thread.join();
+        if (udp_thread.joinable()) {
+            udp_thread.join();
+        }
+        if (shm_thread.joinable()) {
+            shm_thread.join();
+        }
+        task_pool.stop();
+        ingest_pipeline.stop();
+        derived_metrics.stop_notifier();
+        device_store.unpublish();
+        capture_writer.close();
+        coarse_clock.stop();
         
         std::cout << "Сервис телеметрии завершил работу." << std::endl;
         
@@ -0,0 +1,568 @@
+#include "query_engine.hpp"
+#include "task_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TELEMETRY_X86 1
+#endif
+
+
+namespace {
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void url_decode(std::string_view text, std::string& out) {
+    out.clear();
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            out += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() && hex_digit(text[i + 1]) >= 0 && hex_digit(text[i + 2]) >= 0) {
+            out += static_cast<char>(hex_digit(text[i + 1]) * 16 + hex_digit(text[i + 2]));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+}
+
+template <typename Fn>
+bool for_each_item(std::string_view list, char separator, Fn&& fn) {
+    while (true) {
+        size_t end = list.find(separator);
+        if (!fn(list.substr(0, end))) return false;
+        if (end == std::string_view::npos) return true;
+        list.remove_prefix(end + 1);
+    }
+}
+
+template <typename T>
+bool parse_number(std::string_view text, T& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+bool parse_devices(std::string_view list, uint32_t device_count, std::vector<uint32_t>& devices) {
+    static thread_local std::vector<bool> selected;
+    selected.assign(device_count, false);
+    bool ok = for_each_item(list, ',', [&](std::string_view item) {
+        size_t dash = item.find('-');
+        uint32_t first = 0;
+        uint32_t last = 0;
+        if (dash == std::string_view::npos) {
+            if (!parse_number(item, first)) return false;
+            last = first;
+        } else if (!parse_number(item.substr(0, dash), first) || !parse_number(item.substr(dash + 1), last)) {
+            return false;
+        }
+        if (first > last || last >= device_count) return false;
+        std::fill(selected.begin() + first, selected.begin() + last + 1, true);
+        return true;
+    });
+    if (!ok) return false;
+    devices.clear();
+    for (uint32_t id = 0; id < device_count; ++id) {
+        if (selected[id]) devices.push_back(id);
+    }
+    return true;
+}
+
+// Значения хранятся во float, поэтому строгое сравнение с порогом сводится
+// к нестрогому с соседним float.
+float lower_bound_for(double threshold, bool strict) {
+    float bound = static_cast<float>(threshold);
+    if (bound < threshold || (strict && bound == threshold)) {
+        bound = std::nextafter(bound, std::numeric_limits<float>::infinity());
+    }
+    return bound;
+}
+
+float upper_bound_for(double threshold, bool strict) {
+    float bound = static_cast<float>(threshold);
+    if (bound > threshold || (strict && bound == threshold)) {
+        bound = std::nextafter(bound, -std::numeric_limits<float>::infinity());
+    }
+    return bound;
+}
+
+bool parse_condition(std::string_view condition, QueryRequest& request) {
+    static constexpr std::string_view metric = "value";
+    if (!condition.starts_with(metric)) return false;
+    condition.remove_prefix(metric.size());
+    std::string_view op = condition.substr(0, condition.size() > 1 && condition[1] == '=' ? 2 : 1);
+    double threshold = 0;
+    if (!parse_number(condition.substr(op.size()), threshold) || std::isnan(threshold)) return false;
+
+    float lower = -std::numeric_limits<float>::infinity();
+    float upper = std::numeric_limits<float>::infinity();
+    if (op == ">") {
+        lower = lower_bound_for(threshold, true);
+    } else if (op == ">=") {
+        lower = lower_bound_for(threshold, false);
+    } else if (op == "<") {
+        upper = upper_bound_for(threshold, true);
+    } else if (op == "<=") {
+        upper = upper_bound_for(threshold, false);
+    } else if (op == "=" || op == "==") {
+        lower = lower_bound_for(threshold, false);
+        upper = upper_bound_for(threshold, false);
+    } else {
+        return false;
+    }
+    request.min_value = std::max(request.min_value, lower);
+    request.max_value = std::min(request.max_value, upper);
+    return true;
+}
+
+bool parse_aggregates(std::string_view list, uint32_t& aggregates) {
+    aggregates = 0;
+    return for_each_item(list, ',', [&](std::string_view name) {
+        if (name == "count") {
+            aggregates |= QUERY_COUNT;
+        } else if (name == "sum") {
+            aggregates |= QUERY_SUM;
+        } else if (name == "avg") {
+            aggregates |= QUERY_AVG;
+        } else if (name == "min") {
+            aggregates |= QUERY_MIN;
+        } else if (name == "max") {
+            aggregates |= QUERY_MAX;
+        } else {
+            return false;
+        }
+        return true;
+    });
+}
+
+}
+
+
+bool parse_query(std::string_view query, uint32_t device_count, QueryRequest& request, std::string& error) {
+    // Список устройств и буферы разбора сохраняют емкость между запросами,
+    // поэтому повторный запрос не выделяет память.
+    std::vector<uint32_t> devices = std::move(request.devices);
+    devices.clear();
+    request = QueryRequest{};
+    request.devices = std::move(devices);
+    error.clear();
+    bool has_devices = false;
+    static thread_local std::string value;
+    bool ok = query.empty() || for_each_item(query, '&', [&](std::string_view param) {
+        size_t equals = param.find('=');
+        std::string_view key = param.substr(0, equals);
+        url_decode(equals == std::string_view::npos ? std::string_view() : param.substr(equals + 1), value);
+        if (key.empty()) return true;
+        if (key == "devices") {
+            has_devices = true;
+            if (!parse_devices(value, device_count, request.devices)) {
+                char limit[16];
+                error = "devices: expected ids or ranges like 10-40,50 below ";
+                error.append(limit, std::to_chars(limit, limit + sizeof(limit), device_count).ptr);
+                return false;
+            }
+        } else if (key == "from" || key == "to") {
+            int64_t& bound = key == "from" ? request.from : request.to;
+            if (!parse_number(std::string_view(value), bound)) {
+                error.assign(key);
+                error += ": expected an integer timestamp, negative is relative to the newest";
+                return false;
+            }
+            (key == "from" ? request.has_from : request.has_to) = true;
+        } else if (key == "where") {
+            if (!for_each_item(value, ',', [&](std::string_view condition) { return parse_condition(condition, request); })) {
+                error = "where: expected conditions like value>5,value<=10";
+                return false;
+            }
+        } else if (key == "agg") {
+            if (!parse_aggregates(value, request.aggregates) || request.aggregates == 0) {
+                error = "agg: expected a list of count, sum, avg, min, max";
+                return false;
+            }
+        } else if (key == "group") {
+            if (value != "device" && value != "none") {
+                error = "group: expected device or none";
+                return false;
+            }
+            request.by_device = value == "device";
+        } else {
+            error = "unknown parameter, use devices, from, to, where, agg, group";
+            return false;
+        }
+        return true;
+    });
+    if (!ok) return false;
+    if (!has_devices) {
+        request.devices.resize(device_count);
+        for (uint32_t id = 0; id < device_count; ++id) request.devices[id] = id;
+    }
+    return true;
+}
+
+
+QueryPartial scan_samples_scalar(const uint64_t* timestamps, const float* values, size_t count,
+                                 const QueryBounds& bounds) {
+    QueryPartial partial;
+    for (size_t i = 0; i < count; ++i) {
+        float value = values[i];
+        bool keep = (timestamps[i] >= bounds.from) & (timestamps[i] <= bounds.to) &
+                    (value >= bounds.min_value) & (value <= bounds.max_value);
+        partial.count += keep;
+        partial.sum += keep ? value : 0.0f;
+        partial.min = keep && value < partial.min ? value : partial.min;
+        partial.max = keep && value > partial.max ? value : partial.max;
+    }
+    return partial;
+}
+
+
+#ifdef TELEMETRY_X86
+
+// Восемь сэмплов за шаг: метки сравниваются двумя векторами по четыре
+// (беззнаково, через сдвиг знакового бита), маски сжимаются до 32 бит и
+// складываются с маской значений. Сумма копится в double, как в скалярном ядре.
+__attribute__((target("avx2")))
+QueryPartial scan_samples_avx2(const uint64_t* timestamps, const float* values, size_t count,
+                               const QueryBounds& bounds) {
+    const __m256i sign = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+    const __m256i from = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(bounds.from)), sign);
+    const __m256i to = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(bounds.to)), sign);
+    const __m256 min_value = _mm256_set1_ps(bounds.min_value);
+    const __m256 max_value = _mm256_set1_ps(bounds.max_value);
+    const __m256 positive_inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 negative_inf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+
+    __m256i counts = _mm256_setzero_si256();
+    __m256d sum_low = _mm256_setzero_pd();
+    __m256d sum_high = _mm256_setzero_pd();
+    __m256 mins = positive_inf;
+    __m256 maxs = negative_inf;
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i ts_low = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(timestamps + i)), sign);
+        __m256i ts_high = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(timestamps + i + 4)), sign);
+        __m256i out_low = _mm256_or_si256(_mm256_cmpgt_epi64(from, ts_low), _mm256_cmpgt_epi64(ts_low, to));
+        __m256i out_high = _mm256_or_si256(_mm256_cmpgt_epi64(from, ts_high), _mm256_cmpgt_epi64(ts_high, to));
+        __m256 out = _mm256_shuffle_ps(_mm256_castsi256_ps(out_low), _mm256_castsi256_ps(out_high),
+                                       _MM_SHUFFLE(2, 0, 2, 0));
+        out = _mm256_castsi256_ps(_mm256_permute4x64_epi64(_mm256_castps_si256(out), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        __m256 v = _mm256_loadu_ps(values + i);
+        __m256 in_range = _mm256_and_ps(_mm256_cmp_ps(v, min_value, _CMP_GE_OQ), _mm256_cmp_ps(v, max_value, _CMP_LE_OQ));
+        __m256 keep = _mm256_andnot_ps(out, in_range);
+
+        counts = _mm256_sub_epi32(counts, _mm256_castps_si256(keep));
+        __m256 kept = _mm256_and_ps(keep, v);
+        sum_low = _mm256_add_pd(sum_low, _mm256_cvtps_pd(_mm256_castps256_ps128(kept)));
+        sum_high = _mm256_add_pd(sum_high, _mm256_cvtps_pd(_mm256_extractf128_ps(kept, 1)));
+        mins = _mm256_min_ps(mins, _mm256_blendv_ps(positive_inf, v, keep));
+        maxs = _mm256_max_ps(maxs, _mm256_blendv_ps(negative_inf, v, keep));
+    }
+
+    alignas(32) uint32_t count_lanes[8];
+    alignas(32) double sum_lanes[4];
+    alignas(32) float min_lanes[8];
+    alignas(32) float max_lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(count_lanes), counts);
+    _mm256_store_pd(sum_lanes, _mm256_add_pd(sum_low, sum_high));
+    _mm256_store_ps(min_lanes, mins);
+    _mm256_store_ps(max_lanes, maxs);
+
+    QueryPartial partial = scan_samples_scalar(timestamps + i, values + i, count - i, bounds);
+    for (size_t lane = 0; lane < 8; ++lane) {
+        partial.count += count_lanes[lane];
+        partial.min = std::min(partial.min, min_lanes[lane]);
+        partial.max = std::max(partial.max, max_lanes[lane]);
+    }
+    for (size_t lane = 0; lane < 4; ++lane) {
+        partial.sum += sum_lanes[lane];
+    }
+    return partial;
+}
+
+bool query_kernel_supported(QueryKernel kernel) {
+    return kernel == QueryKernel::Scalar || __builtin_cpu_supports("avx2");
+}
+
+#else
+
+QueryPartial scan_samples_avx2(const uint64_t* timestamps, const float* values, size_t count,
+                               const QueryBounds& bounds) {
+    return scan_samples_scalar(timestamps, values, count, bounds);
+}
+
+bool query_kernel_supported(QueryKernel kernel) {
+    return kernel == QueryKernel::Scalar;
+}
+
+#endif
+
+
+QueryKernel active_query_kernel() {
+    static const QueryKernel kernel = query_kernel_supported(QueryKernel::Avx2) ? QueryKernel::Avx2
+                                                                                 : QueryKernel::Scalar;
+    return kernel;
+}
+
+const char* query_kernel_name(QueryKernel kernel) {
+    return kernel == QueryKernel::Avx2 ? "avx2" : "scalar";
+}
+
+
+namespace {
+
+// Запрос без группировки делит устройства не больше чем на столько порций
+// (с округлением до двух раз больше).
+constexpr size_t QUERY_PORTIONS = 1024;
+
+struct ScanCounters {
+    uint64_t chunks_scanned = 0;
+    uint64_t chunks_skipped = 0;
+    uint64_t chunks_summarized = 0;
+    uint64_t samples_scanned = 0;
+};
+
+enum class ChunkAction {
+    Scan,
+    Skip,
+    Summarize,
+    Stop
+};
+
+// Блоки обходятся от нового к старому. Блок вне окна времени или отрезка
+// значений пропускается по зоне; если метки устройства не убывали, блок
+// целиком старше from означает, что старше и все остальные. Заполненный
+// блок, целиком попавший в условия, отдает итог из зоны без сканирования.
+QueryPartial scan_device(const HistoryStore& store, uint32_t device, const QueryBounds& bounds,
+                         const QueryExecution& execution, ScanCounters& counters) {
+    QueryPartial total;
+    if (device >= store.device_count() || store.samples(device) == 0) return total;
+    const bool pushdown = execution.pushdown;
+    // Устройство целиком старше окна не возвращается из вытеснения.
+    if (pushdown && store.newest(device) < bounds.from) return total;
+    const bool ordered = store.ordered(device);
+    const auto scan = execution.kernel == QueryKernel::Avx2 && query_kernel_supported(QueryKernel::Avx2)
+                          ? scan_samples_avx2
+                          : scan_samples_scalar;
+
+    store.for_each_chunk(device, [&](const HistoryChunk& chunk, size_t older) {
+        QueryPartial partial;
+        ChunkAction action = ChunkAction::Scan;
+        uint32_t samples = 0;
+        bool valid = chunk.read([&](uint32_t count) {
+            samples = count;
+            if (count == 0) {
+                action = ChunkAction::Skip;
+                return;
+            }
+            if (pushdown) {
+                uint64_t min_ts = chunk.min_timestamp.load(std::memory_order_relaxed);
+                uint64_t max_ts = chunk.max_timestamp.load(std::memory_order_relaxed);
+                float min_v = chunk.min_value.load(std::memory_order_relaxed);
+                float max_v = chunk.max_value.load(std::memory_order_relaxed);
+                if (max_ts < bounds.from) {
+                    action = ordered ? ChunkAction::Stop : ChunkAction::Skip;
+                    return;
+                }
+                if (min_ts > bounds.to || max_v < bounds.min_value || min_v > bounds.max_value) {
+                    action = ChunkAction::Skip;
+                    return;
+                }
+                double sum = chunk.sum.load(std::memory_order_relaxed);
+                if (chunk.full(count) && min_ts >= bounds.from && max_ts <= bounds.to &&
+                    min_v >= bounds.min_value && max_v <= bounds.max_value && !std::isnan(sum)) {
+                    partial.count = count;
+                    partial.sum = sum;
+                    partial.min = min_v;
+                    partial.max = max_v;
+                    action = ChunkAction::Summarize;
+                    return;
+                }
+            }
+            partial = scan(chunk.timestamps, chunk.values, count, bounds);
+        });
+        // Блок переиспользован во время чтения: его сэмплы уже вытеснены
+        // из истории, а новые пришли после начала запроса.
+        if (!valid) return true;
+
+        switch (action) {
+            case ChunkAction::Scan:
+                ++counters.chunks_scanned;
+                counters.samples_scanned += samples;
+                break;
+            case ChunkAction::Summarize:
+                ++counters.chunks_summarized;
+                break;
+            case ChunkAction::Skip:
+                ++counters.chunks_skipped;
+                break;
+            case ChunkAction::Stop:
+                counters.chunks_skipped += 1 + older;
+                return false;
+        }
+        total.merge(partial);
+        return true;
+    });
+    return total;
+}
+
+// Устройства делятся между вызывающим потоком и помощниками из пула через
+// общий счетчик. Помощник, запущенный после того, как вызывающий закрыл
+// задание, сразу выходит; закрытие и вход помощника упорядочены как у
+// Деккера, поэтому вызывающий ждет только начавших работу.
+struct QueryJob {
+    const HistoryStore* store;
+    QueryBounds bounds;
+    QueryExecution execution;
+    const std::vector<uint32_t>* devices;
+    // Устройств на одну порцию: при группировке по устройству по одному,
+    // иначе итог порции сливается сразу, и колонка частичных итогов не
+    // растет с числом устройств. Порции сливаются по порядку, поэтому
+    // сумма не зависит от того, какой поток считал порцию.
+    size_t batch = 1;
+    std::vector<QueryPartial> partials;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> running{0};
+    std::atomic<bool> closed{true};
+    std::atomic<uint64_t> chunks_scanned{0};
+    std::atomic<uint64_t> chunks_skipped{0};
+    std::atomic<uint64_t> chunks_summarized{0};
+    std::atomic<uint64_t> samples_scanned{0};
+    // Владельцы: кэш потока, выполняющего запрос, и каждая отправленная
+    // задача помощника, которая может начаться и после конца запроса.
+    std::atomic<size_t> refs{1};
+};
+
+void release_job(QueryJob* job) {
+    if (job->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete job;
+    }
+}
+
+void drain(QueryJob& job) {
+    ScanCounters counters;
+    size_t total = job.partials.size();
+    for (size_t index = job.next.fetch_add(1, std::memory_order_relaxed); index < total;
+         index = job.next.fetch_add(1, std::memory_order_relaxed)) {
+        size_t begin = index * job.batch;
+        size_t end = std::min(begin + job.batch, job.devices->size());
+        QueryPartial partial;
+        for (size_t i = begin; i < end; ++i) {
+            partial.merge(scan_device(*job.store, (*job.devices)[i], job.bounds, job.execution, counters));
+        }
+        job.partials[index] = partial;
+    }
+    job.chunks_scanned.fetch_add(counters.chunks_scanned, std::memory_order_relaxed);
+    job.chunks_skipped.fetch_add(counters.chunks_skipped, std::memory_order_relaxed);
+    job.chunks_summarized.fetch_add(counters.chunks_summarized, std::memory_order_relaxed);
+    job.samples_scanned.fetch_add(counters.samples_scanned, std::memory_order_relaxed);
+}
+
+void help(QueryJob* job) {
+    job->running.fetch_add(1, std::memory_order_seq_cst);
+    if (!job->closed.load(std::memory_order_seq_cst)) {
+        drain(*job);
+    }
+    job->running.fetch_sub(1, std::memory_order_release);
+    release_job(job);
+}
+
+// Задание одно на поток и переиспользуется, а колонка частичных итогов
+// сохраняет емкость. Между запросами задание закрыто: опоздавший помощник
+// прошлого запроса видит closed и выходит, не трогая поля, а после открытия
+// помогает уже новому запросу. Задачи помощников захватывают только
+// указатель, поэтому std::function хранит их без кучи.
+QueryJob* acquire_job() {
+    struct Cache {
+        QueryJob* job = nullptr;
+        ~Cache() {
+            if (job != nullptr) release_job(job);
+        }
+    };
+    static thread_local Cache cache;
+    if (cache.job == nullptr) {
+        cache.job = new QueryJob;
+    }
+    QueryJob& job = *cache.job;
+    job.next.store(0, std::memory_order_relaxed);
+    job.chunks_scanned.store(0, std::memory_order_relaxed);
+    job.chunks_skipped.store(0, std::memory_order_relaxed);
+    job.chunks_summarized.store(0, std::memory_order_relaxed);
+    job.samples_scanned.store(0, std::memory_order_relaxed);
+    return cache.job;
+}
+
+uint64_t resolve(int64_t bound, uint64_t newest) {
+    if (bound >= 0) return static_cast<uint64_t>(bound);
+    uint64_t offset = static_cast<uint64_t>(-(bound + 1)) + 1;
+    return offset > newest ? 0 : newest - offset;
+}
+
+}
+
+
+void run_query(const HistoryStore& store, const QueryRequest& request, QueryResult& result,
+               const QueryExecution& execution) {
+    std::vector<QueryGroup> groups = std::move(result.groups);
+    groups.clear();
+    result = QueryResult{};
+    result.groups = std::move(groups);
+    result.devices = request.devices.size();
+
+    uint64_t newest = 0;
+    for (uint32_t device : request.devices) {
+        if (device < store.device_count()) newest = std::max(newest, store.newest(device));
+    }
+    if (request.has_from) result.bounds.from = resolve(request.from, newest);
+    if (request.has_to) result.bounds.to = resolve(request.to, newest);
+    result.bounds.min_value = request.min_value;
+    result.bounds.max_value = request.max_value;
+    if (!store.enabled()) {
+        if (!request.by_device) result.groups.push_back({0, QueryPartial{}});
+        return;
+    }
+
+    QueryJob* job = acquire_job();
+    job->store = &store;
+    job->bounds = result.bounds;
+    job->execution = execution;
+    job->devices = &request.devices;
+    job->batch = request.by_device ? 1 : std::max<size_t>(1, request.devices.size() / QUERY_PORTIONS);
+    job->partials.assign((request.devices.size() + job->batch - 1) / job->batch, QueryPartial{});
+    job->closed.store(false, std::memory_order_seq_cst);
+
+    size_t helpers = std::min({execution.parallelism > 0 ? execution.parallelism - 1 : 0,
+                               task_pool.threads(), job->partials.size() / 2});
+    for (size_t i = 0; i < helpers; ++i) {
+        job->refs.fetch_add(1, std::memory_order_relaxed);
+        task_pool.submit(TaskPriority::Low, [job] { help(job); });
+    }
+    drain(*job);
+    job->closed.store(true, std::memory_order_seq_cst);
+    while (job->running.load(std::memory_order_seq_cst) > 0) {
+        std::this_thread::yield();
+    }
+
+    result.chunks_scanned = job->chunks_scanned.load(std::memory_order_relaxed);
+    result.chunks_skipped = job->chunks_skipped.load(std::memory_order_relaxed);
+    result.chunks_summarized = job->chunks_summarized.load(std::memory_order_relaxed);
+    result.samples_scanned = job->samples_scanned.load(std::memory_order_relaxed);
+    if (request.by_device) {
+        for (size_t i = 0; i < request.devices.size(); ++i) {
+            if (job->partials[i].count > 0) result.groups.push_back({request.devices[i], job->partials[i]});
+        }
+    } else {
+        QueryPartial total;
+        for (const QueryPartial& partial : job->partials) total.merge(partial);
+        result.groups.push_back({0, total});
+    }
+}
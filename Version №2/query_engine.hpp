@@ -0,0 +1,104 @@
+#pragma once
+#include "history_store.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+static constexpr uint32_t QUERY_COUNT = 1;
+static constexpr uint32_t QUERY_SUM = 2;
+static constexpr uint32_t QUERY_AVG = 4;
+static constexpr uint32_t QUERY_MIN = 8;
+static constexpr uint32_t QUERY_MAX = 16;
+
+
+// Запрос /query?devices=10-40&from=-30000&where=value>5&agg=avg,max&group=device.
+// Отрицательные from и to отсчитываются от самой свежей метки выбранных
+// устройств. Условия where складываются через И и сводятся к отрезку значений.
+struct QueryRequest {
+    std::vector<uint32_t> devices;
+    int64_t from = 0;
+    int64_t to = 0;
+    bool has_from = false;
+    bool has_to = false;
+    float min_value = -std::numeric_limits<float>::infinity();
+    float max_value = std::numeric_limits<float>::infinity();
+    uint32_t aggregates = QUERY_COUNT | QUERY_AVG;
+    bool by_device = false;
+};
+
+// Без devices выбираются все устройства истории.
+bool parse_query(std::string_view query, uint32_t device_count, QueryRequest& request, std::string& error);
+
+
+// Границы после разрешения относительного времени, все включительно.
+struct QueryBounds {
+    uint64_t from = 0;
+    uint64_t to = std::numeric_limits<uint64_t>::max();
+    float min_value = -std::numeric_limits<float>::infinity();
+    float max_value = std::numeric_limits<float>::infinity();
+};
+
+struct QueryPartial {
+    uint64_t count = 0;
+    double sum = 0;
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+
+    void merge(const QueryPartial& other) {
+        count += other.count;
+        sum += other.sum;
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+};
+
+
+enum class QueryKernel {
+    Scalar,
+    Avx2
+};
+
+// Ядро сканирования без ветвлений: фильтр по метке и значению и агрегаты
+// за один проход по колонкам.
+QueryPartial scan_samples_scalar(const uint64_t* timestamps, const float* values, size_t count,
+                                 const QueryBounds& bounds);
+QueryPartial scan_samples_avx2(const uint64_t* timestamps, const float* values, size_t count,
+                               const QueryBounds& bounds);
+
+bool query_kernel_supported(QueryKernel kernel);
+QueryKernel active_query_kernel();
+const char* query_kernel_name(QueryKernel kernel);
+
+
+struct QueryExecution {
+    QueryKernel kernel = active_query_kernel();
+    // Пропуск блоков по зонам. Выключается только для сравнения в бенчмарке.
+    bool pushdown = true;
+    // Сколько потоков, считая вызывающий, делят устройства. Помощники
+    // берутся из общего пула задач с низким приоритетом.
+    size_t parallelism = 1;
+};
+
+struct QueryGroup {
+    uint32_t device_id;
+    QueryPartial partial;
+};
+
+// С группировкой — группа на каждое устройство с сэмплами в выборке,
+// без нее — одна общая группа.
+struct QueryResult {
+    QueryBounds bounds;
+    size_t devices = 0;
+    std::vector<QueryGroup> groups;
+    uint64_t chunks_scanned = 0;
+    uint64_t chunks_skipped = 0;
+    uint64_t chunks_summarized = 0;
+    uint64_t samples_scanned = 0;
+};
+
+void run_query(const HistoryStore& store, const QueryRequest& request, QueryResult& result,
+               const QueryExecution& execution = {});
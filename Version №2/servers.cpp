@@ -1,4 +1,21 @@
 #include "binary_message.hpp"
+#include "encoding.hpp"
+#include "device_store.hpp"
+#include "ingest_worker.hpp"
+#include "udp_listener.hpp"
+#include "shm_ingest_server.hpp"
+#include "latency_histogram.hpp"
+#include "capture.hpp"
+#include "freshness.hpp"
+#include "async_io.hpp"
+#include "task_pool.hpp"
+#include "slab_pool.hpp"
+#include "connection_limiter.hpp"
+#include "fleet_snapshot.hpp"
+#include "coarse_clock.hpp"
+#include "history_store.hpp"
+#include "query_engine.hpp"
+#include <cerrno>
 #include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -7,90 +24,799 @@
 #include <cstring>
 #include <thread>
 #include <vector>
-#include <regex>
-#include <sstream>
-#include <iomanip>
+#include <bit>
+#include <charconv>
+#include <cstdio>
+#include <type_traits>
 #include <algorithm>
+#include <chrono>
+#include <string_view>
+
+static void write_response(std::string& response, const char* status, const char* type, const std::string& body) {
+    response.clear();
+    // Резерв до степени двойки: ответ чуть длиннее прошлого не
+    // перевыделяет строку, а емкость не уходит дальше удвоения.
+    response.reserve(std::bit_ceil(64 + std::strlen(status) + std::strlen(type) + body.size()));
+    response += "HTTP/1.1 ";
+    response += status;
+    response += "\r\nContent-Type: ";
+    response += type;
+    response += "\r\nContent-Length: ";
+    append_uint(response, body.size());
+    response += "\r\n\r\n";
+    response += body;
+}
+
+enum class HttpRoute {
+    Latest,
+    Stats,
+    Devices,
+    Metrics,
+    Derived,
+    Query,
+    Other,
+    Count
+};
+
+static constexpr size_t HTTP_ROUTE_COUNT = static_cast<size_t>(HttpRoute::Count);
+static const char* const HTTP_ROUTE_NAMES[HTTP_ROUTE_COUNT] = {"latest", "stats", "devices", "metrics", "derived", "query", "other"};
+static constexpr int HTTP_STATUSES[] = {200, 400, 404, 405, 500};
+static constexpr size_t HTTP_STATUS_COUNT = sizeof(HTTP_STATUSES) / sizeof(HTTP_STATUSES[0]);
+
+static ShardedCounter http_requests[HTTP_ROUTE_COUNT][HTTP_STATUS_COUNT];
+static ShardedCounter query_chunks_scanned;
+static ShardedCounter query_chunks_skipped;
+static ShardedCounter query_chunks_summarized;
+static ShardedCounter query_samples_scanned;
+
+static void count_http_request(HttpRoute route, const std::string& response) {
+    int status = response.size() > 12 ? std::atoi(response.c_str() + 9) : 500;
+    for (size_t i = 0; i < HTTP_STATUS_COUNT; ++i) {
+        if (HTTP_STATUSES[i] == status) {
+            http_requests[static_cast<size_t>(route)][i].add();
+            return;
+        }
+    }
+}
 
 void BynaryServer() {
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        std::cerr << "Ошибка создания сокета" << std::endl;
+    IngestWorkerGroup workers;
+    if (!workers.start(BINARY_PORT, options.ingest_workers, options.cpu_affinity,
+                       options.listen_backlog)) {
+        std::cerr << "Ошибка запуска бинарного сервера" << std::endl;
         return;
     }
     
-    binary_listen_socket = server_fd;
+    std::cout << "Бинарный сервер запущен на порту " << BINARY_PORT
+              << " (потоков приема: " << options.ingest_workers << ")" << std::endl;
     
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        std::cerr << "Ошибка setsockopt" << std::endl;
-        close(server_fd);
-        return;
+    IngestWorkerGroup crc32c_workers;
+    if (options.crc32c_port > 0) {
+        if (crc32c_workers.start(options.crc32c_port, options.ingest_workers, options.cpu_affinity,
+                                 options.listen_backlog, FrameIntegrity::Crc32c)) {
+            std::cout << "Бинарный сервер CRC-32C запущен на порту " << options.crc32c_port << std::endl;
+        } else {
+            std::cerr << "Ошибка запуска бинарного сервера CRC-32C" << std::endl;
+        }
     }
     
-    sockaddr_in address{};
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(BINARY_PORT);
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
     
-    if (bind(server_fd, (sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "Ошибка привязки сокета" << std::endl;
-        close(server_fd);
+    crc32c_workers.stop();
+    workers.stop();
+}
+
+void UdpServer() {
+    UdpListener listener(options.udp_port, options.udp_batch, options.udp_receive_buffer);
+    if (!listener.start()) {
+        std::cerr << "Ошибка запуска UDP сервера" << std::endl;
         return;
     }
     
-    if (listen(server_fd, 10) < 0) {
-        std::cerr << "Ошибка listen" << std::endl;
-        close(server_fd);
+    std::cout << "UDP сервер запущен на порту " << options.udp_port
+              << " (пачка recvmmsg: " << options.udp_batch << ")" << std::endl;
+    
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    
+    listener.stop();
+}
+
+void ShmServer() {
+    ShmIngestServer server(options.shm_ingest, options.shm_rings, options.shm_ring_capacity);
+    if (!server.start()) {
+        std::cerr << "Ошибка запуска приема через разделяемую память" << std::endl;
         return;
     }
     
-    std::cout << "Бинарный сервер запущен на порту " << BINARY_PORT << std::endl;
+    std::cout << "Прием через разделяемую память: " << options.shm_ingest
+              << " (колец: " << options.shm_rings << ")" << std::endl;
     
     while (running) {
-        sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
-        
-        int client_socket = accept(server_fd, (sockaddr*)&client_addr, &client_len);
-        if (client_socket < 0) {
-            if (running) {
-                std::cerr << "Ошибка accept" << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    
+    server.stop();
+}
+
+// Текстовый вывод метрик. Пишет прямо в тело ответа, которое сохраняет
+// емкость между запросами, поэтому /metrics не создает временных строк.
+// Числа с плавающей точкой выводятся как в std::ostream: %g с заданной
+// точностью.
+class TextWriter {
+public:
+    explicit TextWriter(std::string& out) : out(out) {}
+
+    void precision(int digits) { float_digits = digits; }
+
+    TextWriter& operator<<(const char* text) {
+        out += text;
+        return *this;
+    }
+
+    TextWriter& operator<<(char c) {
+        out.push_back(c);
+        return *this;
+    }
+
+    template <typename T>
+        requires std::is_integral_v<T> && (!std::is_same_v<T, bool>) && (!std::is_same_v<T, char>)
+    TextWriter& operator<<(T value) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+        return *this;
+    }
+
+    TextWriter& operator<<(double value) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.*g", float_digits, value);
+        out.append(buffer, static_cast<size_t>(length));
+        return *this;
+    }
+
+private:
+    std::string& out;
+    int float_digits = 6;
+};
+
+static void write_summary_json(TextWriter& json, const LatencySummary& summary) {
+    json << "{\"count\": " << summary.count
+         << ", \"p50\": " << summary.p50
+         << ", \"p90\": " << summary.p90
+         << ", \"p99\": " << summary.p99
+         << ", \"p999\": " << summary.p999
+         << ", \"max\": " << summary.max << "}";
+}
+
+// Многоустройственные ответы берут список устройств и их счетчики из одного
+// среза парка. Без срезов список читается из хранилища напрямую.
+static void fleet_devices(const FleetSnapshot* snapshot, std::vector<uint8_t>& ids) {
+    if (snapshot != nullptr) {
+        ids.assign(snapshot->ids, snapshot->ids + snapshot->device_count);
+    } else {
+        device_store.active_devices(ids);
+    }
+}
+
+static uint64_t snapshot_age_ms(const FleetSnapshot& snapshot) {
+    uint64_t now = coarse_clock.wall_ms();
+    return now > snapshot.wall_ms ? now - snapshot.wall_ms : 0;
+}
+
+static void metrics_json(std::string& body, std::vector<uint8_t>& active) {
+    auto snapshot = fleet_snapshots.read();
+    fleet_devices(snapshot.get(), active);
+
+    TextWriter json(body);
+    json << "{\"total_samples\": " << ingest_pipeline.applied_total()
+         << ", \"active_devices\": " << active.size()
+         << ", \"crc_failures\": " << ingest_counters.crc_failures.load()
+         << ", \"protocol_errors\": " << ingest_counters.protocol_errors.load()
+         << ", \"udp_datagrams\": " << ingest_counters.udp_datagrams.load()
+         << ", \"udp_frames\": " << ingest_counters.udp_frames.load()
+         << ", \"udp_malformed\": " << ingest_counters.udp_malformed.load()
+         << ", \"udp_kernel_drops\": " << ingest_counters.udp_kernel_drops.load()
+         << ", \"capture_bytes\": " << capture_writer.written_bytes()
+         << ", \"capture_dropped_bytes\": " << capture_writer.dropped_bytes()
+         << ", \"connections\": {\"open\": " << connection_limiter.open()
+         << ", \"sources\": " << connection_limiter.sources()
+         << ", \"accepted\": " << ingest_counters.connections_accepted.load()
+         << ", \"rejected_global\": " << ingest_counters.rejected_global.load()
+         << ", \"rejected_per_ip\": " << ingest_counters.rejected_per_ip.load()
+         << ", \"evicted_idle\": " << ingest_counters.evicted_idle.load()
+         << ", \"evicted_slow\": " << ingest_counters.evicted_slow.load() << "}"
+         << ", \"flow\": {\"policy\": \"" << flow_policy_name(options.flow_policy) << "\""
+         << ", \"connection_dropped\": " << ingest_counters.flow_dropped.load()
+         << ", \"connection_pauses\": " << ingest_counters.flow_pauses.load()
+         << ", \"device_dropped\": " << ingest_pipeline.throttled_total()
+         << ", \"overload\": \"" << overload_policy_name(ingest_pipeline.overload_policy()) << "\""
+         << ", \"overloaded_producers\": " << ingest_pipeline.overloaded_producers()
+         << ", \"coalesced\": " << ingest_pipeline.coalesced_total() << "}"
+         << ", \"alerts\": {\"rules\": " << derived_metrics.rule_count()
+         << ", \"active\": " << derived_metrics.active()
+         << ", \"raised\": " << derived_metrics.raised()
+         << ", \"cleared\": " << derived_metrics.cleared()
+         << ", \"delivered\": " << derived_metrics.delivered()
+         << ", \"dropped\": " << derived_metrics.dropped() << "}"
+         << ", \"history\": {\"capacity\": " << history_store.capacity()
+         << ", \"budget_bytes\": " << history_store.budget()
+         << ", \"memory_bytes\": " << history_store.memory_bytes()
+         << ", \"compressed_bytes\": " << history_store.compressed_memory_bytes()
+         << ", \"spill_file_bytes\": " << history_store.spill_file_bytes()
+         << ", \"resident_devices\": " << history_store.devices_in(HistoryTier::Resident)
+         << ", \"compressed_devices\": " << history_store.devices_in(HistoryTier::Compressed)
+         << ", \"spilled_devices\": " << history_store.devices_in(HistoryTier::Spilled)
+         << ", \"evictions\": {\"compressed\": " << history_store.evictions(HistoryTier::Compressed)
+         << ", \"spilled\": " << history_store.evictions(HistoryTier::Spilled)
+         << ", \"discarded\": " << history_store.evictions(HistoryTier::Empty) << "}"
+         << ", \"page_ins\": {\"compressed\": " << history_store.page_ins(HistoryTier::Compressed)
+         << ", \"spilled\": " << history_store.page_ins(HistoryTier::Spilled) << "}"
+         << ", \"streamed\": {\"compressed\": " << history_store.streamed_reads(HistoryTier::Compressed)
+         << ", \"spilled\": " << history_store.streamed_reads(HistoryTier::Spilled) << "}"
+         << ", \"queries\": " << http_requests[static_cast<size_t>(HttpRoute::Query)][0].load()
+         << ", \"chunks_scanned\": " << query_chunks_scanned.load()
+         << ", \"chunks_skipped\": " << query_chunks_skipped.load()
+         << ", \"chunks_summarized\": " << query_chunks_summarized.load()
+         << ", \"samples_scanned\": " << query_samples_scanned.load() << "}";
+    if (snapshot) {
+        json << ", \"snapshot\": {\"version\": " << snapshot->version
+             << ", \"age_ms\": " << snapshot_age_ms(*snapshot)
+             << ", \"samples\": " << snapshot->samples_total
+             << ", \"devices\": " << snapshot->device_count
+             << ", \"latest_min\": " << snapshot->latest_min
+             << ", \"latest_max\": " << snapshot->latest_max
+             << ", \"latest_average\": " << snapshot->latest_average
+             << ", \"build_ns\": " << fleet_snapshots.build_ns()
+             << ", \"published\": " << fleet_snapshots.published()
+             << ", \"retired\": " << fleet_snapshots.retired() << "}";
+    }
+    json << ", \"latency_ns\": {";
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        Stage stage = static_cast<Stage>(i);
+        LatencySummary summary = latency_summary(stage);
+        json << (i > 0 ? ", " : "") << "\"" << stage_name(stage) << "\": ";
+        write_summary_json(json, summary);
+    }
+    json << "}, \"freshness_ns\": {\"visible\": ";
+    write_summary_json(json, freshness.visible(-1));
+    json << ", \"device_clock\": ";
+    write_summary_json(json, freshness.device(-1));
+    json << ", \"clock_ahead\": " << freshness.clock_ahead()
+         << ", \"alerts\": " << freshness.alerts()
+         << ", \"devices\": {";
+    for (size_t i = 0; i < active.size(); ++i) {
+        LatencySummary visible = freshness.visible(active[i]);
+        LatencySummary device = freshness.device(active[i]);
+        json << (i > 0 ? ", " : "") << "\"" << static_cast<int>(active[i]) << "\": {"
+             << "\"visible_p50\": " << visible.p50 << ", \"visible_p99\": " << visible.p99
+             << ", \"device_clock_p50\": " << device.p50 << ", \"device_clock_p99\": " << device.p99 << "}";
+    }
+    json << "}}";
+    TaskPool::Stats pool = task_pool.stats();
+    json << ", \"task_pool\": {\"threads\": " << pool.threads << ", \"steals\": " << pool.steals;
+    for (size_t level = 0; level < TASK_PRIORITY_COUNT; ++level) {
+        const char* name = task_priority_name(static_cast<TaskPriority>(level));
+        json << ", \"" << name << "\": {\"queued\": " << pool.queued[level]
+             << ", \"executed\": " << pool.executed[level] << "}";
+    }
+    json << "}"
+         << ", \"timestamp\": " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()
+         << "}";
+}
+
+static void prometheus_header(TextWriter& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+static void prometheus_freshness(TextWriter& out, const char* name, const char* labels,
+                                 const LatencySummary& summary, const char* kind) {
+    const std::pair<const char*, uint64_t> quantiles[] = {{"0.5", summary.p50}, {"0.99", summary.p99}};
+    for (const auto& [quantile, ns] : quantiles) {
+        out << name << '{' << labels << "kind=\"" << kind << "\",quantile=\"" << quantile << "\"} "
+            << static_cast<double>(ns) / 1e9 << '\n';
+    }
+    out << name << "_sum{" << labels << "kind=\"" << kind << "\"} " << static_cast<double>(summary.sum) / 1e9 << '\n';
+    out << name << "_count{" << labels << "kind=\"" << kind << "\"} " << summary.count << '\n';
+}
+
+static void metrics_prometheus(std::string& body, std::vector<uint8_t>& ids, std::vector<WorkerTraffic>& traffic) {
+    auto snapshot = fleet_snapshots.read();
+    fleet_devices(snapshot.get(), ids);
+
+    TextWriter out(body);
+    
+    prometheus_header(out, "telemetry_samples_total", "counter", "Samples applied to the device store.");
+    out << "telemetry_samples_total " << ingest_pipeline.applied_total() << '\n';
+    
+    prometheus_header(out, "telemetry_device_samples_total", "counter", "Samples applied per device.");
+    for (uint8_t id : ids) {
+        out << "telemetry_device_samples_total{device=\"" << static_cast<int>(id) << "\"} "
+            << (snapshot ? snapshot->devices[id].applied : device_store.applied(id)) << '\n';
+    }
+    
+    prometheus_header(out, "telemetry_crc_failures_total", "counter", "Frames rejected by checksum.");
+    out << "telemetry_crc_failures_total " << ingest_counters.crc_failures.load() << '\n';
+    prometheus_header(out, "telemetry_protocol_errors_total", "counter", "Connections dropped on malformed frames.");
+    out << "telemetry_protocol_errors_total " << ingest_counters.protocol_errors.load() << '\n';
+    prometheus_header(out, "telemetry_udp_datagrams_total", "counter", "UDP datagrams received.");
+    out << "telemetry_udp_datagrams_total " << ingest_counters.udp_datagrams.load() << '\n';
+    prometheus_header(out, "telemetry_udp_frames_total", "counter", "Frames accepted over UDP.");
+    out << "telemetry_udp_frames_total " << ingest_counters.udp_frames.load() << '\n';
+    prometheus_header(out, "telemetry_udp_malformed_total", "counter", "UDP datagrams dropped as malformed.");
+    out << "telemetry_udp_malformed_total " << ingest_counters.udp_malformed.load() << '\n';
+    prometheus_header(out, "telemetry_udp_kernel_drops_total", "counter", "UDP datagrams dropped by the kernel.");
+    out << "telemetry_udp_kernel_drops_total " << ingest_counters.udp_kernel_drops.load() << '\n';
+    
+    prometheus_header(out, "telemetry_active_connections", "gauge", "Open binary ingest connections.");
+    out << "telemetry_active_connections " << connection_registry.open_count() << '\n';
+    prometheus_header(out, "telemetry_connection_sources", "gauge", "Source addresses with open binary connections.");
+    out << "telemetry_connection_sources " << connection_limiter.sources() << '\n';
+    prometheus_header(out, "telemetry_connection_limit", "gauge", "Configured binary connection caps, 0 is unlimited.");
+    out << "telemetry_connection_limit{scope=\"global\"} " << connection_limiter.max_total() << '\n';
+    out << "telemetry_connection_limit{scope=\"per_ip\"} " << connection_limiter.max_per_source() << '\n';
+    prometheus_header(out, "telemetry_connections_accepted_total", "counter", "Binary connections admitted.");
+    out << "telemetry_connections_accepted_total " << ingest_counters.connections_accepted.load() << '\n';
+    prometheus_header(out, "telemetry_connections_rejected_total", "counter", "Binary connections refused by a cap.");
+    out << "telemetry_connections_rejected_total{reason=\"global\"} " << ingest_counters.rejected_global.load() << '\n';
+    out << "telemetry_connections_rejected_total{reason=\"per_ip\"} " << ingest_counters.rejected_per_ip.load() << '\n';
+    prometheus_header(out, "telemetry_connections_evicted_total", "counter",
+                      "Binary connections closed by the idle or partial-frame timeout.");
+    out << "telemetry_connections_evicted_total{reason=\"idle\"} " << ingest_counters.evicted_idle.load() << '\n';
+    out << "telemetry_connections_evicted_total{reason=\"slow\"} " << ingest_counters.evicted_slow.load() << '\n';
+    prometheus_header(out, "telemetry_rate_limited_total", "counter", "Samples dropped by a token bucket.");
+    out << "telemetry_rate_limited_total{scope=\"connection\"} " << ingest_counters.flow_dropped.load() << '\n';
+    out << "telemetry_rate_limited_total{scope=\"device\"} " << ingest_pipeline.throttled_total() << '\n';
+    prometheus_header(out, "telemetry_connection_pauses_total", "counter",
+                      "Times a binary connection stopped reading to wait for its token bucket.");
+    out << "telemetry_connection_pauses_total " << ingest_counters.flow_pauses.load() << '\n';
+    prometheus_header(out, "telemetry_ingest_overloaded_producers", "gauge",
+                      "Ingest producers holding samples because a store queue is full.");
+    out << "telemetry_ingest_overloaded_producers " << ingest_pipeline.overloaded_producers() << '\n';
+    prometheus_header(out, "telemetry_ingest_coalesced_total", "counter",
+                      "Samples replaced by a newer sample of the same device under overload.");
+    out << "telemetry_ingest_coalesced_total " << ingest_pipeline.coalesced_total() << '\n';
+    // Счетчики по воркерам, а не по адресам: число серий не растет с числом
+    // клиентов, а закрытые соединения остаются в итогах.
+    connection_registry.worker_traffic(traffic);
+    prometheus_header(out, "telemetry_connection_bytes_total", "counter", "Bytes read from binary connections per worker.");
+    for (size_t worker = 0; worker < traffic.size(); ++worker) {
+        out << "telemetry_connection_bytes_total{worker=\"" << worker << "\"} " << traffic[worker].bytes << '\n';
+    }
+    prometheus_header(out, "telemetry_connection_frames_total", "counter", "Frames read from binary connections per worker.");
+    for (size_t worker = 0; worker < traffic.size(); ++worker) {
+        out << "telemetry_connection_frames_total{worker=\"" << worker << "\"} " << traffic[worker].frames << '\n';
+    }
+    
+    prometheus_header(out, "telemetry_http_requests_total", "counter", "HTTP requests by route and status.");
+    for (size_t route = 0; route < HTTP_ROUTE_COUNT; ++route) {
+        for (size_t status = 0; status < HTTP_STATUS_COUNT; ++status) {
+            uint64_t count = http_requests[route][status].load();
+            if (count > 0) {
+                out << "telemetry_http_requests_total{route=\"" << HTTP_ROUTE_NAMES[route]
+                    << "\",status=\"" << HTTP_STATUSES[status] << "\"} " << count << '\n';
             }
-            break;
+        }
+    }
+    
+    prometheus_header(out, "telemetry_store_memory_bytes", "gauge", "Memory held by the device store.");
+    out << "telemetry_store_memory_bytes " << device_store.memory_bytes() << '\n';
+    prometheus_header(out, "telemetry_active_devices", "gauge", "Devices with at least one sample.");
+    out << "telemetry_active_devices " << ids.size() << '\n';
+    if (snapshot) {
+        prometheus_header(out, "telemetry_snapshot_version", "gauge", "Version of the published fleet snapshot.");
+        out << "telemetry_snapshot_version " << snapshot->version << '\n';
+        prometheus_header(out, "telemetry_snapshot_age_seconds", "gauge", "Age of the published fleet snapshot.");
+        out << "telemetry_snapshot_age_seconds " << static_cast<double>(snapshot_age_ms(*snapshot)) / 1e3 << '\n';
+        prometheus_header(out, "telemetry_snapshot_build_seconds", "gauge",
+                          "Time from opening a fleet snapshot to its publication.");
+        out << "telemetry_snapshot_build_seconds " << static_cast<double>(fleet_snapshots.build_ns()) / 1e9 << '\n';
+        prometheus_header(out, "telemetry_snapshots_published_total", "counter", "Fleet snapshots published.");
+        out << "telemetry_snapshots_published_total " << fleet_snapshots.published() << '\n';
+        prometheus_header(out, "telemetry_snapshots_retired", "gauge", "Replaced snapshots still pinned by readers.");
+        out << "telemetry_snapshots_retired " << fleet_snapshots.retired() << '\n';
+    }
+    
+    prometheus_header(out, "telemetry_alerts_active", "gauge", "Alert rules currently raised across devices.");
+    out << "telemetry_alerts_active " << derived_metrics.active() << '\n';
+    prometheus_header(out, "telemetry_alerts_total", "counter", "Alert transitions by state.");
+    out << "telemetry_alerts_total{state=\"raised\"} " << derived_metrics.raised() << '\n';
+    out << "telemetry_alerts_total{state=\"cleared\"} " << derived_metrics.cleared() << '\n';
+    prometheus_header(out, "telemetry_alerts_dropped_total", "counter", "Alerts lost because the notifier queue was full.");
+    out << "telemetry_alerts_dropped_total " << derived_metrics.dropped() << '\n';
+    
+    prometheus_header(out, "telemetry_history_memory_bytes", "gauge", "Memory held by sample history for /query.");
+    out << "telemetry_history_memory_bytes " << history_store.memory_bytes() << '\n';
+    prometheus_header(out, "telemetry_history_budget_bytes", "gauge", "Memory budget for sample history, 0 is unlimited.");
+    out << "telemetry_history_budget_bytes " << history_store.budget() << '\n';
+    prometheus_header(out, "telemetry_history_devices", "gauge", "Devices by where their history is kept.");
+    for (HistoryTier tier : {HistoryTier::Resident, HistoryTier::Compressed, HistoryTier::Spilled}) {
+        out << "telemetry_history_devices{tier=\"" << history_tier_name(tier) << "\"} "
+            << history_store.devices_in(tier) << '\n';
+    }
+    prometheus_header(out, "telemetry_history_evictions_total", "counter", "Cold device histories moved down a tier.");
+    out << "telemetry_history_evictions_total{to=\"compressed\"} " << history_store.evictions(HistoryTier::Compressed) << '\n';
+    out << "telemetry_history_evictions_total{to=\"spilled\"} " << history_store.evictions(HistoryTier::Spilled) << '\n';
+    out << "telemetry_history_evictions_total{to=\"discarded\"} " << history_store.evictions(HistoryTier::Empty) << '\n';
+    prometheus_header(out, "telemetry_history_page_ins_total", "counter", "Evicted histories brought back into memory.");
+    out << "telemetry_history_page_ins_total{from=\"compressed\"} " << history_store.page_ins(HistoryTier::Compressed) << '\n';
+    out << "telemetry_history_page_ins_total{from=\"spilled\"} " << history_store.page_ins(HistoryTier::Spilled) << '\n';
+    prometheus_header(out, "telemetry_history_streamed_reads_total", "counter", "Evicted histories read by queries without bringing them back.");
+    out << "telemetry_history_streamed_reads_total{from=\"compressed\"} " << history_store.streamed_reads(HistoryTier::Compressed) << '\n';
+    out << "telemetry_history_streamed_reads_total{from=\"spilled\"} " << history_store.streamed_reads(HistoryTier::Spilled) << '\n';
+    prometheus_header(out, "telemetry_history_spill_file_bytes", "gauge", "Size of the history spill file.");
+    out << "telemetry_history_spill_file_bytes " << history_store.spill_file_bytes() << '\n';
+    prometheus_header(out, "telemetry_query_chunks_total", "counter", "History chunks visited by queries by outcome.");
+    out << "telemetry_query_chunks_total{action=\"scanned\"} " << query_chunks_scanned.load() << '\n';
+    out << "telemetry_query_chunks_total{action=\"skipped\"} " << query_chunks_skipped.load() << '\n';
+    out << "telemetry_query_chunks_total{action=\"summarized\"} " << query_chunks_summarized.load() << '\n';
+    prometheus_header(out, "telemetry_query_samples_scanned_total", "counter", "History samples scanned by queries.");
+    out << "telemetry_query_samples_scanned_total " << query_samples_scanned.load() << '\n';
+    
+    prometheus_header(out, "telemetry_stage_latency_seconds", "summary", "Latency of pipeline stages.");
+    out.precision(9);
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        Stage stage = static_cast<Stage>(i);
+        LatencySummary summary = latency_summary(stage);
+        const std::pair<const char*, uint64_t> quantiles[] = {
+            {"0.5", summary.p50}, {"0.9", summary.p90}, {"0.99", summary.p99}, {"0.999", summary.p999}};
+        for (const auto& [quantile, ns] : quantiles) {
+            out << "telemetry_stage_latency_seconds{stage=\"" << stage_name(stage) << "\",quantile=\""
+                << quantile << "\"} " << static_cast<double>(ns) / 1e9 << '\n';
+        }
+        out << "telemetry_stage_latency_seconds_sum{stage=\"" << stage_name(stage) << "\"} "
+            << static_cast<double>(summary.sum) / 1e9 << '\n';
+        out << "telemetry_stage_latency_seconds_count{stage=\"" << stage_name(stage) << "\"} "
+            << summary.count << '\n';
+    }
+    
+    prometheus_header(out, "telemetry_freshness_seconds", "summary",
+                      "Lag from socket arrival (visible) or device timestamp (device_clock) to store visibility.");
+    prometheus_freshness(out, "telemetry_freshness_seconds", "", freshness.visible(-1), "visible");
+    prometheus_freshness(out, "telemetry_freshness_seconds", "", freshness.device(-1), "device_clock");
+    prometheus_header(out, "telemetry_device_freshness_seconds", "summary", "Freshness lag per device.");
+    for (uint8_t id : ids) {
+        char device[24];
+        std::snprintf(device, sizeof(device), "device=\"%d\",", static_cast<int>(id));
+        prometheus_freshness(out, "telemetry_device_freshness_seconds", device, freshness.visible(id), "visible");
+        prometheus_freshness(out, "telemetry_device_freshness_seconds", device, freshness.device(id), "device_clock");
+    }
+    prometheus_header(out, "telemetry_clock_ahead_total", "counter", "Sampled frames with a device timestamp in the future.");
+    out << "telemetry_clock_ahead_total " << freshness.clock_ahead() << '\n';
+    prometheus_header(out, "telemetry_freshness_alerts_total", "counter", "Samples over a freshness alert threshold.");
+    out << "telemetry_freshness_alerts_total " << freshness.alerts() << '\n';
+    
+    TaskPool::Stats pool = task_pool.stats();
+    prometheus_header(out, "telemetry_pool_queue_depth", "gauge", "Tasks waiting in the shared pool by priority.");
+    for (size_t level = 0; level < TASK_PRIORITY_COUNT; ++level) {
+        out << "telemetry_pool_queue_depth{priority=\"" << task_priority_name(static_cast<TaskPriority>(level))
+            << "\"} " << pool.queued[level] << '\n';
+    }
+    prometheus_header(out, "telemetry_pool_tasks_total", "counter", "Tasks executed by the shared pool by priority.");
+    for (size_t level = 0; level < TASK_PRIORITY_COUNT; ++level) {
+        out << "telemetry_pool_tasks_total{priority=\"" << task_priority_name(static_cast<TaskPriority>(level))
+            << "\"} " << pool.executed[level] << '\n';
+    }
+    prometheus_header(out, "telemetry_pool_steals_total", "counter", "Tasks taken from another pool thread's queue.");
+    out << "telemetry_pool_steals_total " << pool.steals << '\n';
+}
+
+// Состояние одного HTTP-запроса. Объекты берутся из пула, а строки ответа
+// после запроса только очищаются и сохраняют емкость, поэтому в установившемся
+// режиме обработка запроса не выделяет память в куче.
+struct HttpExchange {
+    // Вмещает /metrics в формате Prometheus для всех MAX_DEVICES устройств.
+    static constexpr size_t MAX_RETAINED = 256 * 1024;
+
+    char request[4096];
+    std::string body;
+    std::string response;
+    std::vector<uint8_t> ids;
+    std::vector<WorkerTraffic> traffic;
+    QueryRequest query_request;
+    QueryResult query_result;
+    std::string query_error;
+    std::shared_ptr<LoopMailbox> mailbox;
+    std::coroutine_handle<> waiter;
+    std::atomic<int> owners{0};
+
+    void reset() {
+        body.clear();
+        response.clear();
+        if (body.capacity() > MAX_RETAINED) std::string().swap(body);
+        if (response.capacity() > MAX_RETAINED) std::string().swap(response);
+        mailbox.reset();
+        waiter = {};
+    }
+};
+
+static SlabPool<HttpExchange, 16> http_exchanges;
+
+static void release_exchange(HttpExchange* exchange) {
+    if (exchange->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        exchange->reset();
+        http_exchanges.release(exchange);
+    }
+}
+
+static bool parse_device_route(std::string_view path, std::string_view suffix, int& device_id) {
+    static constexpr std::string_view prefix = "/device/";
+    if (!path.starts_with(prefix) || !path.ends_with(suffix)) {
+        return false;
+    }
+    std::string_view digits = path.substr(prefix.size(), path.size() - prefix.size() - suffix.size());
+    if (digits.empty() || digits.size() > 3) {
+        return false;
+    }
+    device_id = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') return false;
+        device_id = device_id * 10 + (c - '0');
+    }
+    return true;
+}
+
+static HttpRoute match_route(std::string_view path, int& device_id) {
+    if (path == "/devices") return HttpRoute::Devices;
+    if (path == "/metrics") return HttpRoute::Metrics;
+    if (path == "/query") return HttpRoute::Query;
+    if (parse_device_route(path, "/latest", device_id)) return HttpRoute::Latest;
+    if (parse_device_route(path, "/stats", device_id)) return HttpRoute::Stats;
+    if (parse_device_route(path, "/derived", device_id)) return HttpRoute::Derived;
+    return HttpRoute::Other;
+}
+
+static std::string_view next_token(const char*& cursor) {
+    while (*cursor == ' ') ++cursor;
+    const char* start = cursor;
+    while (*cursor != '\0' && *cursor != ' ' && *cursor != '\r' && *cursor != '\n') ++cursor;
+    return std::string_view(start, static_cast<size_t>(cursor - start));
+}
+
+static std::string_view split_query(std::string_view& path) {
+    size_t question = path.find('?');
+    if (question == std::string_view::npos) return {};
+    std::string_view query = path.substr(question + 1);
+    path = path.substr(0, question);
+    return query;
+}
+
+static void write_no_data(HttpExchange& exchange, int device_id) {
+    exchange.body = "{\"error\": \"No data available for device ";
+    append_uint(exchange.body, static_cast<uint64_t>(device_id));
+    exchange.body += "\"}";
+    write_response(exchange.response, "404 Not Found", "application/json", exchange.body);
+}
+
+static void handle_http_request(HttpExchange& exchange) {
+    const char* request = exchange.request;
+    std::string& body = exchange.body;
+    std::string& response = exchange.response;
+    
+    uint64_t parse_start = stage_clock_ns();
+    const char* cursor = request;
+    std::string_view method = next_token(cursor);
+    std::string_view path = next_token(cursor);
+    std::string_view query = split_query(path);
+    
+    if (method != "GET") {
+        response = "HTTP/1.1 405 Method Not Allowed\r\n"
+                   "Content-Type: application/json\r\n"
+                   "Content-Length: 0\r\n\r\n";
+        count_http_request(HttpRoute::Other, response);
+        return;
+    }
+    
+    ResponseFormat format = negotiate_format(request);
+    int device_id = 0;
+    HttpRoute route = match_route(path, device_id);
+    
+    uint64_t handler_start = stage_clock_ns();
+    record_stage(Stage::HttpParse, handler_start - parse_start);
+    uint64_t serialize_ns = 0;
+    auto serialize = [&](auto&& encode) {
+        uint64_t serialize_start = stage_clock_ns();
+        encode();
+        serialize_ns += stage_clock_ns() - serialize_start;
+    };
+    
+    if (route == HttpRoute::Latest) {
+        Sample latest{};
+        bool found = device_id < MAX_DEVICES &&
+                     device_store.latest(static_cast<uint8_t>(device_id), latest);
+        
+        if (!found) {
+            write_no_data(exchange, device_id);
+        } else {
+            serialize([&] {
+                encode_latest(format, device_id, latest, body);
+                write_response(response, "200 OK", content_type(format), body);
+            });
+        }
+    } else if (route == HttpRoute::Stats) {
+        DeviceStats stats{};
+        stats.device_id = device_id;
+        DeviceData device;
+        bool found = device_id < MAX_DEVICES &&
+                     device_store.read(static_cast<uint8_t>(device_id), device);
+        bool computed = false;
+        if (found) {
+            computed = device.get_stats(stats.min, stats.max, stats.average);
+            stats.count = device.count;
         }
         
-        std::thread([client_socket]() {
-            std::vector<uint8_t> buffer;
-            buffer.reserve(1024);
-            
-            while (running) {
-                uint8_t temp[1024];
-                ssize_t bytes_read = read(client_socket, temp, sizeof(temp));
-                
-                if (bytes_read <= 0) {
-                    break;  
-                }
-                
-                buffer.insert(buffer.end(), temp, temp + bytes_read);
-                
-                while (buffer.size() >= 14) {
-                    uint8_t message[14];
-                    std::copy_n(buffer.begin(), 14, message);
-                    process_message(message);
-                    buffer.erase(buffer.begin(), buffer.begin() + 14);
-                }
+        if (!found) {
+            write_no_data(exchange, device_id);
+        } else if (computed) {
+            serialize([&] {
+                encode_stats(format, stats, body);
+                write_response(response, "200 OK", content_type(format), body);
+            });
+        } else {
+            body = "{\"error\": \"Failed to calculate statistics\"}";
+            write_response(response, "500 Internal Server Error", "application/json", body);
+        }
+    } else if (route == HttpRoute::Derived) {
+        DerivedValues values;
+        bool found = device_id < MAX_DEVICES && derived_metrics.enabled() &&
+                     derived_metrics.read(static_cast<uint8_t>(device_id), values);
+        
+        if (!found) {
+            write_no_data(exchange, device_id);
+        } else {
+            serialize([&] {
+                encode_derived(format, device_id, values, derived_metrics, body);
+                write_response(response, "200 OK", content_type(format), body);
+            });
+        }
+    } else if (route == HttpRoute::Query) {
+        QueryRequest& request = exchange.query_request;
+        std::string& error = exchange.query_error;
+        if (!history_store.enabled()) {
+            body = "{\"error\": \"History disabled\", \"message\": \"Start the server with --history=<samples>\"}";
+            write_response(response, "404 Not Found", "application/json", body);
+        } else if (!parse_query(query, history_store.device_count(), request, error)) {
+            body = "{\"error\": \"Bad Request\", \"message\": \"";
+            body += error;
+            body += "\"}";
+            write_response(response, "400 Bad Request", "application/json", body);
+        } else {
+            QueryResult& result = exchange.query_result;
+            QueryExecution execution;
+            execution.parallelism = options.query_parallelism;
+            run_query(history_store, request, result, execution);
+            query_chunks_scanned.add(result.chunks_scanned);
+            query_chunks_skipped.add(result.chunks_skipped);
+            query_chunks_summarized.add(result.chunks_summarized);
+            query_samples_scanned.add(result.samples_scanned);
+            serialize([&] {
+                encode_query(format, request, result, body);
+                write_response(response, "200 OK", content_type(format), body);
+            });
+        }
+    } else if (route == HttpRoute::Devices) {
+        {
+            auto snapshot = fleet_snapshots.read();
+            fleet_devices(snapshot.get(), exchange.ids);
+        }
+        
+        serialize([&] {
+            encode_devices(format, exchange.ids, body);
+            write_response(response, "200 OK", content_type(format), body);
+        });
+    } else if (route == HttpRoute::Metrics) {
+        serialize([&] {
+            if (accepts_prometheus(request)) {
+                metrics_prometheus(body, exchange.ids, exchange.traffic);
+                write_response(response, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body);
+            } else {
+                metrics_json(body, exchange.ids);
+                write_response(response, "200 OK", "application/json", body);
             }
-            
-            close(client_socket);
-        }).detach();
+        });
+    } else {
+        body = "{\"error\": \"Not Found\", \"message\": \"Use /device/{id}/latest, /device/{id}/stats, /device/{id}/derived, /devices or /query\"}";
+        write_response(response, "404 Not Found", "application/json", body);
     }
     
-    close(server_fd);
-    binary_listen_socket = -1;
+    record_stage(Stage::Handler, stage_clock_ns() - handler_start - serialize_ns);
+    record_stage(Stage::Serialize, serialize_ns);
+    count_http_request(route, response);
+}
+
+// Статистика и метрики идут в низкий приоритет пула, чтобы тяжелые запросы
+// аналитики не задерживали запросы последних значений.
+static TaskPriority http_priority(const char* request) {
+    const char* cursor = request;
+    next_token(cursor);
+    std::string_view path = next_token(cursor);
+    split_query(path);
+    if (path == "/metrics" || path == "/query" || path.ends_with("/stats")) {
+        return TaskPriority::Low;
+    }
+    return TaskPriority::Normal;
+}
+
+// Передает запрос в пул и возобновляет корутину в цикле событий. Задача и
+// корутина владеют запросом совместно: при остановке цикла кадр может быть
+// уничтожен раньше, чем задача закончит работу.
+struct HttpDispatch {
+    HttpExchange& exchange;
+    TaskPriority priority;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        exchange.waiter = handle;
+        exchange.owners.fetch_add(1, std::memory_order_relaxed);
+        HttpExchange* shared = &exchange;
+        task_pool.submit(priority, [shared] {
+            handle_http_request(*shared);
+            shared->mailbox->post(shared->waiter);
+            release_exchange(shared);
+        });
+    }
+    void await_resume() const noexcept {}
+};
+
+static Task<> serve_http(EventLoop& loop, int fd) {
+    AsyncSocket socket(loop, fd, WATCH_READ_WRITE);
+    if (!socket.valid()) {
+        co_return;
+    }
+    
+    HttpExchange* exchange = http_exchanges.acquire();
+    exchange->owners.store(1, std::memory_order_relaxed);
+    exchange->mailbox = loop.mailbox();
+    struct ReleaseGuard {
+        HttpExchange* exchange;
+        ~ReleaseGuard() { release_exchange(exchange); }
+    } guard{exchange};
+    
+    // Медленный клиент получает на запрос и на прием ответа тот же срок,
+    // что и бинарное соединение на дописывание кадра.
+    if (options.frame_timeout_ms > 0) {
+        socket.expire_at(loop.now_ms() + options.frame_timeout_ms);
+    }
+    auto read = socket.read_some(exchange->request, sizeof(exchange->request) - 1);
+    ssize_t bytes_read = co_await read;
+    if (bytes_read <= 0) {
+        co_return;
+    }
+    exchange->request[bytes_read] = '\0';
+    
+    HttpDispatch dispatch{*exchange, http_priority(exchange->request)};
+    co_await dispatch;
+    if (options.frame_timeout_ms > 0) {
+        socket.expire_at(loop.now_ms() + options.frame_timeout_ms);
+    }
+    auto write = socket.write_all(exchange->response.data(), exchange->response.size());
+    co_await write;
+}
+
+static Task<> accept_http(EventLoop& loop, int server_fd) {
+    while (running) {
+        int client_socket = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                if (running) {
+                    std::cerr << "Ошибка accept HTTP" << std::endl;
+                }
+                co_return;
+            }
+            co_await loop.readable(server_fd);
+            continue;
+        }
+        loop.spawn(serve_http(loop, client_socket));
+    }
 }
 
 void HTTP_server() {
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_fd < 0) {
         std::cerr << "Ошибка создания сокета HTTP" << std::endl;
         return;
@@ -108,7 +834,7 @@ void HTTP_server() {
     sockaddr_in address{};
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(HTTP_PORT);
+    address.sin_port = htons(options.http_port);
     
     if (bind(server_fd, (sockaddr*)&address, sizeof(address)) < 0) {
         std::cerr << "Ошибка привязки сокета HTTP" << std::endl;
@@ -116,126 +842,24 @@ void HTTP_server() {
         return;
     }
     
-    if (listen(server_fd, 10) < 0) {
+    if (listen(server_fd, 128) < 0) {
         std::cerr << "Ошибка listen HTTP" << std::endl;
         close(server_fd);
         return;
     }
     
-    std::cout << "HTTP сервер запущен на порту " << HTTP_PORT << std::endl;
+    std::cout << "HTTP сервер запущен на порту " << options.http_port << std::endl;
     
-    std::regex re_latest(R"(^/device/(\d{1,3})/latest$)");
-    std::regex re_stats(R"(^/device/(\d{1,3})/stats$)");
-    
-    while (running) {
-        int client_socket = accept(server_fd, nullptr, nullptr);
-        if (client_socket < 0) {
-            if (running) {
-                std::cerr << "Ошибка accept HTTP" << std::endl;
-            }
-            break;
+    {
+        EventLoop loop;
+        if (loop.valid() && loop.watch(server_fd, WATCH_READ)) {
+            loop.spawn(accept_http(loop, server_fd));
+            loop.run([] { return running.load(); });
         }
-        
-        std::thread([client_socket, re_latest, re_stats]() {
-            char request[4096];
-            ssize_t bytes_read = read(client_socket, request, sizeof(request) - 1);
-            
-            if (bytes_read <= 0) {
-                close(client_socket);
-                return;
-            }
-            
-            request[bytes_read] = '\0';
-            
-            std::istringstream req_stream(request);
-            std::string method, path, version;
-            req_stream >> method >> path >> version;
-            
-            std::string response;
-            std::smatch match;
-            
-            if (method != "GET") {
-                response = "HTTP/1.1 405 Method Not Allowed\r\n"
-                          "Content-Type: application/json\r\n"
-                          "Content-Length: 0\r\n\r\n";
-                write(client_socket, response.c_str(), response.size());
-                close(client_socket);
-                return;
-            }
-
-            std::lock_guard<std::mutex> lock(devices_mutex);
-            
-            if (std::regex_match(path, match, re_latest)) {
-                int device_id = std::stoi(match[1].str());
-                
-                auto it = devices.find(device_id);
-                if (it == devices.end() || it->second.count == 0) {
-                    std::string body = "{\"error\": \"No data available for device " + 
-                                       std::to_string(device_id) + "\"}";
-                    response = "HTTP/1.1 404 Not Found\r\n"
-                              "Content-Type: application/json\r\n"
-                              "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
-                } else {
-                    const DeviceData& device = it->second;
-                    const Sample& latest = device.latest;
-                    
-                    std::ostringstream json;
-                    json << std::fixed << std::setprecision(6)
-                         << "{\"device_id\": " << device_id
-                         << ", \"value\": " << latest.value
-                         << ", \"timestamp\": " << latest.timestamp << "}";
-                    
-                    std::string body = json.str();
-                    response = "HTTP/1.1 200 OK\r\n"
-                              "Content-Type: application/json\r\n"
-                              "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
-                }
-            } else if (std::regex_match(path, match, re_stats)) {
-                int device_id = std::stoi(match[1].str());
-                
-                auto it = devices.find(device_id);
-                if (it == devices.end() || it->second.count == 0) {
-                    std::string body = "{\"error\": \"No data available for device " + 
-                                       std::to_string(device_id) + "\"}";
-                    response = "HTTP/1.1 404 Not Found\r\n"
-                              "Content-Type: application/json\r\n"
-                              "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
-                } else {
-                    const DeviceData& device = it->second;
-                    double min_val, max_val, avg;
-                    
-                    if (device.get_stats(min_val, max_val, avg)) {
-                        std::ostringstream json;
-                        json << std::fixed << std::setprecision(6)
-                             << "{\"device_id\": " << device_id
-                             << ", \"min\": " << min_val
-                             << ", \"max\": " << max_val
-                             << ", \"average\": " << avg
-                             << ", \"count\": " << device.count << "}";
-                        
-                        std::string body = json.str();
-                        response = "HTTP/1.1 200 OK\r\n"
-                                  "Content-Type: application/json\r\n"
-                                  "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
-                    } else {
-                        std::string body = "{\"error\": \"Failed to calculate statistics\"}";
-                        response = "HTTP/1.1 500 Internal Server Error\r\n"
-                                  "Content-Type: application/json\r\n"
-                                  "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
-                    }
-                }
-            } else {
-                std::string body = "{\"error\": \"Not Found\", \"message\": \"Use /device/{id}/latest or /device/{id}/stats\"}";
-                response = "HTTP/1.1 404 Not Found\r\n"
-                          "Content-Type: application/json\r\n"
-                          "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
-            }
-            
-            write(client_socket, response.c_str(), response.size());
-            close(client_socket);
-        }).detach();
     }
     
-    close(server_fd);
+    if (http_listen_socket >= 0) {
+        close(server_fd);
+    }
     http_listen_socket = -1;
-}
\ No newline at end of file
+}
@@ -0,0 +1,166 @@
+#include "shm_ingest_server.hpp"
+#include "latency_histogram.hpp"
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <new>
+
+
+static uint32_t round_up_pow2(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+
+ShmIngestServer::ShmIngestServer(const std::string& name, uint32_t ring_count, uint32_t ring_capacity)
+    : name(name),
+      ring_count(ring_count < 1 ? 1 : ring_count),
+      ring_capacity(round_up_pow2(ring_capacity < 64 ? 64 : ring_capacity)) {}
+
+ShmIngestServer::~ShmIngestServer() {
+    stop();
+}
+
+bool ShmIngestServer::start() {
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        std::cerr << "Ошибка shm_open " << name << std::endl;
+        return false;
+    }
+    
+    size = shm_segment_size(ring_count, ring_capacity);
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        std::cerr << "Ошибка ftruncate " << name << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        std::cerr << "Ошибка mmap " << name << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+    
+    header = new (base) ShmIngestHeader{};
+    header->ring_count = ring_count;
+    header->ring_capacity = ring_capacity;
+    header->version = SHM_INGEST_VERSION;
+    for (uint32_t i = 0; i < ring_count; ++i) {
+        new (shm_ring_at(base, i)) ShmIngestRing{};
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_INGEST_MAGIC;
+    
+    producer = ingest_pipeline.register_producer();
+    thread = std::thread(&ShmIngestServer::run, this);
+    return true;
+}
+
+void ShmIngestServer::stop() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (header != nullptr) {
+        header->wake_sequence.fetch_add(1, std::memory_order_release);
+        shm_futex_wake(&header->wake_sequence);
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (base != nullptr) {
+        header->magic = 0;
+        munmap(base, size);
+        shm_unlink(name.c_str());
+        base = nullptr;
+        header = nullptr;
+    }
+}
+
+size_t ShmIngestServer::drain_all() {
+    size_t total = 0;
+    producer->set_arrival(stage_clock_ns());
+    for (uint32_t i = 0; i < ring_count; ++i) {
+        ShmIngestRing* ring = shm_ring_at(base, i);
+        uint64_t h = ring->head.load(std::memory_order_relaxed);
+        uint64_t available = ring->tail.load(std::memory_order_acquire) - h;
+        if (available == 0) continue;
+        
+        size_t n = available < DRAIN_BATCH ? static_cast<size_t>(available) : DRAIN_BATCH;
+        const TelemetryMessage* records = shm_ring_records(ring);
+        uint64_t mask = ring_capacity - 1;
+        for (size_t k = 0; k < n; ++k) {
+            const TelemetryMessage& record = records[(h + k) & mask];
+            IngestMessage msg;
+            msg.device_id = record.device_id;
+            msg.value = record.value;
+            msg.timestamp = record.timestamp;
+            producer->push(msg);
+        }
+        ring->head.store(h + n, std::memory_order_release);
+        total += n;
+    }
+    return total;
+}
+
+bool ShmIngestServer::rings_empty() const {
+    for (uint32_t i = 0; i < ring_count; ++i) {
+        ShmIngestRing* ring = shm_ring_at(base, i);
+        if (ring->tail.load(std::memory_order_acquire) != ring->head.load(std::memory_order_relaxed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShmIngestServer::release_stale_rings() {
+    for (uint32_t i = 0; i < ring_count; ++i) {
+        ShmIngestRing* ring = shm_ring_at(base, i);
+        int32_t pid = ring->owner.load(std::memory_order_acquire);
+        if (pid > 0 && kill(pid, 0) < 0 && errno == ESRCH) {
+            ring->owner.compare_exchange_strong(pid, 0);
+        }
+    }
+}
+
+void ShmIngestServer::run() {
+    unsigned idle_rounds = 0;
+    auto last_stale_check = std::chrono::steady_clock::now();
+    
+    while (!stopping.load(std::memory_order_relaxed)) {
+        size_t n = drain_all();
+        if (n > 0) {
+            received_total.fetch_add(n, std::memory_order_relaxed);
+            idle_rounds = 0;
+            continue;
+        }
+        producer->flush();
+        
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_stale_check > std::chrono::seconds(1)) {
+            release_stale_rings();
+            last_stale_check = now;
+        }
+        
+        if (++idle_rounds < 128) {
+            std::this_thread::yield();
+            continue;
+        }
+        
+        uint32_t sequence = header->wake_sequence.load(std::memory_order_acquire);
+        header->consumer_sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (rings_empty() && !stopping.load(std::memory_order_relaxed)) {
+            timespec timeout{0, 100 * 1000 * 1000};
+            shm_futex_wait(&header->wake_sequence, sequence, &timeout);
+        }
+        header->consumer_sleeping.store(0, std::memory_order_relaxed);
+        idle_rounds = 0;
+    }
+    
+    drain_all();
+    producer->close();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "ingest_pipeline.hpp"
+#include "shm_ring.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+
+class ShmIngestServer {
+public:
+    static constexpr size_t DRAIN_BATCH = 256;
+
+    ShmIngestServer(const std::string& name, uint32_t ring_count, uint32_t ring_capacity);
+    ~ShmIngestServer();
+
+    ShmIngestServer(const ShmIngestServer&) = delete;
+    ShmIngestServer& operator=(const ShmIngestServer&) = delete;
+
+    bool start();
+    void stop();
+
+    uint64_t received() const { return received_total.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    size_t drain_all();
+    bool rings_empty() const;
+    void release_stale_rings();
+
+    std::string name;
+    uint32_t ring_count;
+    uint32_t ring_capacity;
+
+    void* base = nullptr;
+    size_t size = 0;
+    ShmIngestHeader* header = nullptr;
+    IngestProducer* producer = nullptr;
+
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> received_total{0};
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include "structs.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+
+static constexpr uint32_t SHM_INGEST_MAGIC = 0x544C4D53;
+static constexpr uint32_t SHM_INGEST_VERSION = 1;
+static constexpr size_t SHM_ALIGN = 64;
+
+
+struct ShmIngestHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_count;
+    uint32_t ring_capacity;
+    alignas(SHM_ALIGN) std::atomic<uint32_t> consumer_sleeping;
+    std::atomic<uint32_t> wake_sequence;
+};
+
+
+struct ShmIngestRing {
+    alignas(SHM_ALIGN) std::atomic<int32_t> owner;
+    alignas(SHM_ALIGN) std::atomic<uint64_t> head;
+    alignas(SHM_ALIGN) std::atomic<uint64_t> tail;
+};
+
+
+inline size_t shm_align(size_t size) {
+    return (size + SHM_ALIGN - 1) & ~(SHM_ALIGN - 1);
+}
+
+inline size_t shm_ring_stride(uint32_t capacity) {
+    return shm_align(sizeof(ShmIngestRing) + capacity * sizeof(TelemetryMessage));
+}
+
+inline size_t shm_segment_size(uint32_t ring_count, uint32_t capacity) {
+    return shm_align(sizeof(ShmIngestHeader)) + ring_count * shm_ring_stride(capacity);
+}
+
+inline ShmIngestRing* shm_ring_at(void* base, uint32_t index) {
+    ShmIngestHeader* header = static_cast<ShmIngestHeader*>(base);
+    uint8_t* rings = static_cast<uint8_t*>(base) + shm_align(sizeof(ShmIngestHeader));
+    return reinterpret_cast<ShmIngestRing*>(rings + index * shm_ring_stride(header->ring_capacity));
+}
+
+inline TelemetryMessage* shm_ring_records(ShmIngestRing* ring) {
+    return reinterpret_cast<TelemetryMessage*>(ring + 1);
+}
+
+inline long shm_futex_wait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+inline long shm_futex_wake(std::atomic<uint32_t>* word) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+
+class ShmIngestClient {
+public:
+    static constexpr uint64_t PUBLISH_BATCH = 64;
+
+    ShmIngestClient() = default;
+    ~ShmIngestClient() { detach(); }
+
+    ShmIngestClient(const ShmIngestClient&) = delete;
+    ShmIngestClient& operator=(const ShmIngestClient&) = delete;
+
+    bool attach(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return false;
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(ShmIngestHeader)) {
+            close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            return false;
+        }
+
+        header = static_cast<ShmIngestHeader*>(base);
+        if (header->magic != SHM_INGEST_MAGIC || header->version != SHM_INGEST_VERSION ||
+            shm_segment_size(header->ring_count, header->ring_capacity) > size) {
+            detach();
+            return false;
+        }
+
+        int32_t pid = static_cast<int32_t>(getpid());
+        for (uint32_t i = 0; i < header->ring_count; ++i) {
+            ShmIngestRing* candidate = shm_ring_at(base, i);
+            int32_t expected = 0;
+            if (candidate->owner.compare_exchange_strong(expected, pid)) {
+                ring = candidate;
+                records = shm_ring_records(ring);
+                mask = header->ring_capacity - 1;
+                write_index = ring->tail.load(std::memory_order_relaxed);
+                published = write_index;
+                head_cache = ring->head.load(std::memory_order_acquire);
+                return true;
+            }
+        }
+        detach();
+        return false;
+    }
+
+    bool push(uint8_t device_id, float value, uint64_t timestamp) {
+        if (write_index - head_cache > mask) {
+            head_cache = ring->head.load(std::memory_order_acquire);
+            if (write_index - head_cache > mask) {
+                flush();
+                return false;
+            }
+        }
+        TelemetryMessage& record = records[write_index & mask];
+        record.device_id = device_id;
+        record.value = value;
+        record.timestamp = timestamp;
+        record.crc = 0;
+        ++write_index;
+
+        if (write_index - published >= PUBLISH_BATCH) {
+            flush();
+        }
+        return true;
+    }
+
+    void push_wait(uint8_t device_id, float value, uint64_t timestamp) {
+        while (!push(device_id, value, timestamp)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void flush() {
+        if (ring == nullptr || published == write_index) return;
+        ring->tail.store(write_index, std::memory_order_release);
+        published = write_index;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (header->consumer_sleeping.load(std::memory_order_relaxed)) {
+            header->wake_sequence.fetch_add(1, std::memory_order_release);
+            shm_futex_wake(&header->wake_sequence);
+        }
+    }
+
+    void detach() {
+        if (ring != nullptr) {
+            flush();
+            ring->owner.store(0, std::memory_order_release);
+            ring = nullptr;
+        }
+        if (base != nullptr) {
+            munmap(base, size);
+            base = nullptr;
+        }
+    }
+
+    bool attached() const { return ring != nullptr; }
+
+private:
+    void* base = nullptr;
+    size_t size = 0;
+    ShmIngestHeader* header = nullptr;
+    ShmIngestRing* ring = nullptr;
+    TelemetryMessage* records = nullptr;
+    uint64_t mask = 0;
+    uint64_t write_index = 0;
+    uint64_t published = 0;
+    uint64_t head_cache = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// Пул объектов одного типа: объекты создаются пачками (slab) и после release
+// возвращаются в список свободных, а не в кучу. Память пула не уменьшается,
+// поэтому при частом открытии и закрытии соединений RSS остается на уровне пика.
+// Объект не пересоздается между использованиями: состояние сбрасывает вызывающий.
+template <typename T, size_t SlabObjects = 64>
+class SlabPool {
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    T* acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_objects.empty()) {
+            grow();
+        }
+        T* object = free_objects.back();
+        free_objects.pop_back();
+        ++used;
+        return object;
+    }
+
+    void release(T* object) {
+        if (object == nullptr) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        free_objects.push_back(object);
+        --used;
+    }
+
+    size_t capacity() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return slabs.size() * SlabObjects;
+    }
+
+    size_t in_use() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+
+private:
+    void grow() {
+        slabs.push_back(std::make_unique<T[]>(SlabObjects));
+        T* slab = slabs.back().get();
+        free_objects.reserve(slabs.size() * SlabObjects);
+        for (size_t i = SlabObjects; i > 0; --i) {
+            free_objects.push_back(&slab[i - 1]);
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<T[]>> slabs;
+    std::vector<T*> free_objects;
+    size_t used = 0;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : mask(round_up_pow2(capacity) - 1),
+          slots(new T[mask + 1]) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    bool stage(const T& item) {
+        if (write_index - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (write_index - head_cache > mask) {
+                return false;
+            }
+        }
+        slots[write_index & mask] = item;
+        ++write_index;
+        return true;
+    }
+
+    size_t staged() const {
+        return write_index - tail.load(std::memory_order_relaxed);
+    }
+
+    void publish() {
+        tail.store(write_index, std::memory_order_release);
+    }
+
+    bool push(const T& item) {
+        if (!stage(item)) {
+            return false;
+        }
+        publish();
+        return true;
+    }
+
+    template <typename Fn>
+    size_t drain(size_t max_items, Fn&& fn) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t available = tail.load(std::memory_order_acquire) - h;
+        size_t n = available < max_items ? static_cast<size_t>(available) : max_items;
+        for (size_t i = 0; i < n; ++i) {
+            fn(slots[(h + i) & mask]);
+        }
+        if (n > 0) {
+            head.store(h + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    const uint64_t mask;
+    std::unique_ptr<T[]> slots;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail{0};
+    alignas(CACHE_LINE_SIZE) uint64_t write_index = 0;
+    uint64_t head_cache = 0;
+};
@@ -1,6 +1,9 @@
 #pragma once
+#include "flow_control.hpp"
+#include <cstddef>
 #include <cstdint>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -16,6 +19,45 @@ struct Sample {
 };
 
 
+struct ServerOptions {
+    size_t ingest_shards = 0;
+    size_t ingest_workers = 0;
+    std::vector<int> cpu_affinity;
+    int listen_backlog = 4096;
+    int http_port = HTTP_PORT;
+    int crc32c_port = 0;
+    int udp_port = 0;
+    size_t udp_batch = 64;
+    int udp_receive_buffer = 4 * 1024 * 1024;
+    std::string shm_ingest;
+    uint32_t shm_rings = 16;
+    uint32_t shm_ring_capacity = 65536;
+    std::string shm_devices;
+    std::string capture_path;
+    uint32_t freshness_sample = 16;
+    uint64_t freshness_alert_ms = 0;
+    uint64_t device_lag_alert_ms = 0;
+    int clock_tick_us = 1000;
+    size_t pool_threads = 0;
+    uint64_t max_connections = 0;
+    uint32_t max_connections_per_ip = 0;
+    uint64_t idle_timeout_ms = 120000;
+    uint64_t frame_timeout_ms = 10000;
+    double connection_rate = 0;
+    double connection_burst = 0;
+    double device_rate = 0;
+    double device_burst = 0;
+    FlowPolicy flow_policy = FlowPolicy::Pause;
+    OverloadPolicy overload_policy = OverloadPolicy::Block;
+    uint64_t snapshot_interval_ms = 10;
+    size_t history_samples = 4096;
+    size_t history_budget_mb = 0;
+    std::string history_spill;
+    size_t query_parallelism = 0;
+    bool log_samples = true;
+};
+
+
 #pragma pack(push, 1)
 struct TelemetryMessage {
     uint8_t device_id{};
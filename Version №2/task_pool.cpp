@@ -0,0 +1,157 @@
+#include "task_pool.hpp"
+#include <chrono>
+
+
+TaskPool task_pool;
+
+static thread_local const TaskPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+
+const char* task_priority_name(TaskPriority priority) {
+    switch (priority) {
+        case TaskPriority::High: return "high";
+        case TaskPriority::Normal: return "normal";
+        case TaskPriority::Low: return "low";
+        default: return "unknown";
+    }
+}
+
+
+TaskPool::~TaskPool() {
+    stop();
+}
+
+void TaskPool::start(size_t count) {
+    if (active.exchange(true)) return;
+
+    stopping.store(false, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        workers[i]->thread = std::thread(&TaskPool::run, this, i);
+    }
+}
+
+void TaskPool::stop() {
+    if (!active.load()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping.store(true);
+    }
+    wakeup.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    workers.clear();
+    active.store(false);
+}
+
+void TaskPool::submit(TaskPriority priority, Job job) {
+    if (!active.load(std::memory_order_acquire)) {
+        job();
+        return;
+    }
+
+    size_t level = static_cast<size_t>(priority);
+    // Задача, порожденная внутри пула, остается в очереди своего потока;
+    // внешние задачи раскладываются по кругу, простаивающие потоки их украдут.
+    size_t index = current_pool == this ? current_worker
+                                        : next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        // Счетчик растет до публикации задачи: take() уменьшает его только
+        // после извлечения, и глубина очереди не уходит ниже нуля.
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        queued[level].fetch_add(1);
+        worker.queues[level].push_back(std::move(job));
+    }
+
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wakeup.notify_one();
+    }
+}
+
+TaskPool::Stats TaskPool::stats() const {
+    Stats result{};
+    result.threads = workers.size();
+    for (size_t level = 0; level < TASK_PRIORITY_COUNT; ++level) {
+        result.queued[level] = queued[level].load(std::memory_order_relaxed);
+        result.executed[level] = executed[level].load();
+    }
+    result.steals = steals.load();
+    return result;
+}
+
+bool TaskPool::has_queued() const {
+    for (const auto& depth : queued) {
+        if (depth.load() > 0) return true;
+    }
+    return false;
+}
+
+bool TaskPool::steal(size_t index, size_t level, Job& job) {
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker& victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        JobQueue& queue = victim.queues[level];
+        if (!queue.empty()) {
+            job = queue.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskPool::take(size_t index, Job& job) {
+    Worker& self = *workers[index];
+    for (size_t level = 0; level < TASK_PRIORITY_COUNT; ++level) {
+        if (queued[level].load(std::memory_order_relaxed) == 0) continue;
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            JobQueue& queue = self.queues[level];
+            if (!queue.empty()) {
+                job = queue.pop_front();
+                queued[level].fetch_sub(1, std::memory_order_relaxed);
+                executed[level].add(1);
+                return true;
+            }
+        }
+        if (steal(index, level, job)) {
+            queued[level].fetch_sub(1, std::memory_order_relaxed);
+            executed[level].add(1);
+            steals.add(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::run(size_t index) {
+    current_pool = this;
+    current_worker = index;
+
+    Job job;
+    while (true) {
+        if (take(index, job)) {
+            job();
+            job = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if (stopping.load()) break;
+        sleepers.fetch_add(1);
+        if (!has_queued()) {
+            wakeup.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        sleepers.fetch_sub(1);
+    }
+
+    current_pool = nullptr;
+}
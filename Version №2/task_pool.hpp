@@ -0,0 +1,121 @@
+#pragma once
+#include "counters.hpp"
+#include "spsc_ring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Классы приоритета: задача более высокого класса всегда берется раньше,
+// в том числе кражей у соседнего потока, поэтому аналитика не задерживает прием.
+enum class TaskPriority {
+    High,
+    Normal,
+    Low,
+    Count
+};
+
+static constexpr size_t TASK_PRIORITY_COUNT = static_cast<size_t>(TaskPriority::Count);
+
+const char* task_priority_name(TaskPriority priority);
+
+
+class TaskPool {
+public:
+    using Job = std::function<void()>;
+
+    struct Stats {
+        size_t threads;
+        uint64_t queued[TASK_PRIORITY_COUNT];
+        uint64_t executed[TASK_PRIORITY_COUNT];
+        uint64_t steals;
+    };
+
+    ~TaskPool();
+
+    void start(size_t threads);
+    void stop();
+
+    // Если пул не запущен, задача выполняется сразу в вызывающем потоке.
+    void submit(TaskPriority priority, Job job);
+
+    size_t threads() const { return workers.size(); }
+    Stats stats() const;
+
+private:
+    // Кольцевая очередь сохраняет емкость: в отличие от std::deque, поток
+    // задач в установившемся режиме не выделяет и не освобождает блоки.
+    class JobQueue {
+    public:
+        bool empty() const { return count == 0; }
+
+        void push_back(Job&& job) {
+            if (count == jobs.size()) grow();
+            jobs[(head + count) % jobs.size()] = std::move(job);
+            ++count;
+        }
+
+        Job pop_front() {
+            Job job = std::move(jobs[head]);
+            jobs[head] = nullptr;
+            head = (head + 1) % jobs.size();
+            --count;
+            return job;
+        }
+
+        Job pop_back() {
+            --count;
+            size_t index = (head + count) % jobs.size();
+            Job job = std::move(jobs[index]);
+            jobs[index] = nullptr;
+            return job;
+        }
+
+    private:
+        void grow() {
+            std::vector<Job> larger(std::max<size_t>(16, jobs.size() * 2));
+            for (size_t i = 0; i < count; ++i) {
+                larger[i] = std::move(jobs[(head + i) % jobs.size()]);
+            }
+            jobs.swap(larger);
+            head = 0;
+        }
+
+        std::vector<Job> jobs;
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Worker {
+        std::mutex mutex;
+        JobQueue queues[TASK_PRIORITY_COUNT];
+        std::thread thread;
+    };
+
+    void run(size_t index);
+    bool take(size_t index, Job& job);
+    bool steal(size_t index, size_t priority, Job& job);
+    bool has_queued() const;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> active{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> next_worker{0};
+
+    std::mutex sleep_mutex;
+    std::condition_variable wakeup;
+    std::atomic<size_t> sleepers{0};
+
+    std::atomic<uint64_t> queued[TASK_PRIORITY_COUNT] = {};
+    ShardedCounter executed[TASK_PRIORITY_COUNT];
+    ShardedCounter steals;
+};
+
+extern TaskPool task_pool;
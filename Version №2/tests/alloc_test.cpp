@@ -0,0 +1,296 @@
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "derived_metrics.hpp"
+#include "device_store.hpp"
+#include "history_store.hpp"
+#include "ingest_worker.hpp"
+#include "task_pool.hpp"
+#include "test_util.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <netinet/in.h>
+#include <new>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+// Хук подсчета выделений: глобальные operator new/delete заменены только в этом
+// тесте и считают все выделения процесса, включая потоки сервера.
+static std::atomic<uint64_t> heap_allocations{0};
+
+void* operator new(std::size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t alignment = static_cast<size_t>(align);
+    size_t rounded = (size + alignment - 1) / alignment * alignment;
+    if (void* ptr = std::aligned_alloc(alignment, rounded == 0 ? alignment : rounded)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+
+static const uint64_t BASE_TS = 1700000000000ULL;
+
+// Кадры заполняют все устройства, кроме последнего: на нем проверяется 404.
+static const uint32_t SILENT_DEVICE = MAX_DEVICES - 1;
+
+static std::vector<uint8_t> make_frames(size_t count) {
+    std::vector<uint8_t> frames(count * 14);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* frame = frames.data() + i * 14;
+        frame[0] = static_cast<uint8_t>(i % SILENT_DEVICE);
+        float value = static_cast<float>(i);
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        for (int b = 0; b < 4; ++b) frame[1 + b] = static_cast<uint8_t>(bits >> (24 - 8 * b));
+        uint64_t ts = BASE_TS + i;
+        for (int b = 0; b < 8; ++b) frame[5 + b] = static_cast<uint8_t>(ts >> (56 - 8 * b));
+        frame[13] = calculate_crc8(frame, 13);
+    }
+    return frames;
+}
+
+static uint64_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+static int connect_to(int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const void* data, size_t size) {
+    const char* cursor = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, cursor, size);
+        if (n <= 0) return false;
+        cursor += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Клиент не выделяет память: запрос и ответ живут в фиксированных буферах.
+// Возвращает код статуса ответа или 0 при ошибке соединения.
+static int http_get(int fd, const char* request) {
+    if (fd < 0) return 0;
+    bool ok = write_all(fd, request, std::strlen(request));
+    char response[65536];
+    size_t total = 0;
+    int status = 0;
+    while (ok) {
+        ssize_t n = read(fd, response + total, sizeof(response) - total);
+        if (n <= 0) break;
+        total += static_cast<size_t>(n);
+        if (status == 0 && total >= 12) status = std::atoi(response + 9);
+        if (total == sizeof(response)) total = 0;
+    }
+    close(fd);
+    return ok ? status : 0;
+}
+
+static int http_get(const char* request) {
+    return http_get(connect_to(options.http_port), request);
+}
+
+static constexpr size_t HTTP_BURST = 4;
+
+// Параллельные запросы держат одновременно несколько объектов пула
+// HttpExchange, поэтому прогреваются все объекты, которые затем может выдать
+// пул, а не только тот, что случайно оказался первым в списке свободных.
+static void http_burst(const char* request) {
+    int fds[HTTP_BURST];
+    for (size_t i = 0; i < HTTP_BURST; ++i) {
+        fds[i] = connect_to(options.http_port);
+        if (fds[i] >= 0 && !write_all(fds[i], request, std::strlen(request))) {
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+    for (int fd : fds) http_get(fd, "");
+}
+
+struct HttpCase {
+    const char* request;
+    int status;
+};
+
+// Каждый маршрут в основных форматах и с ошибками. Запросы к /query
+// охватывают окно, фильтр, группировку и разбор с ошибкой.
+static const HttpCase HTTP_CASES[] = {
+    {"GET /device/1/latest HTTP/1.1\r\nHost: localhost\r\n\r\n", 200},
+    {"GET /device/2/stats HTTP/1.1\r\nHost: localhost\r\n\r\n", 200},
+    {"GET /devices HTTP/1.1\r\nHost: localhost\r\n\r\n", 200},
+    {"GET /device/3/latest HTTP/1.1\r\nHost: localhost\r\nAccept: application/msgpack\r\n\r\n", 200},
+    {"GET /device/4/stats HTTP/1.1\r\nHost: localhost\r\nAccept: application/cbor\r\n\r\n", 200},
+    {"GET /device/255/latest HTTP/1.1\r\nHost: localhost\r\n\r\n", 404},
+    {"GET /unknown HTTP/1.1\r\nHost: localhost\r\n\r\n", 404},
+    {"GET /device/5/derived HTTP/1.1\r\nHost: localhost\r\n\r\n", 200},
+    {"GET /device/6/derived HTTP/1.1\r\nHost: localhost\r\nAccept: application/cbor\r\n\r\n", 200},
+    {"GET /device/255/derived HTTP/1.1\r\nHost: localhost\r\n\r\n", 404},
+    {"GET /query HTTP/1.1\r\nHost: localhost\r\n\r\n", 200},
+    {"GET /query?devices=1-8&from=-500&where=value>100&agg=count,sum,avg,min,max&group=device HTTP/1.1\r\n"
+     "Host: localhost\r\n\r\n", 200},
+    {"GET /query?devices=0-31&agg=avg,max&group=none HTTP/1.1\r\nHost: localhost\r\n"
+     "Accept: application/msgpack\r\n\r\n", 200},
+    {"GET /query?devices=9&agg=median HTTP/1.1\r\nHost: localhost\r\n\r\n", 400},
+    {"GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", 200},
+    {"GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: text/plain\r\n\r\n", 200},
+};
+static constexpr size_t HTTP_CASE_COUNT = sizeof(HTTP_CASES) / sizeof(HTTP_CASES[0]);
+static constexpr size_t HTTP_WARMUP = 8;
+
+static void run_http(size_t rounds) {
+    for (size_t round = 0; round < rounds; ++round) {
+        for (const HttpCase& http_case : HTTP_CASES) {
+            http_get(http_case.request);
+        }
+    }
+}
+
+static void wait_applied(uint64_t target) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (ingest_pipeline.applied_total() < target && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static void run_binary(const std::vector<int>& fds, const std::vector<uint8_t>& chunk, size_t rounds) {
+    uint64_t target = ingest_pipeline.applied_total() + fds.size() * rounds * (chunk.size() / 14);
+    for (size_t round = 0; round < rounds; ++round) {
+        for (int fd : fds) {
+            write_all(fd, chunk.data(), chunk.size());
+        }
+    }
+    wait_applied(target);
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    int port = config.get_int("port", 19201);
+    size_t connections = config.get_int("connections", 8);
+    size_t rounds = config.get_int("rounds", 20);
+    size_t http_rounds = config.get_int("http-rounds", 20);
+    size_t churn_rounds = config.get_int("churn-rounds", 3);
+    size_t churn_connections = config.get_int("churn-connections", 200);
+
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    // Свой HTTP-порт: тест не должен попасть в уже запущенный сервер.
+    options.http_port = config.get_int("http-port", 19280);
+    options.log_samples = false;
+    derived_metrics.configure({0.1, 0.01}, {});
+    derived_metrics.set_enabled(true);
+    history_store.configure(MAX_DEVICES, 2048);
+    options.query_parallelism = 2;
+    ingest_pipeline.start(1, apply_message);
+    task_pool.start(2);
+    IngestWorkerGroup group;
+    if (!group.start(port, 1, {}, 4096)) return 1;
+    std::thread http_thread(HTTP_server);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::vector<uint8_t> chunk = make_frames(1024);
+    std::vector<int> fds;
+    for (size_t i = 0; i < connections; ++i) {
+        fds.push_back(connect_to(port));
+    }
+
+    // Прогрев: буферы, пулы и история доходят до установившегося размера.
+    run_binary(fds, chunk, rounds);
+    run_http(2);
+
+    uint64_t before = heap_allocations.load();
+    run_binary(fds, chunk, rounds);
+    uint64_t binary_allocations = heap_allocations.load() - before;
+    std::printf("binary ingest: %zu frames, heap allocations: %lu\n",
+                connections * rounds * 1024, (unsigned long)binary_allocations);
+    TEST_CHECK(binary_allocations == 0, "binary ingest allocated %lu times", (unsigned long)binary_allocations);
+
+    // Каждый маршрут считается отдельно, чтобы неудача указывала на него.
+    for (size_t i = 0; i < HTTP_CASE_COUNT; ++i) {
+        const char* request = HTTP_CASES[i].request;
+        int line = static_cast<int>(std::strchr(request, '\r') - request);
+        // Прогрев маршрута: ответ проходит через все объекты пула запросов.
+        for (size_t round = 0; round < HTTP_WARMUP; ++round) {
+            http_burst(request);
+        }
+        before = heap_allocations.load();
+        int status = 0;
+        for (size_t round = 0; round < http_rounds; ++round) {
+            status = http_get(request);
+        }
+        uint64_t allocations = heap_allocations.load() - before;
+        std::printf("%.*s: status %d, heap allocations: %lu\n", line, request, status, (unsigned long)allocations);
+        TEST_CHECK(status == HTTP_CASES[i].status, "%.*s: status %d, expected %d", line, request, status,
+                   HTTP_CASES[i].status);
+        TEST_CHECK(allocations == 0, "%.*s allocated %lu times", line, request, (unsigned long)allocations);
+    }
+
+    for (int fd : fds) close(fd);
+
+    std::vector<uint64_t> rss;
+    for (size_t round = 0; round < churn_rounds; ++round) {
+        std::vector<int> churn;
+        for (size_t i = 0; i < churn_connections; ++i) {
+            int fd = connect_to(port);
+            if (fd >= 0) {
+                write_all(fd, chunk.data(), 14 * 10 + 5);
+                churn.push_back(fd);
+            }
+        }
+        while (group.accepted() < connections + (round + 1) * churn_connections) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (int fd : churn) close(fd);
+        while (group.active_connections() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        run_http(1);
+        rss.push_back(resident_bytes());
+    }
+    if (!rss.empty()) {
+        std::printf("connection churn: %zu rounds x %zu connections, rss first=%.1f MB last=%.1f MB\n",
+                    churn_rounds, churn_connections, rss.front() / 1048576.0, rss.back() / 1048576.0);
+    }
+
+    running = false;
+    http_thread.join();
+    group.stop();
+    task_pool.stop();
+    ingest_pipeline.stop();
+    return test_result("alloc_test");
+}
@@ -0,0 +1,99 @@
+#include "binary_message.hpp"
+#include "frame_decoder.hpp"
+#include "test_util.hpp"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+struct DecodeBuffers {
+    std::vector<uint8_t> device_id;
+    std::vector<float> value;
+    std::vector<uint64_t> timestamp;
+    std::vector<uint8_t> valid;
+
+    explicit DecodeBuffers(size_t frames)
+        : device_id(frames), value(frames), timestamp(frames), valid(frames) {}
+
+    DecodedFrames view() {
+        return DecodedFrames{device_id.data(), value.data(), timestamp.data(), valid.data()};
+    }
+};
+
+// Случайные кадры, около 10% с одним испорченным битом.
+static std::vector<uint8_t> make_frames(size_t frames, std::mt19937_64& rng) {
+    std::vector<uint8_t> data(frames * LEGACY_FRAME_SIZE);
+    for (size_t i = 0; i < frames; ++i) {
+        uint8_t* frame = data.data() + i * LEGACY_FRAME_SIZE;
+        uint64_t a = rng();
+        uint64_t b = rng();
+        std::memcpy(frame, &a, 8);
+        std::memcpy(frame + 8, &b, 5);
+        frame[13] = calculate_crc8(frame, 13);
+        if (rng() % 10 == 0) {
+            frame[rng() % LEGACY_FRAME_SIZE] ^= static_cast<uint8_t>(1u << (rng() % 8));
+        }
+    }
+    return data;
+}
+
+static size_t decode_with(DecoderKind kind, const std::vector<uint8_t>& data, size_t frames, DecodeBuffers& out) {
+    switch (kind) {
+        case DecoderKind::Avx2: return decode_frames_avx2(data.data(), frames, out.view());
+        case DecoderKind::Ssse3: return decode_frames_ssse3(data.data(), frames, out.view());
+        default: return decode_frames_scalar(data.data(), frames, out.view());
+    }
+}
+
+// Скалярный путь сверяется с parse_binary_message, векторные — со скалярным.
+static void check_frames(size_t frames, std::mt19937_64& rng) {
+    std::vector<uint8_t> data = make_frames(frames, rng);
+    DecodeBuffers expected(frames);
+    size_t expected_valid = decode_frames_scalar(data.data(), frames, expected.view());
+
+    size_t reference_valid = 0;
+    for (size_t i = 0; i < frames; ++i) {
+        uint8_t device_id;
+        float value;
+        uint64_t timestamp;
+        bool valid = parse_binary_message(data.data() + i * LEGACY_FRAME_SIZE, device_id, value, timestamp);
+        reference_valid += valid;
+        TEST_CHECK(valid == static_cast<bool>(expected.valid[i]), "scalar validity differs at frame %zu of %zu",
+                   i, frames);
+        if (valid && valid == static_cast<bool>(expected.valid[i])) {
+            TEST_CHECK(device_id == expected.device_id[i] && std::memcmp(&value, &expected.value[i], 4) == 0 &&
+                           timestamp == expected.timestamp[i],
+                       "scalar fields differ at frame %zu of %zu", i, frames);
+        }
+    }
+    TEST_CHECK(reference_valid == expected_valid, "scalar valid count %zu, expected %zu", expected_valid,
+               reference_valid);
+
+    for (DecoderKind kind : {DecoderKind::Ssse3, DecoderKind::Avx2}) {
+        if (!decoder_supported(kind)) {
+            std::printf("%s not supported, skipped\n", decoder_name(kind));
+            continue;
+        }
+        DecodeBuffers actual(frames);
+        size_t actual_valid = decode_with(kind, data, frames, actual);
+        TEST_CHECK(actual_valid == expected_valid, "%s valid count %zu, scalar %zu (%zu frames)",
+                   decoder_name(kind), actual_valid, expected_valid, frames);
+        TEST_CHECK(actual.device_id == expected.device_id && actual.timestamp == expected.timestamp &&
+                       actual.valid == expected.valid &&
+                       std::memcmp(actual.value.data(), expected.value.data(), frames * sizeof(float)) == 0,
+                   "%s output differs from scalar (%zu frames)", decoder_name(kind), frames);
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(12345);
+    // Неверные кадры пишут в лог через parse_binary_message.
+    std::freopen("/dev/null", "w", stderr);
+
+    // Длины вокруг шагов векторных путей и хвостов.
+    for (size_t frames : {0, 1, 2, 3, 4, 5, 7, 8, 9, 63, 255, 4097, 65536}) {
+        check_frames(frames, rng);
+    }
+    return test_result("decode_test");
+}
@@ -0,0 +1,77 @@
+#include "device_store.hpp"
+#include "device_view.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+// Сколько отображений сегмента видно в /proc/self/maps.
+static int mappings_of(const std::string& name) {
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    int count = 0;
+    while (std::getline(maps, line)) {
+        if (line.find(name) != std::string::npos) ++count;
+    }
+    return count;
+}
+
+int main() {
+    std::string name = "/telemetry_view_test_" + std::to_string(getpid());
+    TEST_CHECK(device_store.publish(name), "publish %s", name.c_str());
+    for (int i = 1; i <= 60; ++i) {
+        device_store.apply(3, i, 1000 + i);
+    }
+
+    DeviceTableView view;
+    TEST_CHECK(view.open(name), "open view");
+    DeviceData data;
+    Sample latest;
+    DeviceSummary summary;
+    TEST_CHECK(view.read(3, data) == SlotRead::Ok && data.count == RING_SIZE, "read device 3");
+    TEST_CHECK(view.latest(3, latest) == SlotRead::Ok && latest.value == 60 && latest.timestamp == 1060,
+               "latest device 3");
+    TEST_CHECK(view.stats(3, summary) == SlotRead::Ok && summary.min == 11 && summary.max == 60 &&
+                   summary.average == 35.5 && summary.count == RING_SIZE && summary.applied == 60,
+               "stats device 3: min %f max %f avg %f count %d applied %lu", summary.min, summary.max,
+               summary.average, summary.count, static_cast<unsigned long>(summary.applied));
+    TEST_CHECK(view.read(4, data) == SlotRead::Empty, "device 4 has no samples");
+
+    // Писатель умер посреди записи: номер слота остался нечетным.
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    size_t size = sizeof(DeviceTableHeader) + sizeof(DeviceSlot) * MAX_DEVICES;
+    void* base = fd >= 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (fd >= 0) close(fd);
+    TEST_CHECK(base != MAP_FAILED, "map segment for writing");
+    if (base != MAP_FAILED) {
+        DeviceSlot* slots = reinterpret_cast<DeviceSlot*>(static_cast<DeviceTableHeader*>(base) + 1);
+        uint32_t sequence = slots[3].sequence.load();
+        slots[3].sequence.store(sequence + 1);
+        auto start = std::chrono::steady_clock::now();
+        SlotRead status = view.read(3, data, 5'000'000);
+        auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        TEST_CHECK(status == SlotRead::Unavailable, "stuck slot reported unavailable");
+        TEST_CHECK(waited.count() < 1000, "stuck slot read returned after %ld ms", static_cast<long>(waited.count()));
+        TEST_CHECK(view.latest(4, latest, 5'000'000) == SlotRead::Empty, "other slots still readable");
+        slots[3].sequence.store(sequence);
+        TEST_CHECK(view.read(3, data) == SlotRead::Ok, "slot readable again after recovery");
+        munmap(base, size);
+    }
+
+    view.close();
+    TEST_CHECK(mappings_of(name) == 1, "only the store maps the segment before unpublish");
+    device_store.unpublish();
+    TEST_CHECK(mappings_of(name) == 0, "unpublish removes the mapping");
+    int reopened = shm_open(name.c_str(), O_RDONLY, 0);
+    TEST_CHECK(reopened < 0, "unpublish removes the name");
+    if (reopened >= 0) close(reopened);
+    TEST_CHECK(device_store.latest(3, latest) && latest.value == 60, "store keeps its data after unpublish");
+    device_store.apply(3, 61, 1061);
+    TEST_CHECK(device_store.latest(3, latest) && latest.value == 61, "store keeps applying after unpublish");
+
+    return test_result("device_view_test");
+}
@@ -0,0 +1,39 @@
+#include "flow_control.hpp"
+#include "test_util.hpp"
+#include <cmath>
+#include <cstdio>
+
+
+static const uint64_t SECOND_NS = 1000000000ULL;
+
+// Производитель берет порцию токенов, как IngestProducer::admit_device, и
+// обращается к лимитеру на каждом шаге часов. Возвращает число допущенных
+// сэмплов за вычетом начального запаса.
+static uint64_t admitted(DeviceRateLimiter& limiter, uint64_t step_ns, uint64_t seconds) {
+    uint64_t total = 0;
+    for (uint64_t now = step_ns; now <= seconds * SECOND_NS; now += step_ns) {
+        total += limiter.take(7, limiter.portion(), now);
+    }
+    return total;
+}
+
+int main() {
+    static DeviceRateLimiter limiter;
+    const double rates[] = {600, 1500, 1999};
+    // Шаг 1 мс — разрешение грубых часов; 250 мкс — частые вызовы под нагрузкой.
+    const uint64_t steps[] = {1000000, 250000};
+    const uint64_t seconds = 10;
+
+    for (double rate : rates) {
+        for (uint64_t step : steps) {
+            limiter.configure(rate, 0);
+            double burst = rate;
+            double measured = (static_cast<double>(admitted(limiter, step, seconds)) - burst) / seconds;
+            std::printf("rate %.0f/s, step %lu us: admitted %.1f/s\n", rate, (unsigned long)(step / 1000),
+                        measured);
+            TEST_CHECK(std::fabs(measured - rate) <= rate * 0.01, "rate %.0f/s, step %lu us: admitted %.1f/s",
+                       rate, (unsigned long)(step / 1000), measured);
+        }
+    }
+    return test_result("flow_test");
+}
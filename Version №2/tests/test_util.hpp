@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdio>
+
+
+// Минимальные проверки для тестов ctest: каждая неудача печатается, а
+// итог main — число неудач.
+inline int test_failures = 0;
+
+#define TEST_CHECK(condition, ...)                                        \
+    do {                                                                  \
+        if (!(condition)) {                                               \
+            ++test_failures;                                              \
+            std::printf("FAILED %s:%d: ", __FILE__, __LINE__);            \
+            std::printf(__VA_ARGS__);                                     \
+            std::printf("\n");                                            \
+        }                                                                 \
+    } while (0)
+
+inline int test_result(const char* name) {
+    std::printf("%s: %s\n", name, test_failures == 0 ? "OK" : "FAILED");
+    return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include "timer_wheel.hpp"
+
+
+TimerWheel::TimerWheel(uint64_t now_ms, uint64_t tick_ms, size_t slots)
+    : tick_ms(std::max<uint64_t>(1, tick_ms)),
+      slot_count(std::max<size_t>(1, slots)),
+      current_tick(now_ms / this->tick_ms),
+      heads(slot_count + 1, nullptr) {}
+
+void TimerWheel::schedule(Timer& timer, uint64_t deadline_ms) {
+    if (scheduled(timer)) {
+        // Слот с более ранним сроком все равно будет пройден раньше нового срока.
+        if (deadline_ms >= timer.deadline_ms) {
+            timer.deadline_ms = deadline_ms;
+            return;
+        }
+        unlink(timer);
+    }
+    timer.deadline_ms = deadline_ms;
+    link(timer, slot_for(deadline_ms));
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    if (scheduled(timer)) {
+        unlink(timer);
+    }
+}
+
+size_t TimerWheel::slot_for(uint64_t deadline_ms) const {
+    uint64_t tick = std::max(deadline_ms / tick_ms, current_tick + 1);
+    return static_cast<size_t>(tick % slot_count);
+}
+
+void TimerWheel::link(Timer& timer, size_t slot) {
+    timer.slot = slot;
+    timer.prev = nullptr;
+    timer.next = heads[slot];
+    if (timer.next != nullptr) timer.next->prev = &timer;
+    heads[slot] = &timer;
+    ++count;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    if (timer.prev != nullptr) {
+        timer.prev->next = timer.next;
+    } else {
+        heads[timer.slot] = timer.next;
+    }
+    if (timer.next != nullptr) timer.next->prev = timer.prev;
+    timer.prev = timer.next = nullptr;
+    timer.slot = NOT_LINKED;
+    --count;
+}
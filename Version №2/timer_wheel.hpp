@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Хешированное колесо таймеров: таймер лежит в слоте тика своего срока,
+// постановка и отмена стоят O(1) и не выделяют память. Продление срока
+// ленивое: меняется только deadline_ms, а таймер с непрошедшим сроком
+// переносится в нужный слот, когда колесо до него доходит. Однопоточное.
+class TimerWheel {
+public:
+    static constexpr size_t NOT_LINKED = static_cast<size_t>(-1);
+
+    struct Timer {
+        uint64_t deadline_ms = 0;
+
+    private:
+        friend class TimerWheel;
+        Timer* prev = nullptr;
+        Timer* next = nullptr;
+        size_t slot = NOT_LINKED;
+    };
+
+    TimerWheel(uint64_t now_ms, uint64_t tick_ms = 100, size_t slots = 512);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    void schedule(Timer& timer, uint64_t deadline_ms);
+    void cancel(Timer& timer);
+
+    static bool scheduled(const Timer& timer) { return timer.slot != NOT_LINKED; }
+    size_t size() const { return count; }
+
+    // Обходит слоты прошедших тиков и вызывает fire(timer) для истекших
+    // таймеров. К моменту вызова таймер уже снят с колеса, поэтому fire может
+    // поставить его заново или уничтожить владельца.
+    template <typename Fire>
+    void advance(uint64_t now_ms, Fire&& fire) {
+        uint64_t target = now_ms / tick_ms;
+        if (target <= current_tick) return;
+        uint64_t steps = std::min<uint64_t>(target - current_tick, slot_count);
+        uint64_t first = current_tick + 1;
+        current_tick = target;
+
+        for (uint64_t step = 0; step < steps; ++step) {
+            size_t slot = static_cast<size_t>((first + step) % slot_count);
+            while (heads[slot] != nullptr) {
+                Timer& timer = *heads[slot];
+                unlink(timer);
+                link(timer, slot_count);
+            }
+            while (heads[slot_count] != nullptr) {
+                Timer& timer = *heads[slot_count];
+                unlink(timer);
+                if (timer.deadline_ms <= now_ms) {
+                    fire(timer);
+                } else {
+                    link(timer, slot_for(timer.deadline_ms));
+                }
+            }
+        }
+    }
+
+private:
+    size_t slot_for(uint64_t deadline_ms) const;
+    void link(Timer& timer, size_t slot);
+    void unlink(Timer& timer);
+
+    uint64_t tick_ms;
+    size_t slot_count;
+    uint64_t current_tick;
+    // Последний элемент — промежуточный список обходимого слота.
+    std::vector<Timer*> heads;
+    size_t count = 0;
+};
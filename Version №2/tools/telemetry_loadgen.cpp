@@ -0,0 +1,421 @@
+#include "batch_frame.hpp"
+#include "binary_message.hpp"
+#include "config.hpp"
+#include "frame_decoder.hpp"
+#include "latency_histogram.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+using Clock = std::chrono::steady_clock;
+
+
+struct LoadConfig {
+    std::string host;
+    int port;
+    int http_port;
+    size_t connections;
+    size_t threads;
+    uint64_t rate;
+    double duration;
+    size_t batch;
+    bool batch_protocol;
+    int devices;
+    uint64_t http_rate;
+    size_t http_threads;
+    std::string output;
+};
+
+
+struct Payload {
+    std::vector<uint8_t> hello;
+    std::vector<uint8_t> blob;
+    size_t chunk_bytes = 0;
+    double samples_per_byte = 0;
+};
+
+
+struct SenderStats {
+    uint64_t bytes = 0;
+    uint64_t connected = 0;
+    uint64_t connect_failures = 0;
+    uint64_t write_errors = 0;
+};
+
+
+struct HttpStats {
+    LatencyHistogram corrected;
+    LatencyHistogram service;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+};
+
+
+static std::atomic<bool> stop_requested{false};
+
+static void handle_signal(int) {
+    stop_requested = true;
+}
+
+static sockaddr_in make_address(const std::string& host, int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &address.sin_addr);
+    return address;
+}
+
+static void put_be(uint8_t* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<uint8_t>(value >> ((bytes - 1 - i) * 8));
+    }
+}
+
+static Payload build_payload(const LoadConfig& cfg) {
+    static constexpr size_t CHUNKS = 64;
+    Payload payload;
+    uint64_t samples = 0;
+    uint64_t base_ts = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    if (cfg.batch_protocol) {
+        write_protocol_hello(payload.hello, PROTOCOL_BATCH_V1);
+        std::vector<uint64_t> timestamps(cfg.batch);
+        std::vector<float> values(cfg.batch);
+        for (size_t chunk = 0; chunk < CHUNKS; ++chunk) {
+            for (size_t i = 0; i < cfg.batch; ++i) {
+                timestamps[i] = base_ts + chunk * cfg.batch + i;
+                values[i] = 20.0f + static_cast<float>((chunk * 7 + i) % 100) / 10.0f;
+            }
+            encode_batch_frame(static_cast<uint8_t>(chunk % cfg.devices), timestamps.data(), values.data(),
+                               cfg.batch, payload.blob);
+            samples += cfg.batch;
+        }
+        payload.chunk_bytes = payload.blob.size() / CHUNKS;
+    } else {
+        payload.blob.resize(CHUNKS * cfg.batch * LEGACY_FRAME_SIZE);
+        for (size_t i = 0; i < CHUNKS * cfg.batch; ++i) {
+            uint8_t* frame = payload.blob.data() + i * LEGACY_FRAME_SIZE;
+            float value = 20.0f + static_cast<float>(i % 100) / 10.0f;
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            frame[0] = static_cast<uint8_t>(i % cfg.devices);
+            put_be(frame + 1, bits, 4);
+            put_be(frame + 5, base_ts + i, 8);
+            frame[13] = calculate_crc8(frame, 13);
+        }
+        samples = CHUNKS * cfg.batch;
+        payload.chunk_bytes = cfg.batch * LEGACY_FRAME_SIZE;
+    }
+    payload.samples_per_byte = static_cast<double>(samples) / static_cast<double>(payload.blob.size());
+    return payload;
+}
+
+static void run_sender(const LoadConfig& cfg, const Payload& payload, size_t connections,
+                       uint64_t rate, Clock::time_point start, Clock::time_point end, SenderStats& stats) {
+    sockaddr_in address = make_address(cfg.host, cfg.port);
+    std::vector<int> fds;
+    std::vector<size_t> offsets;
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    for (size_t i = 0; i < connections; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+            if (fd >= 0) close(fd);
+            ++stats.connect_failures;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (!payload.hello.empty() &&
+            write(fd, payload.hello.data(), payload.hello.size()) != static_cast<ssize_t>(payload.hello.size())) {
+            close(fd);
+            ++stats.connect_failures;
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLOUT;
+        ev.data.u32 = static_cast<uint32_t>(fds.size());
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        offsets.push_back((fds.size() * payload.chunk_bytes) % payload.blob.size());
+        fds.push_back(fd);
+    }
+    stats.connected = fds.size();
+    if (fds.empty()) {
+        close(epoll_fd);
+        return;
+    }
+
+    double bytes_per_second = rate > 0 ? static_cast<double>(rate) / payload.samples_per_byte : 0;
+    std::vector<epoll_event> events(256);
+    size_t next = 0;
+
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+        Clock::time_point now = Clock::now();
+        if (now >= end) break;
+
+        uint64_t budget = UINT64_MAX;
+        if (rate > 0) {
+            double allowed = std::chrono::duration<double>(now - start).count() * bytes_per_second;
+            budget = allowed > static_cast<double>(stats.bytes) ? static_cast<uint64_t>(allowed) - stats.bytes : 0;
+            if (budget < payload.chunk_bytes) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+        }
+
+        bool progress = false;
+        for (size_t visited = 0; visited < fds.size() && budget >= payload.chunk_bytes; ++visited) {
+            size_t index = next;
+            next = (next + 1) % fds.size();
+            if (fds[index] < 0) continue;
+
+            size_t offset = offsets[index];
+            size_t length = std::min(payload.chunk_bytes, payload.blob.size() - offset);
+            ssize_t n = write(fds[index], payload.blob.data() + offset, length);
+            if (n > 0) {
+                offsets[index] = (offset + static_cast<size_t>(n)) % payload.blob.size();
+                stats.bytes += static_cast<uint64_t>(n);
+                budget -= std::min<uint64_t>(budget, static_cast<uint64_t>(n));
+                progress = true;
+            } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                ++stats.write_errors;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[index], nullptr);
+                close(fds[index]);
+                fds[index] = -1;
+            }
+        }
+
+        if (!progress) {
+            epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 1);
+        }
+    }
+
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+    close(epoll_fd);
+}
+
+static bool http_get(const LoadConfig& cfg, const std::string& path, std::string* body) {
+    sockaddr_in address = make_address(cfg.host, cfg.http_port);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return false;
+    }
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + cfg.host + "\r\nConnection: close\r\n\r\n";
+    if (write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        close(fd);
+        return false;
+    }
+
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        response.append(buffer, static_cast<size_t>(n));
+    }
+    close(fd);
+
+    bool ok = response.compare(0, 12, "HTTP/1.1 200") == 0 || response.compare(0, 12, "HTTP/1.1 404") == 0;
+    if (body != nullptr) {
+        size_t header_end = response.find("\r\n\r\n");
+        *body = header_end == std::string::npos ? std::string() : response.substr(header_end + 4);
+    }
+    return ok;
+}
+
+static void run_http(const LoadConfig& cfg, std::atomic<uint64_t>& next_request, Clock::time_point start,
+                     Clock::time_point end, HttpStats& stats) {
+    std::chrono::duration<double> interval(1.0 / static_cast<double>(cfg.http_rate));
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+        uint64_t index = next_request.fetch_add(1, std::memory_order_relaxed);
+        Clock::time_point intended = start + std::chrono::duration_cast<Clock::duration>(interval * index);
+        if (intended >= end) break;
+        std::this_thread::sleep_until(intended);
+
+        Clock::time_point sent = Clock::now();
+        std::string path = "/device/" + std::to_string(index % cfg.devices) + "/latest";
+        bool ok = http_get(cfg, path, nullptr);
+        Clock::time_point done = Clock::now();
+
+        ++stats.requests;
+        if (!ok) ++stats.errors;
+        stats.corrected.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - intended).count());
+        stats.service.record(std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent).count());
+    }
+}
+
+static long long server_total_samples(const LoadConfig& cfg) {
+    std::string body;
+    if (!http_get(cfg, "/metrics", &body)) return -1;
+    size_t pos = body.find("\"total_samples\": ");
+    if (pos == std::string::npos) return -1;
+    return std::atoll(body.c_str() + pos + 17);
+}
+
+static void write_latency(std::ostringstream& json, const char* name, const LatencySummary& summary) {
+    json << "\"" << name << "\": {\"p50\": " << summary.p50 / 1000.0
+         << ", \"p90\": " << summary.p90 / 1000.0
+         << ", \"p99\": " << summary.p99 / 1000.0
+         << ", \"p999\": " << summary.p999 / 1000.0
+         << ", \"max\": " << summary.max / 1000.0 << "}";
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    if (config.has("help")) {
+        std::cout << "Использование: telemetry_loadgen [опции]\n"
+                  << "  --host=<ip>            Адрес сервера (по умолчанию: 127.0.0.1)\n"
+                  << "  --port=<n>             Бинарный порт (по умолчанию: 9001)\n"
+                  << "  --http-port=<n>        HTTP порт (по умолчанию: 8080)\n"
+                  << "  --connections=<n>      Число бинарных соединений (по умолчанию: 1000)\n"
+                  << "  --threads=<n>          Потоков отправки (по умолчанию: 4)\n"
+                  << "  --rate=<n>             Сэмплов в секунду всего, 0 - без ограничения (по умолчанию: 0)\n"
+                  << "  --duration=<sec>       Длительность прогона (по умолчанию: 10)\n"
+                  << "  --batch=<n>            Кадров в одной записи (по умолчанию: 64)\n"
+                  << "  --protocol=legacy|batch  Формат кадров (по умолчанию: legacy)\n"
+                  << "  --devices=<n>          Число устройств 1..256 (по умолчанию: 256)\n"
+                  << "  --http-rate=<n>        HTTP запросов в секунду, 0 - отключить (по умолчанию: 200)\n"
+                  << "  --http-threads=<n>     Потоков HTTP клиента (по умолчанию: 4)\n"
+                  << "  --output=<file>        Записать JSON отчет в файл вместо stdout\n";
+        return 0;
+    }
+
+    LoadConfig cfg;
+    cfg.host = config.get_string("host", "127.0.0.1");
+    cfg.port = config.get_int("port", BINARY_PORT);
+    cfg.http_port = config.get_int("http-port", HTTP_PORT);
+    cfg.connections = std::max(1, config.get_int("connections", 1000));
+    cfg.threads = std::max(1, config.get_int("threads", 4));
+    cfg.rate = std::max(0, config.get_int("rate", 0));
+    cfg.duration = std::max(0.1, config.get_double("duration", 10.0));
+    cfg.batch = std::min(static_cast<int>(MAX_BATCH_SAMPLES), std::max(1, config.get_int("batch", 64)));
+    cfg.batch_protocol = config.get_string("protocol", "legacy") == "batch";
+    cfg.devices = std::min(256, std::max(1, config.get_int("devices", 256)));
+    cfg.http_rate = std::max(0, config.get_int("http-rate", 200));
+    cfg.http_threads = std::max(1, config.get_int("http-threads", 4));
+    cfg.output = config.get_string("output");
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, handle_signal);
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    Payload payload = build_payload(cfg);
+    long long samples_before = server_total_samples(cfg);
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(cfg.duration));
+
+    std::vector<SenderStats> sender_stats(cfg.threads);
+    std::vector<std::thread> senders;
+    for (size_t t = 0; t < cfg.threads; ++t) {
+        size_t connections = cfg.connections / cfg.threads + (t < cfg.connections % cfg.threads ? 1 : 0);
+        uint64_t rate = cfg.rate / cfg.threads + (t < cfg.rate % cfg.threads ? 1 : 0);
+        senders.emplace_back(run_sender, std::cref(cfg), std::cref(payload), connections,
+                             cfg.rate > 0 ? std::max<uint64_t>(1, rate) : 0, start, end,
+                             std::ref(sender_stats[t]));
+    }
+
+    std::vector<std::unique_ptr<HttpStats>> http_stats;
+    std::vector<std::thread> http_clients;
+    std::atomic<uint64_t> next_request{0};
+    if (cfg.http_rate > 0) {
+        for (size_t t = 0; t < cfg.http_threads; ++t) {
+            http_stats.push_back(std::make_unique<HttpStats>());
+            http_clients.emplace_back(run_http, std::cref(cfg), std::ref(next_request), start, end,
+                                      std::ref(*http_stats.back()));
+        }
+    }
+
+    for (auto& sender : senders) sender.join();
+    for (auto& client : http_clients) client.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    long long samples_after = server_total_samples(cfg);
+
+    SenderStats total;
+    for (const SenderStats& stats : sender_stats) {
+        total.bytes += stats.bytes;
+        total.connected += stats.connected;
+        total.connect_failures += stats.connect_failures;
+        total.write_errors += stats.write_errors;
+    }
+    uint64_t samples_sent = static_cast<uint64_t>(static_cast<double>(total.bytes) * payload.samples_per_byte);
+
+    LatencyTotals corrected{};
+    LatencyTotals service{};
+    uint64_t http_requests = 0;
+    uint64_t http_errors = 0;
+    for (const auto& stats : http_stats) {
+        stats->corrected.merge_into(corrected);
+        stats->service.merge_into(service);
+        http_requests += stats->requests;
+        http_errors += stats->errors;
+    }
+
+    std::ostringstream json;
+    json.setf(std::ios::fixed);
+    json.precision(1);
+    json << "{\"config\": {\"host\": \"" << cfg.host << "\", \"port\": " << cfg.port
+         << ", \"connections\": " << cfg.connections << ", \"threads\": " << cfg.threads
+         << ", \"rate\": " << cfg.rate << ", \"duration\": " << cfg.duration
+         << ", \"batch\": " << cfg.batch << ", \"protocol\": \"" << (cfg.batch_protocol ? "batch" : "legacy")
+         << "\", \"devices\": " << cfg.devices << ", \"http_rate\": " << cfg.http_rate << "}"
+         << ", \"elapsed_s\": " << elapsed
+         << ", \"ingest\": {\"connected\": " << total.connected
+         << ", \"connect_failures\": " << total.connect_failures
+         << ", \"write_errors\": " << total.write_errors
+         << ", \"bytes_sent\": " << total.bytes
+         << ", \"samples_sent\": " << samples_sent
+         << ", \"samples_per_sec\": " << samples_sent / elapsed
+         << ", \"mb_per_sec\": " << total.bytes / elapsed / 1e6;
+    if (samples_before >= 0 && samples_after >= 0) {
+        json << ", \"server_applied\": " << samples_after - samples_before
+             << ", \"server_applied_per_sec\": " << (samples_after - samples_before) / elapsed;
+    }
+    json << "}, \"http\": {\"requests\": " << http_requests << ", \"errors\": " << http_errors
+         << ", \"requests_per_sec\": " << http_requests / elapsed << ", ";
+    write_latency(json, "latency_us", summarize_latency(corrected));
+    json << ", ";
+    write_latency(json, "service_time_us", summarize_latency(service));
+    json << "}}\n";
+
+    if (cfg.output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream out(cfg.output);
+        out << json.str();
+    }
+    return total.connected > 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+#include "batch_frame.hpp"
+#include "capture.hpp"
+#include "config.hpp"
+#include "frame_decoder.hpp"
+#include "structs.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+
+using Clock = std::chrono::steady_clock;
+
+
+struct ReplayEvent {
+    uint64_t timestamp_ns;
+    uint32_t connection;
+    CaptureKind kind;
+    const uint8_t* data;
+    uint32_t length;
+};
+
+
+struct ReplayStats {
+    uint64_t bytes = 0;
+    uint64_t events = 0;
+    uint64_t connections = 0;
+    uint64_t failures = 0;
+    uint64_t max_lag_ns = 0;
+};
+
+
+static bool load_capture(const std::string& path, std::vector<uint8_t>& content, std::vector<ReplayEvent>& events) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    if (content.size() < sizeof(CaptureFileHeader)) return false;
+    CaptureFileHeader header;
+    std::memcpy(&header, content.data(), sizeof(header));
+    if (std::memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != CAPTURE_VERSION) {
+        return false;
+    }
+
+    size_t offset = sizeof(CaptureFileHeader);
+    while (offset + sizeof(CaptureRecord) <= content.size()) {
+        CaptureRecord record;
+        std::memcpy(&record, content.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (offset + record.length > content.size()) break;
+        events.push_back({record.timestamp_ns, record.connection, static_cast<CaptureKind>(record.kind),
+                          content.data() + offset, record.length});
+        offset += record.length;
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const ReplayEvent& a, const ReplayEvent& b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+    return true;
+}
+
+struct SampleCounter {
+    uint64_t samples = 0;
+    void push(const IngestMessage&) { ++samples; }
+};
+
+// Считает сэмплы в потоках соединений так же, как их разбирает сервер:
+// приветствие выбирает протокол, без него кадры старые (14 байт или 17 с
+// CRC-32C). Кадры с неверной контрольной суммой не считаются.
+static uint64_t count_samples(const std::vector<ReplayEvent>& events, bool crc32c_default) {
+    std::unordered_map<uint32_t, std::vector<uint8_t>> streams;
+    for (const ReplayEvent& event : events) {
+        if (event.kind == CaptureKind::Data) {
+            streams[event.connection].insert(streams[event.connection].end(), event.data,
+                                             event.data + event.length);
+        }
+    }
+
+    SampleCounter counter;
+    for (const auto& [id, stream] : streams) {
+        const uint8_t* data = stream.data();
+        size_t length = stream.size();
+        size_t offset = 0;
+        uint8_t version = crc32c_default ? PROTOCOL_LEGACY_CRC32C : 0;
+        if (length >= PROTOCOL_HELLO_SIZE && parse_protocol_hello(data, version)) {
+            offset = PROTOCOL_HELLO_SIZE;
+        }
+
+        if (version == 0) {
+            for (; offset + LEGACY_FRAME_SIZE <= length; offset += LEGACY_FRAME_SIZE) {
+                const uint8_t* frame = data + offset;
+                counter.samples += xor_bytes(frame, LEGACY_FRAME_SIZE - 1) == frame[LEGACY_FRAME_SIZE - 1];
+            }
+        } else if (version == PROTOCOL_LEGACY_CRC32C) {
+            IngestMessage msg;
+            for (; offset + CRC32C_FRAME_SIZE <= length; offset += CRC32C_FRAME_SIZE) {
+                counter.samples += parse_crc32c_frame(data + offset, msg);
+            }
+        } else {
+            FrameIntegrity integrity = version == PROTOCOL_BATCH_CRC32C ? FrameIntegrity::Crc32c : FrameIntegrity::Xor;
+            while (offset < length) {
+                size_t consumed = 0;
+                SampleCounter frame;
+                FrameStatus status = decode_batch_frame(data + offset, length - offset, consumed, frame, integrity);
+                if (status == FrameStatus::NeedMore || status == FrameStatus::Malformed) break;
+                counter.samples += frame.samples;
+                offset += consumed;
+            }
+        }
+    }
+    return counter.samples;
+}
+
+static int open_connection(const sockaddr_in& address) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool write_all(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void replay_thread(const std::vector<const ReplayEvent*>& events, const sockaddr_in& address,
+                          double speed, Clock::time_point start, uint64_t base_ns, ReplayStats& stats) {
+    std::unordered_map<uint32_t, int> sockets;
+
+    for (const ReplayEvent* event : events) {
+        if (speed > 0) {
+            auto offset = std::chrono::nanoseconds(static_cast<uint64_t>((event->timestamp_ns - base_ns) / speed));
+            Clock::time_point due = start + offset;
+            Clock::time_point now = Clock::now();
+            if (due > now) {
+                std::this_thread::sleep_until(due);
+            } else {
+                stats.max_lag_ns = std::max<uint64_t>(stats.max_lag_ns,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count());
+            }
+        }
+
+        auto it = sockets.find(event->connection);
+        if (event->kind == CaptureKind::Close) {
+            if (it != sockets.end()) {
+                if (it->second >= 0) close(it->second);
+                sockets.erase(it);
+            }
+            ++stats.events;
+            continue;
+        }
+
+        if (it == sockets.end()) {
+            int fd = open_connection(address);
+            if (fd < 0) ++stats.failures;
+            else ++stats.connections;
+            it = sockets.emplace(event->connection, fd).first;
+        }
+
+        if (event->kind == CaptureKind::Data && it->second >= 0) {
+            if (write_all(it->second, event->data, event->length)) {
+                stats.bytes += event->length;
+            } else {
+                ++stats.failures;
+                close(it->second);
+                it->second = -1;
+            }
+        }
+        ++stats.events;
+    }
+
+    for (auto& [id, fd] : sockets) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    config.parse_args(argc, argv);
+
+    std::string path = config.get_string("capture");
+    if (config.has("help") || path.empty()) {
+        std::cout << "Использование: telemetry_replay --capture=<file> [опции]\n"
+                  << "  --host=<ip>        Адрес сервера (по умолчанию: 127.0.0.1)\n"
+                  << "  --port=<n>         Бинарный порт (по умолчанию: 9001)\n"
+                  << "  --speed=<x|max>    Скорость воспроизведения: 1 - реальное время, N - ускорение, max - без пауз\n"
+                  << "  --threads=<n>      Потоков воспроизведения (по умолчанию: 4)\n"
+                  << "  --loops=<n>        Сколько раз проиграть захват (по умолчанию: 1)\n"
+                  << "  --crc32c           Захват снят с порта CRC-32C: кадры без приветствия по 17 байт\n";
+        return path.empty() && !config.has("help") ? 1 : 0;
+    }
+
+    std::string speed_arg = config.get_string("speed", "1");
+    double speed = speed_arg == "max" ? 0.0 : std::max(0.001, config.get_double("speed", 1.0));
+    size_t threads = std::max(1, config.get_int("threads", 4));
+    int loops = std::max(1, config.get_int("loops", 1));
+
+    std::vector<uint8_t> content;
+    std::vector<ReplayEvent> events;
+    if (!load_capture(path, content, events)) {
+        std::cerr << "Не удалось прочитать файл захвата " << path << std::endl;
+        return 1;
+    }
+    if (events.empty()) {
+        std::cerr << "Файл захвата пуст" << std::endl;
+        return 1;
+    }
+
+    uint64_t samples_per_loop = count_samples(events, config.get_bool("crc32c"));
+
+    std::signal(SIGPIPE, SIG_IGN);
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.get_int("port", BINARY_PORT));
+    inet_pton(AF_INET, config.get_string("host", "127.0.0.1").c_str(), &address.sin_addr);
+
+    std::vector<std::vector<const ReplayEvent*>> partitions(threads);
+    for (const ReplayEvent& event : events) {
+        partitions[event.connection % threads].push_back(&event);
+    }
+
+    uint64_t base_ns = events.front().timestamp_ns;
+    double capture_seconds = (events.back().timestamp_ns - base_ns) / 1e9;
+    ReplayStats total;
+    Clock::time_point run_start = Clock::now();
+
+    for (int loop = 0; loop < loops; ++loop) {
+        std::vector<ReplayStats> stats(threads);
+        std::vector<std::thread> workers;
+        Clock::time_point start = Clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back(replay_thread, std::cref(partitions[t]), std::cref(address), speed, start,
+                                 base_ns, std::ref(stats[t]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (const ReplayStats& s : stats) {
+            total.bytes += s.bytes;
+            total.events += s.events;
+            total.connections += s.connections;
+            total.failures += s.failures;
+            total.max_lag_ns = std::max(total.max_lag_ns, s.max_lag_ns);
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - run_start).count();
+    std::printf("{\"capture\": \"%s\", \"capture_seconds\": %.3f, \"speed\": \"%s\", \"loops\": %d, "
+                "\"events\": %llu, \"connections\": %llu, \"failures\": %llu, \"bytes\": %llu, "
+                "\"elapsed_s\": %.3f, \"mb_per_sec\": %.1f, \"samples\": %llu, \"samples_per_sec\": %.0f, \"max_lag_ms\": %.3f}\n",
+                path.c_str(), capture_seconds, speed_arg.c_str(), loops,
+                static_cast<unsigned long long>(total.events), static_cast<unsigned long long>(total.connections),
+                static_cast<unsigned long long>(total.failures), static_cast<unsigned long long>(total.bytes),
+                elapsed, total.bytes / elapsed / 1e6, static_cast<unsigned long long>(samples_per_loop * loops),
+                static_cast<double>(samples_per_loop * loops) / elapsed, total.max_lag_ns / 1e6);
+    return total.failures == 0 ? 0 : 1;
+}
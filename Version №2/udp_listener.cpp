@@ -0,0 +1,130 @@
+#include "udp_listener.hpp"
+#include "latency_histogram.hpp"
+#include "binary_message.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+static constexpr size_t FRAME_SIZE = 14;
+
+
+UdpListener::UdpListener(int port, size_t batch, int receive_buffer)
+    : port(port), batch(batch < 1 ? 1 : batch), receive_buffer(receive_buffer) {}
+
+UdpListener::~UdpListener() {
+    stop();
+}
+
+bool UdpListener::start() {
+    socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0) {
+        std::cerr << "Ошибка создания UDP сокета" << std::endl;
+        return false;
+    }
+    
+    int opt = 1;
+    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(socket_fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+    if (receive_buffer > 0) {
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+    }
+    
+    timeval timeout{};
+    timeout.tv_usec = 100000;
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    
+    if (bind(socket_fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Ошибка привязки UDP сокета" << std::endl;
+        close(socket_fd);
+        socket_fd = -1;
+        return false;
+    }
+    
+    producer = ingest_pipeline.register_producer();
+    thread = std::thread(&UdpListener::run, this);
+    return true;
+}
+
+void UdpListener::stop() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void UdpListener::run() {
+    std::vector<uint8_t> storage(batch * MAX_DATAGRAM);
+    std::vector<mmsghdr> messages(batch);
+    std::vector<iovec> iovecs(batch);
+    std::vector<uint8_t> controls(batch * CMSG_SPACE(sizeof(uint32_t)));
+    uint32_t kernel_drops_seen = 0;
+    
+    while (!stopping.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < batch; ++i) {
+            iovecs[i].iov_base = storage.data() + i * MAX_DATAGRAM;
+            iovecs[i].iov_len = MAX_DATAGRAM;
+            std::memset(&messages[i], 0, sizeof(mmsghdr));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = controls.data() + i * CMSG_SPACE(sizeof(uint32_t));
+            messages[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+        }
+        
+        int received = recvmmsg(socket_fd, messages.data(), static_cast<unsigned>(batch),
+                                MSG_WAITFORONE, nullptr);
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            std::cerr << "Ошибка recvmmsg" << std::endl;
+            break;
+        }
+        
+        StageTimer framing_timer(Stage::Framing);
+        producer->set_arrival(stage_clock_ns());
+        uint64_t frames = 0;
+        uint64_t malformed = 0;
+        for (int i = 0; i < received; ++i) {
+            const msghdr& hdr = messages[i].msg_hdr;
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    uint32_t drops;
+                    std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                    if (drops != kernel_drops_seen) {
+                        ingest_counters.udp_kernel_drops.add(drops - kernel_drops_seen);
+                        kernel_drops_seen = drops;
+                    }
+                }
+            }
+            
+            size_t length = messages[i].msg_len;
+            if ((hdr.msg_flags & MSG_TRUNC) || length == 0 || length % FRAME_SIZE != 0) {
+                ++malformed;
+                continue;
+            }
+            
+            const uint8_t* data = static_cast<const uint8_t*>(iovecs[i].iov_base);
+            frames += process_frames(data, length / FRAME_SIZE, *producer);
+        }
+        producer->flush();
+        
+        ingest_counters.udp_datagrams.add(received);
+        ingest_counters.udp_frames.add(frames);
+        if (malformed > 0) {
+            ingest_counters.udp_malformed.add(malformed);
+        }
+    }
+    
+    producer->close();
+    close(socket_fd);
+    socket_fd = -1;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "ingest_pipeline.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+
+class UdpListener {
+public:
+    static constexpr size_t MAX_DATAGRAM = 9216;
+
+    UdpListener(int port, size_t batch, int receive_buffer);
+    ~UdpListener();
+
+    UdpListener(const UdpListener&) = delete;
+    UdpListener& operator=(const UdpListener&) = delete;
+
+    bool start();
+    void stop();
+
+private:
+    void run();
+
+    int port;
+    size_t batch;
+    int receive_buffer;
+
+    int socket_fd = -1;
+    IngestProducer* producer = nullptr;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+};
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""
+Тест форматов ответа: JSON, MessagePack, CBOR и выбор по весам Accept
+"""
+import json
+import socket
+import struct
+import sys
+import time
+import urllib.request
+
+HOST = 'localhost'
+BINARY_PORT = 9001
+HTTP_PORT = 8080
+
+failures = 0
+
+
+def check(condition, message):
+    global failures
+    if condition:
+        print(f"✓ {message}")
+    else:
+        failures += 1
+        print(f"✗ {message}")
+
+
+def create_message(device_id, value, timestamp):
+    data = bytes([device_id]) + struct.pack('>f', value) + struct.pack('>Q', timestamp)
+    crc = 0
+    for byte in data:
+        crc ^= byte
+    return data + bytes([crc])
+
+
+def send_sample(device_id, value, timestamp):
+    sock = socket.create_connection((HOST, BINARY_PORT), timeout=5)
+    sock.sendall(create_message(device_id, value, timestamp))
+    sock.close()
+
+
+def get(path, accept=None):
+    req = urllib.request.Request(f"http://{HOST}:{HTTP_PORT}{path}")
+    if accept is not None:
+        req.add_header('Accept', accept)
+    with urllib.request.urlopen(req, timeout=5) as response:
+        return response.headers.get('Content-Type', ''), response.read()
+
+
+def decode_msgpack(data, pos=0):
+    tag = data[pos]
+    pos += 1
+    if tag < 0x80:
+        return tag, pos
+    if 0x80 <= tag <= 0x8f or tag == 0xde:
+        size = tag & 0x0f
+        if tag == 0xde:
+            size = struct.unpack_from('>H', data, pos)[0]
+            pos += 2
+        result = {}
+        for _ in range(size):
+            key, pos = decode_msgpack(data, pos)
+            result[key], pos = decode_msgpack(data, pos)
+        return result, pos
+    if 0x90 <= tag <= 0x9f or tag in (0xdc, 0xdd):
+        size = tag & 0x0f
+        if tag == 0xdc:
+            size = struct.unpack_from('>H', data, pos)[0]
+            pos += 2
+        elif tag == 0xdd:
+            size = struct.unpack_from('>I', data, pos)[0]
+            pos += 4
+        result = []
+        for _ in range(size):
+            item, pos = decode_msgpack(data, pos)
+            result.append(item)
+        return result, pos
+    if 0xa0 <= tag <= 0xbf or tag in (0xd9, 0xda, 0xdb):
+        size = tag & 0x1f
+        if tag == 0xd9:
+            size = data[pos]
+            pos += 1
+        elif tag == 0xda:
+            size = struct.unpack_from('>H', data, pos)[0]
+            pos += 2
+        elif tag == 0xdb:
+            size = struct.unpack_from('>I', data, pos)[0]
+            pos += 4
+        return data[pos:pos + size].decode(), pos + size
+    formats = {0xcc: '>B', 0xcd: '>H', 0xce: '>I', 0xcf: '>Q', 0xcb: '>d'}
+    if tag in formats:
+        value = struct.unpack_from(formats[tag], data, pos)[0]
+        return value, pos + struct.calcsize(formats[tag])
+    raise ValueError(f"неизвестный тег MessagePack 0x{tag:02x}")
+
+
+def decode_cbor(data, pos=0):
+    head = data[pos]
+    pos += 1
+    major, info = head >> 5, head & 0x1f
+    if major == 7 and info == 27:
+        return struct.unpack_from('>d', data, pos)[0], pos + 8
+    if info < 24:
+        value = info
+    else:
+        size = 1 << (info - 24)
+        value = int.from_bytes(data[pos:pos + size], 'big')
+        pos += size
+    if major == 0:
+        return value, pos
+    if major == 3:
+        return data[pos:pos + value].decode(), pos + value
+    if major == 4:
+        result = []
+        for _ in range(value):
+            item, pos = decode_cbor(data, pos)
+            result.append(item)
+        return result, pos
+    if major == 5:
+        result = {}
+        for _ in range(value):
+            key, pos = decode_cbor(data, pos)
+            result[key], pos = decode_cbor(data, pos)
+        return result, pos
+    raise ValueError(f"неизвестный тип CBOR {major}")
+
+
+def test_formats():
+    print("Тест форматов ответа...")
+    timestamp = int(time.time())
+    send_sample(42, 12.5, timestamp)
+    time.sleep(0.5)
+
+    content_type, body = get("/device/42/latest")
+    reference = json.loads(body)
+    check(content_type.startswith("application/json") and reference['value'] == 12.5,
+          "JSON по умолчанию")
+
+    content_type, body = get("/device/42/latest", "application/msgpack")
+    decoded, end = decode_msgpack(body)
+    check(content_type == "application/msgpack" and end == len(body) and decoded == reference,
+          "MessagePack совпадает с JSON")
+
+    content_type, body = get("/device/42/latest", "application/cbor")
+    decoded, end = decode_cbor(body)
+    check(content_type == "application/cbor" and end == len(body) and decoded == reference,
+          "CBOR совпадает с JSON")
+
+
+def test_accept_weights():
+    print("\nТест весов q в Accept...")
+    cases = [
+        ("application/json;q=1, application/msgpack;q=0.1", "application/json"),
+        ("application/msgpack;q=0.5, application/cbor", "application/cbor"),
+        ("application/cbor;q=0, application/msgpack", "application/msgpack"),
+        ("application/msgpack;q=0", "application/json"),
+        ("application/msgpack; q=0.9, */*;q=0.8", "application/msgpack"),
+        ("application/cbor;q=0.3, application/msgpack;q=0.3", "application/cbor"),
+    ]
+    for accept, expected in cases:
+        content_type, _ = get("/device/42/latest", accept)
+        check(content_type.startswith(expected), f"Accept: {accept} -> {expected}")
+
+    content_type, _ = get("/metrics", "text/plain;q=0, application/json")
+    check(content_type.startswith("application/json"), "text/plain;q=0 для /metrics дает JSON")
+    content_type, _ = get("/metrics", "application/json;q=0.5, text/plain")
+    check(content_type.startswith("text/plain"), "text/plain с большим весом дает Prometheus")
+
+
+def main():
+    print("=" * 60)
+    print("ТЕСТ ФОРМАТОВ ОТВЕТА")
+    print("=" * 60)
+    test_formats()
+    test_accept_weights()
+    print("\n" + "=" * 60)
+    print("ТЕСТ ЗАВЕРШЕН" if failures == 0 else f"ОШИБОК: {failures}")
+    print("=" * 60)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
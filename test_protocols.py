@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Тест протоколов приема: старые кадры, приветствие TLM, пакетные кадры
+и кадры с CRC-32C (Version 2)
+"""
+import json
+import socket
+import struct
+import sys
+import time
+import urllib.request
+
+HOST = 'localhost'
+BINARY_PORT = 9001
+HTTP_PORT = 8080
+
+HELLO_BATCH = 0x01
+HELLO_LEGACY_CRC32C = 0x02
+HELLO_BATCH_CRC32C = 0x03
+
+failures = 0
+
+
+def check(condition, message):
+    global failures
+    if condition:
+        print(f"✓ {message}")
+    else:
+        failures += 1
+        print(f"✗ {message}")
+
+
+def xor_bytes(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+    return crc
+
+
+def crc32c(data):
+    crc = 0xffffffff
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82f63b78 if crc & 1 else 0)
+    return crc ^ 0xffffffff
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7f) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def legacy_frame(device_id, value, timestamp):
+    data = bytes([device_id]) + struct.pack('>f', value) + struct.pack('>Q', timestamp)
+    return data + bytes([xor_bytes(data)])
+
+
+def legacy_crc32c_frame(device_id, value, timestamp):
+    data = bytes([device_id]) + struct.pack('>f', value) + struct.pack('>Q', timestamp)
+    return data + struct.pack('>I', crc32c(data))
+
+
+def batch_frame(device_id, samples, crc=False):
+    base = samples[0][1]
+    body = bytes([0xB2 if crc else 0xB1, device_id]) + struct.pack('>Q', base) + varint(len(samples))
+    previous = base
+    for value, timestamp in samples:
+        body += varint(timestamp - previous) + struct.pack('>f', value)
+        previous = timestamp
+    return body + (struct.pack('>I', crc32c(body)) if crc else bytes([xor_bytes(body)]))
+
+
+def hello(version):
+    data = b'TLM' + bytes([version, 6])
+    return data + bytes([xor_bytes(data)])
+
+
+def send(payload):
+    sock = socket.create_connection((HOST, BINARY_PORT), timeout=5)
+    sock.sendall(payload)
+    time.sleep(0.2)
+    sock.close()
+
+
+def latest(device_id):
+    url = f"http://{HOST}:{HTTP_PORT}/device/{device_id}/latest"
+    try:
+        with urllib.request.urlopen(url, timeout=5) as response:
+            return json.loads(response.read())
+    except urllib.error.HTTPError:
+        return None
+
+
+def expect_latest(device_id, value, timestamp, message):
+    data = latest(device_id)
+    check(data is not None and data.get('value') == value and data.get('timestamp') == timestamp,
+          f"{message}: {data}")
+
+
+def test_legacy():
+    print("Старые 14-байтовые кадры...")
+    now = int(time.time())
+    send(legacy_frame(201, 1.5, now) + legacy_frame(201, 2.5, now + 1))
+    time.sleep(0.3)
+    expect_latest(201, 2.5, now + 1, "старый кадр без приветствия")
+
+
+def test_batch():
+    print("\nПриветствие и пакетные кадры...")
+    now = int(time.time())
+    samples = [(10.0 + i, now + i * 5) for i in range(20)]
+    send(hello(HELLO_BATCH) + batch_frame(202, samples[:10]) + batch_frame(202, samples[10:]))
+    time.sleep(0.3)
+    expect_latest(202, 29.0, now + 95, "пакетные кадры с XOR")
+
+    send(hello(HELLO_BATCH_CRC32C) + batch_frame(203, samples, crc=True))
+    time.sleep(0.3)
+    expect_latest(203, 29.0, now + 95, "пакетные кадры с CRC-32C")
+
+    send(hello(HELLO_LEGACY_CRC32C) + legacy_crc32c_frame(204, 7.25, now))
+    time.sleep(0.3)
+    expect_latest(204, 7.25, now, "17-байтовые кадры с CRC-32C")
+
+
+def test_ambiguous_prefix():
+    print("\nСтарый кадр, похожий на приветствие...")
+    # Устройство 84 — это 'T'; первые байты float дают 'L', 'M' и версию.
+    # Байт длины совпадает с приветствием, но контрольный байт нет.
+    for device_byte, tail, label in [(0x01, 0x00, "версия 0x01"), (0x03, 0x06, "версия 0x03 и длина 6")]:
+        value = struct.unpack('>f', bytes([ord('L'), ord('M'), device_byte, tail]))[0]
+        timestamp = int(time.time())
+        frame = legacy_frame(ord('T'), value, timestamp)
+        check(frame[:3] == b'TLM', f"кадр начинается с TLM ({label})")
+        send(frame + legacy_frame(ord('T'), value, timestamp + 1))
+        time.sleep(0.3)
+        expect_latest(ord('T'), value, timestamp + 1, f"кадр принят как старый ({label})")
+
+
+def main():
+    print("=" * 60)
+    print("ТЕСТ ПРОТОКОЛОВ ПРИЕМА")
+    print("=" * 60)
+    test_legacy()
+    test_batch()
+    test_ambiguous_prefix()
+    print("\n" + "=" * 60)
+    print("ТЕСТ ЗАВЕРШЕН" if failures == 0 else f"ОШИБОК: {failures}")
+    print("=" * 60)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Тест производных метрик и выборки по истории: /device/{id}/derived
+и /query, включая ответы 400 на ошибки разбора (Version 2)
+"""
+import json
+import socket
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+
+HOST = 'localhost'
+BINARY_PORT = 9001
+HTTP_PORT = 8080
+
+DEVICE = 160
+OTHER_DEVICE = 161
+SILENT_DEVICE = 255
+SAMPLES = 20
+
+failures = 0
+
+
+def check(condition, message):
+    global failures
+    if condition:
+        print(f"✓ {message}")
+    else:
+        failures += 1
+        print(f"✗ {message}")
+
+
+def create_message(device_id, value, timestamp):
+    data = bytes([device_id]) + struct.pack('>f', value) + struct.pack('>Q', timestamp)
+    crc = 0
+    for byte in data:
+        crc ^= byte
+    return data + bytes([crc])
+
+
+def send(payload):
+    sock = socket.create_connection((HOST, BINARY_PORT), timeout=5)
+    sock.sendall(payload)
+    time.sleep(0.2)
+    sock.close()
+
+
+def get(path):
+    try:
+        with urllib.request.urlopen(f"http://{HOST}:{HTTP_PORT}{path}", timeout=5) as response:
+            return response.status, json.loads(response.read())
+    except urllib.error.HTTPError as error:
+        return error.code, json.loads(error.read())
+
+
+def send_history():
+    # Метки в миллисекундах с шагом 1 мс: значения 0..19 у DEVICE и
+    # 100..119 у OTHER_DEVICE. Окно запросов привязано к base, а окна
+    # разных запусков не пересекаются, поэтому повторный запуск на том же
+    # сервере дает те же итоги.
+    base = int(time.time() * 1000)
+    payload = b''
+    for i in range(SAMPLES):
+        payload += create_message(DEVICE, float(i), base + i)
+        payload += create_message(OTHER_DEVICE, 100.0 + i, base + i)
+    send(payload)
+    time.sleep(0.3)
+    return base
+
+
+def test_derived(base):
+    print("Производные метрики...")
+    status, data = get(f"/device/{DEVICE}/derived")
+    check(status == 200, f"/device/{DEVICE}/derived отвечает 200")
+    if status != 200:
+        return
+    last = base + SAMPLES - 1
+    check(data.get('device_id') == DEVICE and data.get('value') == SAMPLES - 1 and data.get('timestamp') == last,
+          f"последний сэмпл: {data.get('value')} @ {data.get('timestamp')}")
+    check(data.get('samples', 0) >= SAMPLES, f"сэмплов учтено: {data.get('samples')}")
+    check(abs(data.get('rate', 0) - 1000.0) < 1e-6, f"скорость 1000 в секунду: {data.get('rate')}")
+    check(isinstance(data.get('ewma'), dict) and len(data['ewma']) > 0, f"EWMA: {data.get('ewma')}")
+    check(isinstance(data.get('alerts'), list), "список тревог")
+    for key in ('mean', 'stddev', 'z'):
+        check(isinstance(data.get(key), (int, float)), f"поле {key}: {data.get(key)}")
+
+    status, data = get(f"/device/{SILENT_DEVICE}/derived")
+    check(status == 404, f"устройство без данных: {status}")
+
+
+def test_query(base):
+    print("\nВыборка по истории...")
+    window = f"from={base}&to={base + SAMPLES - 1}"
+
+    status, data = get(f"/query?devices={DEVICE}&{window}&agg=count,sum,avg,min,max")
+    groups = data.get('groups', []) if status == 200 else []
+    check(status == 200 and len(groups) == 1, f"один итог без группировки: {status}")
+    if groups:
+        total = groups[0]
+        check(total.get('count') == SAMPLES and total.get('sum') == sum(range(SAMPLES)) and
+              total.get('min') == 0 and total.get('max') == SAMPLES - 1 and
+              total.get('avg') == (SAMPLES - 1) / 2, f"count, sum, avg, min, max: {total}")
+    check(data.get('devices') == 1 and 'chunks' in data, "число устройств и счетчики блоков")
+
+    status, data = get(f"/query?devices={DEVICE}&{window}&where=value>4,value<=10&agg=count,min,max")
+    groups = data.get('groups', []) if status == 200 else []
+    check(len(groups) == 1 and groups[0].get('count') == 6 and groups[0].get('min') == 5 and
+          groups[0].get('max') == 10, f"условие where: {groups}")
+
+    status, data = get(f"/query?devices={DEVICE}-{OTHER_DEVICE}&{window}&agg=count,max&group=device")
+    by_device = {group.get('device_id'): group for group in data.get('groups', [])} if status == 200 else {}
+    check(by_device.get(DEVICE, {}).get('max') == SAMPLES - 1 and
+          by_device.get(OTHER_DEVICE, {}).get('max') == 100 + SAMPLES - 1 and
+          all(group.get('count') == SAMPLES for group in by_device.values()),
+          f"группировка по устройству: {sorted(by_device)}")
+
+    status, data = get(f"/query?devices={DEVICE},{OTHER_DEVICE}&{window}&agg=count&group=none")
+    groups = data.get('groups', []) if status == 200 else []
+    check(len(groups) == 1 and groups[0].get('count') == 2 * SAMPLES, f"group=none по списку устройств: {groups}")
+
+    status, data = get(f"/query?devices={DEVICE}&from=-4&agg=count")
+    groups = data.get('groups', []) if status == 200 else []
+    check(len(groups) == 1 and groups[0].get('count') == 5 and data.get('from') == base + SAMPLES - 5,
+          f"отрицательный from от самой свежей метки: {groups}")
+
+
+def test_bad_requests():
+    print("\nОшибки разбора...")
+    cases = [
+        ("/query?agg=median", "agg"),
+        ("/query?devices=999", "devices"),
+        ("/query?devices=abc", "devices"),
+        ("/query?from=abc", "from"),
+        ("/query?to=1x", "to"),
+        ("/query?foo=1", "unknown parameter"),
+        ("/query?group=hour", "group"),
+        ("/query?where=value~5", "where"),
+    ]
+    for path, prefix in cases:
+        status, data = get(path)
+        check(status == 400 and data.get('error') == "Bad Request" and
+              data.get('message', '').startswith(prefix), f"{path} -> 400 ({data.get('message')})")
+
+
+def main():
+    print("=" * 60)
+    print("ТЕСТ ПРОИЗВОДНЫХ МЕТРИК И ЗАПРОСОВ")
+    print("=" * 60)
+    base = send_history()
+    test_derived(base)
+    test_query(base)
+    test_bad_requests()
+    print("\n" + "=" * 60)
+    print("ТЕСТ ЗАВЕРШЕН" if failures == 0 else f"ОШИБОК: {failures}")
+    print("=" * 60)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()